@@ -13,6 +13,7 @@
 */
 
 #include "ById.h"
+#include "LeftRight.h"
 
 #include <unordered_map>
 #include <typeinfo>
@@ -44,11 +45,14 @@ int IdAlloc::getNextId()
 
 class AnyById::Impl
 {
-public:    
+public:
+    Impl() { }
+    
     ~Impl() {
         QMutexLocker locker(&m_mutex);
+        const Items &items = m_items[m_leftRight.getFront()];
         bool empty = true;
-        for (const auto &p: m_items) {
+        for (const auto &p: items) {
             if (p.second && p.second.use_count() > 0) {
                 empty = false;
                 break;
@@ -57,7 +61,7 @@ public:
         if (!empty) {
             SVCERR << "WARNING: ById map is not empty at close; some items have not been released" << endl;
             SVCERR << "         Unreleased items are:" << endl;
-            for (const auto &p: m_items) {
+            for (const auto &p: items) {
                 auto ptr = p.second;
                 if (ptr && ptr.use_count() > 0) {
                     QString message = QString("id #%1: type %2")
@@ -83,15 +87,17 @@ public:
                << typeid(*item.get()).name() << endl;
 #endif
         QMutexLocker locker(&m_mutex);
-        if (m_items.find(id) != m_items.end()) {
+        const Items &current = m_items[m_leftRight.getFront()];
+        if (current.find(id) != current.end()) {
             SVCERR << "ById::add: item with id " << id
                    << " is already recorded (existing item type is "
-                   << typeid(*m_items.find(id)->second.get()).name()
+                   << typeid(*current.find(id)->second.get()).name()
                    << ", proposed is "
                    << typeid(*item.get()).name() << ")" << endl;
             throw std::logic_error("item id is already recorded in add");
         }
-        m_items[id] = item;
+        item->m_released->store(false, std::memory_order_release);
+        modify([&](Items &items) { items[id] = item; });
         return id;
     }
 
@@ -102,30 +108,53 @@ public:
 #ifdef DEBUG_BY_ID
         SVCERR << "ById::release(#" << id << ")" << endl;
 #endif
+        // Hold on to the item until after we have unlocked, so that
+        // its destructor (which may be substantial) is not called
+        // with the writer lock held
+        std::shared_ptr<WithId> item;
+        
         QMutexLocker locker(&m_mutex);
-        if (m_items.find(id) == m_items.end()) {
+        const Items &current = m_items[m_leftRight.getFront()];
+        auto itr = current.find(id);
+        if (itr == current.end()) {
             SVCERR << "ById::release: unknown item id " << id << endl;
             throw std::logic_error("unknown item id in release");
         }
-        m_items.erase(id);
+        item = itr->second;
+        item->m_released->store(true, std::memory_order_release);
+        modify([&](Items &items) { items.erase(id); });
+        locker.unlock();
     }
     
     std::shared_ptr<WithId> get(int id) const {
         if (id == IdAlloc::NO_ID) {
-            return {}; // this id cannot be added: avoid locking
+            return {}; // this id cannot be added: avoid registering
         }
-        QMutexLocker locker(&m_mutex);
-        const auto &itr = m_items.find(id);
-        if (itr != m_items.end()) {
+
+        LeftRight::ReadGuard guard(m_leftRight);
+        const Items &items = m_items[guard.getIndex()];
+        const auto &itr = items.find(id);
+        if (itr != items.end()) {
             return itr->second;
-        } else {
-            return {};
         }
+        return {};
     }
 
 private:
-    mutable QMutex m_mutex;
-    std::unordered_map<int, std::shared_ptr<WithId>> m_items;
+    typedef std::unordered_map<int, std::shared_ptr<WithId>> Items;
+
+    // Two copies of the map in a left-right arrangement (see
+    // LeftRight), so that readers never block. Writers (add and
+    // release, which are rare) serialise on m_mutex.
+    
+    Items m_items[2];
+    LeftRight m_leftRight;
+    QMutex m_mutex;
+
+    template <typename Modifier>
+    void modify(Modifier modifier) {
+        m_leftRight.modify(m_items, modifier);
+    }
 };
 
 int
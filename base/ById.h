@@ -21,6 +21,7 @@
 #include <iostream>
 #include <climits>
 #include <stdexcept>
+#include <atomic>
 
 #include <QMutex>
 #include <QString>
@@ -98,6 +99,12 @@
  *
  * // application wants to be rid of the Thing
  * ThingById::release(thingId);
+ *
+ * Lookups do not take any lock, so many threads may look up the same
+ * object at once without contending. Code that repeatedly looks up
+ * the same object with getAs - in a per-column getter, for example -
+ * can use a ByIdHandle instead (see getHandle), which does the lookup
+ * and the cast only once.
  */
 
 //!!! to do: review how often we are calling getAs<...> when we could
@@ -152,13 +159,16 @@ class WithId
 {
 public:
     WithId() :
-        m_id(IdAlloc::getNextId()) {
+        m_id(IdAlloc::getNextId()),
+        m_released(std::make_shared<std::atomic<bool>>(false)) {
     }
     virtual ~WithId() {
     }
 
 protected:
     friend class AnyById;
+    template <typename Derived>
+    friend class ByIdHandle;
     
     /**
      * Return an id for this object. The id is a unique number for
@@ -169,8 +179,20 @@ protected:
         return m_id;
     }
 
+    /**
+     * Return true if this object has been released from the ById
+     * store it was added to.
+     */
+    bool isReleased() const {
+        return m_released->load(std::memory_order_acquire);
+    }
+
 private:
     int m_id;
+
+    // Shared so that a ByIdHandle can observe release without either
+    // holding a reference to the object or looking it up again
+    std::shared_ptr<std::atomic<bool>> m_released;
 };
 
 template <typename T>
@@ -221,6 +243,88 @@ private:
     static Impl &impl();
 };
 
+/**
+ * A handle on an item in a ById store, cast to type Derived. The item
+ * is looked up and cast once, when the handle is constructed, after
+ * which get() returns the same as AnyById::getAs<Derived> would - the
+ * item, or null if it has since been released - without consulting
+ * the store at all.
+ *
+ * If the item was not in the store when the handle was constructed,
+ * get() falls back to looking it up every time.
+ *
+ * A handle does not keep its item alive, and once constructed it may
+ * be used from any number of threads at once.
+ */
+template <typename Derived>
+class ByIdHandle
+{
+public:
+    ByIdHandle() :
+        m_id(IdAlloc::NO_ID),
+        m_found(false),
+        m_derived(nullptr) { }
+    
+    explicit ByIdHandle(int id) :
+        m_id(id),
+        m_found(false),
+        m_derived(nullptr) {
+        std::shared_ptr<WithId> p = AnyById::get(id);
+        if (p) {
+            m_found = true;
+            m_item = p;
+            m_released = p->m_released;
+            m_derived = dynamic_cast<Derived *>(p.get());
+        }
+    }
+
+    ByIdHandle(const ByIdHandle &) =default;
+    ByIdHandle &operator=(const ByIdHandle &) =default;
+
+    std::shared_ptr<Derived> get() const {
+        if (!m_found) {
+            return AnyById::getAs<Derived>(m_id);
+        }
+        if (!m_derived) {
+            return {};
+        }
+        if (m_released->load(std::memory_order_acquire)) {
+            return {};
+        }
+        std::shared_ptr<WithId> p = m_item.lock();
+        if (!p || p->isReleased()) {
+            return {};
+        }
+        // Share ownership with p, but point to the already-cast object
+        return std::shared_ptr<Derived>(p, m_derived);
+    }
+
+    /**
+     * Return true if the object is still in the store, i.e. get()
+     * would return it. Once the handle has found its object, this is
+     * a single atomic load: it neither looks the id up nor takes a
+     * reference to the object, so it is cheap enough to call on
+     * every iteration of a processing loop.
+     */
+    bool isLive() const {
+        if (!m_found) {
+            return bool(AnyById::getAs<Derived>(m_id));
+        }
+        return m_derived && !m_released->load(std::memory_order_acquire);
+    }
+
+    int getUntypedId() const {
+        return m_id;
+    }
+
+private:
+    int m_id;
+    bool m_found;
+    std::weak_ptr<WithId> m_item;
+    std::shared_ptr<std::atomic<bool>> m_released;
+    Derived *m_derived;
+};
+
 template <typename Item, typename Id>
 class TypedById
 {
@@ -251,6 +355,16 @@ public:
     static std::shared_ptr<Item> get(Id id) {
         return getAs<Item>(id);
     }
+
+    /**
+     * Return a handle through which the item with the given id, cast
+     * to Derived, can be retrieved repeatedly without a lookup or
+     * cast each time. See ByIdHandle.
+     */
+    template <typename Derived>
+    static ByIdHandle<Derived> getHandle(Id id) {
+        return ByIdHandle<Derived>(id.untyped);
+    }
     
     /**
      * If the Item type is an XmlExportable, return the export ID of
@@ -20,6 +20,7 @@
 #include "NoteData.h"
 #include "XmlExportable.h"
 #include "DataExportOptions.h"
+#include "SymbolTable.h"
 
 #include <vector>
 #include <stdexcept>
@@ -47,6 +48,9 @@ static uint qHash(float key, uint seed = 0) {
  * has numerical value, level, duration in frames, and a mapped
  * reference frame. Event has an operator< defining a total ordering,
  * by frame first and then by the other properties.
+ *
+ * Labels and URIs are held as SymbolTable ids, so an event does not
+ * carry its own copy of either string.
  * 
  * Event is based on the Clipboard::Point type up to SV v3.2.1 and is
  * intended also to replace the custom point types previously found in
@@ -56,34 +60,37 @@ class Event
 {
 public:
     Event() :
+        m_frame(0), m_duration(0), m_referenceFrame(0),
+        m_value(0.f), m_level(0.f), m_label(0), m_uri(0),
         m_haveValue(false), m_haveLevel(false),
-        m_haveDuration(false), m_haveReferenceFrame(false),
-        m_value(0.f), m_level(0.f), m_frame(0),
-        m_duration(0), m_referenceFrame(0), m_label() { }
+        m_haveDuration(false), m_haveReferenceFrame(false) { }
     
     Event(sv_frame_t frame) :
+        m_frame(frame), m_duration(0), m_referenceFrame(0),
+        m_value(0.f), m_level(0.f), m_label(0), m_uri(0),
         m_haveValue(false), m_haveLevel(false),
-        m_haveDuration(false), m_haveReferenceFrame(false),
-        m_value(0.f), m_level(0.f), m_frame(frame),
-        m_duration(0), m_referenceFrame(0), m_label() { }
+        m_haveDuration(false), m_haveReferenceFrame(false) { }
         
     Event(sv_frame_t frame, QString label) :
-        m_haveValue(false), m_haveLevel(false), 
-        m_haveDuration(false), m_haveReferenceFrame(false),
-        m_value(0.f), m_level(0.f), m_frame(frame),
-        m_duration(0), m_referenceFrame(0), m_label(label) { }
+        m_frame(frame), m_duration(0), m_referenceFrame(0),
+        m_value(0.f), m_level(0.f),
+        m_label(SymbolTable::intern(label)), m_uri(0),
+        m_haveValue(false), m_haveLevel(false),
+        m_haveDuration(false), m_haveReferenceFrame(false) { }
         
     Event(sv_frame_t frame, float value, QString label) :
-        m_haveValue(true), m_haveLevel(false), 
-        m_haveDuration(false), m_haveReferenceFrame(false),
-        m_value(value), m_level(0.f), m_frame(frame),
-        m_duration(0), m_referenceFrame(0), m_label(label) { }
+        m_frame(frame), m_duration(0), m_referenceFrame(0),
+        m_value(value), m_level(0.f),
+        m_label(SymbolTable::intern(label)), m_uri(0),
+        m_haveValue(true), m_haveLevel(false),
+        m_haveDuration(false), m_haveReferenceFrame(false) { }
         
     Event(sv_frame_t frame, float value, sv_frame_t duration, QString label) :
-        m_haveValue(true), m_haveLevel(false), 
-        m_haveDuration(true), m_haveReferenceFrame(false),
-        m_value(value), m_level(0.f), m_frame(frame),
-        m_duration(duration), m_referenceFrame(0), m_label(label) {
+        m_frame(frame), m_duration(duration), m_referenceFrame(0),
+        m_value(value), m_level(0.f),
+        m_label(SymbolTable::intern(label)), m_uri(0),
+        m_haveValue(true), m_haveLevel(false),
+        m_haveDuration(true), m_haveReferenceFrame(false) {
         if (m_duration < 0) {
             m_frame += m_duration;
             m_duration = -m_duration;
@@ -92,10 +99,11 @@ public:
         
     Event(sv_frame_t frame, float value, sv_frame_t duration,
           float level, QString label) :
-        m_haveValue(true), m_haveLevel(true), 
-        m_haveDuration(true), m_haveReferenceFrame(false),
-        m_value(value), m_level(level), m_frame(frame),
-        m_duration(duration), m_referenceFrame(0), m_label(label) {
+        m_frame(frame), m_duration(duration), m_referenceFrame(0),
+        m_value(value), m_level(level),
+        m_label(SymbolTable::intern(label)), m_uri(0),
+        m_haveValue(true), m_haveLevel(true),
+        m_haveDuration(true), m_haveReferenceFrame(false) {
         if (m_duration < 0) {
             m_frame += m_duration;
             m_duration = -m_duration;
@@ -154,21 +162,21 @@ public:
         return p;
     }
 
-    bool hasLabel() const { return m_label != QString(); }
-    QString getLabel() const { return m_label; }
+    bool hasLabel() const { return m_label != 0; }
+    QString getLabel() const { return SymbolTable::lookup(m_label); }
 
     Event withLabel(QString label) const {
         Event p(*this);
-        p.m_label = label;
+        p.m_label = SymbolTable::intern(label);
         return p;
     }
 
-    bool hasUri() const { return m_uri != QString(); }
-    QString getURI() const { return m_uri; }
+    bool hasUri() const { return m_uri != 0; }
+    QString getURI() const { return SymbolTable::lookup(m_uri); }
 
     Event withURI(QString uri) const {
         Event p(*this);
-        p.m_uri = uri;
+        p.m_uri = SymbolTable::intern(uri);
         return p;
     }
     
@@ -227,6 +235,7 @@ public:
         if (m_haveReferenceFrame &&
             (m_referenceFrame != p.m_referenceFrame)) return false;
         
+        // interned, so equal strings have equal ids
         if (m_label != p.m_label) return false;
         if (m_uri != p.m_uri) return false;
         
@@ -273,10 +282,16 @@ public:
             return m_referenceFrame < p.m_referenceFrame;
         }
         
+        // order by text, not by id, which depends on the order in
+        // which the strings happened to be interned - but only look
+        // at the text if the ids differ
         if (m_label != p.m_label) {
-            return m_label < p.m_label;
+            return SymbolTable::compare(m_label, p.m_label) < 0;
+        }
+        if (m_uri != p.m_uri) {
+            return SymbolTable::compare(m_uri, p.m_uri) < 0;
         }
-        return m_uri < p.m_uri;
+        return false;
     }
 
     struct ExportNameOptions {
@@ -316,12 +331,12 @@ public:
         }
 
         stream << QString("label=\"%1\" ")
-            .arg(XmlExportable::encodeEntities(m_label));
+            .arg(XmlExportable::encodeEntities(getLabel()));
         
-        if (m_uri != QString()) {
+        if (hasUri()) {
             stream << QString("%1=\"%2\" ")
                 .arg(opts.uriAttributeName)
-                .arg(XmlExportable::encodeEntities(m_uri));
+                .arg(XmlExportable::encodeEntities(getURI()));
         }
         stream << extraAttributes << "/>\n";
     }
@@ -404,7 +419,7 @@ public:
             }
         }
         
-        if (m_uri != "") {
+        if (hasUri()) {
             list << nameOpts.uriAttributeName;
         }
         
@@ -453,8 +468,8 @@ public:
         // used in the custom Image model exporter. We shouldn't
         // change the column ordering unless (until?) we provide a
         // facility for the user to customise it
-        if (m_uri != "") list << m_uri;
-        if (m_label != "") list << m_label;
+        if (hasUri()) list << getURI();
+        if (hasLabel()) list << getLabel();
 
         return list.toVector();
     }
@@ -466,7 +481,7 @@ public:
         h ^= qHash(m_frame);
         if (m_haveDuration) h ^= qHash(m_duration);
         if (m_haveReferenceFrame) h ^= qHash(m_referenceFrame);
-        h ^= qHash(m_uri);
+        h ^= qHash(uint(m_uri));
         return h;
     }
     
@@ -474,17 +489,20 @@ private:
     // The order of fields here is chosen to minimise overall size of struct.
     // We potentially store very many of these objects.
     // If you change something, check what difference it makes to packing.
-    bool m_haveValue : 1;
-    bool m_haveLevel : 1;
-    bool m_haveDuration : 1;
-    bool m_haveReferenceFrame : 1;
-    float m_value;
-    float m_level;
+    // Labels and URIs are interned (see SymbolTable) as they are
+    // typically repeated very many times, and the flags share a word
+    // with the URI id, giving 40 bytes in all on 64-bit platforms.
     sv_frame_t m_frame;
     sv_frame_t m_duration;
     sv_frame_t m_referenceFrame;
-    QString m_label;
-    QString m_uri;
+    float m_value;
+    float m_level;
+    SymbolTable::Id m_label;
+    SymbolTable::Id m_uri : SymbolTable::IdBits;
+    SymbolTable::Id m_haveValue : 1;
+    SymbolTable::Id m_haveLevel : 1;
+    SymbolTable::Id m_haveDuration : 1;
+    SymbolTable::Id m_haveReferenceFrame : 1;
 };
 
 inline uint qHash(const Event &e, uint seed = 0) {
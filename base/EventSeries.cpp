@@ -16,285 +16,412 @@
 
 #include <QMutexLocker>
 
+#include <algorithm>
+#include <limits>
+
 using std::vector;
 using std::string;
 
-EventSeries::EventSeries(const EventSeries &other) :
-    EventSeries(other, QMutexLocker(&other.m_mutex))
+class EventSeries::ReadGuard
 {
-}
+public:
+    ReadGuard(const EventSeries &s) :
+        m_guard(s.m_leftRight),
+        m_contents(&s.m_contents[m_guard.getIndex()]) { }
+
+    const Contents &contents() const {
+        return *m_contents;
+    }
+
+private:
+    LeftRight::ReadGuard m_guard;
+    const Contents *m_contents;
+
+    ReadGuard(const ReadGuard &) =delete;
+    ReadGuard &operator=(const ReadGuard &) =delete;
+};
 
-EventSeries::EventSeries(const EventSeries &other, const QMutexLocker &) :
-    m_events(other.m_events),
-    m_seams(other.m_seams),
-    m_finalDurationlessEventFrame(other.m_finalDurationlessEventFrame)
+EventSeries::EventSeries(const EventSeries &other)
 {
+    ReadGuard guard(other);
+    m_contents[0] = guard.contents();
+    m_contents[1] = m_contents[0];
 }
 
 EventSeries &
 EventSeries::operator=(const EventSeries &other)
 {
-    QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
-    m_events = other.m_events;
-    m_seams = other.m_seams;
-    m_finalDurationlessEventFrame = other.m_finalDurationlessEventFrame;
+    if (&other == this) {
+        return *this;
+    }
+    Contents contents;
+    {
+        ReadGuard guard(other);
+        contents = guard.contents();
+    }
+    replace(std::move(contents));
     return *this;
 }
 
 EventSeries &
 EventSeries::operator=(EventSeries &&other)
 {
-    QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
-    m_events = std::move(other.m_events);
-    m_seams = std::move(other.m_seams);
-    m_finalDurationlessEventFrame = std::move(other.m_finalDurationlessEventFrame);
+    if (&other == this) {
+        return *this;
+    }
+    Contents contents;
+    {
+        // Readers only ever use the front copy, and there can be no
+        // writer while we hold the mutex, so the back copy is ours to
+        // take. Clearing afterwards leaves both copies consistent.
+        QMutexLocker otherLocker(&other.m_mutex);
+        contents = std::move(other.m_contents[other.m_leftRight.getBack()]);
+    }
+    other.clear();
+    replace(std::move(contents));
     return *this;
 }
 
 bool
 EventSeries::operator==(const EventSeries &other) const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_events == other.m_events;
+    ReadGuard guard(*this), otherGuard(other);
+    return guard.contents().events == otherGuard.contents().events;
 }
 
 EventSeries
 EventSeries::fromEvents(const EventVector &v)
 {
+    Contents contents;
+    contents.events = v;
+    std::sort(contents.events.begin(), contents.events.end());
+    contents.buildSpans();
+
     EventSeries s;
-    for (const auto &e: v) {
-        s.add(e);
-    }
+    s.m_contents[1] = contents;
+    s.m_contents[0] = std::move(contents);
     return s;
 }
 
-bool
-EventSeries::isEmpty() const
+template <typename Modifier>
+void
+EventSeries::modify(Modifier modifier)
 {
     QMutexLocker locker(&m_mutex);
-    return m_events.empty();
-}
 
-int
-EventSeries::count() const
-{
-    QMutexLocker locker(&m_mutex);
-    if (m_events.size() > INT_MAX) {
-        throw std::logic_error("too many events");
-    }
-    return int(m_events.size());
+    m_leftRight.modify(m_contents, modifier);
+
+#ifdef DEBUG_EVENT_SERIES
+    std::cerr << "after modify:" << std::endl;
+    dumpEvents(m_contents[m_leftRight.getFront()]);
+    dumpSpans(m_contents[m_leftRight.getFront()]);
+#endif
 }
 
 void
-EventSeries::add(const Event &p)
+EventSeries::replace(Contents &&contents)
 {
     QMutexLocker locker(&m_mutex);
 
-    bool isUnique = true;
+    m_contents[m_leftRight.getBack()] = contents;
+    int old = m_leftRight.publish();
+    m_contents[old] = std::move(contents);
+}
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr != m_events.end() && *pitr == p) {
-        isUnique = false;
-    }
-    m_events.insert(pitr, p);
+void
+EventSeries::Contents::add(const Event &p)
+{
+    auto pitr = lower_bound(events.begin(), events.end(), p);
+    events.insert(pitr, p);
 
-    if (!p.hasDuration() && p.getFrame() > m_finalDurationlessEventFrame) {
-        m_finalDurationlessEventFrame = p.getFrame();
+    if (!p.hasDuration() && p.getFrame() > finalDurationlessEventFrame) {
+        finalDurationlessEventFrame = p.getFrame();
     }
     
-    if (p.hasDuration() && isUnique) {
-
-        const sv_frame_t frame = p.getFrame();
-        const sv_frame_t endFrame = p.getFrame() + p.getDuration();
+    if (p.hasDuration()) {
+        addSpan(p);
+    }
+}
 
-        createSeam(frame);
-        createSeam(endFrame);
+void
+EventSeries::Contents::addSorted(const EventVector &ee)
+{
+    if (!events.empty() && ee.front() < events.back()) {
+        // Some of them go in the middle
+        for (const auto &p: ee) {
+            add(p);
+        }
+        return;
+    }
 
-        // These calls must both succeed after calling createSeam above
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
+    events.insert(events.end(), ee.begin(), ee.end());
 
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                SVCERR << "ERROR: EventSeries::add: "
-                       << "reached end of seam map"
-                       << endl;
-                break;
-            }
-            i->second.push_back(p);
+    for (const auto &p: ee) {
+        if (p.hasDuration()) {
+            addSpan(p);
+        } else if (p.getFrame() > finalDurationlessEventFrame) {
+            finalDurationlessEventFrame = p.getFrame();
         }
     }
-
-#ifdef DEBUG_EVENT_SERIES
-    std::cerr << "after add:" << std::endl;
-    dumpEvents();
-    dumpSeams();
-#endif
 }
 
 void
-EventSeries::remove(const Event &p)
+EventSeries::Contents::remove(const Event &p)
 {
-    QMutexLocker locker(&m_mutex);
-
-    // If we are removing the last (unique) example of an event,
-    // then we also need to remove it from the seam map. If this
-    // is only one of multiple identical events, then we don't.
+    // If we are removing the last (unique) example of a durationless
+    // event, we may need to update finalDurationlessEventFrame
     bool isUnique = true;
         
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr == m_events.end() || *pitr != p) {
+    auto pitr = lower_bound(events.begin(), events.end(), p);
+    if (pitr == events.end() || *pitr != p) {
         // we don't know this event
         return;
     } else {
         auto nitr = pitr;
         ++nitr;
-        if (nitr != m_events.end() && *nitr == p) {
+        if (nitr != events.end() && *nitr == p) {
             isUnique = false;
         }
     }
 
-    m_events.erase(pitr);
+    events.erase(pitr);
 
     if (!p.hasDuration() && isUnique &&
-        p.getFrame() == m_finalDurationlessEventFrame) {
-        m_finalDurationlessEventFrame = 0;
-        for (auto ritr = m_events.rbegin(); ritr != m_events.rend(); ++ritr) {
+        p.getFrame() == finalDurationlessEventFrame) {
+        finalDurationlessEventFrame = 0;
+        for (auto ritr = events.rbegin(); ritr != events.rend(); ++ritr) {
             if (!ritr->hasDuration()) {
-                m_finalDurationlessEventFrame = ritr->getFrame();
+                finalDurationlessEventFrame = ritr->getFrame();
                 break;
             }
         }
     }
     
-    if (p.hasDuration() && isUnique) {
-            
-        const sv_frame_t frame = p.getFrame();
-        const sv_frame_t endFrame = p.getFrame() + p.getDuration();
+    if (p.hasDuration()) {
+        removeSpan(p);
+    }
+}
 
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
+void
+EventSeries::Contents::clear()
+{
+    events.clear();
+    spans.clear();
+    finalDurationlessEventFrame = 0;
+}
 
-#ifdef DEBUG_EVENT_SERIES
-        // This should be impossible if we found p in m_events above
-        if (i0 == m_seams.end() || i1 == m_seams.end()) {
-            SVCERR << "ERROR: EventSeries::remove: either frame " << frame
-                   << " or endFrame " << endFrame
-                   << " for event not found in seam map: event is "
-                   << p.toXmlString() << endl;
-        }
-#endif
+void
+EventSeries::Contents::buildSpans()
+{
+    spans.clear();
+    finalDurationlessEventFrame = 0;
 
-        // Remove any and all instances of p from the seam map; we
-        // are only supposed to get here if we are removing the
-        // last instance of p from the series anyway
-            
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                // This can happen only if we have a negative
-                // duration, which Event forbids
-                throw std::logic_error("unexpectedly reached end of map");
-            }
-            for (size_t j = 0; j < i->second.size(); ) {
-                if (i->second[j] == p) {
-                    i->second.erase(i->second.begin() + j);
-                } else {
-                    ++j;
-                }
+    // Because events is sorted by frame and then duration, each class
+    // of the span index receives its spans in order, and events
+    // sharing a span arrive together
+    
+    for (const Event &e: events) {
+        if (!e.hasDuration()) {
+            if (e.getFrame() > finalDurationlessEventFrame) {
+                finalDurationlessEventFrame = e.getFrame();
             }
+            continue;
+        }
+        int k = getSpanClass(e.getDuration());
+        if (!in_range_for(spans, k)) {
+            spans.resize(k + 1);
         }
+        SpanMap &map = spans[k];
+        Span span(e.getFrame(), e.getDuration());
+        if (!map.empty() && map.rbegin()->first == span) {
+            ++map.rbegin()->second;
+        } else {
+            map.emplace_hint(map.end(), span, 1);
+        }
+    }
+}
 
-        // Tidy up by removing any entries that are now identical
-        // to their predecessors
-            
-        std::vector<sv_frame_t> redundant;
+void
+EventSeries::Contents::addSpan(const Event &e)
+{
+    int k = getSpanClass(e.getDuration());
+    if (!in_range_for(spans, k)) {
+        spans.resize(k + 1);
+    }
+    ++spans[k][Span(e.getFrame(), e.getDuration())];
+}
+
+void
+EventSeries::Contents::removeSpan(const Event &e)
+{
+    int k = getSpanClass(e.getDuration());
+    if (!in_range_for(spans, k)) {
+        return;
+    }
+    SpanMap &map = spans[k];
+    auto itr = map.find(Span(e.getFrame(), e.getDuration()));
+    if (itr == map.end()) {
+        return;
+    }
+    if (--itr->second == 0) {
+        map.erase(itr);
+    }
+}
+
+void
+EventSeries::Contents::appendEventsSpanning(sv_frame_t start,
+                                            sv_frame_t end,
+                                            EventVector &out) const
+{
+    std::vector<Span> found;
 
-        auto pitr = m_seams.end();
-        if (i0 != m_seams.begin()) {
-            pitr = i0;
-            --pitr;
+    // Class 0 holds only events of zero duration, which span nothing
+    
+    for (int k = 1; in_range_for(spans, k); ++k) {
+
+        const SpanMap &map = spans[k];
+        if (map.empty()) {
+            continue;
         }
 
-        for (auto i = i0; i != m_seams.end(); ++i) {
-            if (pitr != m_seams.end() &&
-                seamsEqual(i->second, pitr->second)) {
-                redundant.push_back(i->first);
-            }
-            pitr = i;
-            if (i == i1) {
-                break;
+        // No event in this class can reach start if it begins as
+        // much as the class's maximum duration before it
+        
+        const sv_frame_t longest = getSpanClassMaxDuration(k);
+        sv_frame_t from = std::numeric_limits<sv_frame_t>::min();
+        if (start > from + longest) {
+            from = start - longest + 1;
+        }
+
+        for (auto itr = map.lower_bound(Span(from, 0));
+             itr != map.end() && itr->first.first < end; ++itr) {
+            if (itr->first.first + itr->first.second > start) {
+                found.push_back(itr->first);
             }
         }
+    }
+
+    std::sort(found.begin(), found.end());
 
-        for (sv_frame_t f: redundant) {
-            m_seams.erase(f);
+    for (const auto &span: found) {
+        auto pitr = lower_bound(events.begin(), events.end(),
+                                Event(span.first).withDuration(span.second));
+        while (pitr != events.end() &&
+               pitr->getFrame() == span.first &&
+               pitr->getDuration() == span.second) {
+            out.push_back(*pitr);
+            ++pitr;
         }
+    }
+}
 
-        // And remove any empty seams from the start of the map
-            
-        while (m_seams.begin() != m_seams.end() &&
-               m_seams.begin()->second.empty()) {
-            m_seams.erase(m_seams.begin());
+sv_frame_t
+EventSeries::Contents::getEndFrame() const
+{
+    sv_frame_t latest = 0;
+
+    if (events.empty()) return latest;
+    
+    latest = finalDurationlessEventFrame;
+
+    // Within each class of the span index, once we reach a start
+    // frame more than the class's maximum duration before the latest
+    // end found so far, nothing earlier can end any later
+    
+    for (int k = 0; in_range_for(spans, k); ++k) {
+        const sv_frame_t longest = getSpanClassMaxDuration(k);
+        const SpanMap &map = spans[k];
+        for (auto ritr = map.rbegin(); ritr != map.rend(); ++ritr) {
+            if (ritr->first.first + longest <= latest) {
+                break;
+            }
+            sv_frame_t end = ritr->first.first + ritr->first.second;
+            if (end > latest) {
+                latest = end;
+            }
         }
     }
 
-#ifdef DEBUG_EVENT_SERIES
-    std::cerr << "after remove:" << std::endl;
-    dumpEvents();
-    dumpSeams();
-#endif
+    return latest;
+}
+
+bool
+EventSeries::isEmpty() const
+{
+    ReadGuard guard(*this);
+    return guard.contents().events.empty();
+}
+
+int
+EventSeries::count() const
+{
+    ReadGuard guard(*this);
+    const Events &events = guard.contents().events;
+    if (events.size() > INT_MAX) {
+        throw std::logic_error("too many events");
+    }
+    return int(events.size());
+}
+
+void
+EventSeries::add(const Event &p)
+{
+    modify([&](Contents &c) { c.add(p); });
+}
+
+void
+EventSeries::addEvents(const EventVector &ee)
+{
+    if (ee.empty()) return;
+    
+    EventVector sorted(ee);
+    std::sort(sorted.begin(), sorted.end());
+    
+    modify([&](Contents &c) { c.addSorted(sorted); });
+}
+
+void
+EventSeries::remove(const Event &p)
+{
+    modify([&](Contents &c) { c.remove(p); });
 }
 
 bool
 EventSeries::contains(const Event &p) const
 {
-    QMutexLocker locker(&m_mutex);
-    return binary_search(m_events.begin(), m_events.end(), p);
+    ReadGuard guard(*this);
+    const Events &events = guard.contents().events;
+    return binary_search(events.begin(), events.end(), p);
 }
 
 void
 EventSeries::clear()
 {
-    QMutexLocker locker(&m_mutex);
-    m_events.clear();
-    m_seams.clear();
-    m_finalDurationlessEventFrame = 0;
+    modify([](Contents &c) { c.clear(); });
 }
 
 sv_frame_t
 EventSeries::getStartFrame() const
 {
-    QMutexLocker locker(&m_mutex);
-    if (m_events.empty()) return 0;
-    return m_events.begin()->getFrame();
+    ReadGuard guard(*this);
+    const Events &events = guard.contents().events;
+    if (events.empty()) return 0;
+    return events.begin()->getFrame();
 }
 
 sv_frame_t
 EventSeries::getEndFrame() const
 {
-    QMutexLocker locker(&m_mutex);
-
-    sv_frame_t latest = 0;
-
-    if (m_events.empty()) return latest;
-    
-    latest = m_finalDurationlessEventFrame;
-
-    if (m_seams.empty()) return latest;
-    
-    sv_frame_t lastSeam = m_seams.rbegin()->first;
-    if (lastSeam > latest) {
-        latest = lastSeam;
-    }
-
-    return latest;
+    ReadGuard guard(*this);
+    return guard.contents().getEndFrame();
 }
 
 EventVector
 EventSeries::getEventsSpanning(sv_frame_t frame,
                                sv_frame_t duration) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     EventVector span;
     
@@ -303,37 +430,18 @@ EventSeries::getEventsSpanning(sv_frame_t frame,
         
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
+    auto pitr = lower_bound(c.events.begin(), c.events.end(),
                             Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
+    while (pitr != c.events.end() && pitr->getFrame() < end) {
         if (!pitr->hasDuration()) {
             span.push_back(*pitr);
         }
         ++pitr;
     }
 
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the span index
 
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(start);
-    if (sitr == m_seams.end() || sitr->first > start) {
-        if (sitr != m_seams.begin()) {
-            --sitr;
-        }                
-    }
-    while (sitr != m_seams.end() && sitr->first < end) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            span.push_back(p);
-            ++pitr;
-        }
-    }
+    c.appendEventsSpanning(start, end, span);
             
     return span;
 }
@@ -343,7 +451,8 @@ EventSeries::getEventsWithin(sv_frame_t frame,
                              sv_frame_t duration,
                              int overspill) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     EventVector span;
     
@@ -351,16 +460,16 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     const sv_frame_t end = frame + duration;
 
     // because we don't need to "look back" at events that end within
-    // but started without, we can do this entirely from m_events.
+    // but started without, we can do this entirely from the events vector.
     // The core operation is very simple, it's just overspill that
     // complicates it.
 
     Events::const_iterator reference = 
-        lower_bound(m_events.begin(), m_events.end(), Event(start));
+        lower_bound(c.events.begin(), c.events.end(), Event(start));
 
     Events::const_iterator first = reference;
     for (int i = 0; i < overspill; ++i) {
-        if (first == m_events.begin()) break;
+        if (first == c.events.begin()) break;
         --first;
     }
     for (int i = 0; i < overspill; ++i) {
@@ -372,7 +481,7 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     Events::const_iterator pitr = reference;
     Events::const_iterator last = reference;
 
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
+    while (pitr != c.events.end() && pitr->getFrame() < end) {
         if (!pitr->hasDuration() ||
             (pitr->getFrame() + pitr->getDuration() <= end)) {
             span.push_back(*pitr);
@@ -383,7 +492,7 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     }
 
     for (int i = 0; i < overspill; ++i) {
-        if (last == m_events.end()) break;
+        if (last == c.events.end()) break;
         span.push_back(*last);
         ++last;
     }
@@ -395,7 +504,8 @@ EventVector
 EventSeries::getEventsStartingWithin(sv_frame_t frame,
                                      sv_frame_t duration) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     EventVector span;
     
@@ -404,11 +514,11 @@ EventSeries::getEventsStartingWithin(sv_frame_t frame,
 
     // because we don't need to "look back" at events that started
     // earlier than the start of the given range, we can do this
-    // entirely from m_events
+    // entirely from the events vector
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
+    auto pitr = lower_bound(c.events.begin(), c.events.end(),
                             Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
+    while (pitr != c.events.end() && pitr->getFrame() < end) {
         span.push_back(*pitr);
         ++pitr;
     }
@@ -419,43 +529,25 @@ EventSeries::getEventsStartingWithin(sv_frame_t frame,
 EventVector
 EventSeries::getEventsCovering(sv_frame_t frame) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     EventVector cover;
 
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
+    auto pitr = lower_bound(c.events.begin(), c.events.end(),
                             Event(frame));
-    while (pitr != m_events.end() && pitr->getFrame() == frame) {
+    while (pitr != c.events.end() && pitr->getFrame() == frame) {
         if (!pitr->hasDuration()) {
             cover.push_back(*pitr);
         }
         ++pitr;
     }
         
-    // now any non-zero-duration ones from the seam map
-        
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(frame);
-    if (sitr == m_seams.end() || sitr->first > frame) {
-        if (sitr != m_seams.begin()) {
-            --sitr;
-        }                
-    }
-    if (sitr != m_seams.end() && sitr->first <= frame) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            cover.push_back(p);
-            ++pitr;
-        }
-    }
+    // now any non-zero-duration ones from the span index
+
+    c.appendEventsSpanning(frame, frame + 1, cover);
         
     return cover;
 }
@@ -463,21 +555,23 @@ EventSeries::getEventsCovering(sv_frame_t frame) const
 EventVector
 EventSeries::getAllEvents() const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
-    return m_events;
+    return c.events;
 }
 
 bool
 EventSeries::getEventPreceding(const Event &e, Event &preceding) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    auto pitr = lower_bound(c.events.begin(), c.events.end(), e);
+    if (pitr == c.events.end() || *pitr != e) {
         return false;
     }
-    if (pitr == m_events.begin()) {
+    if (pitr == c.events.begin()) {
         return false;
     }
     --pitr;
@@ -488,15 +582,16 @@ EventSeries::getEventPreceding(const Event &e, Event &preceding) const
 bool
 EventSeries::getEventFollowing(const Event &e, Event &following) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    auto pitr = lower_bound(c.events.begin(), c.events.end(), e);
+    if (pitr == c.events.end() || *pitr != e) {
         return false;
     }
     while (*pitr == e) {
         ++pitr;
-        if (pitr == m_events.end()) {
+        if (pitr == c.events.end()) {
             return false;
         }
     }
@@ -510,21 +605,22 @@ EventSeries::getNearestEventMatching(sv_frame_t startSearchAt,
                                      Direction direction,
                                      Event &found) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
+    auto pitr = lower_bound(c.events.begin(), c.events.end(),
                             Event(startSearchAt));
 
     while (true) {
 
         if (direction == Backward) {
-            if (pitr == m_events.begin()) {
+            if (pitr == c.events.begin()) {
                 break;
             } else {
                 --pitr;
             }
         } else {
-            if (pitr == m_events.end()) {
+            if (pitr == c.events.end()) {
                 break;
             }
         }
@@ -546,19 +642,21 @@ EventSeries::getNearestEventMatching(sv_frame_t startSearchAt,
 Event
 EventSeries::getEventByIndex(int index) const
 {
-    QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_events, index)) {
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
+    if (!in_range_for(c.events, index)) {
         throw std::logic_error("index out of range");
     }
-    return m_events[index];
+    return c.events[index];
 }
 
 int
 EventSeries::getIndexForEvent(const Event &e) const
 {
-    QMutexLocker locker(&m_mutex);
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    auto d = distance(m_events.begin(), pitr);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
+    auto pitr = lower_bound(c.events.begin(), c.events.end(), e);
+    auto d = distance(c.events.begin(), pitr);
     if (d < 0 || d > INT_MAX) return 0;
     return int(d);
 }
@@ -568,13 +666,14 @@ EventSeries::toXml(QTextStream &out,
                    QString indent,
                    QString extraAttributes) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     out << indent << QString("<dataset id=\"%1\" %2>\n")
         .arg(getExportId())
         .arg(extraAttributes);
     
-    for (const auto &p: m_events) {
+    for (const auto &p: c.events) {
         p.toXml(out, indent + "  ", "", {});
     }
     
@@ -587,13 +686,14 @@ EventSeries::toXml(QTextStream &out,
                    QString extraAttributes,
                    Event::ExportNameOptions options) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     out << indent << QString("<dataset id=\"%1\" %2>\n")
         .arg(getExportId())
         .arg(extraAttributes);
     
-    for (const auto &p: m_events) {
+    for (const auto &p: c.events) {
         p.toXml(out, indent + "  ", "", options);
     }
     
@@ -604,10 +704,12 @@ QVector<QString>
 EventSeries::getStringExportHeaders(DataExportOptions opts,
                                     Event::ExportNameOptions nopts) const
 {
-    if (m_events.empty()) {
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
+    if (c.events.empty()) {
         return {};
     } else {
-        return m_events.begin()->getStringExportHeaders(opts, nopts);
+        return c.events.begin()->getStringExportHeaders(opts, nopts);
     }
 }
 
@@ -619,18 +721,19 @@ EventSeries::toStringExportRows(DataExportOptions options,
                                 sv_frame_t resolution,
                                 Event fillEvent) const
 {
-    QMutexLocker locker(&m_mutex);
+    ReadGuard guard(*this);
+    const Contents &c = guard.contents();
 
     QVector<QVector<QString>> rows;
 
     const sv_frame_t end = startFrame + duration;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
+    auto pitr = lower_bound(c.events.begin(), c.events.end(),
                             Event(startFrame));
             
     if (!(options & DataExportFillGaps)) {
         
-        while (pitr != m_events.end() && pitr->getFrame() < end) {
+        while (pitr != c.events.end() && pitr->getFrame() < end) {
             rows.push_back(pitr->toStringExportRow(options, sampleRate));
             ++pitr;
         }
@@ -639,7 +742,7 @@ EventSeries::toStringExportRows(DataExportOptions options,
         
         // find frame time of first point in range (if any)
         sv_frame_t first = startFrame;
-        if (pitr != m_events.end()) {
+        if (pitr != c.events.end()) {
             first = pitr->getFrame();
         }
 
@@ -654,7 +757,7 @@ EventSeries::toStringExportRows(DataExportOptions options,
         // now progress, either writing the next point (if within
         // distance) or a default fill point
         while (f < end) {
-            if (pitr != m_events.end() && pitr->getFrame() <= f) {
+            if (pitr != c.events.end() && pitr->getFrame() <= f) {
                 rows.push_back(pitr->toStringExportRow
                                (options & ~DataExportFillGaps,
                                 sampleRate));
@@ -17,8 +17,10 @@
 
 #include "Event.h"
 #include "XmlExportable.h"
+#include "LeftRight.h"
 
 #include <set>
+#include <map>
 #include <string>
 #include <vector>
 #include <functional>
@@ -32,24 +34,30 @@
  * and supporting the ability to query which events are active at a
  * given frame or within a span of frames.
  *
- * To that end, in addition to the series of events, it stores a
- * series of "seams", which are frame positions at which the set of
- * simultaneous events changes (i.e. an event of non-zero duration
- * starts or ends) associated with a set of the events that are active
- * at or from that position. These are updated when an event is added
- * or removed.
+ * To that end, in addition to the series of events, it stores an
+ * index of the start frames and durations of events with duration,
+ * grouped by length, from which the events overlapping a given range
+ * can be found without scanning back through the whole series. This
+ * is updated when an event is added or removed.
  *
  * This class is highly optimised for inserting events in increasing
  * order of start frame. Inserting (or deleting) events in the middle
  * does work, and should be acceptable in interactive use, but it is
  * very slow in bulk.
  *
- * EventSeries is thread-safe.
+ * EventSeries is thread-safe. Readers never take a lock: the series
+ * keeps two copies of its contents, and a writer modifies the copy
+ * that readers are not using, publishes it, waits for any readers
+ * still using the other copy to finish, and then applies the same
+ * modification to that one (see LeftRight). Writers are serialised
+ * with a mutex, and each write costs about twice what it would in a
+ * single copy, but readers are never held up by a writer and only a
+ * writer ever waits.
  */
 class EventSeries : public XmlExportable
 {
 public:
-    EventSeries() : m_finalDurationlessEventFrame(0) { }
+    EventSeries() { }
     ~EventSeries() =default;
 
     EventSeries(const EventSeries &);
@@ -59,10 +67,27 @@ public:
     
     bool operator==(const EventSeries &other) const;
 
+    /**
+     * Construct a series containing the given events, which need not
+     * be sorted. This is much faster than adding the events one at a
+     * time to an empty series: the events are sorted once and the
+     * span index is then built in a single pass over them.
+     */
     static EventSeries fromEvents(const EventVector &ee);
     
     void clear();
     void add(const Event &e);
+
+    /**
+     * Add all of the given events, which need not be sorted, in a
+     * single write. This is much cheaper than adding them one at a
+     * time, as the new contents are published to readers once for the
+     * whole batch rather than once per event, and events that all
+     * follow the existing ones (the usual case when a series is being
+     * filled in order) are appended in one go.
+     */
+    void addEvents(const EventVector &ee);
+
     void remove(const Event &e);
     bool contains(const Event &e) const;
     bool isEmpty() const;
@@ -148,7 +173,7 @@ public:
      * Retrieve all events, in their natural order.
      */
     EventVector getAllEvents() const;
-    
+
     /**
      * If e is in the series and is not the first event in it, set
      * preceding to the event immediate preceding it according to the
@@ -243,10 +268,6 @@ public:
                        Event fillEvent) const;
     
 private:
-    mutable QMutex m_mutex;
-
-    EventSeries(const EventSeries &other, const QMutexLocker &);
-    
     /**
      * This vector contains all events in the series, in the normal
      * sort order. For backward compatibility we must support series
@@ -261,116 +282,152 @@ private:
      * delete them.
      */
     typedef std::vector<Event> Events;
-    Events m_events;
     
     /**
-     * The FrameEventMap maps from frame number to a set of events. In
-     * the seam map this is used to represent the events that are
-     * active at that frame, either because they begin at that frame
-     * or because they are continuing from an earlier frame. There is
-     * an entry here for each frame at which an event starts or ends,
-     * with the event appearing in all entries from its start time
-     * onward and disappearing again at its end frame.
+     * A Span is the start frame and duration of an event with
+     * duration. The span index records, for each distinct span, how
+     * many events in the series have it; the events themselves live
+     * only in the events vector, where all those sharing a span are
+     * adjacent and can be found by binary search. So the index is
+     * linear in the number of events however much they overlap.
      *
-     * Only events with duration appear in this map; point events
-     * appear only in m_events. Note that unlike m_events, we only
-     * store one instance of each event here, even if we hold many -
-     * we refer back to m_events when we need to know how many
-     * identical copies of a given event we have.
+     * The index is split into classes by duration: class 0 holds
+     * events of zero duration and class c > 0 holds those with
+     * duration from 2^(c-1) to 2^c - 1. Within a class, an event
+     * overlapping a given frame must start no more than the class's
+     * maximum duration before it, which bounds the range of each map
+     * we have to search to answer getEventsSpanning or
+     * getEventsCovering. Point events do not appear here at all.
      */
-    typedef std::map<sv_frame_t, std::vector<Event>> FrameEventMap;
-    FrameEventMap m_seams;
+    typedef std::pair<sv_frame_t, sv_frame_t> Span;
+    typedef std::map<Span, int> SpanMap;
 
     /**
-     * The frame of the last durationless event we have in the series.
-     * This is to support a fast-ish getEndFrame(): we can easily keep
-     * this up-to-date when events are added or removed, and we can
-     * easily find the end frame of the last with-duration event from
-     * the seam map, but it's not so easy to continuously update an
-     * overall end frame or to find the last frame of all events
-     * without this.
+     * One complete copy of the contents of the series. We keep two of
+     * these; see the class documentation.
      */
-    sv_frame_t m_finalDurationlessEventFrame;
-    
-    /** 
-     * Create a seam at the given frame, copying from the prior seam
-     * if there is one. If a seam already exists at the given frame,
-     * leave it untouched.
-     *
-     * Call with m_mutex locked.
+    struct Contents {
+        
+        Contents() : finalDurationlessEventFrame(0) { }
+        
+        Events events;
+        std::vector<SpanMap> spans;
+
+        /**
+         * The frame of the last durationless event we have in the
+         * series. This is to support a fast-ish getEndFrame(): we
+         * can easily keep this up-to-date when events are added or
+         * removed, and we can easily find the end frame of the last
+         * with-duration event from the span index, but it's not so
+         * easy to continuously update an overall end frame or to
+         * find the last frame of all events without this.
+         */
+        sv_frame_t finalDurationlessEventFrame;
+
+        void add(const Event &e);
+        void remove(const Event &e);
+        void clear();
+
+        /**
+         * Add all of the given events, which must already be sorted.
+         */
+        void addSorted(const EventVector &ee);
+
+        /**
+         * Rebuild the span index and finalDurationlessEventFrame from
+         * scratch, from the contents of events, which must already be
+         * sorted.
+         */
+        void buildSpans();
+
+        /**
+         * Record or forget one instance of the span of the given
+         * event, which must have a duration.
+         */
+        void addSpan(const Event &e);
+        void removeSpan(const Event &e);
+
+        /**
+         * Append to the given vector all events with non-zero
+         * duration whose start frame is less than end and whose end
+         * frame is greater than start, in the normal sort order.
+         */
+        void appendEventsSpanning(sv_frame_t start, sv_frame_t end,
+                                  EventVector &out) const;
+
+        sv_frame_t getEndFrame() const;
+    };
+
+    /**
+     * Return the span index class for events of the given duration.
      */
-    void createSeam(sv_frame_t frame) {
-        auto itr = m_seams.lower_bound(frame);
-        if (itr == m_seams.end() || itr->first > frame) {
-            if (itr != m_seams.begin()) {
-                --itr;
-            }
-        }
-        if (itr == m_seams.end()) {
-            m_seams[frame] = {};
-        } else if (itr->first < frame) {
-            m_seams[frame] = itr->second;
-        } else if (itr->first > frame) { // itr must be begin()
-            m_seams[frame] = {};
+    static int getSpanClass(sv_frame_t duration) {
+        int c = 0;
+        while (duration > 0) {
+            ++c;
+            duration >>= 1;
         }
+        return c;
     }
 
-    /** 
-     * Return true if the two seam map entries contain the same set of
-     * events.
-     *
-     * Precondition: no duplicates, i.e. no event appears more than
-     * once in s1 or more than once in s2.
-     *
-     * Call with m_mutex locked.
+    /**
+     * Return the longest duration an event in the given span index
+     * class can have.
      */
-    bool seamsEqual(const std::vector<Event> &s1,
-                    const std::vector<Event> &s2) const {
-        
-        if (s1.size() != s2.size()) {
-            return false;
-        }
+    static sv_frame_t getSpanClassMaxDuration(int c) {
+        if (c == 0) return 0;
+        return sv_frame_t((uint64_t(1) << c) - 1);
+    }
 
-#ifdef DEBUG_EVENT_SERIES
-        for (int i = 0; in_range_for(s1, i); ++i) {
-            for (int j = i + 1; in_range_for(s1, j); ++j) {
-                if (s1[i] == s1[j] || s2[i] == s2[j]) {
-                    throw std::runtime_error
-                        ("debug error: duplicate event in s1 or s2");
-                }
-            }
-        }
-#endif
+    /**
+     * The two copies of the contents, and the left-right
+     * synchronisation that says which one readers should use.
+     */
+    Contents m_contents[2];
+    LeftRight m_leftRight;
 
-        std::set<Event> ee;
-        for (const auto &e: s1) {
-            ee.insert(e);
-        }
-        for (const auto &e: s2) {
-            if (ee.find(e) == ee.end()) {
-                return false;
-            }
-        }
-        return true;
-    }
+    /**
+     * Serialises writers. Readers never take it.
+     */
+    QMutex m_mutex;
+
+    /**
+     * Registers a reader for its lifetime and gives it the copy of
+     * the contents it should use.
+     */
+    class ReadGuard;
+
+    /**
+     * Apply the given modification to both copies of the contents,
+     * publishing the result to readers before modifying the copy
+     * they were using. The modification must be deterministic, as it
+     * is applied twice.
+     */
+    template <typename Modifier>
+    void modify(Modifier modifier);
+
+    /**
+     * Replace the contents outright.
+     */
+    void replace(Contents &&contents);
 
 #ifdef DEBUG_EVENT_SERIES
-    void dumpEvents() const {
-        std::cerr << "EVENTS (" << m_events.size() << ") [" << std::endl;
-        for (const auto &i: m_events) {
+    static void dumpEvents(const Contents &c) {
+        std::cerr << "EVENTS (" << c.events.size() << ") [" << std::endl;
+        for (const auto &i: c.events) {
             std::cerr << "  " << i.toXmlString();
         }
         std::cerr << "]" << std::endl;
     }
     
-    void dumpSeams() const {
-        std::cerr << "SEAMS (" << m_seams.size() << ") [" << std::endl;
-        for (const auto &s: m_seams) {
-            std::cerr << "  " << s.first << " -> {" << std::endl;
-            for (const auto &p: s.second) {
-                std::cerr << p.toXmlString("    ");
+    static void dumpSpans(const Contents &c) {
+        std::cerr << "SPANS [" << std::endl;
+        for (int k = 0; in_range_for(c.spans, k); ++k) {
+            for (const auto &s: c.spans[k]) {
+                std::cerr << "  " << k << ": " << s.first.first << " + "
+                          << s.first.second << " x " << s.second
+                          << std::endl;
             }
-            std::cerr << "  }" << std::endl;
         }
         std::cerr << "]" << std::endl;
     }
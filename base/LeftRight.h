@@ -0,0 +1,144 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_LEFT_RIGHT_H
+#define SV_LEFT_RIGHT_H
+
+#include <atomic>
+#include <thread>
+
+/**
+ * The synchronisation for a "left-right" arrangement, in which a
+ * structure is kept in two copies so that readers never have to
+ * block. Readers use the copy at the front. A writer modifies the
+ * copy at the back, publishes it, waits until no reader can still be
+ * using the old front copy, and then makes the same modification to
+ * that. Each write costs about twice what it would in a single copy,
+ * but readers are never held up and only a writer ever waits.
+ *
+ * This class holds only the index of the front copy and the reader
+ * counts. The owner holds the two copies, indexed 0 and 1, and must
+ * serialise its writers itself.
+ */
+class LeftRight
+{
+public:
+    LeftRight() : m_front(0), m_versionIndex(0) {
+        m_readers[0] = 0;
+        m_readers[1] = 0;
+    }
+
+    LeftRight(const LeftRight &) =delete;
+    LeftRight &operator=(const LeftRight &) =delete;
+
+    /**
+     * Registers a reader for its lifetime and tells it which copy to
+     * use.
+     */
+    class ReadGuard
+    {
+    public:
+        // Register with the reader count for the current version
+        // before finding out which copy to use: a writer that has
+        // published a new copy then waits for both counts to drain
+        // in turn, so it cannot modify the copy we pick until we
+        // have finished with it
+        ReadGuard(const LeftRight &lr) :
+            m_lr(lr),
+            m_versionIndex(lr.m_versionIndex.load()) {
+            ++m_lr.m_readers[m_versionIndex];
+            m_index = m_lr.m_front.load();
+        }
+
+        ~ReadGuard() {
+            --m_lr.m_readers[m_versionIndex];
+        }
+
+        /**
+         * Return the index of the copy this reader should use.
+         */
+        int getIndex() const { return m_index; }
+
+    private:
+        const LeftRight &m_lr;
+        int m_versionIndex;
+        int m_index;
+
+        ReadGuard(const ReadGuard &) =delete;
+        ReadGuard &operator=(const ReadGuard &) =delete;
+    };
+
+    /**
+     * Return the index of the copy readers are currently using. A
+     * writer may read this copy, but not modify it.
+     */
+    int getFront() const { return m_front.load(); }
+
+    /**
+     * Return the index of the copy readers are not using, which a
+     * writer may modify.
+     */
+    int getBack() const { return 1 - m_front.load(); }
+
+    /**
+     * Make the back copy the front one, and wait until no reader can
+     * still be using the copy that was at the front before. Return
+     * the index of that copy, which is now the back one.
+     */
+    int publish() {
+        int back = getBack();
+        m_front.store(back);
+        waitForReaders();
+        return 1 - back;
+    }
+
+    /**
+     * Apply the given modification to both of the given copies,
+     * publishing the result to readers before modifying the copy
+     * they were using. The modification must be deterministic, as it
+     * is applied twice.
+     */
+    template <typename T, typename Modifier>
+    void modify(T (&copies)[2], Modifier modifier) {
+        modifier(copies[getBack()]);
+        modifier(copies[publish()]);
+    }
+
+private:
+    std::atomic<int> m_front;
+    std::atomic<int> m_versionIndex;
+    mutable std::atomic<int> m_readers[2];
+
+    void waitForReaders() {
+        int prev = m_versionIndex.load();
+        int next = 1 - prev;
+
+        // Readers arriving from here on may see either copy, but all
+        // of them register against one version index or the
+        // other. Wait for the index we are about to switch to to be
+        // idle, switch, and then wait for the old one to drain:
+        // after that, nobody can be reading the copy that was in
+        // front before the last publish.
+
+        while (m_readers[next].load() != 0) {
+            std::this_thread::yield();
+        }
+        m_versionIndex.store(next);
+        while (m_readers[prev].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,415 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_RTREE_H
+#define SV_RTREE_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * A two-dimensional R-tree, storing values of type T each associated
+ * with a closed axis-aligned rectangle, and able to find all values
+ * whose rectangles intersect a given one. T must be copyable and
+ * support operator== (used to identify the value to remove).
+ *
+ * Values may be added and removed one at a time, or the tree may be
+ * bulk-loaded using sort-tile-recursive packing, which is much
+ * quicker and gives a better tree when all the values are known in
+ * advance.
+ *
+ * RTree is not thread-safe.
+ */
+template <typename T>
+class RTree
+{
+public:
+    struct Box {
+        Box() : x0(0), x1(0), y0(0), y1(0) { }
+        Box(double _x0, double _x1, double _y0, double _y1) :
+            x0(_x0), x1(_x1), y0(_y0), y1(_y1) { }
+
+        double x0, x1, y0, y1;
+
+        bool intersects(const Box &b) const {
+            return x0 <= b.x1 && b.x0 <= x1 && y0 <= b.y1 && b.y0 <= y1;
+        }
+        bool contains(const Box &b) const {
+            return x0 <= b.x0 && b.x1 <= x1 && y0 <= b.y0 && b.y1 <= y1;
+        }
+        void include(const Box &b) {
+            x0 = std::min(x0, b.x0);
+            x1 = std::max(x1, b.x1);
+            y0 = std::min(y0, b.y0);
+            y1 = std::max(y1, b.y1);
+        }
+        double centreX() const { return (x0 + x1) / 2.0; }
+        double centreY() const { return (y0 + y1) / 2.0; }
+
+        // The + 1 keeps degenerate (point or line) boxes, which are
+        // common here, from all having zero area
+        double area() const { return (x1 - x0 + 1.0) * (y1 - y0 + 1.0); }
+    };
+
+    typedef std::pair<Box, T> Item;
+
+    RTree() : m_root(new Node(true)), m_size(0) { }
+
+    size_t size() const { return m_size; }
+
+    void clear() {
+        m_root.reset(new Node(true));
+        m_size = 0;
+    }
+
+    void insert(const Box &box, const T &value) {
+        Node *leaf = chooseLeaf(box);
+        leaf->items.push_back(Item(box, value));
+        ++m_size;
+        adjustUpward(leaf);
+    }
+
+    /**
+     * Remove one value equal to the given one, whose rectangle is the
+     * given one. Return false if there was no such value.
+     */
+    bool remove(const Box &box, const T &value) {
+        Node *leaf = nullptr;
+        size_t index = 0;
+        if (!findLeaf(m_root.get(), box, value, leaf, index)) {
+            return false;
+        }
+        leaf->items.erase(leaf->items.begin() + index);
+        --m_size;
+        condense(leaf);
+        return true;
+    }
+
+    /**
+     * Replace the contents of the tree with the given items.
+     */
+    void load(std::vector<Item> items) {
+
+        clear();
+        if (items.empty()) return;
+        m_size = items.size();
+
+        std::vector<std::unique_ptr<Node>> level;
+
+        tile(items,
+             [](const Item &i) { return i.first; },
+             [&](typename std::vector<Item>::iterator i0,
+                 typename std::vector<Item>::iterator i1) {
+                 std::unique_ptr<Node> n(new Node(true));
+                 n->items.assign(i0, i1);
+                 n->recalculate();
+                 level.push_back(std::move(n));
+             });
+
+        while (level.size() > 1) {
+            std::vector<std::unique_ptr<Node>> upper;
+            tile(level,
+                 [](const std::unique_ptr<Node> &n) { return n->box; },
+                 [&](typename std::vector<std::unique_ptr<Node>>::iterator i0,
+                     typename std::vector<std::unique_ptr<Node>>::iterator i1) {
+                     std::unique_ptr<Node> n(new Node(false));
+                     for (auto i = i0; i != i1; ++i) {
+                         (*i)->parent = n.get();
+                         n->children.push_back(std::move(*i));
+                     }
+                     n->recalculate();
+                     upper.push_back(std::move(n));
+                 });
+            level = std::move(upper);
+        }
+
+        m_root = std::move(level[0]);
+        m_root->parent = nullptr;
+    }
+
+    /**
+     * Call f(box, value) for every value whose rectangle intersects
+     * the given one, in no particular order.
+     */
+    template <typename F>
+    void search(const Box &box, F f) const {
+        std::vector<const Node *> stack;
+        stack.push_back(m_root.get());
+        while (!stack.empty()) {
+            const Node *n = stack.back();
+            stack.pop_back();
+            if (n->leaf) {
+                for (const auto &i: n->items) {
+                    if (i.first.intersects(box)) {
+                        f(i.first, i.second);
+                    }
+                }
+            } else {
+                for (const auto &c: n->children) {
+                    if (c->box.intersects(box)) {
+                        stack.push_back(c.get());
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static const size_t maxEntries = 16;
+    static const size_t minEntries = 6;
+
+    struct Node {
+        Node(bool isLeaf) : leaf(isLeaf), parent(nullptr) { }
+
+        bool leaf;
+        Node *parent;
+        Box box;
+        std::vector<std::unique_ptr<Node>> children; // if !leaf
+        std::vector<Item> items; // if leaf
+
+        size_t count() const {
+            return leaf ? items.size() : children.size();
+        }
+
+        void recalculate() {
+            bool first = true;
+            if (leaf) {
+                for (const auto &i: items) {
+                    if (first) box = i.first;
+                    else box.include(i.first);
+                    first = false;
+                }
+            } else {
+                for (const auto &c: children) {
+                    if (first) box = c->box;
+                    else box.include(c->box);
+                    first = false;
+                }
+            }
+            if (first) box = Box();
+        }
+    };
+
+    std::unique_ptr<Node> m_root;
+    size_t m_size;
+
+    Node *chooseLeaf(const Box &box) const {
+        Node *n = m_root.get();
+        while (!n->leaf) {
+            Node *best = nullptr;
+            double bestEnlargement = 0.0, bestArea = 0.0;
+            for (const auto &c: n->children) {
+                Box b(c->box);
+                double area = b.area();
+                b.include(box);
+                double enlargement = b.area() - area;
+                if (!best ||
+                    enlargement < bestEnlargement ||
+                    (enlargement == bestEnlargement && area < bestArea)) {
+                    best = c.get();
+                    bestEnlargement = enlargement;
+                    bestArea = area;
+                }
+            }
+            n = best;
+        }
+        return n;
+    }
+
+    /**
+     * Recalculate the boxes of n and its ancestors, splitting any
+     * that have overflowed.
+     */
+    void adjustUpward(Node *n) {
+        while (n) {
+            n->recalculate();
+            if (n->count() > maxEntries) {
+                std::unique_ptr<Node> sibling = split(n);
+                if (n == m_root.get()) {
+                    std::unique_ptr<Node> root(new Node(false));
+                    m_root->parent = root.get();
+                    sibling->parent = root.get();
+                    root->children.push_back(std::move(m_root));
+                    root->children.push_back(std::move(sibling));
+                    m_root = std::move(root);
+                } else {
+                    sibling->parent = n->parent;
+                    n->parent->children.push_back(std::move(sibling));
+                }
+            }
+            n = n->parent;
+        }
+    }
+
+    /**
+     * Move half of the entries of n, along whichever axis their
+     * centres are more spread out on, into a new sibling node.
+     */
+    std::unique_ptr<Node> split(Node *n) {
+        std::unique_ptr<Node> sibling(new Node(n->leaf));
+        if (n->leaf) {
+            splitEntries(n->items, sibling->items,
+                         [](const Item &i) { return i.first; });
+        } else {
+            splitEntries(n->children, sibling->children,
+                         [](const std::unique_ptr<Node> &c) {
+                             return c->box;
+                         });
+            for (auto &c: sibling->children) {
+                c->parent = sibling.get();
+            }
+        }
+        n->recalculate();
+        sibling->recalculate();
+        return sibling;
+    }
+
+    template <typename E, typename BoxOf>
+    static void splitEntries(std::vector<E> &from, std::vector<E> &to,
+                             BoxOf boxOf) {
+        double minX = 0, maxX = 0, minY = 0, maxY = 0;
+        for (size_t i = 0; i < from.size(); ++i) {
+            Box b = boxOf(from[i]);
+            if (i == 0 || b.centreX() < minX) minX = b.centreX();
+            if (i == 0 || b.centreX() > maxX) maxX = b.centreX();
+            if (i == 0 || b.centreY() < minY) minY = b.centreY();
+            if (i == 0 || b.centreY() > maxY) maxY = b.centreY();
+        }
+        bool byX = (maxX - minX >= maxY - minY);
+        std::sort(from.begin(), from.end(),
+                  [&](const E &a, const E &b) {
+                      return byX ?
+                          boxOf(a).centreX() < boxOf(b).centreX() :
+                          boxOf(a).centreY() < boxOf(b).centreY();
+                  });
+        size_t half = from.size() / 2;
+        for (size_t i = half; i < from.size(); ++i) {
+            to.push_back(std::move(from[i]));
+        }
+        from.resize(half);
+    }
+
+    bool findLeaf(Node *n, const Box &box, const T &value,
+                  Node *&leaf, size_t &index) const {
+        if (!n->box.contains(box)) {
+            return false;
+        }
+        if (n->leaf) {
+            for (size_t i = 0; i < n->items.size(); ++i) {
+                const Item &item = n->items[i];
+                if (item.second == value &&
+                    item.first.x0 == box.x0 && item.first.x1 == box.x1 &&
+                    item.first.y0 == box.y0 && item.first.y1 == box.y1) {
+                    leaf = n;
+                    index = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+        for (const auto &c: n->children) {
+            if (findLeaf(c.get(), box, value, leaf, index)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * After removing an entry from leaf n, remove any nodes on the
+     * path from n to the root that have become underfull, and
+     * reinsert the values from beneath them.
+     */
+    void condense(Node *n) {
+        std::vector<Item> orphans;
+        while (n != m_root.get()) {
+            Node *parent = n->parent;
+            if (n->count() < minEntries) {
+                collect(n, orphans);
+                for (auto i = parent->children.begin();
+                     i != parent->children.end(); ++i) {
+                    if (i->get() == n) {
+                        parent->children.erase(i);
+                        break;
+                    }
+                }
+            } else {
+                n->recalculate();
+            }
+            n = parent;
+        }
+        m_root->recalculate();
+
+        while (!m_root->leaf && m_root->children.size() == 1) {
+            std::unique_ptr<Node> child = std::move(m_root->children[0]);
+            child->parent = nullptr;
+            m_root = std::move(child);
+        }
+        if (!m_root->leaf && m_root->children.empty()) {
+            m_root.reset(new Node(true));
+        }
+
+        m_size -= orphans.size();
+        for (const auto &i: orphans) {
+            insert(i.first, i.second);
+        }
+    }
+
+    static void collect(const Node *n, std::vector<Item> &out) {
+        if (n->leaf) {
+            out.insert(out.end(), n->items.begin(), n->items.end());
+        } else {
+            for (const auto &c: n->children) {
+                collect(c.get(), out);
+            }
+        }
+    }
+
+    /**
+     * Sort-tile-recursive packing: sort entries by x centre, cut them
+     * into vertical slices, sort each slice by y centre, and pass
+     * runs of up to maxEntries to makeNode.
+     */
+    template <typename E, typename BoxOf, typename MakeNode>
+    static void tile(std::vector<E> &entries, BoxOf boxOf, MakeNode makeNode) {
+        size_t n = entries.size();
+        size_t nodes = (n + maxEntries - 1) / maxEntries;
+        size_t slices = size_t(ceil(sqrt(double(nodes))));
+        size_t perSlice = slices * maxEntries;
+        std::sort(entries.begin(), entries.end(),
+                  [&](const E &a, const E &b) {
+                      return boxOf(a).centreX() < boxOf(b).centreX();
+                  });
+        for (size_t s = 0; s < n; s += perSlice) {
+            auto s0 = entries.begin() + s;
+            auto s1 = entries.begin() + std::min(n, s + perSlice);
+            std::sort(s0, s1,
+                      [&](const E &a, const E &b) {
+                          return boxOf(a).centreY() < boxOf(b).centreY();
+                      });
+            for (auto i = s0; i < s1; ) {
+                auto j = i + std::min(size_t(s1 - i), maxEntries);
+                makeNode(i, j);
+                i = j;
+            }
+        }
+    }
+};
+
+template <typename T> const size_t RTree<T>::maxEntries;
+template <typename T> const size_t RTree<T>::minEntries;
+
+#endif
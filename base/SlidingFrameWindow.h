@@ -0,0 +1,156 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SLIDING_FRAME_WINDOW_H
+#define SV_SLIDING_FRAME_WINDOW_H
+
+#include "BaseTypes.h"
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * A multi-channel window of fixed block size over a stream of audio
+ * frames, for supplying overlapping blocks to a plugin or similar
+ * without re-reading the overlap. Construct with a reader function
+ * that fetches frames from the underlying source, then call
+ * getBlock() with the start frame of each block in turn. When a
+ * block starts after the previous one but overlaps it, only the
+ * frames not already held are read; otherwise the whole block is.
+ *
+ * The returned channel pointers address contiguous storage of
+ * blockSize frames each, and remain valid until the next call to
+ * getBlock(). The frames are held in a buffer several blocks long,
+ * and the overlap is moved back to its start only when the window
+ * reaches its end, so the cost of keeping blocks contiguous is small
+ * compared with that of reading them.
+ *
+ * Not thread-safe.
+ */
+class SlidingFrameWindow
+{
+public:
+    /**
+     * Function to read count frames starting at startFrame into the
+     * given per-channel buffers, padding with zeros where the source
+     * has no frames.
+     */
+    typedef std::function<void(sv_frame_t startFrame,
+                               sv_frame_t count,
+                               float **buffers)> Reader;
+
+    SlidingFrameWindow(int channelCount, int blockSize, Reader reader) :
+        m_channelCount(channelCount),
+        m_blockSize(blockSize),
+        m_capacity(blockSize * 4),
+        m_reader(reader),
+        m_data(channelCount, std::vector<float>(m_capacity, 0.f)),
+        m_pointers(channelCount, nullptr),
+        m_offset(0),
+        m_frame(0),
+        m_valid(false),
+        m_framesRead(0) {
+        if (channelCount < 1) {
+            throw std::logic_error("channelCount must be >= 1");
+        }
+        if (blockSize < 1) {
+            throw std::logic_error("blockSize must be >= 1");
+        }
+    }
+
+    SlidingFrameWindow(const SlidingFrameWindow &) =delete;
+    SlidingFrameWindow &operator=(const SlidingFrameWindow &) =delete;
+
+    int getChannelCount() const { return m_channelCount; }
+    int getBlockSize() const { return m_blockSize; }
+
+    /**
+     * Return the block of blockSize frames starting at the given
+     * frame, as one pointer per channel.
+     */
+    float **getBlock(sv_frame_t frame) {
+
+        sv_frame_t advance = frame - m_frame;
+
+        if (!m_valid || advance < 0 || advance >= m_blockSize) {
+            m_offset = 0;
+            read(frame, 0, m_blockSize);
+
+        } else if (advance > 0) {
+
+            int keep = m_blockSize - int(advance);
+
+            if (m_offset + advance + m_blockSize > m_capacity) {
+                for (auto &d: m_data) {
+                    std::copy(d.begin() + m_offset + advance,
+                              d.begin() + m_offset + m_blockSize,
+                              d.begin());
+                }
+                m_offset = 0;
+            } else {
+                m_offset += int(advance);
+            }
+
+            read(frame + keep, m_offset + keep, int(advance));
+        }
+
+        m_frame = frame;
+        m_valid = true;
+
+        for (int c = 0; c < m_channelCount; ++c) {
+            m_pointers[c] = m_data[c].data() + m_offset;
+        }
+        return m_pointers.data();
+    }
+
+    /**
+     * Discard the current contents, so that the next block is read
+     * in full.
+     */
+    void reset() {
+        m_valid = false;
+    }
+
+    /**
+     * Return the total number of frames (per channel) read from the
+     * reader so far.
+     */
+    sv_frame_t getFramesRead() const {
+        return m_framesRead;
+    }
+
+private:
+    int m_channelCount;
+    int m_blockSize;
+    int m_capacity;
+    Reader m_reader;
+    std::vector<std::vector<float>> m_data;
+    std::vector<float *> m_pointers;
+    int m_offset;
+    sv_frame_t m_frame;
+    bool m_valid;
+    sv_frame_t m_framesRead;
+
+    void read(sv_frame_t startFrame, int index, int count) {
+        for (int c = 0; c < m_channelCount; ++c) {
+            m_pointers[c] = m_data[c].data() + index;
+        }
+        m_reader(startFrame, count, m_pointers.data());
+        m_framesRead += count;
+    }
+};
+
+#endif
@@ -71,12 +71,15 @@ StringBits::stringToDoubleLocaleFree(QString s, bool *ok)
     return result * sign;
 }
     
-QStringList
-StringBits::splitQuoted(QString s, QChar separator, EscapeMode escapeMode)
+// The splitQuoted state machine, shared between splitting and
+// counting. The Fields type receives the characters of each field
+// as they are found and is told where each field ends
+
+template <typename Fields>
+static void
+scanQuoted(const QString &s, QChar separator,
+           StringBits::EscapeMode escapeMode, Fields &fields)
 {
-    QStringList tokens;
-    QString tok;
-
     // beg -> at beginning of line
     // sep -> just seen a field separator
     // unq -> in an unquoted field
@@ -85,10 +88,10 @@ StringBits::splitQuoted(QString s, QChar separator, EscapeMode escapeMode)
 
     enum { beg, sep, unq, q1, q2 } mode = beg;
 
-    bool use_doubling = (escapeMode == EscapeDoubling ||
-                         escapeMode == EscapeAny);
-    bool use_backslash = (escapeMode == EscapeBackslash ||
-                          escapeMode == EscapeAny);
+    bool use_doubling = (escapeMode == StringBits::EscapeDoubling ||
+                         escapeMode == StringBits::EscapeAny);
+    bool use_backslash = (escapeMode == StringBits::EscapeBackslash ||
+                          escapeMode == StringBits::EscapeAny);
 
     for (int i = 0; i < s.length(); ++i) {
         
@@ -97,10 +100,10 @@ StringBits::splitQuoted(QString s, QChar separator, EscapeMode escapeMode)
         if (c == '\'') {
             switch (mode) {
             case beg: case sep: mode = q1; break;
-            case unq: case q2: tok += c; break;
+            case unq: case q2: fields.add(c); break;
             case q1:
                 if (use_doubling && i+1 < s.length() && s[i+1] == c) {
-                    tok += c; ++i; break;
+                    fields.add(c); ++i; break;
                 } else {
                     mode = unq; break;
                 }
@@ -109,10 +112,10 @@ StringBits::splitQuoted(QString s, QChar separator, EscapeMode escapeMode)
         } else if (c == '"') {
             switch (mode) {
             case beg: case sep: mode = q2; break;
-            case unq: case q1: tok += c; break;
+            case unq: case q1: fields.add(c); break;
             case q2: 
                 if (use_doubling && i+1 < s.length() && s[i+1] == c) {
-                    tok += c; ++i; break;
+                    fields.add(c); ++i; break;
                 } else {
                     mode = unq; break;
                 }
@@ -120,40 +123,76 @@ StringBits::splitQuoted(QString s, QChar separator, EscapeMode escapeMode)
 
         } else if (c == separator || (separator == ' ' && c.isSpace())) {
             switch (mode) {
-            case beg: mode = sep; tokens << ""; break;
-            case sep: if (separator != ' ') tokens << ""; break;
-            case unq: mode = sep; tokens << tok; tok = ""; break;
-            case q1: case q2: tok += c; break;
+            case beg: mode = sep; fields.end(); break;
+            case sep: if (separator != ' ') fields.end(); break;
+            case unq: mode = sep; fields.end(); break;
+            case q1: case q2: fields.add(c); break;
             }
 
         } else if (c == '\\' && use_backslash) {
             if (++i < s.length()) {
                 c = s[i];
                 switch (mode) {
-                case beg: case sep: mode = unq; tok += c; break;
-                case unq: case q1: case q2: tok += c; break;
+                case beg: case sep: mode = unq; fields.add(c); break;
+                case unq: case q1: case q2: fields.add(c); break;
                 }
             }
 
         } else {
             switch (mode) {
-            case beg: case sep: mode = unq; tok += c; break;
-            case unq: case q1: case q2: tok += c; break;
+            case beg: case sep: mode = unq; fields.add(c); break;
+            case unq: case q1: case q2: fields.add(c); break;
             }
         }
     }
 
-    if (tok != "" || mode != beg) {
+    if (fields.isStarted() || mode != beg) {
         if (mode == q1) {
-            tokens << ("'" + tok);  // turns out it wasn't quoted after all
+            fields.endUnterminated('\'');  // turns out it wasn't quoted after all
         } else if (mode == q2) {
-            tokens << ("\"" + tok);
+            fields.endUnterminated('"');
         } else {
-            tokens << tok;
+            fields.end();
         }
     }
+}
+
+namespace {
+
+struct FieldList {
+    QStringList tokens;
+    QString tok;
+    void add(QChar c) { tok += c; }
+    void end() { tokens << tok; tok = ""; }
+    void endUnterminated(QChar quote) { tokens << (quote + tok); tok = ""; }
+    bool isStarted() const { return tok != ""; }
+};
+
+struct FieldCounter {
+    int count = 0;
+    bool started = false;
+    void add(QChar) { started = true; }
+    void end() { ++count; started = false; }
+    void endUnterminated(QChar) { end(); }
+    bool isStarted() const { return started; }
+};
+
+}
+
+QStringList
+StringBits::splitQuoted(QString s, QChar separator, EscapeMode escapeMode)
+{
+    FieldList fields;
+    scanQuoted(s, separator, escapeMode, fields);
+    return fields.tokens;
+}
 
-    return tokens;
+int
+StringBits::countQuoted(QString s, QChar separator, EscapeMode escapeMode)
+{
+    FieldCounter counter;
+    scanQuoted(s, separator, escapeMode, counter);
+    return counter.count;
 }
 
 QStringList
@@ -168,6 +207,27 @@ StringBits::split(QString line, QChar separator, bool quoted)
     }
 }
 
+int
+StringBits::countFields(QString line, QChar separator, bool quoted)
+{
+    if (quoted) {
+        return countQuoted(line, separator);
+    }
+
+    // As the size of the list returned by split(), without building it
+    int count = 0;
+    if (separator == ' ') {
+        for (int i = 0; i < line.length(); ++i) {
+            if (line[i] != separator && (i == 0 || line[i-1] == separator)) {
+                ++count;
+            }
+        }
+    } else {
+        count = line.count(separator) + 1;
+    }
+    return count;
+}
+
 QString
 StringBits::joinDelimited(QVector<QString> row, QString delimiter)
 {
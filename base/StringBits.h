@@ -67,6 +67,22 @@ public:
                              QChar separator,
                              bool quoted);
 
+    /**
+     * Return the number of fields that splitQuoted would split the
+     * given string into, without building them.
+     */
+    static int countQuoted(QString s,
+                           QChar separator,
+                           EscapeMode escapeMode = EscapeAny);
+
+    /**
+     * Return the number of fields that split would split the given
+     * string into, without building them.
+     */
+    static int countFields(QString s,
+                           QChar separator,
+                           bool quoted);
+
     /**
      * Join a vector of strings into a single string, with the
      * delimiter as the joining string. If a string contains the
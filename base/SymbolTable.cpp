@@ -0,0 +1,154 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "SymbolTable.h"
+#include "Debug.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadStorage>
+
+#include <atomic>
+
+// Entries are stored in fixed-size blocks that are never moved or
+// freed once allocated, so a reader holding an id can find its string
+// without synchronising with writers beyond loading the block
+// pointer. An entry's string is written once, under the mutex, before
+// its id is handed out
+
+static const int blockBits = 12;
+static const SymbolTable::Id blockSize = (1u << blockBits);
+static const SymbolTable::Id maxIds = (1u << SymbolTable::IdBits);
+static const int maxBlocks = (1 << (SymbolTable::IdBits - blockBits));
+
+// Zero-initialised before any dynamic initialisation, so safe to use
+// from other static initialisers
+static std::atomic<QString *> blocks[maxBlocks];
+
+struct TableState {
+    QMutex mutex;
+    QHash<QString, SymbolTable::Id> ids;
+    SymbolTable::Id nextId = 1;
+    bool warned = false;
+};
+
+static TableState &
+getState()
+{
+    // Never deleted, as events with static storage duration may look
+    // up their labels during static destruction
+    static TableState *state = new TableState;
+    return *state;
+}
+
+static const QString &
+getText(SymbolTable::Id id)
+{
+    return blocks[id >> blockBits].load(std::memory_order_acquire)
+        [id & (blockSize - 1)];
+}
+
+// Each thread remembers the ids of the strings it has interned most
+// recently, in a small table indexed by hash. As ids are never
+// reused, an id found here is always still the right one
+
+static const int cacheSize = 256;
+
+struct InternCache {
+    QString text[cacheSize];
+    SymbolTable::Id id[cacheSize] = {};
+};
+
+static QThreadStorage<InternCache *> &
+getCaches()
+{
+    // Never deleted, for the same reason as the state
+    static QThreadStorage<InternCache *> *caches =
+        new QThreadStorage<InternCache *>;
+    return *caches;
+}
+
+SymbolTable::Id
+SymbolTable::intern(const QString &s)
+{
+    if (s.isEmpty()) {
+        return 0;
+    }
+
+    QThreadStorage<InternCache *> &caches = getCaches();
+    if (!caches.hasLocalData()) {
+        caches.setLocalData(new InternCache);
+    }
+    InternCache *cache = caches.localData();
+    int slot = int(qHash(s) % cacheSize);
+    if (cache->id[slot] != 0 && cache->text[slot] == s) {
+        return cache->id[slot];
+    }
+
+    TableState &state = getState();
+    QMutexLocker locker(&state.mutex);
+
+    Id id = state.ids.value(s, 0);
+
+    if (id == 0) {
+
+        if (state.nextId >= maxIds) {
+            if (!state.warned) {
+                SVCERR << "WARNING: SymbolTable::intern: Table is full, "
+                       << "further new strings will be replaced by empty ones"
+                       << endl;
+                state.warned = true;
+            }
+            return 0;
+        }
+
+        id = state.nextId++;
+
+        int b = int(id >> blockBits);
+        QString *block = blocks[b].load(std::memory_order_relaxed);
+        if (!block) {
+            block = new QString[blockSize];
+            blocks[b].store(block, std::memory_order_release);
+        }
+
+        block[id & (blockSize - 1)] = s;
+        state.ids.insert(s, id);
+    }
+
+    cache->text[slot] = s;
+    cache->id[slot] = id;
+    return id;
+}
+
+QString
+SymbolTable::lookup(Id id)
+{
+    if (id == 0 || id >= maxIds) {
+        return {};
+    }
+    return getText(id);
+}
+
+int
+SymbolTable::compare(Id a, Id b)
+{
+    if (a == b) {
+        return 0;
+    }
+    static const QString empty;
+    const QString &sa = (a == 0 ? empty : getText(a));
+    const QString &sb = (b == 0 ? empty : getText(b));
+    return sa.compare(sb);
+}
@@ -0,0 +1,68 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SYMBOL_TABLE_H
+#define SV_SYMBOL_TABLE_H
+
+#include <QString>
+
+#include <cstdint>
+
+/**
+ * A process-wide table of interned strings, each identified by a
+ * small integer id. Interning the same text twice returns the same
+ * id, so strings that recur very many times - such as the labels of
+ * events returned by a transform - can be stored as one id each,
+ * and compared for equality without looking at their text. Id 0 is
+ * always the empty string.
+ *
+ * Strings are never removed from the table, so an id remains valid
+ * for the life of the process and may be copied freely without any
+ * bookkeeping. Interning a string already seen by the calling thread
+ * is usually answered from a small per-thread cache without taking a
+ * lock; otherwise it takes the table's lock. Looking up and comparing
+ * ids never do.
+ */
+class SymbolTable
+{
+public:
+    typedef uint32_t Id;
+
+    /**
+     * The number of bits needed to store any id. The table will not
+     * hold more than 2^IdBits strings.
+     */
+    static const int IdBits = 28;
+
+    /**
+     * Return the id for the given string, adding it to the table if
+     * it is not there already. If the table is full, return 0 (the
+     * empty string) and print a warning: this does not throw.
+     */
+    static Id intern(const QString &s);
+
+    /**
+     * Return the string for the given id.
+     */
+    static QString lookup(Id id);
+
+    /**
+     * Compare the strings for the given ids, returning a negative
+     * value, zero, or a positive value as the first sorts before, the
+     * same as, or after the second. Equal ids are equal without the strings being looked up.
+     */
+    static int compare(Id a, Id b);
+};
+
+#endif
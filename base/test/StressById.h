@@ -0,0 +1,116 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef STRESS_BY_ID_H
+#define STRESS_BY_ID_H
+
+#include "../ById.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+struct StressThing : public WithTypedId<StressThing> {
+    using WithTypedId<StressThing>::getId;
+};
+struct StressSubThing : public StressThing { int value = 1; };
+
+typedef TypedById<StressThing, StressThing::Id> StressThingById;
+
+class StressById : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Many threads all looking up the same item, as when several
+    // layers and caches read from one model, while another thread
+    // adds and releases unrelated items
+    
+    void contended(int nthreads, bool useHandle) {
+
+        auto thing = std::make_shared<StressSubThing>();
+        auto id = StressThingById::add(thing);
+        auto handle = StressThingById::getHandle<StressSubThing>(id);
+
+        auto lookup = [&]() {
+            if (useHandle) {
+                return handle.get()->value;
+            } else {
+                return StressThingById::getAs<StressSubThing>(id)->value;
+            }
+        };
+
+        std::atomic<bool> stop(false);
+        std::atomic<long long> lookups(0);
+        
+        std::vector<std::thread> readers;
+        for (int i = 0; i < nthreads; ++i) {
+            readers.push_back(std::thread([&]() {
+                long long n = 0;
+                long long sum = 0;
+                while (!stop) {
+                    for (int j = 0; j < 1000; ++j) {
+                        sum += lookup();
+                    }
+                    n += 1000;
+                }
+                lookups += n;
+                if (sum != n) {
+                    cerr << "ERROR: lookup failed" << endl;
+                }
+            }));
+        }
+
+        std::thread writer([&]() {
+            while (!stop) {
+                auto other = std::make_shared<StressThing>();
+                StressThingById::add(other);
+                StressThingById::release(other);
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        stop = true;
+        for (auto &r: readers) r.join();
+        writer.join();
+        auto end = std::chrono::steady_clock::now();
+
+        StressThingById::release(id);
+        
+        double sec = std::chrono::duration<double>(end - start).count();
+        QString message = QString("%1, %2 threads = ")
+            .arg(useHandle ? "handle" : "getAs").arg(nthreads);
+        cerr << "                 " << message;
+        for (int i = 0; i < 34 - message.size(); ++i) cerr << " ";
+        cerr << double(lookups) / sec / 1.0e6 << "M lookups/sec" << endl;
+    }
+
+private slots:
+    void getAs_1() { contended(1, false); }
+    void getAs_4() { contended(4, false); }
+    void getAs_8() { contended(8, false); }
+    void handle_1() { contended(1, true); }
+    void handle_4() { contended(4, true); }
+    void handle_8() { contended(8, true); }
+};
+
+#endif
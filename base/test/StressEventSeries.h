@@ -71,6 +71,47 @@ private:
         report(n, "longish", start, end);
     }
 
+    void overlapping_n(int n) {
+        // Every event overlaps a large fraction of the others, as
+        // with long regions or sustained notes
+        clock_t start = clock();
+        std::set<Event> ee;
+        EventSeries s;
+        for (int i = 0; i < n; ++i) {
+            float value = float(rand()) / float(RAND_MAX);
+            Event e(rand() % n, value, n / 4 + rand() % n,
+                    QString("event %1").arg(i));
+            ee.insert(e);
+        }
+        for (const Event &e: ee) {
+            s.add(e);
+        }
+        QCOMPARE(s.count(), n);
+        clock_t end = clock();
+        report(n, "overlapping", start, end);
+
+        start = clock();
+        std::vector<int> found;
+        for (int i = 0; i < 100; ++i) {
+            sv_frame_t f = i * (n / 50);
+            found.push_back(int(s.getEventsCovering(f).size()));
+        }
+        end = clock();
+        report(100, "covering queries on", start, end);
+        
+        for (int i = 0; i < 100; ++i) {
+            sv_frame_t f = i * (n / 50);
+            int expected = 0;
+            for (const auto &e: ee) {
+                if (e.getFrame() <= f &&
+                    e.getFrame() + e.getDuration() > f) {
+                    ++expected;
+                }
+            }
+            QCOMPARE(found[i], expected);
+        }
+    }
+
 private slots:
     void short_3() { short_n(1000); }
     void short_4() { short_n(10000); }
@@ -79,6 +120,9 @@ private slots:
     void longish_3() { longish_n(1000); }
     void longish_4() { longish_n(10000); }
     void longish_5() { longish_n(100000); }
+    void overlapping_3() { overlapping_n(1000); }
+    void overlapping_4() { overlapping_n(10000); }
+    void overlapping_5() { overlapping_n(100000); }
 };
 
 #endif
@@ -0,0 +1,92 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef STRESS_SLIDING_FRAME_WINDOW_H
+#define STRESS_SLIDING_FRAME_WINDOW_H
+
+#include "../SlidingFrameWindow.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <vector>
+
+// Throughput of the sliding window against reading every block in
+// full, as the feature extraction transformer used to, with a typical
+// 2048/256 block and step size over 30 seconds of stereo audio
+
+class StressSlidingFrameWindow : public QObject
+{
+    Q_OBJECT
+
+    static const int channels = 2;
+    static const int blockSize = 2048;
+    static const int stepSize = 256;
+    static const int n = 44100 * 30;
+
+    std::vector<std::vector<float>> m_source;
+
+    void read(sv_frame_t start, sv_frame_t count, float **into) {
+        for (int c = 0; c < channels; ++c) {
+            for (sv_frame_t i = 0; i < count; ++i) {
+                sv_frame_t f = start + i;
+                into[c][i] = (f >= 0 && f < n) ? m_source[c][f] : 0.f;
+            }
+        }
+    }
+
+private slots:
+    void initTestCase() {
+        m_source = std::vector<std::vector<float>>(channels);
+        for (int c = 0; c < channels; ++c) {
+            for (int i = 0; i < n; ++i) {
+                m_source[c].push_back(float(c * n + i));
+            }
+        }
+    }
+
+    void fullBlocks() {
+        std::vector<std::vector<float>> buffers
+            (channels, std::vector<float>(blockSize));
+        std::vector<float *> ptrs(channels);
+        for (int c = 0; c < channels; ++c) ptrs[c] = buffers[c].data();
+        float total = 0.f;
+        QBENCHMARK {
+            for (sv_frame_t f = 0; f < n; f += stepSize) {
+                read(f, blockSize, ptrs.data());
+                total += ptrs[0][blockSize - 1];
+            }
+        }
+        QVERIFY(total > 0.f);
+    }
+
+    void slidingWindow() {
+        SlidingFrameWindow window
+            (channels, blockSize,
+             [this](sv_frame_t start, sv_frame_t count, float **into) {
+                 read(start, count, into);
+             });
+        float total = 0.f;
+        QBENCHMARK {
+            window.reset();
+            for (sv_frame_t f = 0; f < n; f += stepSize) {
+                float **block = window.getBlock(f);
+                total += block[0][blockSize - 1];
+            }
+        }
+        QVERIFY(total > 0.f);
+    }
+};
+
+#endif
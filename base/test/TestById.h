@@ -180,6 +180,62 @@ private slots:
         AById::release(y);
     }
 
+    void handleSimple() {
+        auto b1 = std::make_shared<B1>();
+        auto id = AById::add(b1);
+
+        auto h = AById::getHandle<B1>(id);
+        QCOMPARE(h.get().get(), b1.get());
+        QCOMPARE(h.getUntypedId(), id.untyped);
+
+        auto h2 = AById::getHandle<B2>(id);
+        QVERIFY(!h2.get());
+
+        AById::release(id);
+        QVERIFY(!h.get()); // even though b1 itself is still alive
+    }
+
+    void handleCrosscast() {
+        auto y = std::make_shared<Y>();
+        AById::add(y);
+
+        auto hm = AById::getHandle<M>(y->getId());
+        auto hx = AById::getHandle<X>(y->getId());
+        QCOMPARE((void *)hm.get().get(), (void *)(M *)y.get());
+        QCOMPARE(hx.get()->getUntypedId(), y->getId().untyped);
+        
+        AById::release(y);
+        QVERIFY(!hm.get());
+        QVERIFY(!hx.get());
+    }
+
+    void handleBeforeAdd() {
+        auto a = std::make_shared<A>();
+        auto h = AById::getHandle<A>(a->getId());
+        QVERIFY(!h.get());
+        AById::add(a);
+        QCOMPARE(h.get().get(), a.get());
+        AById::release(a);
+        QVERIFY(!h.get());
+    }
+
+    void handleLiveness() {
+        auto b1 = std::make_shared<B1>();
+        auto h = AById::getHandle<B1>(b1->getId());
+        QVERIFY(!h.isLive());
+        auto id = AById::add(b1);
+        QVERIFY(h.isLive());
+        auto h1 = AById::getHandle<B1>(id);
+        auto h2 = AById::getHandle<B2>(id);
+        QVERIFY(h1.isLive());
+        QVERIFY(!h2.isLive());
+        AById::release(id);
+        QVERIFY(!h.isLive());
+        QVERIFY(!h1.isLive()); // even though b1 itself is still alive
+        b1.reset();
+        QVERIFY(!h1.isLive());
+    }
+
     void duplicateAdd() {
         auto a = std::make_shared<A>();
         AById::add(a);
@@ -21,6 +21,7 @@
 #include <QtTest>
 
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
@@ -742,6 +743,201 @@ private slots:
                   EventSeries::Backward, p), true);
         QCOMPARE(p, dd);
     }
+
+    void fromEventsMatchesAdd() {
+
+        EventVector v {
+            Event(14, 5.0f, 3, QString("e")),
+            Event(0, 1.0f, 18, QString("a")),
+            Event(6, 4.0f, 10, QString("d")),
+            Event(3, 2.0f, 6, QString("b")),
+            Event(6, 4.0f, 10, QString("d")),
+            Event(5, 3.0f, 2, QString("c")),
+            Event(7, 3.0f, 0, QString("z")),
+            Event(9, QString("p")),
+            Event(24, QString("q")),
+            Event(5, 3.0f, 2, QString("c"))
+        };
+        
+        EventSeries added;
+        for (const auto &e: v) {
+            added.add(e);
+        }
+        EventSeries built = EventSeries::fromEvents(v);
+        
+        QCOMPARE(built, added);
+        QCOMPARE(built.count(), added.count());
+        QCOMPARE(built.getStartFrame(), added.getStartFrame());
+        QCOMPARE(built.getEndFrame(), added.getEndFrame());
+
+        for (sv_frame_t f = -1; f < 27; ++f) {
+            QCOMPARE(built.getEventsCovering(f), added.getEventsCovering(f));
+            for (sv_frame_t d = 1; d < 6; ++d) {
+                QCOMPARE(built.getEventsSpanning(f, d),
+                         added.getEventsSpanning(f, d));
+            }
+        }
+
+        Event d(6, 4.0f, 10, QString("d"));
+        added.remove(d);
+        built.remove(d);
+        QCOMPARE(built.getEventsCovering(8), added.getEventsCovering(8));
+        added.remove(d);
+        built.remove(d);
+        QCOMPARE(built.getEventsCovering(8), added.getEventsCovering(8));
+    }
+
+    void addEventsMatchesAdd() {
+
+        // One batch appended after the existing events, and one that
+        // has to be merged in among them
+        EventVector first {
+            Event(3, 2.0f, 6, QString("b")),
+            Event(0, 1.0f, 18, QString("a")),
+            Event(9, QString("p"))
+        };
+        EventVector after {
+            Event(24, QString("q")),
+            Event(14, 5.0f, 3, QString("e")),
+            Event(14, 5.0f, 3, QString("e"))
+        };
+        EventVector among {
+            Event(5, 3.0f, 2, QString("c")),
+            Event(30, QString("r")),
+            Event(6, 4.0f, 10, QString("d"))
+        };
+
+        EventSeries added, batched;
+        for (const auto &v: { first, after, among }) {
+            for (const auto &e: v) {
+                added.add(e);
+            }
+            batched.addEvents(v);
+            QCOMPARE(batched, added);
+            QCOMPARE(batched.getEndFrame(), added.getEndFrame());
+        }
+
+        for (sv_frame_t f = -1; f < 32; ++f) {
+            QCOMPARE(batched.getEventsCovering(f), added.getEventsCovering(f));
+            for (sv_frame_t d = 1; d < 6; ++d) {
+                QCOMPARE(batched.getEventsSpanning(f, d),
+                         added.getEventsSpanning(f, d));
+            }
+        }
+    }
+
+    void concurrentReadAndWrite() {
+
+        EventSeries s;
+        const int n = 20000;
+
+        std::thread writer([&]() {
+                for (int i = 0; i < n; ++i) {
+                    s.add(Event(i, float(i), 10, QString()));
+                }
+            });
+
+        // don't fail until the writer is finished with the series
+        bool consistent = true;
+        int previous = 0;
+        while (previous < n) {
+            int count = s.count();
+            if (count < previous) {
+                consistent = false;
+            }
+            auto r = s.getAllEvents();
+            if (int(r.size()) < count) {
+                consistent = false;
+            }
+            // frames are 0, 1, 2... so the ends tell us if the
+            // events are intact
+            if (!r.empty() &&
+                (r[0].getFrame() != 0 ||
+                 r[r.size()-1].getFrame() != sv_frame_t(r.size()-1))) {
+                consistent = false;
+            }
+            previous = count;
+        }
+
+        writer.join();
+        QVERIFY(consistent);
+        QCOMPARE(s.count(), n);
+        QCOMPARE(s.getEventsCovering(n - 5).size(), size_t(10));
+    }
+
+    void internedLabels() {
+
+        // Labels are interned, but must still order by their text
+        // rather than by the order in which they were first seen
+        Event z(10, QString("zzz interned first"));
+        Event a(10, QString("aaa interned second"));
+        QVERIFY(a < z);
+        QVERIFY(!(z < a));
+
+        Event a2 = Event(10).withLabel(QString("aaa interned ") + "second");
+        QCOMPARE(a2, a);
+        QCOMPARE(a2.getLabel(), QString("aaa interned second"));
+
+        Event e(10, QString(""));
+        QVERIFY(!e.hasLabel());
+        QCOMPARE(e, Event(10));
+        QCOMPARE(e.getLabel(), QString());
+
+        EventSeries s;
+        s.add(z);
+        s.add(a);
+        s.add(a2);
+        QCOMPARE(s.count(), 3);
+        QCOMPARE(s.getEventByIndex(0), a);
+        QCOMPARE(s.getEventByIndex(2), z);
+    }
+
+    void internedLabels() {
+
+        // The same text has the same id wherever it is interned,
+        // and the id stays valid after the events using it are gone
+        SymbolTable::Id id = 0;
+        {
+            Event e(10, QString("persistent label"));
+            Event f(e);
+            Event g = Event(20).withLabel(QString("other label"));
+            g = f;
+            QCOMPARE(g.getLabel(), QString("persistent label"));
+            id = SymbolTable::intern(QString("persistent label"));
+        }
+        QVERIFY(id != 0);
+        QCOMPARE(SymbolTable::lookup(id), QString("persistent label"));
+
+        vector<SymbolTable::Id> ids(4, 0);
+        vector<thread> threads;
+        for (int i = 0; in_range_for(ids, i); ++i) {
+            threads.push_back(thread([&ids, i]() {
+                for (int j = 0; j < 1000; ++j) {
+                    // Other strings in between, so that the
+                    // per-thread cache is both hit and missed
+                    SymbolTable::intern(QString("label %1").arg(j % 300));
+                    ids[i] = SymbolTable::intern
+                        (QString("persistent ") + QString("label"));
+                }
+            }));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        for (auto i: ids) {
+            QCOMPARE(i, id);
+        }
+        QCOMPARE(SymbolTable::lookup(SymbolTable::intern("label 299")),
+                 QString("label 299"));
+
+        // Comparison does not look up equal ids, and orders by text
+        SymbolTable::Id other = SymbolTable::intern(QString("another"));
+        QCOMPARE(SymbolTable::compare(id, id), 0);
+        QVERIFY(SymbolTable::compare(id, 0) > 0);
+        QVERIFY(SymbolTable::compare(0, id) < 0);
+        QVERIFY(SymbolTable::compare(other, id) < 0);
+        QVERIFY(SymbolTable::compare(id, other) > 0);
+    }
 };
 
 #endif
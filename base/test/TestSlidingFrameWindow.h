@@ -0,0 +1,126 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SLIDING_FRAME_WINDOW_H
+#define TEST_SLIDING_FRAME_WINDOW_H
+
+#include "../SlidingFrameWindow.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <vector>
+
+class TestSlidingFrameWindow : public QObject
+{
+    Q_OBJECT
+
+    // Source of n frames per channel, in which frame i of channel c
+    // has value c * n + i, padded with zeros either side
+    std::vector<std::vector<float>> makeSource(int channels, int n) {
+        std::vector<std::vector<float>> source(channels);
+        for (int c = 0; c < channels; ++c) {
+            for (int i = 0; i < n; ++i) {
+                source[c].push_back(float(c * n + i));
+            }
+        }
+        return source;
+    }
+
+    SlidingFrameWindow::Reader makeReader
+    (const std::vector<std::vector<float>> &source) {
+        return [&source](sv_frame_t start, sv_frame_t count, float **into) {
+                   for (int c = 0; c < int(source.size()); ++c) {
+                       sv_frame_t n = sv_frame_t(source[c].size());
+                       for (sv_frame_t i = 0; i < count; ++i) {
+                           sv_frame_t f = start + i;
+                           into[c][i] = (f >= 0 && f < n) ? source[c][f] : 0.f;
+                       }
+                   }
+               };
+    }
+
+    void checkBlocks(int blockSize, int stepSize, sv_frame_t startFrame) {
+        int channels = 2, n = 1000;
+        auto source = makeSource(channels, n);
+        auto reader = makeReader(source);
+        SlidingFrameWindow window(channels, blockSize, reader);
+        std::vector<std::vector<float>> expected
+            (channels, std::vector<float>(blockSize));
+        std::vector<float *> ptrs(channels);
+        int blocks = 0;
+        for (sv_frame_t f = startFrame; f < n; f += stepSize) {
+            for (int c = 0; c < channels; ++c) ptrs[c] = expected[c].data();
+            reader(f, blockSize, ptrs.data());
+            float **block = window.getBlock(f);
+            for (int c = 0; c < channels; ++c) {
+                for (int i = 0; i < blockSize; ++i) {
+                    if (block[c][i] != expected[c][i]) {
+                        QCOMPARE(block[c][i], expected[c][i]);
+                    }
+                }
+            }
+            ++blocks;
+        }
+        sv_frame_t expectedRead = blockSize;
+        if (stepSize < blockSize) {
+            expectedRead += sv_frame_t(blocks - 1) * stepSize;
+        } else {
+            expectedRead = sv_frame_t(blocks) * blockSize;
+        }
+        QCOMPARE(window.getFramesRead(), expectedRead);
+    }
+
+private slots:
+    void overlapping() {
+        checkBlocks(64, 16, 0);
+    }
+
+    void overlappingUneven() {
+        checkBlocks(100, 7, 0);
+    }
+
+    void overlappingFromNegative() {
+        checkBlocks(64, 32, -32);
+    }
+
+    void noOverlap() {
+        checkBlocks(32, 32, 0);
+    }
+
+    void gaps() {
+        checkBlocks(16, 40, 0);
+    }
+
+    void rewind() {
+        int blockSize = 8;
+        auto source = makeSource(1, 100);
+        SlidingFrameWindow window(1, blockSize, makeReader(source));
+        window.getBlock(50);
+        window.getBlock(52);
+        float **block = window.getBlock(10);
+        for (int i = 0; i < blockSize; ++i) {
+            QCOMPARE(block[0][i], float(10 + i));
+        }
+        block = window.getBlock(10);
+        QCOMPARE(block[0][0], 10.f);
+        QCOMPARE(window.getFramesRead(), sv_frame_t(blockSize * 2 + 2));
+        window.reset();
+        block = window.getBlock(10);
+        QCOMPARE(block[0][0], 10.f);
+        QCOMPARE(window.getFramesRead(), sv_frame_t(blockSize * 3 + 2));
+    }
+};
+
+#endif
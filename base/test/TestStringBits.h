@@ -34,6 +34,7 @@ private:
         // Only suitable where the output strings do not have
         // consecutive spaces in them
         QCOMPARE(StringBits::splitQuoted(in, ' '), out);
+        QCOMPARE(StringBits::countQuoted(in, ' '), out.size());
         QString in2(in);
         in2.replace(' ', ',');
         QStringList out2;
@@ -41,6 +42,7 @@ private:
             out2 << o.replace(' ', ',');
         }
         QCOMPARE(StringBits::splitQuoted(in2, ','), out2);
+        QCOMPARE(StringBits::countQuoted(in2, ','), out2.size());
     }
 
 private slots:
@@ -232,6 +234,34 @@ private slots:
              << "dd\"" << "'";
         QCOMPARE(StringBits::splitQuoted(in2, ','), out2);
     }
+
+    void countFields() {
+        // The field counts must agree with the sizes of the lists
+        // that split returns, in both quoted and unquoted modes and
+        // for every escape mode
+        QStringList lines;
+        lines << "" << " " << "  " << "," << ",," << "a" << "a b  c"
+              << "  a b " << "a,b,,c," << "\"a,b\",c" << "'a b' c"
+              << "\"a\"\"b\",c" << "a\\,b,c" << "\"unterminated, d"
+              << "'x' 'y\t z'" << "a\tb\t\tc" << "a|b|\"|\"|c";
+        QString separators = " ,\t|";
+        StringBits::EscapeMode modes[] = {
+            StringBits::EscapeAny, StringBits::EscapeBackslash,
+            StringBits::EscapeDoubling, StringBits::EscapeNone
+        };
+        foreach (QString line, lines) {
+            for (QChar sep: separators) {
+                QCOMPARE(StringBits::countFields(line, sep, true),
+                         StringBits::split(line, sep, true).size());
+                QCOMPARE(StringBits::countFields(line, sep, false),
+                         StringBits::split(line, sep, false).size());
+                for (auto mode: modes) {
+                    QCOMPARE(StringBits::countQuoted(line, sep, mode),
+                             StringBits::splitQuoted(line, sep, mode).size());
+                }
+            }
+        }
+    }
 };
 
 #endif
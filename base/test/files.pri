@@ -8,9 +8,12 @@ TEST_HEADERS = \
 	     TestEventSeries.h \
 	     TestRangeMapper.h \
 	     TestScaleTickIntervals.h \
+	     TestSlidingFrameWindow.h \
 	     TestStringBits.h \
 	     TestVampRealTime.h \
-	     StressEventSeries.h
+	     StressEventSeries.h \
+	     StressById.h \
+	     StressSlidingFrameWindow.h
 	     
 TEST_SOURCES += \
 	     svcore-base-test.cpp
@@ -22,7 +22,10 @@
 #include "TestMovingMedian.h"
 #include "TestById.h"
 #include "TestEventSeries.h"
+#include "TestSlidingFrameWindow.h"
 #include "StressEventSeries.h"
+#include "StressById.h"
+#include "StressSlidingFrameWindow.h"
 
 #include "system/Init.h"
 
@@ -97,6 +100,11 @@ int main(int argc, char *argv[])
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        TestSlidingFrameWindow t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
 
 #ifdef NOT_DEFINED
     {
@@ -104,6 +112,16 @@ int main(int argc, char *argv[])
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        StressById t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+    {
+        StressSlidingFrameWindow t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
 #endif
     
     if (bad > 0) {
@@ -140,6 +140,17 @@ public:
      */
     virtual bool isUpdating() const { return false; }
 
+    /**
+     * Return the number of frames, from the start, that can already
+     * be read and will not change as decoding continues. This is the
+     * same as getFrameCount() unless decoding is still in progress.
+     * Subclasses that decode in the background, and that can serve
+     * the frames decoded so far, should override it.
+     */
+    virtual sv_frame_t getAvailableFrameCount() const {
+        return isUpdating() ? 0 : getFrameCount();
+    }
+
     /** 
      * Return interleaved samples for count frames from index start.
      * The resulting vector will contain count * getChannelCount()
@@ -30,6 +30,7 @@
 #include "DataFileReaderFactory.h"
 
 #include <QFile>
+#include <QByteArray>
 #include <QDir>
 #include <QFileInfo>
 #include <QString>
@@ -41,6 +42,11 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 
 using namespace std;
 
@@ -55,7 +61,9 @@ CSVFileReader::CSVFileReader(QString path, CSVFormat format,
     m_fileSize(0),
     m_readCount(0),
     m_progress(-1),
-    m_reporter(reporter)
+    m_reporter(reporter),
+    m_chunkSize(8 * 1024 * 1024),
+    m_loadedInChunks(false)
 {
     QFile *file = new QFile(path);
     bool good = false;
@@ -89,7 +97,9 @@ CSVFileReader::CSVFileReader(QIODevice *device, CSVFormat format,
     m_fileSize(0),
     m_readCount(0),
     m_progress(-1),
-    m_reporter(reporter)
+    m_reporter(reporter),
+    m_chunkSize(8 * 1024 * 1024),
+    m_loadedInChunks(false)
 {
     if (m_reporter) m_reporter->setDefinite(false);
 }
@@ -174,6 +184,8 @@ CSVFileReader::convertTimeValue(QString s, int lineno,
 Model *
 CSVFileReader::load() const
 {
+    m_loadedInChunks = false;
+
     if (!m_device) return nullptr;
 
     CSVFormat::ModelType modelType = m_format.getModelType();
@@ -263,6 +275,15 @@ CSVFileReader::load() const
         }
     }
 
+    if (modelType == CSVFormat::ThreeDimensionalModel) {
+        Model *chunked = nullptr;
+        if (loadNumericChunked(sampleRate, windowSize, valueColumns,
+                               chunked)) {
+            m_loadedInChunks = true;
+            return chunked;
+        }
+    }
+
     map<QString, int> labelCountMap;
 
     bool atStart = true;
@@ -678,6 +699,500 @@ CSVFileReader::load() const
     return model;
 }
 
+namespace {
+
+const double powersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool isBlank(char c)
+{
+    return (c == ' ' || c == '\t');
+}
+
+/**
+ * Parse the "C"-locale decimal number in [p, e), ignoring leading and
+ * trailing blanks. The plain forms found in numeric CSV files are
+ * handled here directly: with at most 15 significant digits and a
+ * decimal exponent no bigger than 22, both the mantissa and the power
+ * of ten are exact in a double, so a single multiply or divide gives
+ * the correctly rounded result. Anything else is handed to Qt, which
+ * uses the same locale-free syntax as QString::toDouble.
+ */
+bool parseNumber(const char *p, const char *e, double &result)
+{
+    while (p < e && isBlank(*p)) ++p;
+    while (e > p && isBlank(e[-1])) --e;
+    if (p == e) return false;
+
+    const char *start = p;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool simple = true;
+    bool anyDigits = false;
+
+    auto addDigit = [&](char c) {
+        anyDigits = true;
+        if (mantissa == 0 && c == '0') return;
+        if (++significant > 15) {
+            simple = false;
+        } else {
+            mantissa = mantissa * 10 + uint64_t(c - '0');
+        }
+    };
+
+    while (p < e && *p >= '0' && *p <= '9') {
+        addDigit(*p++);
+    }
+    if (p < e && *p == '.') {
+        ++p;
+        while (p < e && *p >= '0' && *p <= '9') {
+            addDigit(*p++);
+            --exponent;
+        }
+    }
+    if (anyDigits && p < e && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = false;
+        if (p < e && (*p == '-' || *p == '+')) {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+        int e10 = 0;
+        bool anyExponentDigits = false;
+        while (p < e && *p >= '0' && *p <= '9') {
+            if (e10 < 10000) e10 = e10 * 10 + (*p - '0');
+            anyExponentDigits = true;
+            ++p;
+        }
+        if (!anyExponentDigits) simple = false;
+        exponent += (negativeExponent ? -e10 : e10);
+    }
+
+    if (p != e || !anyDigits) {
+        simple = false;
+    }
+
+    if (simple) {
+        if (mantissa == 0) {
+            result = (negative ? -0.0 : 0.0);
+            return true;
+        }
+        if (exponent >= -22 && exponent <= 22) {
+            double m = double(mantissa);
+            if (exponent < 0) {
+                result = m / powersOfTen[-exponent];
+            } else {
+                result = m * powersOfTen[exponent];
+            }
+            if (negative) result = -result;
+            return true;
+        }
+    }
+
+    bool ok = false;
+    result = QByteArray::fromRawData(start, int(e - start)).toDouble(&ok);
+    return ok;
+}
+
+/**
+ * Parse an optionally signed decimal integer in [p, e), ignoring
+ * leading and trailing blanks. Fails if the integer is too long to
+ * be sure of fitting in a long long, so that the caller falls back
+ * to the general conversion.
+ */
+bool parseInteger(const char *p, const char *e, long long &result)
+{
+    while (p < e && isBlank(*p)) ++p;
+    while (e > p && isBlank(e[-1])) --e;
+
+    bool negative = false;
+    if (p < e && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    if (p == e) return false;
+
+    long long n = 0;
+    while (p < e) {
+        if (*p < '0' || *p > '9') return false;
+        if (n > (LLONG_MAX - 9) / 10) return false;
+        n = n * 10 + (*p - '0');
+        ++p;
+    }
+
+    result = (negative ? -n : n);
+    return true;
+}
+
+}
+
+void
+CSVFileReader::NumericChunkParser::run()
+{
+    parseNumericChunk(m_layout, m_chunk);
+}
+
+void
+CSVFileReader::parseNumericChunk(const NumericLayout &layout,
+                                 NumericChunk &chunk)
+{
+    // Must produce the same rows as the line-by-line parse in load()
+    // would. Anything that parse would treat differently from a
+    // simple numeric split (quoting, unconvertible time values,
+    // wide-character text) marks the chunk as unsupported and we
+    // give up on it.
+    
+    chunk.supported = true;
+
+    const int badValueRowLimit = 10;
+    int valueColumnCount = int(layout.valueColumns.size());
+    int row = 0;
+    
+    const char *p = chunk.begin;
+
+    while (p < chunk.end) {
+
+        const char *line = p;
+        const char *eol = p;
+        while (eol < chunk.end && *eol != '\n' && *eol != '\r') {
+            ++eol;
+        }
+        p = (eol < chunk.end ? eol + 1 : eol);
+
+        if (eol == line || *line == '#') {
+            continue;
+        }
+
+        sv_frame_t frame = -1;
+        bool skip = false;
+        bool bad = false;
+        size_t valuesBefore = chunk.values.size();
+
+        const char *field = line;
+        int column = 0;
+
+        while (true) {
+
+            const char *fieldEnd = field;
+            while (fieldEnd < eol && *fieldEnd != layout.separator) {
+                char c = *fieldEnd;
+                if (c == '\0' ||
+                    (layout.quotingAllowed &&
+                     (c == '"' || c == '\'' || c == '\\'))) {
+                    chunk.supported = false;
+                    return;
+                }
+                ++fieldEnd;
+            }
+
+            if (column == layout.startTimeColumn) {
+
+                if (layout.timeUnits == CSVFormat::TimeSeconds ||
+                    layout.timeUnits == CSVFormat::TimeMilliseconds) {
+                    double time = 0.0;
+                    if (!parseNumber(field, fieldEnd, time)) {
+                        chunk.supported = false;
+                        return;
+                    }
+                    if (layout.timeUnits == CSVFormat::TimeMilliseconds) {
+                        time = time / 1000.0;
+                    }
+                    frame = sv_frame_t(time * layout.sampleRate + 0.5);
+                } else {
+                    long long n = 0;
+                    if (!parseInteger(field, fieldEnd, n)) {
+                        chunk.supported = false;
+                        return;
+                    }
+                    frame = (n >= 0 ? sv_frame_t(n) : 0);
+                    if (layout.timeUnits == CSVFormat::TimeWindows) {
+                        frame *= layout.windowSize;
+                    }
+                }
+
+                // load() drops any line whose converted start time
+                // is zero, so we must too
+                if (frame == 0) {
+                    skip = true;
+                }
+                
+            } else if (column < valueColumnCount &&
+                       layout.valueColumns[column]) {
+
+                double value = 0.0;
+                if (!parseNumber(field, fieldEnd, value) ||
+                    (std::isfinite(value) && std::fabs(value) > FLT_MAX)) {
+                    value = 0.0;
+                    bad = true;
+                }
+                chunk.values.push_back(float(value));
+            }
+
+            if (fieldEnd == eol) {
+                break;
+            }
+            field = fieldEnd + 1;
+            ++column;
+        }
+
+        if (skip) {
+            chunk.values.resize(valuesBefore);
+            continue;
+        }
+
+        chunk.rowFrames.push_back(frame);
+        chunk.rowValueCounts.push_back(int(chunk.values.size() - valuesBefore));
+
+        if (bad && int(chunk.badValueRows.size()) < badValueRowLimit) {
+            chunk.badValueRows.push_back(row);
+        }
+        
+        ++row;
+    }
+}
+
+bool
+CSVFileReader::loadNumericChunked(sv_samplerate_t sampleRate,
+                                  int windowSize,
+                                  int valueColumns,
+                                  Model *&model) const
+{
+    // Only files we opened ourselves, so that we know we can map
+    // them and nobody else cares about the device position
+    
+    if (!m_ownDevice) return false;
+    QFile *file = qobject_cast<QFile *>(m_device);
+    if (!file) return false;
+
+    // Space separators are collapsed by StringBits::split, which we
+    // don't attempt to reproduce here
+    QChar separator = m_format.getSeparator();
+    if (separator.unicode() > 127 || separator == ' ') {
+        return false;
+    }
+
+    NumericLayout layout;
+    layout.separator = char(separator.unicode());
+    layout.quotingAllowed = m_format.getAllowQuoting();
+    layout.startTimeColumn = -1;
+    layout.timeUnits = m_format.getTimeUnits();
+    layout.sampleRate = sampleRate;
+    layout.windowSize = windowSize;
+
+    for (int i = 0; i < m_format.getColumnCount(); ++i) {
+        CSVFormat::ColumnPurpose purpose = m_format.getColumnPurpose(i);
+        layout.valueColumns.push_back(purpose == CSVFormat::ColumnValue);
+        if (purpose == CSVFormat::ColumnStartTime) {
+            if (layout.startTimeColumn >= 0) return false;
+            layout.startTimeColumn = i;
+        } else if (purpose == CSVFormat::ColumnDuration) {
+            return false;
+        }
+    }
+
+    qint64 size = file->size();
+    if (size <= 0) return false;
+
+    uchar *mapped = file->map(0, size);
+    if (!mapped) {
+        SVDEBUG << "CSVFileReader::loadNumericChunked: Failed to map file, "
+                << "falling back to line-by-line load" << endl;
+        return false;
+    }
+
+    const char *base = reinterpret_cast<const char *>(mapped);
+    const char *end = base + size;
+    const char *data = base;
+
+    if (size >= 3 && !memcmp(data, "\xef\xbb\xbf", 3)) {
+        data += 3;
+    }
+
+    // Skip comments and blank lines to the first real line, and skip
+    // that too if it is a header
+    
+    while (data < end) {
+        if (*data == '\n' || *data == '\r') {
+            ++data;
+            continue;
+        }
+        const char *eol = data;
+        while (eol < end && *eol != '\n' && *eol != '\r') ++eol;
+        if (*data == '#') {
+            data = eol;
+            continue;
+        }
+        if (m_format.getHeaderStatus() == CSVFormat::HeaderPresent) {
+            data = eol;
+        }
+        break;
+    }
+
+    const qint64 chunkSize = (m_chunkSize > 0 ? m_chunkSize : 1);
+    int threadCount = QThread::idealThreadCount();
+    if (threadCount < 1) threadCount = 1;
+
+    SVDEBUG << "CSVFileReader::loadNumericChunked: Loading " << size
+            << " bytes in chunks of up to " << chunkSize << " using "
+            << threadCount << " thread(s)" << endl;
+    
+    EditableDenseThreeDimensionalModel *model3 =
+        new EditableDenseThreeDimensionalModel
+        (sampleRate, windowSize, valueColumns);
+
+    if (!model3->isOK()) {
+        delete model3;
+        file->unmap(mapped);
+        return false;
+    }
+    if (m_filename != "") {
+        model3->setObjectName(m_filename);
+    }
+
+    CSVFormat::TimingType timingType = m_format.getTimingType();
+    unsigned int warnings = 0, warnLimit = 10;
+    int lineno = 0;
+    float min = 0.f, max = 0.f;
+    sv_frame_t frameNo = 0;
+    sv_frame_t startFrame = 0;
+    bool firstEverValue = true;
+    bool supported = true;
+    
+    while (data < end) {
+
+        if (m_reporter) {
+            if (m_reporter->wasCancelled()) {
+                break;
+            }
+            int progress = int((double(data - base) / double(size)) * 100.0);
+            if (progress != m_progress) {
+                m_reporter->setProgress(progress);
+                m_progress = progress;
+            }
+        }
+
+        // Divide up the next threadCount * chunkSize bytes, pushing
+        // each boundary on to the start of a line
+
+        std::vector<NumericChunk> chunks;
+
+        while (data < end && int(chunks.size()) < threadCount) {
+            const char *chunkEnd = end;
+            if (end - data > chunkSize) {
+                chunkEnd = data + chunkSize;
+                while (chunkEnd < end &&
+                       *chunkEnd != '\n' && *chunkEnd != '\r') {
+                    ++chunkEnd;
+                }
+                if (chunkEnd < end) ++chunkEnd;
+            }
+            NumericChunk chunk;
+            chunk.begin = data;
+            chunk.end = chunkEnd;
+            chunk.supported = false;
+            chunks.push_back(chunk);
+            data = chunkEnd;
+        }
+
+        std::vector<NumericChunkParser *> parsers;
+        for (int i = 1; in_range_for(chunks, i); ++i) {
+            parsers.push_back(new NumericChunkParser(layout, chunks[i]));
+            parsers.back()->start();
+        }
+        parseNumericChunk(layout, chunks[0]);
+        for (auto parser: parsers) {
+            parser->wait();
+            delete parser;
+        }
+
+        // Merge the parsed rows in file order, following the same
+        // rules for frames, resolution and extents as load()
+        
+        for (const auto &chunk: chunks) {
+
+            if (!chunk.supported) {
+                supported = false;
+                break;
+            }
+
+            size_t badIndex = 0;
+            const float *values = chunk.values.data();
+            
+            for (int row = 0; in_range_for(chunk.rowFrames, row); ++row) {
+
+                if (chunk.rowFrames[row] >= 0) {
+                    frameNo = chunk.rowFrames[row];
+                }
+
+                int n = chunk.rowValueCounts[row];
+                DenseThreeDimensionalModel::Column column(values, values + n);
+                values += n;
+
+                for (float value: column) {
+                    if (firstEverValue || value < min) min = value;
+                    if (firstEverValue || value > max) max = value;
+                    if (firstEverValue) {
+                        startFrame = frameNo;
+                        model3->setStartFrame(startFrame);
+                    } else if (lineno == 1 &&
+                               timingType == CSVFormat::ExplicitTiming) {
+                        model3->setResolution(int(frameNo - startFrame));
+                    }
+                    firstEverValue = false;
+                }
+
+                if (badIndex < chunk.badValueRows.size() &&
+                    chunk.badValueRows[badIndex] == row) {
+                    ++badIndex;
+                    if (warnings < warnLimit) {
+                        SVCERR << "WARNING: CSVFileReader::load: "
+                               << "Non-numeric value in data line "
+                               << lineno+1 << endl;
+                        ++warnings;
+                    }
+                }
+                
+                model3->setColumn(lineno, column);
+
+                ++lineno;
+                if (timingType == CSVFormat::ImplicitTiming) {
+                    frameNo += windowSize;
+                }
+            }
+        }
+
+        if (!supported) {
+            break;
+        }
+    }
+
+    file->unmap(mapped);
+    
+    if (!supported || lineno == 0) {
+        SVDEBUG << "CSVFileReader::loadNumericChunked: File is not suitable "
+                << "for chunked load, falling back to line-by-line load"
+                << endl;
+        delete model3;
+        return false;
+    }
+
+    model3->setMinimumLevel(min);
+    model3->setMaximumLevel(max);
+
+    model = model3;
+    return true;
+}
+
 QString
 CSVFileReader::getConvertedAudioFilePath() const
 {
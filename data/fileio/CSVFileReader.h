@@ -21,11 +21,14 @@
 #include "CSVFormat.h"
 
 #include "base/BaseTypes.h"
+#include "base/Thread.h"
 
 #include <QList>
 #include <QStringList>
 #include <QIODevice>
 
+#include <vector>
+
 class QFile;
 class ProgressReporter;
 
@@ -57,6 +60,22 @@ public:
 
     Model *load() const override;
 
+    /**
+     * Set the size in bytes of the sections into which a file is
+     * divided for parsing on several threads at once, when it can be
+     * loaded that way. The default is 8MB. This is mostly of use in
+     * testing, where a very small size makes rows fall on either side
+     * of section boundaries.
+     */
+    void setChunkSize(qint64 bytes) { m_chunkSize = bytes; }
+
+    /**
+     * Return true if the last call to load() parsed the file in
+     * sections on several threads, or false if it read it line by
+     * line.
+     */
+    bool wasLoadedInChunks() const { return m_loadedInChunks; }
+
 protected:
     CSVFormat m_format;
     QIODevice *m_device;
@@ -69,11 +88,73 @@ protected:
     mutable qint64 m_readCount;
     mutable int m_progress;
     ProgressReporter *m_reporter;
+    qint64 m_chunkSize;
+    mutable bool m_loadedInChunks;
 
     bool convertTimeValue(QString, int lineno, sv_samplerate_t sampleRate,
                           int windowSize, sv_frame_t &calculatedFrame) const;
 
     QString getConvertedAudioFilePath() const;
+
+    /**
+     * Description of how to pull numbers out of a line, shared by all
+     * of the chunk parsers in a chunked load.
+     */
+    struct NumericLayout {
+        char separator;
+        bool quotingAllowed;
+        int startTimeColumn;             // -1 for implicit timing
+        std::vector<bool> valueColumns;  // indexed by column number
+        CSVFormat::TimeUnits timeUnits;
+        sv_samplerate_t sampleRate;
+        int windowSize;
+    };
+
+    /**
+     * One line-aligned section of a memory-mapped file, together with
+     * the rows parsed from it. Values are stored flat, with
+     * rowValueCounts recording how many belong to each row.
+     */
+    struct NumericChunk {
+        const char *begin;
+        const char *end;
+        bool supported;
+        std::vector<sv_frame_t> rowFrames;
+        std::vector<int> rowValueCounts;
+        std::vector<float> values;
+        std::vector<int> badValueRows;
+    };
+
+    class NumericChunkParser : public Thread
+    {
+    public:
+        NumericChunkParser(const NumericLayout &layout, NumericChunk &chunk) :
+            m_layout(layout), m_chunk(chunk) { }
+        void run() override;
+
+    protected:
+        const NumericLayout &m_layout;
+        NumericChunk &m_chunk;
+    };
+
+    /**
+     * Load a three-dimensional model from a file we have opened
+     * ourselves, by memory-mapping it and parsing line-aligned
+     * chunks of it on several threads at once, without going through
+     * QString. The rows are added to the model in file order.
+     *
+     * Return false if the file or format is not suitable for this
+     * (for example because it uses quoting or non-numeric time
+     * values), in which case nothing has been created and the caller
+     * should use the line-by-line load instead.
+     */
+    bool loadNumericChunked(sv_samplerate_t sampleRate,
+                            int windowSize,
+                            int valueColumns,
+                            Model *&model) const;
+
+    static void parseNumericChunk(const NumericLayout &layout,
+                                  NumericChunk &chunk);
 };
 
 
@@ -18,6 +18,7 @@
 #include "base/StringBits.h"
 
 #include <QFile>
+#include <QByteArray>
 #include <QString>
 #include <QRegExp>
 #include <QStringList>
@@ -27,6 +28,47 @@
 
 #include "base/Debug.h"
 
+namespace {
+
+// Limits on how much of a file we look at when guessing
+const qint64 headSampleBytes = 64 * 1024;
+const int headSampleLines = 150;
+const int seekSampleCount = 4;
+const qint64 seekSampleBytes = 8 * 1024;
+const int seekSampleLines = 10;
+
+bool isLineEnd(char c)
+{
+    return (c == '\n' || c == '\r');
+}
+
+/**
+ * Decode bytes into lines, splitting at any of CR, LF or CR/LF, and
+ * append the non-empty ones to lines until maxLines of them (not
+ * counting comments) have been added.
+ */
+void appendLines(QByteArray bytes, int maxLines, QStringList &lines)
+{
+    QTextStream in(&bytes, QIODevice::ReadOnly);
+    int count = 0;
+
+    while (!in.atEnd() && count < maxLines) {
+
+        // See comment about line endings in CSVFileReader::load() 
+
+        QString chunk = in.readLine();
+        QStringList parts = chunk.split('\r', QString::SkipEmptyParts);
+
+        for (const QString &line: parts) {
+            lines.push_back(line);
+            if (line.startsWith("#")) continue;
+            if (++count >= maxLines) break;
+        }
+    }
+}
+
+}
+
 CSVFormat::CSVFormat(QString path) :
     m_separator(""),
     m_sampleRate(44100),
@@ -67,47 +109,111 @@ CSVFormat::guessFormatFor(QString path)
     }
     SVDEBUG << "CSVFormat::guessFormatFor(" << path << ")" << endl;
 
-    QTextStream in(&file);
-    in.seek(0);
+    QStringList lines = readSampleLines(file);
 
     int lineno = 0;
 
-    while (!in.atEnd()) {
+    for (const QString &line: lines) {
+        if (line.startsWith("#") || line == "") {
+            continue;
+        }
+        guessQualities(line, lineno);
+        ++lineno;
+    }
 
-        // See comment about line endings in CSVFileReader::load() 
+    guessPurposes();
+    guessAudioSampleRange();
 
-        QString chunk = in.readLine();
-        QStringList lines = chunk.split('\r', QString::SkipEmptyParts);
+    return true;
+}
 
-        for (int li = 0; li < lines.size(); ++li) {
+QStringList
+CSVFormat::readSampleLines(QFile &file)
+{
+    QStringList lines;
 
-            QString line = lines[li];
-            if (line.startsWith("#") || line == "") {
-                continue;
+    qint64 size = file.size();
+    
+    QByteArray head = file.read(headSampleBytes);
+    bool wholeFile = file.atEnd();
+
+    if (!wholeFile) {
+        // Drop the incomplete final line, unless it is the only one,
+        // in which case we have to read the rest of it
+        int lastEnd = -1;
+        for (int i = head.size(); i > 0; --i) {
+            if (isLineEnd(head[i-1])) {
+                lastEnd = i;
+                break;
             }
+        }
+        if (lastEnd < 0) {
+            head += file.readLine();
+        } else {
+            head.truncate(lastEnd);
+        }
+    }
 
-            guessQualities(line, lineno);
+    qint64 headEnd = head.size();
+    
+    appendLines(head, headSampleLines, lines);
 
-            ++lineno;
-        }
+    if (wholeFile || headEnd >= size) {
+        return lines;
+    }
 
-        if (lineno >= 150) break;
+    // Arbitrary seeks are only safe in byte-oriented encodings
+    if (head.size() >= 2 &&
+        ((uchar(head[0]) == 0xff && uchar(head[1]) == 0xfe) ||
+         (uchar(head[0]) == 0xfe && uchar(head[1]) == 0xff))) {
+        return lines;
     }
 
-    guessPurposes();
-    guessAudioSampleRange();
+    // Then take a few lines from each of several evenly spaced
+    // positions through the remainder of the file. Each of these
+    // starts with a partial line which we skip, and (unless it hits
+    // the end of the file) ends with one which we drop.
+    
+    qint64 prevEnd = headEnd;
+    
+    for (int i = 0; i < seekSampleCount; ++i) {
 
-    return true;
+        qint64 pos = headEnd + ((size - headEnd) * (i + 1)) /
+            (seekSampleCount + 1);
+        if (pos < prevEnd) pos = prevEnd;
+        if (pos >= size) break;
+
+        if (!file.seek(pos)) break;
+        QByteArray bytes = file.read(seekSampleBytes);
+        prevEnd = pos + bytes.size();
+
+        int start = 0;
+        while (start < bytes.size() && !isLineEnd(bytes[start])) ++start;
+        if (start == bytes.size()) continue;
+
+        int end = bytes.size();
+        if (prevEnd < size) {
+            while (end > start && !isLineEnd(bytes[end-1])) --end;
+        }
+
+        appendLines(bytes.mid(start, end - start), seekSampleLines, lines);
+    }
+    
+    return lines;
 }
 
 void
 CSVFormat::guessSeparator(QString line)
 {
     QString candidates = "\t|,/: ";
-
-    for (int i = 0; i < candidates.length(); ++i) {
-        auto bits = StringBits::split(line, candidates[i], m_allowQuoting);
-        if (bits.size() >= 2) {
+    int nc = candidates.length();
+
+    for (int i = 0; i < nc; ++i) {
+        // Count the fields the line would split into, without
+        // building the list of fields itself
+        int count = StringBits::countFields(line, candidates[i],
+                                            m_allowQuoting);
+        if (count >= 2) {
             m_plausibleSeparators.insert(candidates[i]);
             if (m_separator == "") {
                 m_separator = candidates[i];
@@ -24,6 +24,8 @@
 
 #include "base/BaseTypes.h"
 
+class QFile;
+
 class CSVFormat
 {
 public:
@@ -115,6 +117,11 @@ public:
      * Note also that this function will never guess WaveFileModel for
      * the model type.
      *
+     * Only a bounded sample of the file is examined: the lines at
+     * the start of the file, plus a few short runs of lines read from
+     * evenly spaced positions through the rest of it. The cost of
+     * guessing is therefore roughly independent of file size.
+     *
      * Return false if there is some fundamental error, e.g. the file
      * could not be opened at all. Return true otherwise. Note that
      * this function returns true even if the file doesn't appear to
@@ -190,6 +197,8 @@ protected:
     QList<QStringList> m_example;
     int m_maxExampleCols;
 
+    static QStringList readSampleLines(QFile &file);
+    
     void guessSeparator(QString line);
     void guessQualities(QString line, int lineno);
     void guessPurposes();
@@ -546,6 +546,39 @@ CodedAudioFileReader::pushBufferResampling(float *buffer, sv_frame_t sz,
     }
 }
 
+sv_frame_t
+CodedAudioFileReader::getAvailableFrameCount() const
+{
+    if (!isUpdating()) {
+        return getFrameCount();
+    }
+
+    // While decoding, the frame count runs ahead of what has reached
+    // the cache, so count what is actually in it. And if normalising,
+    // nothing is final until the gain is known at the end
+    
+    if (!m_initialised || m_normalised || m_channelCount == 0) {
+        return 0;
+    }
+
+    switch (m_cacheMode) {
+
+    case CacheInTemporaryFile:
+        if (m_cacheFileReader) {
+            return m_cacheFileReader->getFrameCount();
+        }
+        break;
+
+    case CacheInMemory:
+    {
+        QMutexLocker locker(&m_dataLock);
+        return sv_frame_t(m_data.size()) / m_channelCount;
+    }
+    }
+
+    return 0;
+}
+
 floatvec_t
 CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) const
 {
@@ -56,6 +56,8 @@ public:
 
     floatvec_t getInterleavedFrames(sv_frame_t start, sv_frame_t count) const override;
 
+    sv_frame_t getAvailableFrameCount() const override;
+
     sv_samplerate_t getNativeRate() const override { return m_fileRate; }
 
     QString getLocalFilename() const override { return m_cacheFileName; }
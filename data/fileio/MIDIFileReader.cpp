@@ -66,10 +66,7 @@ MIDIFileReader::MIDIFileReader(QString path,
     m_subframes(0),
     m_format(MIDI_FILE_BAD_FORMAT),
     m_numberOfTracks(0),
-    m_trackByteCount(0),
-    m_decrementCount(false),
     m_path(path),
-    m_midiFile(nullptr),
     m_fileSize(0),
     m_mainModelSampleRate(mainModelSampleRate),
     m_acquirer(acquirer)
@@ -136,73 +133,44 @@ MIDIFileReader::midiBytesToInt(const string& bytes)
 
 
 // Gets a single byte from the MIDI byte stream.  For each track
-// section we can read only a specified number of bytes held in
-// m_trackByteCount.
+// section we can read only up to the limit given by the track's byte
+// count.
 //
 MIDIByte
-MIDIFileReader::getMIDIByte()
+MIDIFileReader::ByteCursor::getMIDIByte()
 {
-    if (!m_midiFile) {
-        throw MIDIException(tr("getMIDIByte called but no MIDI file open"));
-    }
-
-    if (m_midiFile->eof()) {
-        throw MIDIException(tr("End of MIDI file encountered while reading"));
-    }
-
-    if (m_decrementCount && m_trackByteCount <= 0) {
+    if (m_pos >= m_limit) {
         throw MIDIException(tr("Attempt to get more bytes than expected on Track"));
     }
 
-    char byte;
-    if (m_midiFile->read(&byte, 1)) {
-        --m_trackByteCount;
-        return (MIDIByte)byte;
+    if (m_pos >= m_data.size()) {
+        throw MIDIException(tr("Attempt to read past MIDI file end"));
     }
 
-    throw MIDIException(tr("Attempt to read past MIDI file end"));
+    return (MIDIByte)m_data[m_pos++];
 }
 
 
 // Gets a specified number of bytes from the MIDI byte stream.  For
-// each track section we can read only a specified number of bytes
-// held in m_trackByteCount.
+// each track section we can read only up to the limit given by the
+// track's byte count.
 //
 string
-MIDIFileReader::getMIDIBytes(unsigned long numberOfBytes)
+MIDIFileReader::ByteCursor::getMIDIBytes(unsigned long numberOfBytes)
 {
-    if (!m_midiFile) {
-        throw MIDIException(tr("getMIDIBytes called but no MIDI file open"));
-    }
-
-    if (m_midiFile->eof()) {
-        throw MIDIException(tr("End of MIDI file encountered while reading"));
-    }
-
-    if (m_decrementCount && (numberOfBytes > (unsigned long)m_trackByteCount)) {
-        throw MIDIException(tr("Attempt to get more bytes than available on Track (%1, only have %2)").arg(numberOfBytes).arg(m_trackByteCount));
-    }
-
-    string stringRet;
-    char fileMIDIByte;
-
-    while (stringRet.length() < numberOfBytes &&
-           m_midiFile->read(&fileMIDIByte, 1)) {
-        stringRet += fileMIDIByte;
+    if (m_limit != string::npos && numberOfBytes > m_limit - m_pos) {
+        throw MIDIException(tr("Attempt to get more bytes than available on Track (%1, only have %2)").arg(numberOfBytes).arg(m_limit - m_pos));
     }
 
-    // if we've reached the end of file without fulfilling the
-    // quota then panic as our parsing has performed incorrectly
+    // if we would reach the end of file without fulfilling the quota
+    // then panic as our parsing has performed incorrectly
     //
-    if (stringRet.length() < numberOfBytes) {
-        stringRet = "";
+    if (numberOfBytes > m_data.size() - m_pos) {
         throw MIDIException(tr("Attempt to read past MIDI file end"));
     }
 
-    // decrement the byte count
-    if (m_decrementCount)
-        m_trackByteCount -= stringRet.length();
-
+    string stringRet = m_data.substr(m_pos, numberOfBytes);
+    m_pos += numberOfBytes;
     return stringRet;
 }
 
@@ -210,19 +178,13 @@ MIDIFileReader::getMIDIBytes(unsigned long numberOfBytes)
 // Get a long number of variable length from the MIDI byte stream.
 //
 long
-MIDIFileReader::getNumberFromMIDIBytes(int firstByte)
+MIDIFileReader::ByteCursor::getNumberFromMIDIBytes(int firstByte)
 {
-    if (!m_midiFile) {
-        throw MIDIException(tr("getNumberFromMIDIBytes called but no MIDI file open"));
-    }
-
     long longRet = 0;
     MIDIByte midiByte;
 
     if (firstByte >= 0) {
         midiByte = (MIDIByte)firstByte;
-    } else if (m_midiFile->eof()) {
-        return longRet;
     } else {
         midiByte = getMIDIByte();
     }
@@ -233,40 +195,31 @@ MIDIFileReader::getNumberFromMIDIBytes(int firstByte)
         do {
             midiByte = getMIDIByte();
             longRet = (longRet << 7) + (midiByte & 0x7F);
-        } while (!m_midiFile->eof() && (midiByte & 0x80));
+        } while (midiByte & 0x80);
     }
 
     return longRet;
 }
 
 
-// Seek to the next track in the midi file and set the number
-// of bytes to be read in the counter m_trackByteCount.
+// Seek to the next track in the midi file and record its extent in
+// the given chunk, leaving the cursor at the end of the track.
 //
 bool
-MIDIFileReader::skipToNextTrack()
+MIDIFileReader::skipToNextTrack(ByteCursor &cursor, TrackChunk &chunk)
 {
-    if (!m_midiFile) {
-        throw MIDIException(tr("skipToNextTrack called but no MIDI file open"));
-    }
-
-    string buffer, buffer2;
-    m_trackByteCount = -1;
-    m_decrementCount = false;
-
-    while (!m_midiFile->eof() && (m_decrementCount == false)) {
-        buffer = getMIDIBytes(4); 
+    while (!cursor.atLimit()) {
+        string buffer = cursor.getMIDIBytes(4);
         if (buffer.compare(0, 4, MIDI_TRACK_HEADER) == 0) {
-            m_trackByteCount = midiBytesToLong(getMIDIBytes(4));
-            m_decrementCount = true;
+            chunk.length = (unsigned long)midiBytesToLong(cursor.getMIDIBytes(4));
+            chunk.start = cursor.getPosition();
+            chunk.trackCount = 0;
+            cursor.skip(chunk.length);
+            return true;
         }
     }
 
-    if (m_trackByteCount == -1) { // we haven't found a track
-        return false;
-    } else {
-        return true;
-    }
+    return false;
 }
 
 
@@ -283,90 +236,146 @@ MIDIFileReader::parseFile()
     SVDEBUG << "MIDIFileReader::open() : fileName = " << m_fileName.c_str() << endl;
 #endif
 
-    // Open the file
+    // Read the whole file in one go; everything after this works
+    // from memory
 #ifdef _MSC_VER
-    m_midiFile = new ifstream(m_path.utf16(),
-                              ios::in | ios::binary);
+    ifstream midiFile(m_path.utf16(), ios::in | ios::binary);
 #else
-    m_midiFile = new ifstream(m_path.toUtf8().data(),
-                              ios::in | ios::binary);
+    ifstream midiFile(m_path.toUtf8().data(), ios::in | ios::binary);
 #endif
 
-    if (!*m_midiFile) {
+    if (!midiFile) {
         m_error = "File not found or not readable.";
         m_format = MIDI_FILE_BAD_FORMAT;
-        delete m_midiFile;
-        m_midiFile = nullptr;
         return false;
     }
 
+    midiFile.seekg(0, ios::end);
+    std::streamoff off = midiFile.tellg();
+    m_fileSize = 0;
+    if (off > 0) m_fileSize = off;
+    midiFile.seekg(0, ios::beg);
+
+    string data(m_fileSize, '\0');
+    if (m_fileSize > 0) {
+        midiFile.read(&data[0], m_fileSize);
+        data.resize(size_t(midiFile.gcount()));
+    }
+    midiFile.close();
+
     bool retval = false;
 
+    // Locate all of the tracks first (cheap), then parse them
+    // (possibly in parallel), then merge the results in order
+    
+    vector<TrackChunk> chunks;
+    std::shared_ptr<MIDIException> locateError;
+    bool headerRead = false;
+    bool allLocated = false;
+    
     try {
 
-        // Set file size so we can count it off
-        //
-        m_midiFile->seekg(0, ios::end);
-        std::streamoff off = m_midiFile->tellg();
-        m_fileSize = 0;
-        if (off > 0) m_fileSize = off;
-        m_midiFile->seekg(0, ios::beg);
+        ByteCursor cursor(data, 0);
 
         // Parse the MIDI header first.  The first 14 bytes of the file.
-        if (!parseHeader(getMIDIBytes(14))) {
+        if (!parseHeader(cursor.getMIDIBytes(14))) {
             m_format = MIDI_FILE_BAD_FORMAT;
             m_error = "Not a MIDI file.";
             goto done;
         }
 
-        unsigned int i = 0;
-
+        headerRead = true;
+        
         for (unsigned int j = 0; j < m_numberOfTracks; ++j) {
 
-#ifdef MIDI_DEBUG
-            SVDEBUG << "Parsing Track " << j << endl;
-#endif
-
-            if (!skipToNextTrack()) {
+            TrackChunk chunk;
+            
+            if (!skipToNextTrack(cursor, chunk)) {
 #ifdef MIDI_DEBUG
                 SVDEBUG << "Couldn't find Track " << j << endl;
 #endif
-                m_error = "File corrupted or in non-standard format?";
-                m_format = MIDI_FILE_BAD_FORMAT;
-                goto done;
+                break;
             }
 
 #ifdef MIDI_DEBUG
-            SVDEBUG << "Track has " << m_trackByteCount << " bytes" << endl;
+            SVDEBUG << "Track " << j << " has " << chunk.length << " bytes" << endl;
 #endif
 
-            // Run through the events taking them into our internal
-            // representation.
-            if (!parseTrack(i)) {
-#ifdef MIDI_DEBUG
-                SVDEBUG << "Track " << j << " parsing failed" << endl;
-#endif
-                m_error = "File corrupted or in non-standard format?";
-                m_format = MIDI_FILE_BAD_FORMAT;
-                goto done;
-            }
-
-            ++i; // j is the source track number, i the destination
+            chunks.push_back(chunk);
         }
-        
-        m_numberOfTracks = i;
-        retval = true;
+
+        allLocated = (chunks.size() == m_numberOfTracks);
 
     } catch (const MIDIException &e) {
 
-        SVDEBUG << "MIDIFileReader::open() - caught exception - " << e.what() << endl;
-        m_error = e.what();
+        if (!headerRead) {
+            SVDEBUG << "MIDIFileReader::open() - caught exception - " << e.what() << endl;
+            m_error = e.what();
+            goto done;
+        }
+
+        // Report this only if all the tracks before it parse OK
+        locateError = std::make_shared<MIDIException>(e);
     }
-    
-done:
-    m_midiFile->close();
-    delete m_midiFile;
 
+    parseTracks(data, chunks);
+
+    {
+        unsigned int i = 0;
+        size_t merged = 0;
+        bool failed = false;
+
+        for (auto &chunk: chunks) {
+
+            // i is the destination track number for the chunk's
+            // first track
+            
+            for (auto &t: chunk.composition) {
+                m_midiComposition[i + t.first] = t.second;
+            }
+            chunk.composition.clear();
+            for (const auto &n: chunk.trackNames) {
+                m_trackNames[i + n.first] = n.second;
+            }
+            for (auto p: chunk.percussionTracks) {
+                m_percussionTracks.insert(i + p);
+            }
+            ++merged;
+
+            if (chunk.error) {
+                SVDEBUG << "MIDIFileReader::open() - caught exception - " << chunk.error->what() << endl;
+                m_error = chunk.error->what();
+                failed = true;
+                break;
+            }
+
+            i += chunk.trackCount;
+        }
+
+        // Any tracks after a failure are discarded
+        for (size_t j = merged; j < chunks.size(); ++j) {
+            for (auto &t: chunks[j].composition) {
+                for (auto e: t.second) {
+                    delete e;
+                }
+            }
+        }
+        
+        if (!failed) {
+            if (locateError) {
+                SVDEBUG << "MIDIFileReader::open() - caught exception - " << locateError->what() << endl;
+                m_error = locateError->what();
+            } else if (!allLocated) {
+                m_error = "File corrupted or in non-standard format?";
+                m_format = MIDI_FILE_BAD_FORMAT;
+            } else {
+                m_numberOfTracks = i;
+                retval = true;
+            }
+        }
+    }
+
+done:
     for (unsigned int track = 0; track < m_numberOfTracks; ++track) {
 
         // Convert the deltaTime to an absolute time since the track
@@ -394,6 +403,49 @@ done:
     return retval;
 }
 
+void
+MIDIFileReader::TrackParseThread::run()
+{
+    for (size_t i = m_first; i < m_chunks.size(); i += m_step) {
+        m_reader->parseTrack(m_data, m_chunks[i]);
+    }
+}
+
+// Parse all of the given track chunks, sharing them out among a
+// number of threads if there is more than one. Each chunk is
+// independent of the others until they are merged.
+//
+void
+MIDIFileReader::parseTracks(const string &data,
+                            vector<TrackChunk> &chunks) const
+{
+    size_t threadCount = QThread::idealThreadCount();
+    if (threadCount > chunks.size()) threadCount = chunks.size();
+
+    if (threadCount <= 1) {
+        for (auto &chunk: chunks) {
+            parseTrack(data, chunk);
+        }
+        return;
+    }
+
+    vector<TrackParseThread *> threads;
+    for (size_t i = 1; i < threadCount; ++i) {
+        threads.push_back(new TrackParseThread
+                          (this, data, chunks, i, threadCount));
+        threads.back()->start();
+    }
+
+    for (size_t i = 0; i < chunks.size(); i += threadCount) {
+        parseTrack(data, chunks[i]);
+    }
+
+    for (auto t: threads) {
+        t->wait();
+        delete t;
+    }
+}
+
 // Parse and ensure the MIDI Header is legitimate
 //
 bool
@@ -439,12 +491,38 @@ MIDIFileReader::parseHeader(const string &midiHeader)
     return true; 
 }
 
-// Extract the contents from a MIDI file track and places it into
-// our local map of MIDI events.
+// Extract the contents from a MIDI file track and place it into the
+// chunk's own map of MIDI events.  This touches nothing outside the
+// chunk, so that tracks can be parsed concurrently.  If we run into
+// trouble, the exception is stored in the chunk along with whatever
+// we had parsed before it.
 //
-bool
-MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
+void
+MIDIFileReader::parseTrack(const string &data, TrackChunk &chunk) const
+{
+    // The track number is relative to the chunk: 0 is the default
+    // track for all events provided they're all on the same
+    // channel.  If we find events on more than one channel, we
+    // increment lastTrackNum and record the mapping from channel to
+    // track number in channelTrackMap.
+
+    unsigned int lastTrackNum = 0;
+
+    try {
+        parseTrackEvents(data, chunk, lastTrackNum);
+    } catch (const MIDIException &e) {
+        chunk.error = std::make_shared<MIDIException>(e);
+    }
+
+    chunk.trackCount = lastTrackNum + 1;
+}
+
+void
+MIDIFileReader::parseTrackEvents(const string &data, TrackChunk &chunk,
+                                 unsigned int &lastTrackNum) const
 {
+    ByteCursor cursor(data, chunk.start, chunk.start + chunk.length);
+
     MIDIByte midiByte, metaEventCode, data1, data2;
     MIDIByte eventCode = 0x80;
     string metaMessage;
@@ -452,13 +530,6 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
     long deltaTime;
     long accumulatedTime = 0;
 
-    // The trackNum passed in to this method is the default track for
-    // all events provided they're all on the same channel.  If we find
-    // events on more than one channel, we increment trackNum and record
-    // the mapping from channel to trackNum in this channelTrackMap.
-    // We then return the new trackNum by reference so the calling
-    // method knows we've got more tracks than expected.
-
     // This would be a vector<unsigned int> but we need -1 to indicate
     // "not yet used"
     vector<int> channelTrackMap(16, -1);
@@ -478,7 +549,7 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
 
     bool firstTrack = true;
 
-    while (!m_midiFile->eof() && (m_trackByteCount > 0)) {
+    while (cursor.getPosition() < chunk.start + chunk.length) {
 
         if (eventCode < 0x80) {
 #ifdef MIDI_DEBUG
@@ -488,14 +559,14 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
             throw MIDIException(tr("Invalid event code %1 found").arg(int(eventCode)));
         }
 
-        deltaTime = getNumberFromMIDIBytes();
+        deltaTime = cursor.getNumberFromMIDIBytes();
 
 #ifdef MIDI_DEBUG
         SVDEBUG << "read delta time " << deltaTime << endl;
 #endif
 
         // Get a single byte
-        midiByte = getMIDIByte();
+        midiByte = cursor.getMIDIByte();
 
         if (!(midiByte & MIDI_STATUS_BYTE_MASK)) {
 
@@ -514,18 +585,18 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
             SVDEBUG << "have new event code " << int(midiByte) << endl;
 #endif
             eventCode = midiByte;
-            data1 = getMIDIByte();
+            data1 = cursor.getMIDIByte();
         }
 
         if (eventCode == MIDI_FILE_META_EVENT) {
 
             metaEventCode = data1;
-            messageLength = getNumberFromMIDIBytes();
+            messageLength = cursor.getNumberFromMIDIBytes();
 
 //#ifdef MIDI_DEBUG
                 SVDEBUG << "Meta event of type " << int(metaEventCode) << " and " << messageLength << " bytes found, putting on track " << metaTrack << endl;
 //#endif
-            metaMessage = getMIDIBytes(messageLength);
+            metaMessage = cursor.getMIDIBytes(messageLength);
 
             long gap = accumulatedTime - trackTimeMap[metaTrack];
             accumulatedTime += deltaTime;
@@ -537,10 +608,10 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
                                          metaEventCode,
                                          metaMessage);
 
-            m_midiComposition[metaTrack].push_back(e);
+            chunk.composition[metaTrack].push_back(e);
 
             if (metaEventCode == MIDI_TRACK_NAME) {
-                m_trackNames[metaTrack] = metaMessage.c_str();
+                chunk.trackNames[metaTrack] = metaMessage.c_str();
             }
 
         } else { // non-meta events
@@ -572,7 +643,7 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
             case MIDI_NOTE_OFF:
             case MIDI_POLY_AFTERTOUCH:
             case MIDI_CTRL_CHANGE:
-                data2 = getMIDIByte();
+                data2 = cursor.getMIDIByte();
 
                 // create and store our event
                 midiEvent = new MIDIEvent(deltaTime, eventCode, data1, data2);
@@ -584,37 +655,37 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
                           */
 
 
-                m_midiComposition[trackNum].push_back(midiEvent);
+                chunk.composition[trackNum].push_back(midiEvent);
 
                 if (midiEvent->getChannelNumber() == MIDI_PERCUSSION_CHANNEL) {
-                    m_percussionTracks.insert(trackNum);
+                    chunk.percussionTracks.insert(trackNum);
                 }
 
                 break;
 
             case MIDI_PITCH_BEND:
-                data2 = getMIDIByte();
+                data2 = cursor.getMIDIByte();
 
                 // create and store our event
                 midiEvent = new MIDIEvent(deltaTime, eventCode, data1, data2);
-                m_midiComposition[trackNum].push_back(midiEvent);
+                chunk.composition[trackNum].push_back(midiEvent);
                 break;
 
             case MIDI_PROG_CHANGE:
             case MIDI_CHNL_AFTERTOUCH:
                 // create and store our event
                 midiEvent = new MIDIEvent(deltaTime, eventCode, data1);
-                m_midiComposition[trackNum].push_back(midiEvent);
+                chunk.composition[trackNum].push_back(midiEvent);
                 break;
 
             case MIDI_SYSTEM_EXCLUSIVE:
-                messageLength = getNumberFromMIDIBytes(data1);
+                messageLength = cursor.getNumberFromMIDIBytes(data1);
 
 #ifdef MIDI_DEBUG
                 SVDEBUG << "SysEx of " << messageLength << " bytes found" << endl;
 #endif
 
-                metaMessage= getMIDIBytes(messageLength);
+                metaMessage= cursor.getMIDIBytes(messageLength);
 
                 if (MIDIByte(metaMessage[metaMessage.length() - 1]) !=
                         MIDI_END_OF_EXCLUSIVE)
@@ -635,7 +706,7 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
                 midiEvent = new MIDIEvent(deltaTime,
                                           MIDI_SYSTEM_EXCLUSIVE,
                                           metaMessage);
-                m_midiComposition[trackNum].push_back(midiEvent);
+                chunk.composition[trackNum].push_back(midiEvent);
                 break;
 
             default:
@@ -651,12 +722,10 @@ MIDIFileReader::parseTrack(unsigned int &lastTrackNum)
 
     if (lastTrackNum > metaTrack) {
         for (unsigned int track = metaTrack + 1; track <= lastTrackNum; ++track) {
-            m_trackNames[track] = QString("%1 <%2>")
-                .arg(m_trackNames[metaTrack]).arg(track - metaTrack + 1);
+            chunk.trackNames[track] = QString("%1 <%2>")
+                .arg(chunk.trackNames[metaTrack]).arg(track - metaTrack + 1);
         }
     }
-
-    return true;
 }
 
 // Delete dead NOTE OFF and NOTE ON/Zero Velocity Events after
@@ -898,8 +967,16 @@ MIDIFileReader::load() const
 
     if (tracksToLoad.empty()) return nullptr;
 
+    NoteModel *model = new NoteModel(m_mainModelSampleRate, 1, false);
+    model->setValueQuantization(1.0);
+    model->setObjectName(QFileInfo(m_path).fileName());
+
+    // Collect the notes from all tracks and add them to the model in
+    // one go, rather than one at a time
+    
+    EventVector notes;
+    
     int n = int(tracksToLoad.size()), count = 0;
-    Model *model = nullptr;
 
     for (std::set<unsigned int>::iterator i = tracksToLoad.begin();
          i != tracksToLoad.end(); ++i) {
@@ -907,41 +984,26 @@ MIDIFileReader::load() const
         int minProgress = (100 * count) / n;
         int progressAmount = 100 / n;
 
-        model = loadTrack(*i, model, minProgress, progressAmount);
+        loadTrack(*i, model, notes, minProgress, progressAmount);
 
         ++count;
     }
 
-    if (dynamic_cast<NoteModel *>(model)) {
-        dynamic_cast<NoteModel *>(model)->setCompletion(100);
-    }
+    model->addEvents(notes);
+    model->setCompletion(100);
 
     return model;
 }
 
-Model *
+void
 MIDIFileReader::loadTrack(unsigned int trackToLoad,
-                          Model *existingModel,
+                          NoteModel *model,
+                          EventVector &notes,
                           int minProgress,
                           int progressAmount) const
 {
     if (m_midiComposition.find(trackToLoad) == m_midiComposition.end()) {
-        return nullptr;
-    }
-
-    NoteModel *model = nullptr;
-
-    if (existingModel) {
-        model = dynamic_cast<NoteModel *>(existingModel);
-        if (!model) {
-            SVDEBUG << "WARNING: MIDIFileReader::loadTrack: Existing model given, but it isn't a NoteModel -- ignoring it" << endl;
-        }
-    }
-
-    if (!model) {
-        model = new NoteModel(m_mainModelSampleRate, 1, false);
-        model->setValueQuantization(1.0);
-        model->setObjectName(QFileInfo(m_path).fileName());
+        return;
     }
 
     const MIDITrack &track = m_midiComposition.find(trackToLoad)->second;
@@ -1037,7 +1099,7 @@ MIDIFileReader::loadTrack(unsigned int trackToLoad,
 
 //                    SVDEBUG << "Adding note " << startFrame << "," << (endFrame-startFrame) << " : " << int((*i)->getPitch()) << endl;
 
-                    model->add(note);
+                    notes.push_back(note);
                     break;
                 }
 
@@ -1062,8 +1124,6 @@ MIDIFileReader::loadTrack(unsigned int trackToLoad,
                              (count * progressAmount) / totalEvents);
         ++count;
     }
-
-    return model;
 }
 
 
@@ -23,14 +23,20 @@
 
 #include "DataFileReader.h"
 #include "base/RealTime.h"
+#include "base/Event.h"
+#include "base/Thread.h"
 
 #include <map>
 #include <set>
 #include <vector>
+#include <string>
+#include <memory>
 
 #include <QObject>
 
 class MIDIEvent;
+class MIDIException;
+class NoteModel;
 class ProgressReporter;
 
 typedef unsigned char MIDIByte;
@@ -83,14 +89,84 @@ protected:
         MIDI_FILE_BAD_FORMAT            = 0xFF
     } MIDIFileFormatType;
 
+    /**
+     * Reads bytes from the in-memory file data, starting at a given
+     * position and refusing to go beyond the end of the data or
+     * beyond a given limit (the end of the current track) if there
+     * is one.
+     */
+    class ByteCursor
+    {
+    public:
+        ByteCursor(const std::string &data, size_t start,
+                   size_t limit = std::string::npos) :
+            m_data(data), m_pos(start), m_limit(limit) { }
+
+        MIDIByte getMIDIByte();
+        std::string getMIDIBytes(unsigned long bytes);
+        long getNumberFromMIDIBytes(int firstByte = -1);
+
+        size_t getPosition() const { return m_pos; }
+        void skip(size_t bytes) { m_pos += bytes; }
+        bool atLimit() const {
+            return m_pos >= m_limit || m_pos >= m_data.size();
+        }
+
+    private:
+        const std::string &m_data;
+        size_t m_pos;
+        size_t m_limit;
+    };
+
+    /**
+     * One MTrk chunk of the file, together with the events parsed
+     * from it. Track numbers in the composition, names and percussion
+     * set start at zero for each chunk, and are offset into the
+     * overall numbering when the chunks are merged in file order.
+     */
+    struct TrackChunk {
+        size_t start;
+        size_t length;
+        MIDIComposition composition;
+        std::map<int, QString> trackNames;
+        std::set<unsigned int> percussionTracks;
+        unsigned int trackCount;
+        std::shared_ptr<MIDIException> error;
+    };
+
+    class TrackParseThread : public Thread
+    {
+    public:
+        TrackParseThread(const MIDIFileReader *reader,
+                         const std::string &data,
+                         std::vector<TrackChunk> &chunks,
+                         size_t first, size_t step) :
+            m_reader(reader), m_data(data), m_chunks(chunks),
+            m_first(first), m_step(step) { }
+        void run() override;
+
+    protected:
+        const MIDIFileReader *m_reader;
+        const std::string &m_data;
+        std::vector<TrackChunk> &m_chunks;
+        size_t m_first;
+        size_t m_step;
+    };
+
     bool parseFile();
     bool parseHeader(const std::string &midiHeader);
-    bool parseTrack(unsigned int &trackNum);
-
-    Model *loadTrack(unsigned int trackNum,
-                     Model *existingModel = 0,
-                     int minProgress = 0,
-                     int progressAmount = 100) const;
+    bool skipToNextTrack(ByteCursor &cursor, TrackChunk &chunk);
+    void parseTracks(const std::string &data,
+                     std::vector<TrackChunk> &chunks) const;
+    void parseTrack(const std::string &data, TrackChunk &chunk) const;
+    void parseTrackEvents(const std::string &data, TrackChunk &chunk,
+                          unsigned int &lastTrackNum) const;
+
+    void loadTrack(unsigned int trackNum,
+                   NoteModel *model,
+                   EventVector &notes,
+                   int minProgress = 0,
+                   int progressAmount = 100) const;
 
     bool consolidateNoteOffEvents(unsigned int track);
     void updateTempoMap(unsigned int track);
@@ -102,13 +178,6 @@ protected:
     int  midiBytesToInt(const std::string &bytes);
     long midiBytesToLong(const std::string &bytes);
 
-    long getNumberFromMIDIBytes(int firstByte = -1);
-
-    MIDIByte getMIDIByte();
-    std::string getMIDIBytes(unsigned long bytes);
-
-    bool skipToNextTrack();
-
     bool                   m_smpte;
     int                    m_timingDivision;   // pulses per quarter note
     int                    m_fps;              // if smpte
@@ -116,9 +185,6 @@ protected:
     MIDIFileFormatType     m_format;
     unsigned int           m_numberOfTracks;
 
-    long                   m_trackByteCount;
-    bool                   m_decrementCount;
-
     std::map<int, QString> m_trackNames;
     std::set<unsigned int> m_loadableTracks;
     std::set<unsigned int> m_percussionTracks;
@@ -126,7 +192,6 @@ protected:
     TempoMap               m_tempoMap;
 
     QString                m_path;
-    std::ifstream         *m_midiFile;
     size_t                 m_fileSize;
     QString                m_error;
     sv_samplerate_t        m_mainModelSampleRate;
@@ -26,6 +26,8 @@
 #include <QObject>
 #include <QtTest>
 #include <QDir>
+#include <QTemporaryFile>
+#include <QTextStream>
 
 #include <iostream>
 
@@ -139,6 +141,34 @@ private slots:
         QCOMPARE(q, expected);
     }
 
+    void sampledBeyondHead() {
+        // A label column that is empty throughout the first part of
+        // a long file should be found by the samples taken from later
+        // in the file, not mistaken for a near-empty numeric column
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        {
+            QTextStream out(&file);
+            for (int i = 0; i < 50000; ++i) {
+                out << (i + 1) * 2048 << "," << (i % 7) * 0.5;
+                if (i >= 10000) {
+                    out << ",label " << (i % 3);
+                }
+                out << "\n";
+            }
+        }
+        file.close();
+        CSVFormat f;
+        QVERIFY(f.guessFormatFor(file.fileName()));
+        QCOMPARE(f.getSeparator(), QChar(','));
+        QCOMPARE(f.getColumnCount(), 3);
+        QCOMPARE(f.getColumnPurpose(0), CSVFormat::ColumnStartTime);
+        QCOMPARE(f.getColumnPurpose(1), CSVFormat::ColumnValue);
+        QCOMPARE(f.getColumnPurpose(2), CSVFormat::ColumnLabel);
+        QCOMPARE(f.getTimeUnits(), CSVFormat::TimeAudioFrames);
+        QCOMPARE(f.getModelType(), CSVFormat::TwoDimensionalModel);
+    }
+
     void modelType1DSamples() {
         CSVFormat f;
         QVERIFY(f.guessFormatFor(csvDir.filePath("model-type-1d-samples.csv")));
@@ -29,6 +29,7 @@
 #include <QObject>
 #include <QtTest>
 #include <QDir>
+#include <QTemporaryDir>
 
 #include <iostream>
 
@@ -52,6 +53,8 @@ public:
     }
 
 private:
+    QTemporaryDir tempDir;
+
     void loadFrom(QString filename, Model *&model) {
         QString path(csvDir.filePath(filename));
         CSVFormat f;
@@ -63,6 +66,83 @@ private:
         QCOMPARE(reader.getError(), QString());
     }
 
+    // Load the file at the given path in chunks of the given size,
+    // and from a device we pass in (which is always read line by
+    // line), and check that the two give the same model
+    void compareChunkedWithLineByLine(QString path, CSVFormat f,
+                                      qint64 chunkSize,
+                                      bool expectChunked) {
+        CSVFileReader reader(path, f, mainRate);
+        reader.setChunkSize(chunkSize);
+        Model *model = reader.load();
+        QCOMPARE(reader.wasLoadedInChunks(), expectChunked);
+        auto chunked =
+            qobject_cast<EditableDenseThreeDimensionalModel *>(model);
+        QVERIFY(chunked);
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+        CSVFileReader deviceReader(&file, f, mainRate);
+        Model *other = deviceReader.load();
+        QVERIFY(!deviceReader.wasLoadedInChunks());
+        auto lineByLine =
+            qobject_cast<EditableDenseThreeDimensionalModel *>(other);
+        QVERIFY(lineByLine);
+
+        QCOMPARE(chunked->getWidth(), lineByLine->getWidth());
+        QCOMPARE(chunked->getHeight(), lineByLine->getHeight());
+        QCOMPARE(chunked->getStartFrame(), lineByLine->getStartFrame());
+        QCOMPARE(chunked->getResolution(), lineByLine->getResolution());
+        QCOMPARE(chunked->getMinimumLevel(), lineByLine->getMinimumLevel());
+        QCOMPARE(chunked->getMaximumLevel(), lineByLine->getMaximumLevel());
+        for (int x = 0; x < chunked->getWidth(); ++x) {
+            QVERIFY(chunked->getColumn(x) == lineByLine->getColumn(x));
+        }
+
+        delete model;
+        delete other;
+    }
+
+    // Write a file of rows of a frame and three values, with CR/LF
+    // line endings and the occasional comment and blank line. If
+    // quotedRow is in range, one value in that row is quoted
+    QString writeNumeric(QString name, int rows, int quotedRow) {
+        QString path = tempDir.filePath(name);
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return {};
+        }
+        for (int i = 0; i < rows; ++i) {
+            if (i % 37 == 5) {
+                file.write("# comment\r\n\r\n");
+            }
+            QString line = QString("%1,%2,%3,%4\r\n")
+                .arg((i + 1) * 512)
+                .arg(i * 0.25)
+                .arg(i == quotedRow ? QString("\"%1\"").arg(-i) :
+                     QString::number(-i))
+                .arg((i % 11) * 1000.5);
+            file.write(line.toUtf8());
+        }
+        return path;
+    }
+
+    CSVFormat numericFormat() {
+        CSVFormat f;
+        f.setModelType(CSVFormat::ThreeDimensionalModel);
+        f.setTimingType(CSVFormat::ExplicitTiming);
+        f.setTimeUnits(CSVFormat::TimeAudioFrames);
+        f.setSeparator(',');
+        f.setHeaderStatus(CSVFormat::HeaderAbsent);
+        f.setAllowQuoting(true);
+        f.setColumnCount(4);
+        f.setColumnPurposes({ CSVFormat::ColumnStartTime,
+                              CSVFormat::ColumnValue,
+                              CSVFormat::ColumnValue,
+                              CSVFormat::ColumnValue });
+        return f;
+    }
+
 private slots:
     void init() {
         if (!csvDir.exists()) {
@@ -357,6 +437,63 @@ private slots:
         delete model;
     }
 
+    void chunkedMatchesLineByLine3D() {
+        QStringList files {
+            "model-type-3d-implicit.csv",
+            "model-type-3d-implicit-header.csv",
+            "model-type-3d-samples.csv",
+            "model-type-3d-samples-header.csv",
+            "model-type-3d-seconds.csv",
+            "model-type-3d-seconds-header.csv",
+            "with-blank-lines-3d.csv"
+        };
+        // The default, and sizes small enough that every file is
+        // split into several chunks (some of them empty)
+        vector<qint64> chunkSizes { 8 * 1024 * 1024, 1, 3, 10 };
+        for (QString filename: files) {
+            QString path(csvDir.filePath(filename));
+            CSVFormat f;
+            f.guessFormatFor(path);
+            for (auto chunkSize: chunkSizes) {
+                compareChunkedWithLineByLine(path, f, chunkSize, true);
+            }
+        }
+    }
+
+    void chunkedAcrossBoundaries3D() {
+        // Enough rows for several rounds of chunks, with sizes that
+        // put chunk boundaries within rows, between the CR and LF of
+        // a line ending, and on comments and blank lines
+        QString path = writeNumeric("numeric.csv", 400, -1);
+        QVERIFY(path != "");
+        for (qint64 chunkSize: { 1, 2, 7, 19, 64, 1000 }) {
+            compareChunkedWithLineByLine(path, numericFormat(),
+                                         chunkSize, true);
+        }
+    }
+
+    void chunkedFallsBackOnQuoting3D() {
+        // A quoted value, in the first chunk or in a chunk well after
+        // some rows have been added to the model, sends us back to
+        // the line-by-line load, which must give the full result
+        for (int quotedRow: { 0, 200, 399 }) {
+            QString path = writeNumeric
+                (QString("quoted-%1.csv").arg(quotedRow), 400, quotedRow);
+            QVERIFY(path != "");
+            for (qint64 chunkSize: { 1, 13, 8 * 1024 * 1024 }) {
+                compareChunkedWithLineByLine(path, numericFormat(),
+                                             chunkSize, false);
+            }
+        }
+
+        // Without quoting allowed, quote characters are just bad
+        // values to either parser
+        QString path = writeNumeric("quoted-unchecked.csv", 400, 200);
+        CSVFormat f = numericFormat();
+        f.setAllowQuoting(false);
+        compareChunkedWithLineByLine(path, f, 13, true);
+    }
+
     void quoting() {
         Model *model = nullptr;
         loadFrom("quoting.csv", model);
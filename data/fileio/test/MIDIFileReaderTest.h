@@ -17,12 +17,14 @@
 #define TEST_MIDI_FILE_READER_H
 
 #include "../MIDIFileReader.h"
+#include "data/model/NoteModel.h"
 
 #include <cmath>
 
 #include <QObject>
 #include <QtTest>
 #include <QDir>
+#include <QTemporaryFile>
 
 #include "base/Debug.h"
 
@@ -87,6 +89,32 @@ private slots:
 #endif
     }
 
+    void endOfTrackAtFileEnd()
+    {
+        // A single track holding one note and nothing after its
+        // end-of-track event, so that the last read asks for the
+        // zero bytes of meta data at the very end of the file
+        const unsigned char bytes[] = {
+            'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+            'M', 'T', 'r', 'k', 0, 0, 0, 12,
+            0x00, 0x90, 60, 100,
+            0x60, 0x80, 60, 64,
+            0x00, 0xff, 0x2f, 0x00
+        };
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write((const char *)bytes, sizeof(bytes));
+        file.close();
+
+        MIDIFileReader reader(file.fileName(), nullptr, 44100);
+        QVERIFY(reader.isOK());
+        Model *m = reader.load();
+        QVERIFY(m != nullptr);
+        NoteModel *notes = qobject_cast<NoteModel *>(m);
+        QVERIFY(notes != nullptr);
+        QCOMPARE(notes->getEventCount(), 1);
+        delete m;
+    }
 };
 
 #endif
@@ -17,6 +17,8 @@
 
 #include "SparseTimeValueModel.h"
 
+#include <algorithm>
+
 //#define DEBUG_ALIGNMENT_MODEL 1
 
 AlignmentModel::AlignmentModel(ModelId reference,
@@ -206,12 +208,49 @@ AlignmentModel::fromReference(sv_frame_t frame) const
     return performAlignment(*m_reversePath, frame);
 }
 
+std::vector<sv_frame_t>
+AlignmentModel::toReference(const std::vector<sv_frame_t> &frames) const
+{
+    if (!m_path) {
+        if (m_pathSource.isNone()) {
+            return frames;
+        }
+        constructPath();
+    }
+    if (!m_path) {
+        return frames;
+    }
+
+    return performAlignment(*m_path, frames);
+}
+
+std::vector<sv_frame_t>
+AlignmentModel::fromReference(const std::vector<sv_frame_t> &frames) const
+{
+    if (!m_reversePath) {
+        if (m_pathSource.isNone()) {
+            return frames;
+        }
+        constructReversePath();
+    }
+    if (!m_reversePath) {
+        return frames;
+    }
+
+    return performAlignment(*m_reversePath, frames);
+}
+
 void
 AlignmentModel::pathSourceChangedWithin(ModelId, sv_frame_t, sv_frame_t)
 {
-    if (!m_pathComplete) return;
-    constructPath();
-    constructReversePath();
+    if (m_pathComplete) {
+        // An edit to a finished path, which could be anywhere
+        constructPath();
+        constructReversePath();
+    } else {
+        // Still being calculated: new points only arrive at the end
+        extendPath();
+    }
 }    
 
 void
@@ -237,8 +276,15 @@ AlignmentModel::pathSourceCompletionChanged(ModelId)
 
         if (m_pathComplete) {
 
-            constructPath();
-            constructReversePath();
+            extendPath();
+
+            // If any points arrived out of order, extendPath will
+            // have missed them - start again in that case
+            if (!m_path ||
+                m_path->getPointCount() != pathSourceModel->getEventCount()) {
+                constructPath();
+                constructReversePath();
+            }
 
 #ifdef DEBUG_ALIGNMENT_MODEL
             SVCERR << "AlignmentModel: path complete" << endl;
@@ -271,19 +317,23 @@ AlignmentModel::constructPath() const
         if (!pathSourceModel) return;
     }
         
-    m_path->clear();
+    EventVector events = pathSourceModel->getAllEvents();
+    sv_samplerate_t rate = alignedModel->getSampleRate();
 
-    EventVector points = pathSourceModel->getAllEvents();
-
-    for (const auto &p: points) {
+    Path::Points points;
+    points.reserve(events.size());
+    
+    for (const auto &p: events) {
         sv_frame_t frame = p.getFrame();
         double value = p.getValue();
-        sv_frame_t rframe = lrint(value * alignedModel->getSampleRate());
-        m_path->add(PathPoint(frame, rframe));
+        sv_frame_t rframe = lrint(value * rate);
+        points.push_back(PathPoint(frame, rframe));
     }
 
+    m_path->setPoints(std::move(points));
+
 #ifdef DEBUG_ALIGNMENT_MODEL
-    cerr << "AlignmentModel::constructPath: " << m_path->getPointCount() << " points, at least " << (2 * m_path->getPointCount() * (3 * sizeof(void *) + sizeof(int) + sizeof(PathPoint))) << " bytes" << endl;
+    cerr << "AlignmentModel::constructPath: " << m_path->getPointCount() << " points, " << (m_path->getPointCount() * sizeof(PathPoint)) << " bytes" << endl;
 #endif
 }
 
@@ -303,18 +353,67 @@ AlignmentModel::constructReversePath() const
         if (!m_path) return;
     }
         
-    m_reversePath->clear();
+    const Path::Points &forward = m_path->getPoints();
 
-    Path::Points points = m_path->getPoints();
+    Path::Points points;
+    points.reserve(forward.size());
         
-    for (auto p: points) {
-        sv_frame_t frame = p.frame;
-        sv_frame_t rframe = p.mapframe;
-        m_reversePath->add(PathPoint(rframe, frame));
+    for (const auto &p: forward) {
+        points.push_back(PathPoint(p.mapframe, p.frame));
+    }
+
+    m_reversePath->setPoints(std::move(points));
+
+#ifdef DEBUG_ALIGNMENT_MODEL
+    cerr << "AlignmentModel::constructReversePath: " << m_reversePath->getPointCount() << " points, " << (m_reversePath->getPointCount() * sizeof(PathPoint)) << " bytes" << endl;
+#endif
+}
+
+void
+AlignmentModel::extendPath() const
+{
+    if (!m_path || !m_reversePath) {
+        constructPath();
+        constructReversePath();
+        return;
+    }
+    
+    auto alignedModel = ModelById::get(m_aligned);
+    if (!alignedModel) return;
+    
+    auto pathSourceModel =
+        ModelById::getAs<SparseTimeValueModel>(m_pathSource);
+    if (!pathSourceModel) return;
+
+    // Re-read from the last frame we have, rather than the one after
+    // it, in case there are further points at that frame; add() will
+    // skip any we already have
+    
+    sv_frame_t from = 0;
+    if (m_path->getPointCount() > 0) {
+        from = m_path->getPoints().back().frame;
+    }
+    sv_frame_t to = pathSourceModel->getEndFrame() + 1;
+    if (to <= from) return;
+    
+    EventVector events =
+        pathSourceModel->getEventsStartingWithin(from, to - from);
+    sv_samplerate_t rate = alignedModel->getSampleRate();
+
+    for (const auto &p: events) {
+        sv_frame_t frame = p.getFrame();
+        sv_frame_t rframe = lrint(p.getValue() * rate);
+        int count = m_path->getPointCount();
+        m_path->add(PathPoint(frame, rframe));
+        if (m_path->getPointCount() > count) {
+            m_reversePath->add(PathPoint(rframe, frame));
+        }
     }
 
 #ifdef DEBUG_ALIGNMENT_MODEL
-    cerr << "AlignmentModel::constructReversePath: " << m_reversePath->getPointCount() << " points, at least " << (2 * m_reversePath->getPointCount() * (3 * sizeof(void *) + sizeof(int) + sizeof(PathPoint))) << " bytes" << endl;
+    cerr << "AlignmentModel::extendPath: read " << events.size()
+         << " events from " << from << ", now have "
+         << m_path->getPointCount() << " points" << endl;
 #endif
 }
 
@@ -339,8 +438,71 @@ AlignmentModel::performAlignment(const Path &path, sv_frame_t frame) const
     cerr << "AlignmentModel::align: frame " << frame << " requested" << endl;
 #endif
 
-    PathPoint point(frame);
-    Path::Points::const_iterator i = points.lower_bound(point);
+    return alignFrom(points,
+                     std::lower_bound(points.begin(), points.end(),
+                                      PathPoint(frame)),
+                     frame);
+}
+
+std::vector<sv_frame_t>
+AlignmentModel::performAlignment(const Path &path,
+                                 const std::vector<sv_frame_t> &frames) const
+{
+    const Path::Points &points = path.getPoints();
+
+    if (points.empty()) {
+        return frames;
+    }
+
+    std::vector<sv_frame_t> results;
+    results.reserve(frames.size());
+
+    // While the frames are ascending, each search starts from where
+    // the last one ended, galloping forward so that frames close
+    // together cost little and widely separated ones no more than a
+    // binary search
+
+    auto i = points.begin();
+    sv_frame_t prev = 0;
+    
+    for (size_t k = 0; k < frames.size(); ++k) {
+        
+        sv_frame_t frame = frames[k];
+        PathPoint key(frame);
+        
+        if (k == 0 || frame < prev) {
+            i = std::lower_bound(points.begin(), points.end(), key);
+        } else {
+            auto lo = i;
+            size_t step = 1;
+            while (i != points.end() && *i < key) {
+                lo = i + 1;
+                if (size_t(points.end() - i) <= step) {
+                    i = points.end();
+                } else {
+                    i += step;
+                    step *= 2;
+                }
+            }
+            i = std::lower_bound(lo, i, key);
+        }
+
+        results.push_back(alignFrom(points, i, frame));
+        prev = frame;
+    }
+
+    return results;
+}
+
+sv_frame_t
+AlignmentModel::alignFrom(const Path::Points &points,
+                          Path::Points::const_iterator i,
+                          sv_frame_t frame)
+{
+    // i is the first point not less than PathPoint(frame), in a
+    // non-empty path. We want the last point at or before frame, and
+    // the one after it to interpolate towards
+    
     if (i == points.end()) {
 #ifdef DEBUG_ALIGNMENT_MODEL
         cerr << "Note: i == points.end()" << endl;
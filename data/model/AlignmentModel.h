@@ -23,6 +23,8 @@
 #include <QString>
 #include <QStringList>
 
+#include <vector>
+
 class SparseTimeValueModel;
 
 class AlignmentModel : public Model
@@ -61,6 +63,20 @@ public:
     sv_frame_t toReference(sv_frame_t frame) const;
     sv_frame_t fromReference(sv_frame_t frame) const;
 
+    /**
+     * Map each of a series of frames to the reference. The result is
+     * the same as calling toReference for each frame in turn, but if
+     * the frames are in ascending order (e.g. those of the events in
+     * a layer) they are mapped in a single pass along the path.
+     */
+    std::vector<sv_frame_t> toReference(const std::vector<sv_frame_t> &frames) const;
+
+    /**
+     * Map each of a series of frames from the reference, as for the
+     * vector form of toReference.
+     */
+    std::vector<sv_frame_t> fromReference(const std::vector<sv_frame_t> &frames) const;
+
     void setPathFrom(ModelId pathSource); // a SparseTimeValueModel
     void setPath(const Path &path);
 
@@ -114,7 +130,21 @@ protected:
     void constructPath() const;
     void constructReversePath() const;
 
+    /**
+     * Append to the forward and reverse paths any points that have
+     * arrived in the path source since we last looked. Points are
+     * assumed to arrive in order of frame, as they do while the
+     * alignment is being calculated.
+     */
+    void extendPath() const;
+
     sv_frame_t performAlignment(const Path &path, sv_frame_t frame) const;
+    std::vector<sv_frame_t> performAlignment(const Path &path,
+                                             const std::vector<sv_frame_t> &)
+        const;
+    static sv_frame_t alignFrom(const Path::Points &points,
+                                Path::Points::const_iterator i,
+                                sv_frame_t frame);
 };
 
 #endif
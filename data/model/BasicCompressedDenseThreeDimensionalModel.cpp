@@ -324,6 +324,33 @@ BasicCompressedDenseThreeDimensionalModel::setColumn(int index,
 {
     QWriteLocker locker(&m_lock);
 
+    bool allChange = storeColumn(index, values);
+    notifyColumnsChanged(index, 1, allChange);
+}
+
+void
+BasicCompressedDenseThreeDimensionalModel::setColumns(int index,
+                                               const std::vector<Column> &columns)
+{
+    if (columns.empty()) return;
+    
+    QWriteLocker locker(&m_lock);
+
+    bool allChange = false;
+    for (int i = 0; in_range_for(columns, i); ++i) {
+        if (storeColumn(index + i, columns[i])) {
+            allChange = true;
+        }
+    }
+    notifyColumnsChanged(index, int(columns.size()), allChange);
+}
+
+bool
+BasicCompressedDenseThreeDimensionalModel::storeColumn(int index,
+                                                const Column &values)
+{
+    // Call with m_lock held for writing
+    
     while (index >= int(m_data.size())) {
         m_data.push_back(Column());
         m_trunc.push_back(0);
@@ -351,15 +378,26 @@ BasicCompressedDenseThreeDimensionalModel::setColumn(int index,
 
 //    assert(values == expandAndRetrieve(index));
 
+    return allChange;
+}
+
+void
+BasicCompressedDenseThreeDimensionalModel::notifyColumnsChanged(int index,
+                                                         int count,
+                                                         bool allChange)
+{
     sv_frame_t windowStart = index;
     windowStart *= m_resolution;
 
+    // start of the last column changed
+    sv_frame_t lastStart = windowStart + sv_frame_t(count - 1) * m_resolution;
+
     if (m_notifyOnAdd) {
         if (allChange) {
             emit modelChanged(getId());
         } else {
             emit modelChangedWithin(getId(),
-                                    windowStart, windowStart + m_resolution);
+                                    windowStart, lastStart + m_resolution);
         }
     } else {
         if (allChange) {
@@ -372,8 +410,8 @@ BasicCompressedDenseThreeDimensionalModel::setColumn(int index,
                 m_sinceLastNotifyMin = windowStart;
             }
             if (m_sinceLastNotifyMax == -1 ||
-                windowStart > m_sinceLastNotifyMax) {
-                m_sinceLastNotifyMax = windowStart;
+                lastStart > m_sinceLastNotifyMax) {
+                m_sinceLastNotifyMax = lastStart;
             }
         }
     }
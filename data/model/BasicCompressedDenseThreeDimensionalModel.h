@@ -122,6 +122,14 @@ public:
      */
     virtual void setColumn(int x, const Column &values);
 
+    /**
+     * Set the bin values of several consecutive columns, starting at
+     * column x, taking the model's lock once and notifying a single
+     * change for the lot. This is much quicker than calling
+     * setColumn() for each when there are many.
+     */
+    virtual void setColumns(int x, const std::vector<Column> &columns);
+
     /**
      * Return the name of bin n. This is a single label per bin that
      * does not vary from one column to the next.
@@ -207,6 +215,8 @@ protected:
     // stored.
     std::vector<signed char> m_trunc;
     void truncateAndStore(int index, const Column & values);
+    bool storeColumn(int index, const Column &values);
+    void notifyColumnsChanged(int index, int count, bool allChange);
     Column expandAndRetrieve(int index) const;
     Column rightHeight(const Column &c) const;
 
@@ -19,6 +19,7 @@
 #include "TabularModel.h"
 #include "Model.h"
 #include "DeferredNotifier.h"
+#include "EventBoxIndex.h"
 
 #include "base/RealTime.h"
 #include "base/EventSeries.h"
@@ -57,7 +58,8 @@ public:
                    notifyOnAdd ?
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
-        m_completion(100) {
+        m_completion(100),
+        m_boxIndex(EventBoxIndex::ValueToValuePlusLevel) {
     }
 
     BoxModel(sv_samplerate_t sampleRate, int resolution,
@@ -73,7 +75,8 @@ public:
                    notifyOnAdd ?
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
-        m_completion(100) {
+        m_completion(100),
+        m_boxIndex(EventBoxIndex::ValueToValuePlusLevel) {
     }
 
     virtual ~BoxModel() {
@@ -157,6 +160,23 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+    /**
+     * Retrieve all events whose time extent overlaps the given frame
+     * range and whose value extent (from value to value plus level)
+     * overlaps the given inclusive value range. See
+     * EventBoxIndex::getEventsWithinBox. The first call builds a
+     * spatial index, which is maintained from then on.
+     */
+    EventVector getEventsWithinBox(sv_frame_t f, sv_frame_t duration,
+                                   float minValue, float maxValue) const {
+        if (!m_boxIndex.isBuilt()) {
+            QMutexLocker locker(&m_mutex);
+            if (!m_boxIndex.isBuilt()) {
+                m_boxIndex.build(m_events.getAllEvents());
+            }
+        }
+        return m_boxIndex.getEventsWithinBox(f, duration, minValue, maxValue);
+    }
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -175,6 +195,7 @@ public:
         {
             QMutexLocker locker(&m_mutex);
             m_events.add(e);
+            m_boxIndex.add(e);
 
             float f0 = e.getValue();
             float f1 = f0 + fabsf(e.getLevel());
@@ -199,6 +220,7 @@ public:
         {
             QMutexLocker locker(&m_mutex);
             m_events.remove(e);
+            m_boxIndex.remove(e);
         }
         emit modelChangedWithin(getId(),
                                 e.getFrame(),
@@ -428,6 +450,7 @@ protected:
     int m_completion;
 
     EventSeries m_events;
+    mutable EventBoxIndex m_boxIndex;
 
     mutable QMutex m_mutex;
 };
@@ -16,12 +16,24 @@
 #define SV_DEFERRED_NOTIFIER_H
 
 #include "Model.h"
+#include "NotificationScheduler.h"
 
 #include "base/Extents.h"
 
 #include <QMutex>
 #include <QMutexLocker>
 
+/**
+ * Change notification helper for models. In NOTIFY_ALWAYS mode,
+ * update() emits modelChangedWithin at once. In NOTIFY_DEFERRED mode
+ * it only records the extent of the change, and a single notification
+ * covering everything recorded is emitted later, either when the
+ * model calls makeDeferredNotifications() or when the
+ * NotificationScheduler next flushes pending notifiers.
+ *
+ * If notifications have been disabled in the NotificationScheduler,
+ * all changes are dropped.
+ */
 class DeferredNotifier
 {
 public:
@@ -31,7 +43,11 @@ public:
     };
     
     DeferredNotifier(Model *m, ModelId id, Mode mode) :
-        m_model(m), m_modelId(id), m_mode(mode) { }
+        m_model(m), m_modelId(id), m_mode(mode), m_scheduled(false) { }
+
+    ~DeferredNotifier() {
+        NotificationScheduler::getInstance()->cancel(this);
+    }
 
     Mode getMode() const {
         return m_mode;
@@ -41,12 +57,27 @@ public:
     }
     
     void update(sv_frame_t frame, sv_frame_t duration) {
+        auto scheduler = NotificationScheduler::getInstance();
+        if (!scheduler->isEnabled()) {
+            scheduler->noteDropped();
+            return;
+        }
         if (m_mode == NOTIFY_ALWAYS) {
             m_model->modelChangedWithin(m_modelId, frame, frame + duration);
         } else {
-            QMutexLocker locker(&m_mutex);
-            m_extents.sample(frame);
-            m_extents.sample(frame + duration);
+            bool shouldSchedule = false;
+            {   QMutexLocker locker(&m_mutex);
+                m_extents.sample(frame);
+                m_extents.sample(frame + duration);
+                if (!m_scheduled) {
+                    m_scheduled = true;
+                    shouldSchedule = true;
+                }
+            }
+            scheduler->noteQueued();
+            if (shouldSchedule) {
+                scheduler->schedule(this, m_modelId);
+            }
         }
     }
     
@@ -59,20 +90,33 @@ public:
                 from = m_extents.getMin();
                 to = m_extents.getMax();
             }
+            // Reset here rather than after emitting, so as not to
+            // lose any change recorded while we are emitting
+            m_extents.reset();
+            m_scheduled = false;
         }
         if (shouldEmit) {
-            m_model->modelChangedWithin(m_modelId, from, to);
-            QMutexLocker locker(&m_mutex);
-            m_extents.reset();
+            auto scheduler = NotificationScheduler::getInstance();
+            if (scheduler->isEnabled()) {
+                m_model->modelChangedWithin(m_modelId, from, to);
+                scheduler->noteFlushed();
+            }
         }
     }
 
 private:
+    friend class NotificationScheduler;
+
+    void flushScheduled() {
+        makeDeferredNotifications();
+    }
+    
     Model *m_model;
     ModelId m_modelId;
     Mode m_mode;
     QMutex m_mutex;
     Extents<sv_frame_t> m_extents;
+    bool m_scheduled;
 };
 
 #endif
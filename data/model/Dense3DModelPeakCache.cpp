@@ -32,6 +32,8 @@ Dense3DModelPeakCache::Dense3DModelPeakCache(ModelId sourceId,
         return;
     }
 
+    m_sourceHandle = ModelById::getHandle<DenseThreeDimensionalModel>(m_source);
+
     connect(source.get(), SIGNAL(modelChanged(ModelId)),
             this, SLOT(sourceModelChanged(ModelId)));
 }
@@ -94,7 +96,7 @@ Dense3DModelPeakCache::fillColumn(int column) const
         m_cache.resize(column + 1, {});
     }
     
-    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    auto source = m_sourceHandle.get();
     if (!source) {
         return;
     }
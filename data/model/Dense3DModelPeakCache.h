@@ -38,27 +38,27 @@ public:
     ~Dense3DModelPeakCache();
 
     bool isOK() const override {
-        auto source = ModelById::get(m_source);
+        auto source = m_sourceHandle.get();
         return source && source->isOK(); 
     }
 
     sv_samplerate_t getSampleRate() const override {
-        auto source = ModelById::get(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getSampleRate() : 0;
     }
 
     sv_frame_t getStartFrame() const override {
-        auto source = ModelById::get(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getStartFrame() : 0;
     }
 
     sv_frame_t getTrueEndFrame() const override {
-        auto source = ModelById::get(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getTrueEndFrame() : 0;
     }
 
     int getResolution() const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getResolution() * m_columnsPerPeak : 1;
     }
 
@@ -67,7 +67,7 @@ public:
     }
     
     int getWidth() const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         if (!source) return 0;
         int sourceWidth = source->getWidth();
         if ((sourceWidth % m_columnsPerPeak) == 0) {
@@ -78,17 +78,17 @@ public:
     }
 
     int getHeight() const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getHeight() : 0;
     }
 
     float getMinimumLevel() const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getMinimumLevel() : 0.f;
     }
 
     float getMaximumLevel() const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getMaximumLevel() : 1.f;
     }
 
@@ -103,19 +103,19 @@ public:
     float getValueAt(int col, int n) const override;
 
     QString getBinName(int n) const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getBinName(n) : "";
     }
 
     bool shouldUseLogValueScale() const override {
-        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->shouldUseLogValueScale() : false;
     }
 
     QString getTypeName() const override { return tr("Dense 3-D Peak Cache"); }
 
     int getCompletion() const override {
-        auto source = ModelById::get(m_source);
+        auto source = m_sourceHandle.get();
         return source ? source->getCompletion() : 100;
     }
 
@@ -134,6 +134,7 @@ protected slots:
 
 private:
     ModelId m_source;
+    ByIdHandle<DenseThreeDimensionalModel> m_sourceHandle;
     int m_columnsPerPeak;
 
     mutable std::vector<Column> m_cache;
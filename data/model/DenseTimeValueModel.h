@@ -79,6 +79,29 @@ public:
                                                         sv_frame_t count)
         const = 0;
 
+    /**
+     * Return true if all of this model's data are available, so that
+     * its end frame is final. This is the same as isReady() unless
+     * the model is able to serve part of its data while the rest is
+     * still arriving, for example while a file is being decoded.
+     */
+    virtual bool isFullyAvailable() const {
+        return isReady();
+    }
+
+    /**
+     * Return the frame up to which this model's data can already be
+     * read and will not change. Consumers can process data up to this
+     * point while the rest is still arriving. If isFullyAvailable()
+     * returns true, this is the end frame.
+     *
+     * The default implementation returns the start frame until the
+     * model is fully available.
+     */
+    virtual sv_frame_t getAvailableEndFrame() const {
+        return isFullyAvailable() ? getEndFrame() : getStartFrame();
+    }
+
     bool canPlay() const override { return true; }
     QString getDefaultPlayClipId() const override { return ""; }
 
@@ -0,0 +1,114 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventBoxIndex.h"
+
+#include "system/System.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+
+bool
+EventBoxIndex::isIndexable(const Event &e) const
+{
+    // NaN in particular would poison the bounding boxes of every node
+    // above it in the tree
+    float v = e.getValue();
+    if (ISNAN(v) || ISINF(v)) return false;
+    if (m_extent == ValueToValuePlusLevel) {
+        float l = e.getLevel();
+        if (ISNAN(l) || ISINF(l)) return false;
+    }
+    return true;
+}
+
+EventBoxIndex::Tree::Box
+EventBoxIndex::boxFor(const Event &e) const
+{
+    double v0 = e.getValue();
+    double v1 = v0;
+    if (m_extent == ValueToValuePlusLevel) {
+        v1 = v0 + fabs(e.getLevel());
+    }
+    return Tree::Box(double(e.getFrame()),
+                     double(e.getFrame() + e.getDuration()),
+                     v0, v1);
+}
+
+void
+EventBoxIndex::build(const EventVector &events)
+{
+    std::vector<Tree::Item> items;
+    items.reserve(events.size());
+    for (const auto &e: events) {
+        if (!isIndexable(e)) continue;
+        items.push_back(Tree::Item(boxFor(e), e));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_tree.load(items);
+    m_built = true;
+}
+
+void
+EventBoxIndex::add(const Event &e)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_built || !isIndexable(e)) return;
+    m_tree.insert(boxFor(e), e);
+}
+
+void
+EventBoxIndex::remove(const Event &e)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_built || !isIndexable(e)) return;
+    m_tree.remove(boxFor(e), e);
+}
+
+EventVector
+EventBoxIndex::getEventsWithinBox(sv_frame_t frame,
+                                  sv_frame_t duration,
+                                  float minValue,
+                                  float maxValue) const
+{
+    const sv_frame_t end = frame + duration;
+    
+    EventVector found;
+
+    // The tree works with closed rectangles, so this finds a superset
+    // of the events we want, from which we take the exact ones
+    
+    Tree::Box box(double(frame), double(end), minValue, maxValue);
+
+    QMutexLocker locker(&m_mutex);
+    
+    m_tree.search(box, [&](const Tree::Box &, const Event &e) {
+            sv_frame_t f = e.getFrame();
+            sv_frame_t d = e.getDuration();
+            bool inTime = (d > 0) ?
+                (f < end && f + d > frame) :
+                (f >= frame && f < end);
+            if (inTime) {
+                found.push_back(e);
+            }
+        });
+
+    locker.unlock();
+    
+    std::sort(found.begin(), found.end());
+    return found;
+}
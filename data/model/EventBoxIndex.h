@@ -0,0 +1,102 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_EVENT_BOX_INDEX_H
+#define SV_EVENT_BOX_INDEX_H
+
+#include "base/Event.h"
+#include "base/RTree.h"
+
+#include <QMutex>
+
+#include <atomic>
+
+/**
+ * A two-dimensional (time by value) index of the events in a model,
+ * used to answer rectangle queries such as "all notes within this
+ * time range and this pitch range" without examining every event in
+ * the time range.
+ *
+ * The index is optional: it starts out unbuilt, and add() and remove()
+ * do nothing until build() has been called, so a model that never
+ * makes a rectangle query pays nothing for it. The owning model is
+ * responsible for making sure no event is added to or removed from
+ * it between its reading its events for build() and build() being
+ * completed.
+ *
+ * EventBoxIndex is thread-safe.
+ */
+class EventBoxIndex
+{
+public:
+    enum ValueExtent {
+        /// Each event occupies only its own value, as for notes
+        ValueOnly,
+        
+        /// Each event occupies a range from its value to its value
+        /// plus the absolute value of its level, as for BoxModel
+        ValueToValuePlusLevel
+    };
+    
+    EventBoxIndex(ValueExtent extent) :
+        m_extent(extent), m_built(false) { }
+
+    bool isBuilt() const { return m_built; }
+
+    /**
+     * Build the index from the given events, replacing anything
+     * already in it.
+     */
+    void build(const EventVector &events);
+
+    void add(const Event &e);
+    void remove(const Event &e);
+
+    /**
+     * Retrieve all events any part of which falls within the
+     * rectangle defined by the given frame f and duration d in time,
+     * and the given inclusive value range, in their natural order.
+     *
+     * - An event with non-zero duration is within the time range if
+     * its start frame is less than f + d and its start frame plus its
+     * duration is greater than f (as for EventSeries's
+     * getEventsSpanning).
+     *
+     * - Any other event is within the time range if its frame is
+     * greater than or equal to f and less than f + d.
+     *
+     * - An event is within the value range if its own value range
+     * (see ValueExtent) overlaps it. Events whose value range is not
+     * finite are never within any box.
+     *
+     * The index must have been built.
+     */
+    EventVector getEventsWithinBox(sv_frame_t frame,
+                                   sv_frame_t duration,
+                                   float minValue,
+                                   float maxValue) const;
+
+private:
+    typedef RTree<Event> Tree;
+    
+    ValueExtent m_extent;
+    mutable QMutex m_mutex;
+    std::atomic<bool> m_built;
+    Tree m_tree;
+
+    Tree::Box boxFor(const Event &e) const;
+    bool isIndexable(const Event &e) const;
+};
+
+#endif
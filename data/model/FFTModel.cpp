@@ -27,6 +27,8 @@
 #include <cassert>
 #include <deque>
 
+#include <QMutexLocker>
+
 using namespace std;
 
 static HitCount inSmallCache("FFTModel: Small FFT cache");
@@ -39,6 +41,7 @@ FFTModel::FFTModel(ModelId modelId,
                    int windowIncrement,
                    int fftSize) :
     m_model(modelId),
+    m_modelHandle(ModelById::getHandle<DenseTimeValueModel>(modelId)),
     m_sampleRate(0),
     m_channel(channel),
     m_windowType(windowType),
@@ -61,7 +64,7 @@ FFTModel::FFTModel(ModelId modelId,
 
     m_fft.initFloat();
 
-    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    auto model = m_modelHandle.get();
     if (model) {
         m_sampleRate = model->getSampleRate();
         
@@ -92,7 +95,7 @@ FFTModel::clearCaches()
 bool
 FFTModel::isOK() const
 {
-    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    auto model = m_modelHandle.get();
     if (!model) {
         m_error = QString("Model #%1 is not available").arg(m_model.untyped);
         return false;
@@ -108,7 +111,7 @@ int
 FFTModel::getCompletion() const
 {
     int c = 100;
-    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    auto model = m_modelHandle.get();
     if (model) {
         if (model->isReady(&c)) return 100;
     }
@@ -118,14 +121,31 @@ FFTModel::getCompletion() const
 void
 FFTModel::setMaximumFrequency(double freq)
 {
+    QMutexLocker locker(&m_mutex);
     m_maximumFrequency = freq;
     clearCaches();
 }
 
+void
+FFTModel::setColumnCacheSize(int columns)
+{
+    QMutexLocker locker(&m_mutex);
+    if (columns < 1) columns = 1;
+    m_cacheSize = size_t(columns);
+    clearCaches();
+}
+
+int
+FFTModel::getColumnCacheSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_cacheSize);
+}
+
 int
 FFTModel::getWidth() const
 {
-    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    auto model = m_modelHandle.get();
     if (!model) return 0;
     return int((model->getEndFrame() - model->getStartFrame())
                / m_windowIncrement) + 1;
@@ -335,7 +355,7 @@ FFTModel::getSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
 {
     Profiler profiler("FFTModel::getSourceDataUncached");
 
-    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    auto model = m_modelHandle.get();
     if (!model) return {};
     
     decltype(range.first) pfx = 0;
@@ -378,9 +398,14 @@ FFTModel::getSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
     return data;
 }
 
-const complexvec_t &
+complexvec_t
 FFTModel::getFFTColumn(int n) const
 {
+    // The caches and the FFT object are shared by every thread using
+    // this model, so the column is looked up or calculated, and
+    // copied out, under the lock
+    QMutexLocker locker(&m_mutex);
+    
     // The small cache (i.e. the m_cached deque) is for cases where
     // values are looked up individually, and for e.g. peak-frequency
     // spectrograms where values from two consecutive columns are
@@ -396,11 +421,34 @@ FFTModel::getFFTColumn(int n) const
     inSmallCache.miss();
 
     Profiler profiler("FFTModel::getFFTColumn (cache miss)");
+
+    // If the source model is still arriving (e.g. being decoded) and
+    // this column's input extends beyond the frames available so
+    // far, the column is calculated from partial data and will change
+    // later, so it must not be cached
+    bool stable = true;
+    {
+        auto model = m_modelHandle.get();
+        if (model && !model->isFullyAvailable()) {
+            stable = (getSourceSampleRange(n).second <=
+                      model->getAvailableEndFrame());
+        }
+    }
     
     auto samples = getSourceSamples(n);
     m_windower.cut(samples.data() + (m_fftSize - m_windowSize) / 2);
     breakfastquay::v_fftshift(samples.data(), m_fftSize);
 
+    if (!stable) {
+        m_savedData.range = { 0, 0 };
+        m_savedData.data.clear();
+        complexvec_t col(m_fftSize / 2 + 1);
+        m_fft.forwardInterleaved(samples.data(),
+                                 reinterpret_cast<float *>(col.data()));
+        col.resize(getHeight());
+        return col;
+    }
+
     complexvec_t &col = m_cached[m_cacheWriteIndex].col;
 
     // expand to large enough for fft destination, if truncated previously
@@ -410,7 +458,7 @@ FFTModel::getFFTColumn(int n) const
                              reinterpret_cast<float *>(col.data()));
 
     // keep only the number of elements we need - so that we can
-    // return a const ref without having to resize on a cache hit
+    // return the column without having to resize on a cache hit
     col.resize(getHeight());
 
     m_cached[m_cacheWriteIndex].n = n;
@@ -32,12 +32,15 @@
  * An implementation of DenseThreeDimensionalModel that makes FFT data
  * derived from a DenseTimeValueModel available as a generic data
  * grid.
+ *
+ * The data accessors may be called from more than one thread at once,
+ * so that a single FFTModel can be shared between consumers (see
+ * FFTModelRegistry). Columns are calculated and cached under a lock.
  */
 class FFTModel : public DenseThreeDimensionalModel
 {
     Q_OBJECT
 
-    //!!! threading requirements?
     //!!! doubles? since we're not caching much
 
 public:
@@ -122,6 +125,14 @@ public:
     void setMaximumFrequency(double freq);
     double getMaximumFrequency() const { return m_maximumFrequency; }
 
+    /**
+     * Set the number of recently calculated columns to keep. The
+     * default is 3, which suits a single consumer; a model shared by
+     * several consumers reading at different positions needs more.
+     */
+    void setColumnCacheSize(int columns);
+    int getColumnCacheSize() const;
+
 //!!! review which of these are ever actually called
     
     float getMagnitudeAt(int x, int y) const;
@@ -170,6 +181,7 @@ private:
     FFTModel &operator=(const FFTModel &) =delete;
 
     const ModelId m_model; // a DenseTimeValueModel
+    const ByIdHandle<DenseTimeValueModel> m_modelHandle;
     sv_samplerate_t m_sampleRate;
     int m_channel;
     WindowType m_windowType;
@@ -193,7 +205,7 @@ private:
         return { startFrame, endFrame };
     }
 
-    const complexvec_t &getFFTColumn(int column) const;
+    complexvec_t getFFTColumn(int column) const;
     floatvec_t getSourceSamples(int column) const;
     floatvec_t getSourceData(std::pair<sv_frame_t, sv_frame_t>) const;
     floatvec_t getSourceDataUncached(std::pair<sv_frame_t, sv_frame_t>) const;
@@ -0,0 +1,115 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FFTModelRegistry.h"
+#include "FFTModel.h"
+
+#include "base/Debug.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+FFTModelRegistry *
+FFTModelRegistry::m_instance = new FFTModelRegistry;
+
+FFTModelRegistry *
+FFTModelRegistry::getInstance()
+{
+    return m_instance;
+}
+
+FFTModelRegistry::FFTModelRegistry()
+{
+}
+
+ModelId
+FFTModelRegistry::acquire(ModelId input,
+                          int channel,
+                          WindowType windowType,
+                          int windowSize,
+                          int windowIncrement,
+                          int fftSize,
+                          QString *error)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Key key(input, channel, windowType, windowSize, windowIncrement, fftSize);
+
+    auto itr = m_entries.find(key);
+
+    if (itr != m_entries.end()) {
+        auto model = ModelById::getAs<FFTModel>(itr->second.id);
+        if (model) {
+            int refCount = ++itr->second.refCount;
+            // Consumers sharing a model read at different positions,
+            // so keep enough recent columns for each of them
+            int cacheSize = std::min(refCount * 3, 64);
+            if (cacheSize > model->getColumnCacheSize()) {
+                model->setColumnCacheSize(cacheSize);
+            }
+            return itr->second.id;
+        }
+        // Released from ModelById behind our back: start again
+        m_keys.erase(itr->second.id);
+        m_entries.erase(itr);
+    }
+
+    auto model = std::make_shared<FFTModel>(input,
+                                            channel,
+                                            windowType,
+                                            windowSize,
+                                            windowIncrement,
+                                            fftSize);
+    if (!model->isOK() || model->getError() != "") {
+        SVDEBUG << "FFTModelRegistry::acquire: Failed to create FFT model for input model " << input << ": " << model->getError() << endl;
+        if (error) *error = model->getError();
+        return {};
+    }
+
+    ModelId id = ModelById::add(model);
+    m_entries[key] = { id, 1 };
+    m_keys[id] = key;
+    return id;
+}
+
+void
+FFTModelRegistry::release(ModelId id)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto kitr = m_keys.find(id);
+    if (kitr == m_keys.end()) {
+        SVCERR << "WARNING: FFTModelRegistry::release: Model " << id
+               << " was not obtained from the registry" << endl;
+        return;
+    }
+
+    auto itr = m_entries.find(kitr->second);
+    if (--itr->second.refCount > 0) {
+        return;
+    }
+
+    m_entries.erase(itr);
+    m_keys.erase(kitr);
+
+    ModelById::release(id);
+}
+
+int
+FFTModelRegistry::getModelCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_entries.size());
+}
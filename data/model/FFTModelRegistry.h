@@ -0,0 +1,96 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_FFT_MODEL_REGISTRY_H
+#define SV_FFT_MODEL_REGISTRY_H
+
+#include "Model.h"
+
+#include "base/Window.h"
+
+#include <QMutex>
+#include <QString>
+
+#include <map>
+#include <tuple>
+
+/**
+ * A reference-counted store of FFTModels, so that consumers wanting
+ * the FFT of the same input with the same parameters (such as several
+ * feature extraction transforms, or a transform and a spectrogram)
+ * can share one model and its cached columns rather than each
+ * calculating their own.
+ *
+ * acquire() returns the id of an FFTModel in ModelById with the
+ * requested parameters, creating it if no other consumer holds one,
+ * and release() gives it up again. When the last consumer releases
+ * it, the model is released from ModelById as well.
+ *
+ * Shared models must not be reconfigured: in particular, don't call
+ * setMaximumFrequency on a model obtained here, as that would change
+ * it for every other consumer too. Create a private FFTModel for
+ * that instead.
+ *
+ * FFTModelRegistry is thread-safe.
+ */
+class FFTModelRegistry
+{
+public:
+    static FFTModelRegistry *getInstance();
+
+    /**
+     * Return the id of an FFTModel for the given input model and
+     * parameters, as for the FFTModel constructor, and add a
+     * reference to it. Each successful call must be matched by a call
+     * to release(). Return a none id if the model could not be
+     * created, for example because the input model does not exist,
+     * setting the error string if one is provided.
+     */
+    ModelId acquire(ModelId input,
+                    int channel,
+                    WindowType windowType,
+                    int windowSize,
+                    int windowIncrement,
+                    int fftSize,
+                    QString *error = nullptr);
+
+    /**
+     * Remove a reference to an FFTModel previously returned by
+     * acquire(), releasing it if nothing else refers to it.
+     */
+    void release(ModelId fftModel);
+
+    /**
+     * Return the number of distinct FFTModels currently held.
+     */
+    int getModelCount() const;
+
+private:
+    FFTModelRegistry();
+
+    typedef std::tuple<ModelId, int, WindowType, int, int, int> Key;
+
+    struct Entry {
+        ModelId id;
+        int refCount;
+    };
+
+    mutable QMutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    std::map<ModelId, Key> m_keys;
+
+    static FFTModelRegistry *m_instance;
+};
+
+#endif
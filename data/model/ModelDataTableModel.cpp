@@ -18,7 +18,8 @@
 #include "TabularModel.h"
 #include "Model.h"
 
-#include <map>
+#include "system/System.h"
+
 #include <algorithm>
 #include <iostream>
 
@@ -26,7 +27,9 @@ ModelDataTableModel::ModelDataTableModel(ModelId m) :
     m_model(m),
     m_sortColumn(0),
     m_sortOrdering(Qt::AscendingOrder),
-    m_currentRow(0)
+    m_currentRow(0),
+    m_sortKeysColumn(-1),
+    m_sortKeysNumeric(false)
 {
     auto model = ModelById::get(m);
     if (model) {
@@ -178,23 +181,32 @@ ModelDataTableModel::findText(QString text) const
     auto model = getTabularModel();
     if (!model) return QModelIndex();
     if (text == "") return QModelIndex();
+
+    if (!m_textIndex) {
+        readTextIndex();
+    }
+
+    auto matches = m_textIndex->findRows(text);
+    
+    // We want the first match after the current row in display
+    // order, wrapping around to the current row itself last
+
     int rows = rowCount();
-    int cols = columnCount();
     int current = getCurrentRow();
-    for (int row = 1; row <= rows; ++row) {
-        int wrapped = (row + current) % rows;
-        for (int col = 0; col < cols; ++col) {
-            if (model->getSortType(col) != TabularModel::SortAlphabetical) {
-                continue;
-            }
-            QString cell = model->getData(getUnsorted(wrapped), col,
-                                            Qt::DisplayRole).toString();
-            if (cell.contains(text, Qt::CaseInsensitive)) {
-                return createIndex(wrapped, col);
-            }
+    int bestDistance = rows;
+    QModelIndex best;
+
+    for (const auto &m: matches) {
+        if (m.row >= rows) continue;
+        int sorted = getSorted(m.row);
+        int distance = ((sorted - current - 1) % rows + rows) % rows;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = createIndex(sorted, m_textColumns[m.column]);
         }
     }
-    return QModelIndex();
+    
+    return best;
 }
 
 void
@@ -205,6 +217,8 @@ ModelDataTableModel::sort(int column, Qt::SortOrder sortOrder)
     int prevCurrent = getCurrentRow();
     if (m_sortColumn != column) {
         clearSort();
+        m_sortKeys.clear();
+        m_sortKeysColumn = -1;
     }
     m_sortColumn = column;
     m_sortOrdering = sortOrder;
@@ -230,7 +244,7 @@ ModelDataTableModel::modelChanged(ModelId)
     }
     SVDEBUG << "emitting dataChanged from row " << ix0.row() << " to " << ix1.row() << endl;
     emit dataChanged(ix0, ix1);
-    clearSort();
+    clearCaches();
     emit layoutChanged();
 }
 
@@ -238,6 +252,11 @@ void
 ModelDataTableModel::modelChangedWithin(ModelId, sv_frame_t f0, sv_frame_t f1)
 {
     SVDEBUG << "ModelDataTableModel::modelChangedWithin(" << f0 << "," << f1 << ")" << endl;
+    if (updateRows(f0, f1)) {
+        clearSort();
+    } else {
+        clearCaches();
+    }
     QModelIndex ix0 = getModelIndexForFrame(f0);
     QModelIndex ix1 = getModelIndexForFrame(f1);
     int row0 = ix0.row();
@@ -250,7 +269,6 @@ ModelDataTableModel::modelChangedWithin(ModelId, sv_frame_t f0, sv_frame_t f1)
     }
     SVDEBUG << "emitting dataChanged from row " << ix0.row() << " to " << ix1.row() << endl;
     emit dataChanged(ix0, ix1);
-    clearSort();
     emit layoutChanged();
 }
 
@@ -318,81 +336,257 @@ ModelDataTableModel::resort() const
     auto model = getTabularModel();
     if (!model) return;
 
-    bool numeric = (model->getSortType(m_sortColumn) ==
-                    TabularModel::SortNumeric);
+    if (m_sortKeysColumn != m_sortColumn) {
+        readSortKeys();
+    }
 
-//    cerr << "resort: numeric == " << numeric << endl;
+    int n = int(m_sortKeys.size());
 
-    m_sort.clear();
-    m_rsort.clear();
+    // rsort maps from sorted row number to original row number, and
+    // sort from original row number to sorted row number
+    
+    m_rsort.resize(n);
+    m_sort.resize(n);
 
-    if (numeric) resortNumeric();
-    else resortAlphabetical();
+    for (int i = 0; i < n; ++i) {
+        m_rsort[i] = m_sortKeys[i].row;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (m_rsort[i] >= 0 && m_rsort[i] < n) {
+            m_sort[m_rsort[i]] = i;
+        }
+    }
+}
 
-    std::map<int, int> tmp;
+void
+ModelDataTableModel::readSortKeys() const
+{
+    auto model = getTabularModel();
+    if (!model) return;
 
-    // rsort maps from sorted row number to original row number
+    int rows = model->getRowCount();
+    
+    if (!m_textIndex || int(m_rowFrames.size()) != rows) {
+        m_textIndex.reset();
+        readRowFrames();
+    }
+
+    m_sortKeysColumn = m_sortColumn;
+    m_sortKeysNumeric = (model->getSortType(m_sortColumn) ==
+                         TabularModel::SortNumeric);
 
-    for (int i = 0; i < (int)m_rsort.size(); ++i) {
-        tmp[m_rsort[i]] = i;
+    m_sortKeys.clear();
+    m_sortKeys.reserve(rows);
+    
+    for (int i = 0; i < rows; ++i) {
+        m_sortKeys.push_back(readSortKey(model, i));
     }
 
-    // tmp now maps from original row number to sorted row number
+    std::sort(m_sortKeys.begin(), m_sortKeys.end(),
+              [this](const SortKey &a, const SortKey &b) {
+                  return sortKeyLess(a, b);
+              });
+}
 
-    for (std::map<int, int>::const_iterator i = tmp.begin(); i != tmp.end(); ++i) {
-        m_sort.push_back(i->second);
+ModelDataTableModel::SortKey
+ModelDataTableModel::readSortKey(const std::shared_ptr<TabularModel> &model,
+                                 int row) const
+{
+    SortKey key;
+    QVariant value = model->getData(row, m_sortKeysColumn,
+                                    TabularModel::SortRole);
+    if (m_sortKeysNumeric) {
+        key.number = value.toDouble();
+    } else {
+        key.number = 0.0;
+        key.text = value.toString();
     }
+    key.row = row;
+    return key;
+}
 
-    // and sort now maps from original row number to sorted row number
+bool
+ModelDataTableModel::sortKeyLess(const SortKey &a, const SortKey &b) const
+{
+    if (m_sortKeysNumeric) {
+        // NaN sorts first, so as to keep a strict weak ordering
+        bool anan = ISNAN(a.number), bnan = ISNAN(b.number);
+        if (anan != bnan) return anan;
+        if (!anan && a.number != b.number) return a.number < b.number;
+    } else {
+        if (a.text != b.text) return a.text < b.text;
+    }
+    return a.row < b.row;
 }
 
 void
-ModelDataTableModel::resortNumeric() const
+ModelDataTableModel::readTextIndex() const
 {
     auto model = getTabularModel();
     if (!model) return;
 
-    typedef std::multimap<double, int> MapType;
-
-    MapType rowMap;
     int rows = model->getRowCount();
 
-    for (int i = 0; i < rows; ++i) {
-        QVariant value = model->getData(i, m_sortColumn, TabularModel::SortRole);
-        rowMap.insert(MapType::value_type(value.toDouble(), i));
+    if (m_sortKeysColumn < 0 || int(m_rowFrames.size()) != rows) {
+        m_sortKeys.clear();
+        m_sortKeysColumn = -1;
+        m_sort.clear();
+        readRowFrames();
     }
 
-    for (MapType::iterator i = rowMap.begin(); i != rowMap.end(); ++i) {
-//        cerr << "resortNumeric: " << i->second << ": " << i->first << endl;
-        m_rsort.push_back(i->second);
+    m_textColumns.clear();
+    for (int col = 0; col < model->getColumnCount(); ++col) {
+        if (model->getSortType(col) == TabularModel::SortAlphabetical) {
+            m_textColumns.push_back(col);
+        }
     }
 
-    // rsort now maps from sorted row number to original row number
+    std::vector<RowTextIndex::RowTexts> texts;
+    texts.reserve(rows);
+    for (int i = 0; i < rows; ++i) {
+        texts.push_back(readRowTexts(model, i));
+    }
+
+    m_textIndex.reset(new RowTextIndex);
+    m_textIndex->replaceRows(0, 0, texts);
+}
+
+RowTextIndex::RowTexts
+ModelDataTableModel::readRowTexts(const std::shared_ptr<TabularModel> &model,
+                                  int row) const
+{
+    RowTextIndex::RowTexts texts;
+    for (int col: m_textColumns) {
+        texts.push_back(model->getData(row, col, Qt::DisplayRole).toString());
+    }
+    return texts;
 }
 
 void
-ModelDataTableModel::resortAlphabetical() const
+ModelDataTableModel::readRowFrames() const
 {
+    m_rowFrames.clear();
+    
     auto model = getTabularModel();
     if (!model) return;
 
-    typedef std::multimap<QString, int> MapType;
-
-    MapType rowMap;
     int rows = model->getRowCount();
-
+    m_rowFrames.reserve(rows);
     for (int i = 0; i < rows; ++i) {
-        QVariant value =
-            model->getData(i, m_sortColumn, TabularModel::SortRole);
-        rowMap.insert(MapType::value_type(value.toString(), i));
+        m_rowFrames.push_back(model->getFrameForRow(i));
+    }
+}
+
+bool
+ModelDataTableModel::updateRows(sv_frame_t f0, sv_frame_t f1)
+{
+    // Bring the sort keys and text index up to date following a
+    // change to the events from f0 to f1, re-reading only the rows in
+    // that range. Return false if we can't, because the rows outside
+    // the range don't appear to be the ones we had before, in which
+    // case the caller must discard everything.
+    
+    if (m_sortKeysColumn < 0 && !m_textIndex) {
+        return true;
+    }
+    
+    auto model = getTabularModel();
+    if (!model) return false;
+
+    if (f1 <= f0) f1 = f0 + 1;
+
+    // The first row at or after a given frame, in the model as it is
+    // now. We don't use getRowForFrame, as for some models that skips
+    // rows found at the frame itself
+    
+    auto rowForFrame = [&](sv_frame_t frame, int lo, int hi) {
+                           while (lo < hi) {
+                               int mid = lo + (hi - lo) / 2;
+                               if (model->getFrameForRow(mid) < frame) {
+                                   lo = mid + 1;
+                               } else {
+                                   hi = mid;
+                               }
+                           }
+                           return lo;
+                       };
+
+    int oldCount = int(m_rowFrames.size());
+    int newCount = model->getRowCount();
+
+    int oldLo = int(std::lower_bound(m_rowFrames.begin(), m_rowFrames.end(),
+                                     f0) - m_rowFrames.begin());
+    int oldHi = int(std::lower_bound(m_rowFrames.begin(), m_rowFrames.end(),
+                                     f1) - m_rowFrames.begin());
+    
+    int newLo = rowForFrame(f0, 0, newCount);
+    int newHi = rowForFrame(f1, newLo, newCount);
+
+    int removed = oldHi - oldLo;
+    int added = newHi - newLo;
+
+    if (newLo != oldLo || added - removed != newCount - oldCount) {
+        SVDEBUG << "ModelDataTableModel::updateRows: Change from " << f0
+                << " to " << f1 << " does not account for change in row "
+                << "count from " << oldCount << " to " << newCount
+                << ", re-reading all rows" << endl;
+        return false;
+    }
+
+    int delta = added - removed;
+    
+    std::vector<sv_frame_t> frames;
+    frames.reserve(added);
+    for (int i = newLo; i < newHi; ++i) {
+        frames.push_back(model->getFrameForRow(i));
+    }
+    m_rowFrames.erase(m_rowFrames.begin() + oldLo,
+                      m_rowFrames.begin() + oldHi);
+    m_rowFrames.insert(m_rowFrames.begin() + oldLo,
+                       frames.begin(), frames.end());
+
+    if (m_sortKeysColumn >= 0) {
+
+        // Drop the keys of the rows that have gone and renumber the
+        // rest, which leaves them still sorted (since ties are broken
+        // by row number and the renumbering preserves row order); then
+        // merge in the new ones
+
+        std::vector<SortKey> keys;
+        keys.reserve(m_sortKeys.size() + added);
+        for (auto &k: m_sortKeys) {
+            if (k.row < oldLo) {
+                keys.push_back(std::move(k));
+            } else if (k.row >= oldHi) {
+                k.row += delta;
+                keys.push_back(std::move(k));
+            }
+        }
+
+        auto mid = keys.size();
+        for (int i = newLo; i < newHi; ++i) {
+            keys.push_back(readSortKey(model, i));
+        }
+
+        auto less = [this](const SortKey &a, const SortKey &b) {
+                        return sortKeyLess(a, b);
+                    };
+        std::sort(keys.begin() + mid, keys.end(), less);
+        std::inplace_merge(keys.begin(), keys.begin() + mid, keys.end(), less);
+
+        m_sortKeys = std::move(keys);
     }
 
-    for (MapType::iterator i = rowMap.begin(); i != rowMap.end(); ++i) {
-//        cerr << "resortAlphabetical: " << i->second << ": " << i->first << endl;
-        m_rsort.push_back(i->second);
+    if (m_textIndex) {
+        std::vector<RowTextIndex::RowTexts> texts;
+        texts.reserve(added);
+        for (int i = newLo; i < newHi; ++i) {
+            texts.push_back(readRowTexts(model, i));
+        }
+        m_textIndex->replaceRows(oldLo, removed, texts);
     }
 
-    // rsort now maps from sorted row number to original row number
+    return true;
 }
 
 int
@@ -407,6 +601,18 @@ ModelDataTableModel::setCurrentRow(int row)
     m_currentRow = getUnsorted(row);
 }
 
+void
+ModelDataTableModel::clearCaches()
+{
+    clearSort();
+    m_rsort.clear();
+    m_sortKeys.clear();
+    m_sortKeysColumn = -1;
+    m_textIndex.reset();
+    m_textColumns.clear();
+    m_rowFrames.clear();
+}
+
 void
 ModelDataTableModel::clearSort()
 {
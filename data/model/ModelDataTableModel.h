@@ -19,11 +19,13 @@
 #include <QAbstractItemModel>
 
 #include <vector>
+#include <memory>
 
 #include "base/BaseTypes.h"
 
 #include "TabularModel.h"
 #include "Model.h"
+#include "RowTextIndex.h"
 
 class TabularModel;
 class Command;
@@ -88,12 +90,51 @@ protected:
     typedef std::vector<int> RowList;
     mutable RowList m_sort;
     mutable RowList m_rsort;
+
+    /**
+     * The sort key of every row in the sort column, in sorted order,
+     * ties being broken by row number. This is kept up to date as the
+     * model changes, re-reading only the rows that have changed; the
+     * row mappings m_sort and m_rsort are then cheaply derived from
+     * it when next needed. Empty with m_sortKeysColumn == -1 if not
+     * yet read.
+     */
+    struct SortKey {
+        double number;
+        QString text;
+        int row;
+    };
+    mutable std::vector<SortKey> m_sortKeys;
+    mutable int m_sortKeysColumn;
+    mutable bool m_sortKeysNumeric;
+
+    /**
+     * Index of the searchable (alphabetical) columns, built at the
+     * first findText and kept up to date thereafter like the sort keys.
+     */
+    mutable std::unique_ptr<RowTextIndex> m_textIndex;
+    mutable std::vector<int> m_textColumns;
+
+    /**
+     * The frame of every row, as of the last time the sort keys or
+     * text index were read or updated, used to work out which rows a
+     * modelChangedWithin refers to. Empty if neither is in use.
+     */
+    mutable std::vector<sv_frame_t> m_rowFrames;
+    
     int getSorted(int row) const;
     int getUnsorted(int row) const;
     void resort() const;
-    void resortNumeric() const;
-    void resortAlphabetical() const;
+    void readSortKeys() const;
+    SortKey readSortKey(const std::shared_ptr<TabularModel> &, int row) const;
+    bool sortKeyLess(const SortKey &, const SortKey &) const;
+    void readTextIndex() const;
+    RowTextIndex::RowTexts readRowTexts(const std::shared_ptr<TabularModel> &,
+                                        int row) const;
+    void readRowFrames() const;
+    bool updateRows(sv_frame_t f0, sv_frame_t f1);
     void clearSort();
+    void clearCaches();
 };
 
 #endif
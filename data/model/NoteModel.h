@@ -19,6 +19,7 @@
 #include "TabularModel.h"
 #include "EventCommands.h"
 #include "DeferredNotifier.h"
+#include "EventBoxIndex.h"
 #include "base/UnitDatabase.h"
 #include "base/EventSeries.h"
 #include "base/NoteData.h"
@@ -30,6 +31,8 @@
 
 #include <QMutexLocker>
 
+#include <algorithm>
+
 class NoteModel : public Model,
                   public TabularModel,
                   public NoteExportable,
@@ -60,7 +63,8 @@ public:
                    notifyOnAdd ?
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
-        m_completion(100) {
+        m_completion(100),
+        m_boxIndex(EventBoxIndex::ValueOnly) {
         if (subtype == FLEXI_NOTE) {
             m_valueMinimum = 33.f;
             m_valueMaximum = 88.f;
@@ -86,7 +90,8 @@ public:
                    notifyOnAdd ?
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
-        m_completion(100) {
+        m_completion(100),
+        m_boxIndex(EventBoxIndex::ValueOnly) {
         PlayParameterRepository::getInstance()->addPlayable
             (getId().untyped, this);
     }
@@ -197,6 +202,23 @@ public:
         return m_events.getNearestEventMatching
             (startSearchAt, predicate, direction, found);
     }
+    /**
+     * Retrieve all events that overlap the given frame range and
+     * whose values lie within the given inclusive range, e.g. the
+     * notes within a rectangle drawn on a piano-roll display. See
+     * EventBoxIndex::getEventsWithinBox. The first call builds a
+     * spatial index, which is maintained from then on.
+     */
+    EventVector getEventsWithinBox(sv_frame_t f, sv_frame_t duration,
+                                   float minValue, float maxValue) const {
+        if (!m_boxIndex.isBuilt()) {
+            QMutexLocker locker(&m_mutex);
+            if (!m_boxIndex.isBuilt()) {
+                m_boxIndex.build(m_events.getAllEvents());
+            }
+        }
+        return m_boxIndex.getEventsWithinBox(f, duration, minValue, maxValue);
+    }
     int getIndexForEvent(const Event &e) {
         return m_events.getIndexForEvent(e);
     }
@@ -206,21 +228,54 @@ public:
      */
     void add(Event e) override {
 
+        {
+            QMutexLocker locker(&m_mutex);
+            m_events.add(e);
+            m_boxIndex.add(e);
+        }
+
+        bool allChange = noteAdded(e);
+        
+        m_notifier.update(e.getFrame(), e.getDuration() + m_resolution);
+
+        if (allChange) {
+            emit modelChanged(getId());
+        }
+    }
+    
+    void addEvents(EventVector ee) {
+
+        if (ee.empty()) return;
+
+        // Sorted, so that an empty model can build its series directly
+        std::sort(ee.begin(), ee.end());
+
         bool allChange = false;
-           
-        m_events.add(e);
-        float v = e.getValue();
-        if (!ISNAN(v) && !ISINF(v)) {
-            if (!m_haveExtents || v < m_valueMinimum) {
-                m_valueMinimum = v; allChange = true;
+
+        sv_frame_t from = ee.begin()->getFrame();
+        sv_frame_t to = from;
+        
+        for (const auto &e: ee) {
+            if (noteAdded(e)) allChange = true;
+            sv_frame_t end = e.getFrame() + e.getDuration() + m_resolution;
+            if (end > to) to = end;
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_events.isEmpty()) {
+                m_events = EventSeries::fromEvents(ee);
+            } else {
+                m_events.addEvents(ee);
             }
-            if (!m_haveExtents || v > m_valueMaximum) {
-                m_valueMaximum = v; allChange = true;
+            if (m_boxIndex.isBuilt()) {
+                for (const auto &e: ee) {
+                    m_boxIndex.add(e);
+                }
             }
-            m_haveExtents = true;
         }
         
-        m_notifier.update(e.getFrame(), e.getDuration() + m_resolution);
+        m_notifier.update(from, to - from);
 
         if (allChange) {
             emit modelChanged(getId());
@@ -228,7 +283,11 @@ public:
     }
     
     void remove(Event e) override {
-        m_events.remove(e);
+        {
+            QMutexLocker locker(&m_mutex);
+            m_events.remove(e);
+            m_boxIndex.remove(e);
+        }
         emit modelChangedWithin(getId(),
                                 e.getFrame(),
                                 e.getFrame() + e.getDuration() + m_resolution);
@@ -427,6 +486,26 @@ public:
     }
 
 protected:
+    // Update the extents for a newly added event, returning true if
+    // they have changed
+    bool noteAdded(const Event &e) {
+
+        bool allChange = false;
+        
+        float v = e.getValue();
+        if (!ISNAN(v) && !ISINF(v)) {
+            if (!m_haveExtents || v < m_valueMinimum) {
+                m_valueMinimum = v; allChange = true;
+            }
+            if (!m_haveExtents || v > m_valueMaximum) {
+                m_valueMaximum = v; allChange = true;
+            }
+            m_haveExtents = true;
+        }
+
+        return allChange;
+    }
+    
     Subtype m_subtype;
     sv_samplerate_t m_sampleRate;
     int m_resolution;
@@ -440,6 +519,7 @@ protected:
     std::atomic<int> m_completion;
 
     EventSeries m_events;
+    mutable EventBoxIndex m_boxIndex;
 };
 
 #endif
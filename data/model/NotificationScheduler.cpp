@@ -0,0 +1,178 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "NotificationScheduler.h"
+#include "DeferredNotifier.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QTimer>
+
+#include <algorithm>
+
+NotificationScheduler *
+NotificationScheduler::m_instance = new NotificationScheduler;
+
+NotificationScheduler *
+NotificationScheduler::getInstance()
+{
+    return m_instance;
+}
+
+NotificationScheduler::NotificationScheduler() :
+    m_timer(nullptr),
+    m_enabled(true),
+    m_flushInterval(100),
+    m_queued(0),
+    m_flushed(0),
+    m_dropped(0)
+{
+    m_sinceFlush.start();
+}
+
+NotificationScheduler::~NotificationScheduler()
+{
+}
+
+void
+NotificationScheduler::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void
+NotificationScheduler::setFlushInterval(int ms)
+{
+    if (ms < 0) ms = 0;
+    m_flushInterval = ms;
+}
+
+NotificationScheduler::Counts
+NotificationScheduler::getCounts() const
+{
+    Counts counts;
+    counts.queued = m_queued;
+    counts.flushed = m_flushed;
+    counts.dropped = m_dropped;
+    return counts;
+}
+
+void
+NotificationScheduler::resetCounts()
+{
+    m_queued = 0;
+    m_flushed = 0;
+    m_dropped = 0;
+}
+
+void
+NotificationScheduler::schedule(DeferredNotifier *notifier, ModelId modelId)
+{
+    bool wasIdle = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        wasIdle = m_pending.empty();
+        m_pending[notifier] = modelId;
+    }
+
+    // Only the first notifier to arrive after a flush needs to set
+    // the timer going. Without an application there is no event loop
+    // to run it, and models flush themselves on completion anyway
+
+    if (wasIdle && QCoreApplication::instance()) {
+        QMetaObject::invokeMethod(this, "armTimer", Qt::QueuedConnection);
+    }
+}
+
+void
+NotificationScheduler::cancel(DeferredNotifier *notifier)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pending.erase(notifier);
+}
+
+void
+NotificationScheduler::armTimer()
+{
+    if (!m_timer) {
+        m_timer = new QTimer(this);
+        m_timer->setSingleShot(true);
+        connect(m_timer, SIGNAL(timeout()), this, SLOT(flush()));
+    }
+
+    if (m_timer->isActive()) {
+        return;
+    }
+
+    qint64 elapsed = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        elapsed = m_sinceFlush.elapsed();
+    }
+
+    int wait = m_flushInterval - int(std::min(elapsed, qint64(m_flushInterval)));
+    m_timer->start(wait);
+}
+
+void
+NotificationScheduler::flush()
+{
+    std::map<DeferredNotifier *, ModelId> pending;
+    {
+        QMutexLocker locker(&m_mutex);
+        pending = m_pending;
+        m_sinceFlush.restart();
+    }
+
+    for (const auto &p: pending) {
+
+        // Holding the model ensures its notifier can't be destroyed
+        // while we use it. If the model is not in the store, we must
+        // not touch the notifier at all: its entry stays pending,
+        // either for a later flush once the model has been added, or
+        // for the notifier to cancel when it is destroyed
+
+        auto model = ModelById::get(p.second);
+        if (!model) {
+            continue;
+        }
+
+        {
+            QMutexLocker locker(&m_mutex);
+            auto itr = m_pending.find(p.first);
+            if (itr == m_pending.end() || itr->second != p.second) {
+                continue;
+            }
+            m_pending.erase(itr);
+        }
+
+        p.first->flushScheduled();
+    }
+
+    // Nothing else will set the timer going while entries remain
+    // pending, as schedule() only does so when it finds none. That
+    // includes entries for models not yet in the store, and those of
+    // notifiers that scheduled while we were working through our
+    // copy (perhaps from a listener we just notified)
+
+    bool remaining = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        remaining = !m_pending.empty();
+    }
+
+    if (remaining && QCoreApplication::instance()) {
+        QMetaObject::invokeMethod(this, "armTimer", Qt::QueuedConnection);
+    }
+}
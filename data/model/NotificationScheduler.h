@@ -0,0 +1,127 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_NOTIFICATION_SCHEDULER_H
+#define SV_NOTIFICATION_SCHEDULER_H
+
+#include "Model.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <map>
+#include <cstdint>
+
+class DeferredNotifier;
+class QTimer;
+
+/**
+ * Central scheduler for the deferred change notifications of models.
+ *
+ * A model written to at a high rate (by a transform, or while
+ * recording) uses a DeferredNotifier in deferred mode, which gathers
+ * the extents of all changes since its last notification. Rather than
+ * each model choosing when to emit these, the notifiers register with
+ * this scheduler, which flushes every pending notifier together, at
+ * most once per flush interval, from the application's main thread.
+ * So however many writers there are and however quickly they write,
+ * listeners see at most one modelChangedWithin per model per interval.
+ * (A model may still flush its own notifier explicitly, for example
+ * when it reports completion.)
+ *
+ * Notifications can also be switched off altogether, for batch use
+ * with nothing listening. A notifier then drops every change as it is
+ * made, including those from models in immediate-notification mode.
+ *
+ * The scheduler only flushes notifiers of models that are held in the
+ * ModelById store, holding a reference to each model while notifying
+ * for it. The notifier of a model changed before it is added to the
+ * store stays pending until the model has been added.
+ */
+class NotificationScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static NotificationScheduler *getInstance();
+
+    virtual ~NotificationScheduler();
+
+    /**
+     * Enable or disable all change notifications through
+     * DeferredNotifier. They are enabled by default.
+     */
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Set the minimum time in milliseconds between scheduled flushes.
+     * The default is 100ms.
+     */
+    void setFlushInterval(int ms);
+    int getFlushInterval() const { return m_flushInterval; }
+
+    struct Counts {
+        /// Changes accepted by notifiers in deferred mode
+        int64_t queued;
+        /// Notifications actually emitted on behalf of deferred changes
+        int64_t flushed;
+        /// Changes discarded because notifications were disabled
+        int64_t dropped;
+    };
+
+    Counts getCounts() const;
+    void resetCounts();
+
+public slots:
+    /**
+     * Flush every pending notifier now.
+     */
+    void flush();
+
+private slots:
+    void armTimer();
+
+private:
+    NotificationScheduler();
+
+    friend class DeferredNotifier;
+
+    void schedule(DeferredNotifier *, ModelId);
+    void cancel(DeferredNotifier *);
+
+    void noteQueued() { ++m_queued; }
+    void noteFlushed() { ++m_flushed; }
+    void noteDropped() { ++m_dropped; }
+
+    QMutex m_mutex;
+    std::map<DeferredNotifier *, ModelId> m_pending;
+    QElapsedTimer m_sinceFlush;
+    QTimer *m_timer;
+
+    std::atomic<bool> m_enabled;
+    std::atomic<int> m_flushInterval;
+    std::atomic<int64_t> m_queued;
+    std::atomic<int64_t> m_flushed;
+    std::atomic<int64_t> m_dropped;
+
+    static NotificationScheduler *m_instance;
+};
+
+#endif
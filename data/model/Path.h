@@ -20,7 +20,9 @@
 #include "base/BaseTypes.h"
 
 #include <QStringList>
-#include <set>
+
+#include <vector>
+#include <algorithm>
 
 struct PathPoint
 {
@@ -55,6 +57,10 @@ struct PathPoint
         if (frame != p2.frame) return frame < p2.frame;
         return mapframe < p2.mapframe;
     }
+
+    bool operator==(const PathPoint &p2) const {
+        return frame == p2.frame && mapframe == p2.mapframe;
+    }
 };
 
 class Path : public XmlExportable
@@ -67,7 +73,13 @@ public:
     Path(const Path &) =default;
     Path &operator=(const Path &) =default;
 
-    typedef std::set<PathPoint> Points;
+    /**
+     * The points of a path, in order and without duplicates. This is
+     * a sorted vector rather than a set, so that lookups can be made
+     * with a binary search over contiguous memory and whole paths
+     * built or copied cheaply.
+     */
+    typedef std::vector<PathPoint> Points;
 
     sv_samplerate_t getSampleRate() const { return m_sampleRate; }
     int getResolution() const { return m_resolution; }
@@ -80,12 +92,40 @@ public:
         return m_points;
     }
 
+    /**
+     * Add a point, if it is not already present. This is quick if
+     * the point comes after all existing ones, but linear in the
+     * number of points following it otherwise.
+     */
     void add(PathPoint p) {
-        m_points.insert(p);
+        if (m_points.empty() || m_points.back() < p) {
+            m_points.push_back(p);
+            return;
+        }
+        auto i = std::lower_bound(m_points.begin(), m_points.end(), p);
+        if (i == m_points.end() || !(*i == p)) {
+            m_points.insert(i, p);
+        }
+    }
+
+    /**
+     * Replace all points with the given ones, which need not be in
+     * order and may contain duplicates.
+     */
+    void setPoints(Points points) {
+        if (!std::is_sorted(points.begin(), points.end())) {
+            std::sort(points.begin(), points.end());
+        }
+        points.erase(std::unique(points.begin(), points.end()),
+                     points.end());
+        m_points = std::move(points);
     }
     
     void remove(PathPoint p) {
-        m_points.erase(p);
+        auto i = std::lower_bound(m_points.begin(), m_points.end(), p);
+        if (i != m_points.end() && *i == p) {
+            m_points.erase(i);
+        }
     }
 
     void clear() {
@@ -180,6 +180,21 @@ ReadOnlyWaveFileModel::isReady(int *completion) const
     return ready;
 }
 
+bool
+ReadOnlyWaveFileModel::isFullyAvailable() const
+{
+    // Unlike isReady(), this does not wait for the range cache fill
+    return isOK() && !m_reader->isUpdating();
+}
+
+sv_frame_t
+ReadOnlyWaveFileModel::getAvailableEndFrame() const
+{
+    if (!isOK()) return getStartFrame();
+    if (!m_reader->isUpdating()) return getEndFrame();
+    return getStartFrame() + m_reader->getAvailableFrameCount();
+}
+
 sv_frame_t
 ReadOnlyWaveFileModel::getFrameCount() const
 {
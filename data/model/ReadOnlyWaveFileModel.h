@@ -64,6 +64,9 @@ public:
 
     const ZoomConstraint *getZoomConstraint() const override { return &m_zoomConstraint; }
 
+    bool isFullyAvailable() const override;
+    sv_frame_t getAvailableEndFrame() const override;
+
     sv_frame_t getFrameCount() const override;
     int getChannelCount() const override;
     sv_samplerate_t getSampleRate() const override;
@@ -171,26 +171,35 @@ public:
      */
     void add(Event e) override {
 
-        bool allChange = false;
-           
         m_events.add(e);
+        bool allChange = noteAdded(e);
         
-        float v = e.getValue();
-        if (!ISNAN(v) && !ISINF(v)) {
-            if (!m_haveExtents || v < m_valueMinimum) {
-                m_valueMinimum = v; allChange = true;
-            }
-            if (!m_haveExtents || v > m_valueMaximum) {
-                m_valueMaximum = v; allChange = true;
-            }
-            m_haveExtents = true;
+        m_notifier.update(e.getFrame(), e.getDuration() + m_resolution);
+
+        if (allChange) {
+            emit modelChanged(getId());
         }
+    }
+
+    void addEvents(EventVector ee) {
+
+        if (ee.empty()) return;
+
+        bool allChange = false;
+
+        sv_frame_t from = ee.begin()->getFrame();
+        sv_frame_t to = from;
         
-        if (e.hasValue() && e.getValue() != 0.f) {
-            m_haveDistinctValues = true;
+        for (const auto &e: ee) {
+            if (noteAdded(e)) allChange = true;
+            if (e.getFrame() < from) from = e.getFrame();
+            sv_frame_t end = e.getFrame() + e.getDuration() + m_resolution;
+            if (end > to) to = end;
         }
+
+        m_events.addEvents(ee);
         
-        m_notifier.update(e.getFrame(), e.getDuration() + m_resolution);
+        m_notifier.update(from, to - from);
 
         if (allChange) {
             emit modelChanged(getId());
@@ -359,6 +368,30 @@ public:
     }
 
 protected:
+    // Update the extents and the distinct-values flag for a newly
+    // added event, returning true if the extents have changed
+    bool noteAdded(const Event &e) {
+
+        bool allChange = false;
+        
+        float v = e.getValue();
+        if (!ISNAN(v) && !ISINF(v)) {
+            if (!m_haveExtents || v < m_valueMinimum) {
+                m_valueMinimum = v; allChange = true;
+            }
+            if (!m_haveExtents || v > m_valueMaximum) {
+                m_valueMaximum = v; allChange = true;
+            }
+            m_haveExtents = true;
+        }
+
+        if (e.hasValue() && e.getValue() != 0.f) {
+            m_haveDistinctValues = true;
+        }
+
+        return allChange;
+    }
+    
     sv_samplerate_t m_sampleRate;
     int m_resolution;
 
@@ -0,0 +1,176 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "RowTextIndex.h"
+
+#include "base/Debug.h"
+
+#include <algorithm>
+
+RowTextIndex::RowTextIndex() :
+    m_removedCount(0)
+{
+}
+
+void
+RowTextIndex::clear()
+{
+    m_rowIds.clear();
+    m_idRows.clear();
+    m_texts.clear();
+    m_postings.clear();
+    m_removedCount = 0;
+}
+
+void
+RowTextIndex::replaceRows(int row, int count,
+                          const std::vector<RowTexts> &rows)
+{
+    int n = getRowCount();
+
+    if (row < 0 || count < 0 || row > n || count > n - row) {
+        SVCERR << "WARNING: RowTextIndex::replaceRows: rows " << row
+               << " to " << row + count << " out of range (have " << n
+               << " rows)" << endl;
+        return;
+    }
+
+    for (int i = row; i < row + count; ++i) {
+        int id = m_rowIds[i];
+        m_idRows[id] = -1;
+        m_texts[id] = RowTexts();
+        ++m_removedCount;
+    }
+
+    std::vector<int> ids;
+    ids.reserve(rows.size());
+
+    for (const auto &texts: rows) {
+        int id = int(m_texts.size());
+        RowTexts folded;
+        folded.reserve(texts.size());
+        for (const auto &t: texts) {
+            folded.push_back(t.toCaseFolded());
+        }
+        m_texts.push_back(folded);
+        m_idRows.push_back(-1);
+        addToPostings(id);
+        ids.push_back(id);
+    }
+
+    m_rowIds.erase(m_rowIds.begin() + row, m_rowIds.begin() + row + count);
+    m_rowIds.insert(m_rowIds.begin() + row, ids.begin(), ids.end());
+
+    for (int i = row; i < getRowCount(); ++i) {
+        m_idRows[m_rowIds[i]] = i;
+    }
+
+    if (m_removedCount > 1024 && m_removedCount > getRowCount()) {
+        compact();
+    }
+}
+
+void
+RowTextIndex::addToPostings(int id)
+{
+    std::vector<quint64> trigrams;
+    for (const auto &t: m_texts[id]) {
+        for (int i = 0; i + 3 <= t.length(); ++i) {
+            trigrams.push_back(trigramAt(t, i));
+        }
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                   trigrams.end());
+    for (auto g: trigrams) {
+        m_postings[g].push_back(id);
+    }
+}
+
+void
+RowTextIndex::compact()
+{
+    // Renumber so that every id is its row number again, and rebuild
+    // the postings without the removed rows
+
+    std::vector<RowTexts> texts;
+    texts.reserve(m_rowIds.size());
+    for (int id: m_rowIds) {
+        texts.push_back(std::move(m_texts[id]));
+    }
+    m_texts = std::move(texts);
+
+    m_postings.clear();
+    m_removedCount = 0;
+
+    int n = getRowCount();
+    m_idRows.resize(n);
+    for (int i = 0; i < n; ++i) {
+        m_rowIds[i] = i;
+        m_idRows[i] = i;
+        addToPostings(i);
+    }
+}
+
+std::vector<RowTextIndex::Match>
+RowTextIndex::findRows(QString text) const
+{
+    std::vector<Match> matches;
+
+    QString folded = text.toCaseFolded();
+    if (folded == "") return matches;
+
+    auto check = [&](int id) {
+                     int row = m_idRows[id];
+                     if (row < 0) return;
+                     const RowTexts &texts = m_texts[id];
+                     for (int c = 0; c < int(texts.size()); ++c) {
+                         if (texts[c].contains(folded)) {
+                             matches.push_back({ row, c });
+                             return;
+                         }
+                     }
+                 };
+
+    if (folded.length() < 3) {
+        for (int id: m_rowIds) {
+            check(id);
+        }
+        return matches;
+    }
+
+    // Every row containing the text contains all of its trigrams, so
+    // we need only check the rows having the least common one
+
+    const std::vector<int> *candidates = nullptr;
+
+    for (int i = 0; i + 3 <= folded.length(); ++i) {
+        auto itr = m_postings.constFind(trigramAt(folded, i));
+        if (itr == m_postings.constEnd()) {
+            return matches;
+        }
+        if (!candidates || itr->size() < candidates->size()) {
+            candidates = &(*itr);
+        }
+    }
+
+    for (int id: *candidates) {
+        check(id);
+    }
+
+    std::sort(matches.begin(), matches.end(),
+              [](const Match &a, const Match &b) { return a.row < b.row; });
+
+    return matches;
+}
@@ -0,0 +1,94 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_ROW_TEXT_INDEX_H
+#define SV_ROW_TEXT_INDEX_H
+
+#include <QString>
+#include <QHash>
+
+#include <vector>
+
+/**
+ * A substring search index over the text cells of a table, such as
+ * the labels shown in the data editing window for an annotation
+ * layer. Each row holds a fixed number of texts, one per searchable
+ * column. The index keeps a list of the rows containing each
+ * three-character sequence, so that a search for text of three or
+ * more characters need only examine the rows containing its rarest
+ * such sequence.
+ *
+ * Rows can be replaced, inserted and removed in place as the
+ * underlying table changes, in time linear in the number of rows
+ * following the change but without re-reading any other row.
+ *
+ * RowTextIndex is not thread-safe.
+ */
+class RowTextIndex
+{
+public:
+    RowTextIndex();
+
+    /// The texts of one row, one per searchable column
+    typedef std::vector<QString> RowTexts;
+
+    struct Match {
+        int row;
+        int column; /// index into the RowTexts of the row
+    };
+
+    void clear();
+
+    int getRowCount() const { return int(m_rowIds.size()); }
+
+    /**
+     * Remove the count rows starting at the given row and insert the
+     * given rows in their place, moving all subsequent rows up or
+     * down accordingly. Use count 0 to insert only, or an empty
+     * vector to remove only.
+     */
+    void replaceRows(int row, int count, const std::vector<RowTexts> &rows);
+
+    /**
+     * Return one match for every row in which any text contains the
+     * given text, compared case-insensitively, in order of row. The
+     * match refers to the first such text in the row.
+     */
+    std::vector<Match> findRows(QString text) const;
+
+private:
+    std::vector<int> m_rowIds; // row number -> id
+    std::vector<int> m_idRows; // id -> row number, or -1 if removed
+    std::vector<RowTexts> m_texts; // id -> case-folded texts
+
+    /**
+     * Trigram -> ids of rows containing it, in no particular
+     * order. These may include the ids of removed rows, which are
+     * skipped when searching and dropped when the index is next
+     * compacted.
+     */
+    QHash<quint64, std::vector<int>> m_postings;
+    int m_removedCount;
+
+    void addToPostings(int id);
+    void compact();
+
+    static quint64 trigramAt(const QString &s, int i) {
+        return (quint64(s[i].unicode()) << 32) |
+            (quint64(s[i+1].unicode()) << 16) |
+            quint64(s[i+2].unicode());
+    }
+};
+
+#endif
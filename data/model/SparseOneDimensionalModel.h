@@ -150,13 +150,30 @@ public:
      */
     void add(Event e) override {
 
-        m_events.add(e.withoutValue().withoutDuration());
+        e = e.withoutValue().withoutDuration();
+        m_events.add(e);
+        noteAdded(e);
+        
+        m_notifier.update(e.getFrame(), m_resolution);
+    }
 
-        if (e.getLabel() != "") {
-            m_haveTextLabels = true;
+    void addEvents(EventVector ee) {
+
+        if (ee.empty()) return;
+
+        sv_frame_t from = ee.begin()->getFrame();
+        sv_frame_t to = from;
+        
+        for (auto &e: ee) {
+            e = e.withoutValue().withoutDuration();
+            noteAdded(e);
+            if (e.getFrame() < from) from = e.getFrame();
+            if (e.getFrame() > to) to = e.getFrame();
         }
+
+        m_events.addEvents(ee);
         
-        m_notifier.update(e.getFrame(), m_resolution);
+        m_notifier.update(from, to - from + m_resolution);
     }
     
     void remove(Event e) override {
@@ -326,6 +343,12 @@ public:
     }
     
 protected:
+    void noteAdded(const Event &e) {
+        if (e.getLabel() != "") {
+            m_haveTextLabels = true;
+        }
+    }
+    
     sv_samplerate_t m_sampleRate;
     int m_resolution;
 
@@ -19,6 +19,7 @@
 #include "TabularModel.h"
 #include "Model.h"
 #include "DeferredNotifier.h"
+#include "ValueSummaryIndex.h"
 
 #include "base/RealTime.h"
 #include "base/EventSeries.h"
@@ -174,6 +175,28 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+
+    /**
+     * Return the minimum, maximum and mean of the values of the
+     * events whose frames fall within the given range, without
+     * retrieving the events. NaN and infinite values are ignored.
+     */
+    ValueSummaryIndex::Summary getValueSummary(sv_frame_t f,
+                                               sv_frame_t duration) const {
+        return m_valueIndex.getSummary(f, duration);
+    }
+
+    /**
+     * Return value summaries for n consecutive ranges of the given
+     * duration starting at f, e.g. one per pixel column when
+     * rendering zoomed out. Each costs logarithmic time in the number
+     * of events.
+     */
+    std::vector<ValueSummaryIndex::Summary>
+    getValueSummaries(sv_frame_t f, sv_frame_t blockDuration, int n) const {
+        return m_valueIndex.getSummaries(f, blockDuration, n);
+    }
+    
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -187,26 +210,36 @@ public:
      */
     void add(Event e) override {
 
-        bool allChange = false;
-           
-        m_events.add(e.withoutDuration()); // can't have duration here
+        e = e.withoutDuration(); // can't have duration here
+        m_events.add(e);
+        bool allChange = noteAdded(e);
+        
+        m_notifier.update(e.getFrame(), m_resolution);
 
-        if (e.getLabel() != "") {
-            m_haveTextLabels = true;
+        if (allChange) {
+            emit modelChanged(getId());
         }
+    }
 
-        float v = e.getValue();
-        if (!ISNAN(v) && !ISINF(v)) {
-            if (!m_haveExtents || v < m_valueMinimum) {
-                m_valueMinimum = v; allChange = true;
-            }
-            if (!m_haveExtents || v > m_valueMaximum) {
-                m_valueMaximum = v; allChange = true;
-            }
-            m_haveExtents = true;
+    void addEvents(EventVector ee) {
+
+        if (ee.empty()) return;
+
+        bool allChange = false;
+
+        sv_frame_t from = ee.begin()->getFrame();
+        sv_frame_t to = from;
+        
+        for (auto &e: ee) {
+            e = e.withoutDuration(); // can't have duration here
+            if (noteAdded(e)) allChange = true;
+            if (e.getFrame() < from) from = e.getFrame();
+            if (e.getFrame() > to) to = e.getFrame();
         }
+
+        m_events.addEvents(ee);
         
-        m_notifier.update(e.getFrame(), m_resolution);
+        m_notifier.update(from, to - from + m_resolution);
 
         if (allChange) {
             emit modelChanged(getId());
@@ -214,7 +247,10 @@ public:
     }
     
     void remove(Event e) override {
-        m_events.remove(e);
+        if (m_events.contains(e)) {
+            m_events.remove(e);
+            m_valueIndex.remove(e.getFrame(), e.getValue());
+        }
         emit modelChangedWithin(getId(),
                                 e.getFrame(), e.getFrame() + m_resolution);
     }
@@ -365,6 +401,32 @@ public:
     }
   
 protected:
+    // Index the value and update the label flag and extents for a
+    // newly added event. Return true if the extents have changed.
+    bool noteAdded(const Event &e) {
+
+        bool allChange = false;
+        
+        m_valueIndex.add(e.getFrame(), e.getValue());
+
+        if (e.getLabel() != "") {
+            m_haveTextLabels = true;
+        }
+
+        float v = e.getValue();
+        if (!ISNAN(v) && !ISINF(v)) {
+            if (!m_haveExtents || v < m_valueMinimum) {
+                m_valueMinimum = v; allChange = true;
+            }
+            if (!m_haveExtents || v > m_valueMaximum) {
+                m_valueMaximum = v; allChange = true;
+            }
+            m_haveExtents = true;
+        }
+
+        return allChange;
+    }
+    
     sv_samplerate_t m_sampleRate;
     int m_resolution;
 
@@ -377,6 +439,7 @@ protected:
     std::atomic<int> m_completion;
 
     EventSeries m_events;
+    ValueSummaryIndex m_valueIndex;
 };
 
 #endif
@@ -0,0 +1,252 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "ValueSummaryIndex.h"
+
+#include "system/System.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+ValueSummaryIndex::ValueSummaryIndex() :
+    m_tree(2),
+    m_leafBase(1),
+    m_dirtyFrom(-1)
+{
+}
+
+void
+ValueSummaryIndex::Summary::merge(const Summary &other)
+{
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    if (other.minimum < minimum) minimum = other.minimum;
+    if (other.maximum > maximum) maximum = other.maximum;
+    sum += other.sum;
+    count += other.count;
+}
+
+void
+ValueSummaryIndex::add(sv_frame_t frame, float value)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Insert after any existing points at the same frame, so that
+    // adding in frame order always appends
+    auto itr = std::upper_bound(m_frames.begin(), m_frames.end(), frame);
+    size_t i = size_t(itr - m_frames.begin());
+    bool atEnd = (i == m_frames.size());
+    
+    m_frames.insert(itr, frame);
+    m_values.insert(m_values.begin() + i, value);
+
+    int block = int(i / blockSize);
+    if (atEnd && m_dirtyFrom < 0) {
+        updateBlock(block);
+    } else {
+        markDirty(block);
+    }
+}
+
+void
+ValueSummaryIndex::remove(sv_frame_t frame, float value)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto range = std::equal_range(m_frames.begin(), m_frames.end(), frame);
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        size_t i = size_t(itr - m_frames.begin());
+        float v = m_values[i];
+        if (v == value || (ISNAN(v) && ISNAN(value))) {
+            m_frames.erase(itr);
+            m_values.erase(m_values.begin() + i);
+            markDirty(int(i / blockSize));
+            return;
+        }
+    }
+}
+
+void
+ValueSummaryIndex::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_frames.clear();
+    m_values.clear();
+    m_tree = std::vector<Summary>(2);
+    m_leafBase = 1;
+    m_dirtyFrom = -1;
+}
+
+int
+ValueSummaryIndex::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_frames.size());
+}
+
+ValueSummaryIndex::Summary
+ValueSummaryIndex::getSummary(sv_frame_t frame, sv_frame_t duration) const
+{
+    QMutexLocker locker(&m_mutex);
+    refresh();
+    return query(frame, frame + duration);
+}
+
+std::vector<ValueSummaryIndex::Summary>
+ValueSummaryIndex::getSummaries(sv_frame_t frame,
+                                sv_frame_t blockDuration,
+                                int n) const
+{
+    QMutexLocker locker(&m_mutex);
+    refresh();
+
+    std::vector<Summary> summaries;
+    if (n <= 0) {
+        return summaries;
+    }
+    summaries.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        sv_frame_t start = frame + i * blockDuration;
+        summaries.push_back(query(start, start + blockDuration));
+    }
+    return summaries;
+}
+
+ValueSummaryIndex::Summary
+ValueSummaryIndex::summariseRange(size_t i0, size_t i1) const
+{
+    Summary s;
+    for (size_t i = i0; i < i1; ++i) {
+        float v = m_values[i];
+        if (ISNAN(v) || ISINF(v)) {
+            continue;
+        }
+        if (s.count == 0) {
+            s.minimum = v;
+            s.maximum = v;
+        } else {
+            if (v < s.minimum) s.minimum = v;
+            if (v > s.maximum) s.maximum = v;
+        }
+        s.sum += v;
+        ++s.count;
+    }
+    return s;
+}
+
+ValueSummaryIndex::Summary
+ValueSummaryIndex::summariseBlock(int block) const
+{
+    size_t i0 = size_t(block) * blockSize;
+    size_t i1 = std::min(i0 + blockSize, m_frames.size());
+    if (i0 >= i1) {
+        return Summary();
+    }
+    return summariseRange(i0, i1);
+}
+
+ValueSummaryIndex::Summary
+ValueSummaryIndex::query(sv_frame_t start, sv_frame_t end) const
+{
+    size_t i0 = size_t(std::lower_bound(m_frames.begin(), m_frames.end(),
+                                        start) - m_frames.begin());
+    size_t i1 = size_t(std::lower_bound(m_frames.begin() + i0, m_frames.end(),
+                                        end) - m_frames.begin());
+    if (i0 >= i1) {
+        return Summary();
+    }
+
+    size_t b0 = i0 / blockSize;
+    size_t b1 = i1 / blockSize;
+    if (b0 == b1) {
+        return summariseRange(i0, i1);
+    }
+
+    // Partial blocks at either end are summarised directly from the
+    // columns, and the whole blocks between them from the tree
+
+    Summary s = summariseRange(i0, (b0 + 1) * blockSize);
+    
+    size_t lo = m_leafBase + b0 + 1;
+    size_t hi = m_leafBase + b1;
+    while (lo < hi) {
+        if (lo & 1) s.merge(m_tree[lo++]);
+        if (hi & 1) s.merge(m_tree[--hi]);
+        lo /= 2;
+        hi /= 2;
+    }
+
+    s.merge(summariseRange(b1 * blockSize, i1));
+    return s;
+}
+
+void
+ValueSummaryIndex::updateBlock(int block) const
+{
+    if (block >= m_leafBase) {
+        // out of room: refresh() will resize
+        m_dirtyFrom = 0;
+        refresh();
+        return;
+    }
+    int node = m_leafBase + block;
+    m_tree[node] = summariseBlock(block);
+    for (node /= 2; node >= 1; node /= 2) {
+        m_tree[node] = m_tree[2 * node];
+        m_tree[node].merge(m_tree[2 * node + 1]);
+    }
+}
+
+void
+ValueSummaryIndex::markDirty(int block)
+{
+    if (m_dirtyFrom < 0 || block < m_dirtyFrom) {
+        m_dirtyFrom = block;
+    }
+}
+
+void
+ValueSummaryIndex::refresh() const
+{
+    if (m_dirtyFrom < 0) {
+        return;
+    }
+
+    int blocks = blockCount();
+    int base = 1;
+    while (base < blocks) {
+        base *= 2;
+    }
+    if (base != m_leafBase) {
+        m_leafBase = base;
+        m_tree = std::vector<Summary>(2 * base);
+        m_dirtyFrom = 0;
+    }
+
+    for (int b = m_dirtyFrom; b < base; ++b) {
+        m_tree[base + b] = summariseBlock(b);
+    }
+    for (int node = base - 1; node >= 1; --node) {
+        m_tree[node] = m_tree[2 * node];
+        m_tree[node].merge(m_tree[2 * node + 1]);
+    }
+
+    m_dirtyFrom = -1;
+}
@@ -0,0 +1,122 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_VALUE_SUMMARY_INDEX_H
+#define SV_VALUE_SUMMARY_INDEX_H
+
+#include "base/BaseTypes.h"
+
+#include <QMutex>
+
+#include <vector>
+
+/**
+ * A side index of the frames and values of a series of points, held
+ * as two parallel columns sorted by frame, with a segment tree of
+ * per-block minimum, maximum and sum over them. This allows the
+ * minimum, maximum and mean of the values within any range of frames
+ * to be found in logarithmic time, without retrieving the points
+ * themselves - e.g. one summary per pixel column when rendering a
+ * long pitch track zoomed out.
+ *
+ * Appending a point at or after the current end is cheap. Inserting
+ * or removing one elsewhere is linear, as for EventSeries, and the
+ * summaries from that point onward are recalculated at the next
+ * query.
+ *
+ * Values that are NaN or infinite are stored but do not contribute to
+ * any summary.
+ *
+ * ValueSummaryIndex is thread-safe.
+ */
+class ValueSummaryIndex
+{
+public:
+    ValueSummaryIndex();
+
+    struct Summary {
+        Summary() : count(0), minimum(0.f), maximum(0.f), sum(0.0) { }
+
+        /** Number of points contributing; if 0, nothing else is set */
+        int count;
+        float minimum;
+        float maximum;
+        double sum;
+
+        float getMean() const { return count > 0 ? float(sum / count) : 0.f; }
+
+        void merge(const Summary &other);
+    };
+
+    void add(sv_frame_t frame, float value);
+
+    /**
+     * Remove one point with the given frame and value, if there is
+     * one.
+     */
+    void remove(sv_frame_t frame, float value);
+
+    void clear();
+
+    int count() const;
+
+    /**
+     * Return the summary of the values of all points whose frames are
+     * greater than or equal to frame and less than frame + duration.
+     */
+    Summary getSummary(sv_frame_t frame, sv_frame_t duration) const;
+
+    /**
+     * Return n summaries of consecutive ranges, each of the given
+     * duration, starting at the given frame.
+     */
+    std::vector<Summary> getSummaries(sv_frame_t frame,
+                                      sv_frame_t blockDuration,
+                                      int n) const;
+
+private:
+    mutable QMutex m_mutex;
+
+    std::vector<sv_frame_t> m_frames;
+    std::vector<float> m_values;
+
+    /**
+     * Segment tree over blocks of blockSize points, with the block
+     * summaries as leaves at m_leafBase onward and each internal node
+     * at i summarising its children at 2i and 2i+1.
+     */
+    mutable std::vector<Summary> m_tree;
+    mutable int m_leafBase;
+
+    /**
+     * Index of the first block whose summary may be stale, or -1 if
+     * all are up to date.
+     */
+    mutable int m_dirtyFrom;
+
+    static const int blockSize = 64;
+
+    int blockCount() const {
+        return int((m_frames.size() + blockSize - 1) / blockSize);
+    }
+
+    Summary summariseBlock(int block) const;
+    Summary summariseRange(size_t i0, size_t i1) const;
+    Summary query(sv_frame_t start, sv_frame_t end) const;
+    void updateBlock(int block) const;
+    void markDirty(int block);
+    void refresh() const;
+};
+
+#endif
@@ -50,7 +50,8 @@ WritableWaveFileModel::WritableWaveFileModel(QString path,
     m_channels(channels),
     m_frameCount(0),
     m_startFrame(0),
-    m_proportion(PROPORTION_UNKNOWN)
+    m_proportion(PROPORTION_UNKNOWN),
+    m_notifier(this, getId(), DeferredNotifier::NOTIFY_DEFERRED)
 {
     init(path);
 }
@@ -67,7 +68,8 @@ WritableWaveFileModel::WritableWaveFileModel(sv_samplerate_t sampleRate,
     m_channels(channels),
     m_frameCount(0),
     m_startFrame(0),
-    m_proportion(PROPORTION_UNKNOWN)
+    m_proportion(PROPORTION_UNKNOWN),
+    m_notifier(this, getId(), DeferredNotifier::NOTIFY_DEFERRED)
 {
     init();
 }
@@ -83,7 +85,8 @@ WritableWaveFileModel::WritableWaveFileModel(sv_samplerate_t sampleRate,
     m_channels(channels),
     m_frameCount(0),
     m_startFrame(0),
-    m_proportion(PROPORTION_UNKNOWN)
+    m_proportion(PROPORTION_UNKNOWN),
+    m_notifier(this, getId(), DeferredNotifier::NOTIFY_DEFERRED)
 {
     init();
 }
@@ -187,7 +190,9 @@ WritableWaveFileModel::componentModelChanged(ModelId)
 void
 WritableWaveFileModel::componentModelChangedWithin(ModelId, sv_frame_t f0, sv_frame_t f1)
 {
-    emit modelChangedWithin(getId(), f0, f1);
+    // While we are being written, these arrive as often as the
+    // reader is updated; let the scheduler coalesce them
+    m_notifier.update(f0, f1 - f0);
 }
 
 void
@@ -269,6 +274,8 @@ WritableWaveFileModel::writeComplete()
     
     m_reader->updateDone();
     m_proportion = 100;
+    m_notifier.makeDeferredNotifications();
+    m_notifier.switchMode(DeferredNotifier::NOTIFY_ALWAYS);
     emit modelChanged(getId());
     emit writeCompleted(getId());
 }
@@ -19,6 +19,7 @@
 #include "WaveFileModel.h"
 #include "ReadOnlyWaveFileModel.h"
 #include "PowerOfSqrtTwoZoomConstraint.h"
+#include "DeferredNotifier.h"
 
 class WavFileWriter;
 class WavFileReader;
@@ -230,6 +231,7 @@ protected:
     sv_frame_t m_frameCount;
     sv_frame_t m_startFrame;
     int m_proportion;
+    DeferredNotifier m_notifier;
 
 private:
     void init(QString path = "");
@@ -16,6 +16,7 @@
 #define TEST_FFT_MODEL_H
 
 #include "../FFTModel.h"
+#include "../FFTModelRegistry.h"
 
 #include "MockWaveModel.h"
 
@@ -268,6 +269,32 @@ private slots:
              { { {}, {}, {}, {}, {} } }, 7);
         releaseMock(mwm);
     }
+
+    void registry_sharing() {
+        auto mwm = makeMock({ Sine }, 64, 0);
+        auto registry = FFTModelRegistry::getInstance();
+        int count = registry->getModelCount();
+        ModelId a = registry->acquire(mwm, 0, HanningWindow, 8, 4, 8);
+        ModelId b = registry->acquire(mwm, 0, HanningWindow, 8, 4, 8);
+        ModelId c = registry->acquire(mwm, 0, HanningWindow, 8, 2, 8);
+        QVERIFY(!a.isNone());
+        QVERIFY(b == a);
+        QVERIFY(c != a);
+        QCOMPARE(registry->getModelCount(), count + 2);
+        auto model = ModelById::getAs<FFTModel>(a);
+        QVERIFY(model);
+        QVERIFY(model->getColumnCacheSize() > 3);
+        model = {};
+        registry->release(a);
+        QVERIFY(ModelById::get(a));
+        registry->release(a);
+        QVERIFY(!ModelById::get(a));
+        registry->release(c);
+        QCOMPARE(registry->getModelCount(), count);
+        QVERIFY(registry->acquire(ModelId(), 0, HanningWindow, 8, 4, 8)
+                .isNone());
+        releaseMock(mwm);
+    }
     
 };
 
@@ -0,0 +1,156 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_MODEL_DATA_TABLE_MODEL_H
+#define TEST_MODEL_DATA_TABLE_MODEL_H
+
+#include "../ModelDataTableModel.h"
+#include "../SparseTimeValueModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <random>
+
+using namespace std;
+
+class TestModelDataTableModel : public QObject
+{
+    Q_OBJECT
+
+    // Check that a table that has been kept up to date through a
+    // series of changes shows the same rows, in the same order, and
+    // finds the same text, as one that reads the model afresh
+
+    void compareWithRebuilt(ModelDataTableModel &table, ModelId id,
+                            int sortColumn, Qt::SortOrder order) {
+
+        ModelDataTableModel rebuilt(id);
+        rebuilt.sort(sortColumn, order);
+
+        int rows = rebuilt.rowCount();
+        int columns = rebuilt.columnCount();
+        QCOMPARE(table.rowCount(), rows);
+
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < columns; ++c) {
+                QVariant v0 = table.data(table.index(r, c), Qt::DisplayRole);
+                QVariant v1 = rebuilt.data(rebuilt.index(r, c),
+                                           Qt::DisplayRole);
+                if (v0 != v1) {
+                    QCOMPARE(v0.toString(), v1.toString());
+                }
+            }
+        }
+
+        QStringList queries;
+        queries << "on" << "onset" << "Beat" << "at 2" << "chord" << "zz";
+        foreach (QString q, queries) {
+            rebuilt.setCurrentRow(table.getCurrentRow());
+            QModelIndex i0 = table.findText(q);
+            QModelIndex i1 = rebuilt.findText(q);
+            QCOMPARE(i0.isValid(), i1.isValid());
+            QCOMPARE(i0.row(), i1.row());
+            QCOMPARE(i0.column(), i1.column());
+        }
+    }
+
+    void randomEdits(int sortColumn, Qt::SortOrder order) {
+
+        static const QStringList labels = {
+            "onset", "Beat 1", "beat 2", "Chord Em7", "", "downbeat"
+        };
+
+        mt19937 rng(sortColumn * 2 + int(order));
+        uniform_int_distribution<int> frameDist(0, 2000);
+        uniform_int_distribution<int> valueDist(0, 10);
+        uniform_int_distribution<int> labelDist(0, labels.size() - 1);
+        uniform_int_distribution<int> actionDist(0, 9);
+
+        auto randomEvent = [&]() {
+                               return Event(frameDist(rng),
+                                            float(valueDist(rng)),
+                                            labels[labelDist(rng)]);
+                           };
+
+        // Notify at once, so that every change reaches the table
+        auto model = make_shared<SparseTimeValueModel>(100, 1, true);
+        auto id = ModelById::add(model);
+
+        for (int i = 0; i < 50; ++i) {
+            model->add(randomEvent());
+        }
+
+        ModelDataTableModel table(id);
+        table.sort(sortColumn, order);
+
+        // Read the sort keys and build the text index, so that the
+        // changes below update them rather than building them afresh
+        table.data(table.index(0, 0), Qt::DisplayRole);
+        table.findText("onset");
+
+        for (int iteration = 0; iteration < 200; ++iteration) {
+
+            int action = actionDist(rng);
+            int rows = model->getRowCount();
+
+            if (action < 5 || rows == 0) {
+                model->add(randomEvent());
+            } else if (action < 8) {
+                int row = uniform_int_distribution<int>(0, rows - 1)(rng);
+                model->remove(model->getAllEvents()[row]);
+            } else if (action < 9) {
+                EventVector ee;
+                for (int i = 0; i < 5; ++i) {
+                    ee.push_back(randomEvent());
+                }
+                model->addEvents(ee);
+            } else {
+                table.setCurrentRow
+                    (uniform_int_distribution<int>(0, rows - 1)(rng));
+            }
+
+            if (iteration % 20 == 0) {
+                compareWithRebuilt(table, id, sortColumn, order);
+            }
+        }
+
+        compareWithRebuilt(table, id, sortColumn, order);
+
+        ModelById::release(id);
+    }
+
+private slots:
+    void numericAscending() {
+        randomEdits(2, Qt::AscendingOrder);
+    }
+
+    void numericDescending() {
+        randomEdits(2, Qt::DescendingOrder);
+    }
+
+    void alphabeticalAscending() {
+        randomEdits(3, Qt::AscendingOrder);
+    }
+
+    void alphabeticalDescending() {
+        randomEdits(3, Qt::DescendingOrder);
+    }
+
+    void byTime() {
+        randomEdits(0, Qt::AscendingOrder);
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_ROW_TEXT_INDEX_H
+#define TEST_ROW_TEXT_INDEX_H
+
+#include "../RowTextIndex.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <random>
+#include <vector>
+
+using namespace std;
+
+class TestRowTextIndex : public QObject
+{
+    Q_OBJECT
+
+    typedef RowTextIndex::RowTexts RowTexts;
+
+    // The matches a search of the given rows should return, found
+    // by looking at every text
+    vector<RowTextIndex::Match> search(const vector<RowTexts> &rows,
+                                       QString text) {
+        vector<RowTextIndex::Match> matches;
+        if (text == "") return matches;
+        for (int r = 0; r < int(rows.size()); ++r) {
+            for (int c = 0; c < int(rows[r].size()); ++c) {
+                if (rows[r][c].contains(text, Qt::CaseInsensitive)) {
+                    matches.push_back({ r, c });
+                    break;
+                }
+            }
+        }
+        return matches;
+    }
+
+    void compare(const vector<RowTextIndex::Match> &a,
+                 const vector<RowTextIndex::Match> &b) {
+        QCOMPARE(a.size(), b.size());
+        for (int i = 0; i < int(a.size()); ++i) {
+            QCOMPARE(a[i].row, b[i].row);
+            QCOMPARE(a[i].column, b[i].column);
+        }
+    }
+
+    QStringList queries() {
+        return QStringList() << "a" << "an" << "ann" << "ANN" << "onset"
+                             << "beat 1" << "t 2" << "chord" << "Em7"
+                             << "not there" << "";
+    }
+
+    RowTexts randomRow(mt19937 &rng) {
+        static const QStringList words = {
+            "onset", "Beat 1", "beat 2", "Chord Em7", "annotation",
+            "Anna", "banana", "", "t", "x y z"
+        };
+        uniform_int_distribution<int> pick(0, words.size() - 1);
+        return { words[pick(rng)], words[pick(rng)] + " " + words[pick(rng)] };
+    }
+
+private slots:
+    void empty() {
+        RowTextIndex index;
+        QCOMPARE(index.getRowCount(), 0);
+        QVERIFY(index.findRows("abc").empty());
+    }
+
+    void simple() {
+        RowTextIndex index;
+        vector<RowTexts> rows = {
+            { "First", "row" }, { "second", "ROW" }, { "third", "" }
+        };
+        index.replaceRows(0, 0, rows);
+        QCOMPARE(index.getRowCount(), 3);
+        foreach (QString q, queries()) {
+            compare(index.findRows(q), search(rows, q));
+        }
+        auto m = index.findRows("row");
+        QCOMPARE(int(m.size()), 2);
+        QCOMPARE(m[1].row, 1);
+        QCOMPARE(m[1].column, 1);
+        m = index.findRows("IRS");
+        QCOMPARE(int(m.size()), 1);
+        QCOMPARE(m[0].row, 0);
+        QCOMPARE(m[0].column, 0);
+    }
+
+    void randomEdits() {
+        // Apply random replacements, insertions and removals to an
+        // index and to a plain list of rows, and check that searches
+        // of the index agree both with a search of every row and with
+        // an index built afresh from the rows
+        mt19937 rng(42);
+        RowTextIndex index;
+        vector<RowTexts> rows;
+
+        for (int iteration = 0; iteration < 300; ++iteration) {
+
+            int n = int(rows.size());
+            int row = uniform_int_distribution<int>(0, n)(rng);
+            int count = uniform_int_distribution<int>(0, min(4, n - row))(rng);
+            int adding = uniform_int_distribution<int>(0, 5)(rng);
+
+            vector<RowTexts> added;
+            for (int i = 0; i < adding; ++i) {
+                added.push_back(randomRow(rng));
+            }
+
+            index.replaceRows(row, count, added);
+            rows.erase(rows.begin() + row, rows.begin() + row + count);
+            rows.insert(rows.begin() + row, added.begin(), added.end());
+
+            QCOMPARE(index.getRowCount(), int(rows.size()));
+
+            if (iteration % 10 == 0) {
+                RowTextIndex rebuilt;
+                rebuilt.replaceRows(0, 0, rows);
+                foreach (QString q, queries()) {
+                    auto matches = index.findRows(q);
+                    compare(matches, search(rows, q));
+                    compare(matches, rebuilt.findRows(q));
+                }
+            }
+        }
+    }
+};
+
+#endif
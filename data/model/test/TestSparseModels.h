@@ -17,9 +17,12 @@
 
 #include "../SparseOneDimensionalModel.h"
 #include "../NoteModel.h"
+#include "../SparseTimeValueModel.h"
 #include "../TextModel.h"
 #include "../Path.h"
+#include "../AlignmentModel.h"
 #include "../ImageModel.h"
+#include "../NotificationScheduler.h"
 
 #include <QObject>
 #include <QtTest>
@@ -33,10 +36,48 @@ using namespace std;
 // when adding or removing tests we may occasionally need to update
 // the IDs in other ones
 
+// Gives the tests access to the paths an AlignmentModel has built
+class AlignmentModelProbe : public AlignmentModel
+{
+public:
+    AlignmentModelProbe(ModelId reference, ModelId aligned, ModelId path) :
+        AlignmentModel(reference, aligned, path) { }
+
+    Path::Points getForwardPoints() const {
+        return m_path ? m_path->getPoints() : Path::Points();
+    }
+    Path::Points getReversePoints() const {
+        return m_reversePath ? m_reversePath->getPoints() : Path::Points();
+    }
+    void rebuild() {
+        constructPath();
+        constructReversePath();
+    }
+};
+
 class TestSparseModels : public QObject
 {
     Q_OBJECT
 
+    void comparePoints(const Path::Points &a, const Path::Points &b) {
+        QCOMPARE(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            QCOMPARE(a[i].frame, b[i].frame);
+            QCOMPARE(a[i].mapframe, b[i].mapframe);
+        }
+    }
+
+    // Compare the paths of m, however it came by them, with those
+    // constructed afresh from everything now in the path source
+    void compareWithConstructed(const AlignmentModelProbe &m,
+                                ModelId reference, ModelId aligned,
+                                ModelId path) {
+        AlignmentModelProbe constructed(reference, aligned, path);
+        constructed.rebuild();
+        comparePoints(m.getForwardPoints(), constructed.getForwardPoints());
+        comparePoints(m.getReversePoints(), constructed.getReversePoints());
+    }
+
 private slots:
     void s1d_empty() {
         SparseOneDimensionalModel m(100, 10, false);
@@ -194,6 +235,157 @@ private slots:
         QCOMPARE(*pp.begin(), p3);
     }
 
+    void note_addEvents() {
+        NoteModel m(100, 10, false);
+        Event p1(20, 123.4f, 10, 0.8f, "note 1");
+        Event p2(20, 124.3f, 20, 0.9f, "note 2");
+        Event p3(50, 126.3f, 30, 0.9f, "note 3");
+        m.addEvents({ p3, p1, p2 });
+
+        QCOMPARE(m.getEventCount(), 3);
+        QCOMPARE(m.getAllEvents(), EventVector({ p1, p2, p3 }));
+        QCOMPARE(m.getStartFrame(), sv_frame_t(20));
+        QCOMPARE(m.getEndFrame(), sv_frame_t(80));
+        QCOMPARE(m.getValueMinimum(), 123.4f);
+        QCOMPARE(m.getValueMaximum(), 126.3f);
+
+        auto pp = m.getEventsSpanning(30, 20);
+        QCOMPARE(pp.size(), size_t(1));
+        QCOMPARE(*pp.begin(), p2);
+
+        Event p4(10, 120.f, 50, 0.5f, "note 4");
+        m.addEvents({ p4 });
+        QCOMPARE(m.getEventCount(), 4);
+        QCOMPARE(*m.getAllEvents().begin(), p4);
+        QCOMPARE(m.getValueMinimum(), 120.f);
+        pp = m.getEventsCovering(55);
+        QCOMPARE(pp.size(), size_t(2));
+    }
+
+    void stv_valueSummary() {
+        SparseTimeValueModel m(100, 10, false);
+        for (int i = 0; i < 1000; ++i) {
+            m.add(Event(i * 10, float(i % 100), QString()));
+        }
+        m.add(Event(5005, NAN, QString()));
+
+        auto s = m.getValueSummary(0, 10000);
+        QCOMPARE(s.count, 1000);
+        QCOMPARE(s.minimum, 0.f);
+        QCOMPARE(s.maximum, 99.f);
+        QCOMPARE(s.getMean(), 49.5f);
+
+        s = m.getValueSummary(1230, 200); // values 23 to 42
+        QCOMPARE(s.count, 20);
+        QCOMPARE(s.minimum, 23.f);
+        QCOMPARE(s.maximum, 42.f);
+
+        auto ss = m.getValueSummaries(0, 1000, 12);
+        QCOMPARE(ss.size(), size_t(12));
+        QCOMPARE(ss[3].count, 100);
+        QCOMPARE(ss[3].minimum, 0.f);
+        QCOMPARE(ss[3].maximum, 99.f);
+        QCOMPARE(ss[11].count, 0);
+
+        // insert before and remove from the middle, invalidating
+        // the summaries from there on
+        m.add(Event(1235, -5.f, QString()));
+        m.remove(Event(1300, 30.f, QString()));
+        s = m.getValueSummary(1230, 200);
+        QCOMPARE(s.count, 20);
+        QCOMPARE(s.minimum, -5.f);
+        QCOMPARE(s.maximum, 42.f);
+
+        // removing an event the model doesn't have changes nothing
+        m.remove(Event(1310, 30.f, QString("not this one")));
+        QCOMPARE(m.getValueSummary(1230, 200).count, 20);
+    }
+
+    void note_eventsWithinBox() {
+        NoteModel m(100, 10, false);
+        EventVector ee;
+        for (int i = 0; i < 2000; ++i) {
+            ee.push_back(Event((i * 37) % 5000, float(40 + (i * 7) % 50),
+                               (i % 3) * 40, 0.8f, QString()));
+        }
+        m.addEvents(ee);
+
+        auto check = [&](sv_frame_t f, sv_frame_t d, float v0, float v1) {
+            EventVector expected;
+            for (const auto &e: m.getEventsSpanning(f, d)) {
+                if (e.getValue() >= v0 && e.getValue() <= v1) {
+                    expected.push_back(e);
+                }
+            }
+            QCOMPARE(m.getEventsWithinBox(f, d, v0, v1), expected);
+        };
+
+        check(0, 5000, 0.f, 200.f);
+        check(1000, 300, 60.f, 64.f);
+        check(4990, 100, 40.f, 40.f);
+
+        // the index is built now, and must follow further edits
+        Event extra(1100, 62.f, 50, 0.5f, QString("extra"));
+        m.add(extra);
+        m.remove(ee[30]);
+        m.remove(ee[31]);
+        check(1000, 300, 60.f, 64.f);
+        QVERIFY(m.getEventsWithinBox(1100, 1, 62.f, 62.f).size() > 0);
+        m.remove(extra);
+        check(1000, 300, 60.f, 64.f);
+        check(0, 5000, 0.f, 200.f);
+    }
+
+    void path_points() {
+        Path p(100, 10);
+        p.add(PathPoint(50, 49));
+        p.add(PathPoint(20, 30));
+        p.add(PathPoint(40, 60));
+        p.add(PathPoint(20, 30));
+        QCOMPARE(p.getPointCount(), 3);
+        QCOMPARE(p.getPoints()[0].frame, sv_frame_t(20));
+        QCOMPARE(p.getPoints()[2].frame, sv_frame_t(50));
+        p.remove(PathPoint(40, 61));
+        QCOMPARE(p.getPointCount(), 3);
+        p.remove(PathPoint(40, 60));
+        QCOMPARE(p.getPointCount(), 2);
+        p.setPoints({ PathPoint(30, 3), PathPoint(10, 1), PathPoint(30, 3) });
+        QCOMPARE(p.getPointCount(), 2);
+        QCOMPARE(p.getPoints()[0].frame, sv_frame_t(10));
+    }
+
+    void alignment_batch() {
+        Path path(100, 10);
+        Path::Points points;
+        for (int i = 0; i < 1000; ++i) {
+            points.push_back(PathPoint(i * 100, i * 150 + (i % 7) * 10));
+        }
+        path.setPoints(points);
+
+        AlignmentModel m((ModelId()), ModelId(), ModelId());
+        m.setPath(path);
+
+        std::vector<sv_frame_t> frames;
+        for (int i = 0; i < 5000; ++i) {
+            frames.push_back(i * 23 - 100);
+        }
+        // some out of order at the end, to check we handle those too
+        frames.push_back(500);
+        frames.push_back(99999999);
+        frames.push_back(50);
+
+        auto mapped = m.toReference(frames);
+        QCOMPARE(mapped.size(), frames.size());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            QCOMPARE(mapped[i], m.toReference(frames[i]));
+        }
+
+        auto unmapped = m.fromReference(mapped);
+        for (size_t i = 0; i < mapped.size(); ++i) {
+            QCOMPARE(unmapped[i], m.fromReference(mapped[i]));
+        }
+    }
+
     void note_xml() {
         NoteModel m(100, 10, false);
         Event p1(20, 123.4f, 20, 0.8f, "note 1");
@@ -300,6 +492,165 @@ private slots:
         }
         QCOMPARE(xml, expected);
     }
+
+    void notifier_coalescing() {
+        // Created last, so as not to disturb the ids in the xml tests
+        auto scheduler = NotificationScheduler::getInstance();
+        auto m = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        auto id = ModelById::add(m);
+        int notified = 0;
+        sv_frame_t from = 0, to = 0;
+        QObject::connect(m.get(), &Model::modelChangedWithin,
+                         [&](ModelId, sv_frame_t f0, sv_frame_t f1) {
+                             ++notified; from = f0; to = f1;
+                         });
+        scheduler->resetCounts();
+        for (int i = 0; i < 10; ++i) {
+            m->add(Event(100 + i * 10));
+        }
+        QCOMPARE(notified, 0);
+        scheduler->flush();
+        QCOMPARE(notified, 1);
+        QCOMPARE(from, sv_frame_t(100));
+        QCOMPARE(to, sv_frame_t(200));
+        scheduler->flush();
+        QCOMPARE(notified, 1);
+        scheduler->setEnabled(false);
+        m->add(Event(300));
+        scheduler->setEnabled(true);
+        scheduler->flush();
+        QCOMPARE(notified, 1);
+        auto counts = scheduler->getCounts();
+        QCOMPARE(counts.queued, int64_t(10));
+        QCOMPARE(counts.flushed, int64_t(1));
+        QCOMPARE(counts.dropped, int64_t(1));
+        ModelById::release(id);
+    }
+
+    void notifier_beforeAdd() {
+        // Changes made before the model is in the store are notified
+        // once it has been added, and later changes are still notified
+        auto scheduler = NotificationScheduler::getInstance();
+        auto m = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        int notified = 0;
+        sv_frame_t from = 0, to = 0;
+        QObject::connect(m.get(), &Model::modelChangedWithin,
+                         [&](ModelId, sv_frame_t f0, sv_frame_t f1) {
+                             ++notified; from = f0; to = f1;
+                         });
+        m->add(Event(100));
+        m->add(Event(150));
+        scheduler->flush();
+        QCOMPARE(notified, 0);
+        auto id = ModelById::add(m);
+        scheduler->flush();
+        QCOMPARE(notified, 1);
+        QCOMPARE(from, sv_frame_t(100));
+        QCOMPARE(to, sv_frame_t(160));
+        m->add(Event(200));
+        scheduler->flush();
+        QCOMPARE(notified, 2);
+        QCOMPARE(from, sv_frame_t(200));
+        QCOMPARE(to, sv_frame_t(210));
+        ModelById::release(id);
+    }
+
+    void notifier_scheduledDuringFlush() {
+        // A notifier that schedules while a flush is still working
+        // through other notifiers finds the pending set non-empty,
+        // so does not set the timer going itself; the flush must
+        // do so for it
+        auto scheduler = NotificationScheduler::getInstance();
+        int interval = scheduler->getFlushInterval();
+        scheduler->setFlushInterval(20);
+
+        auto a = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        auto c = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        auto b = std::make_shared<SparseOneDimensionalModel>(100, 10, false);
+        auto aId = ModelById::add(a);
+        auto cId = ModelById::add(c);
+        auto bId = ModelById::add(b);
+
+        // Each of a and c, when notified, writes to b. Whichever is
+        // flushed first, the other is still pending when b schedules
+        auto writeToB = [&](ModelId, sv_frame_t, sv_frame_t) {
+                            b->add(Event(300));
+                        };
+        QObject::connect(a.get(), &Model::modelChangedWithin, writeToB);
+        QObject::connect(c.get(), &Model::modelChangedWithin, writeToB);
+
+        int notified = 0;
+        QObject::connect(b.get(), &Model::modelChangedWithin,
+                         [&](ModelId, sv_frame_t, sv_frame_t) {
+                             ++notified;
+                         });
+
+        a->add(Event(100));
+        c->add(Event(200));
+        QTRY_COMPARE_WITH_TIMEOUT(notified, 1, 2000);
+
+        scheduler->setFlushInterval(interval);
+        ModelById::release(bId);
+        ModelById::release(cId);
+        ModelById::release(aId);
+    }
+
+    void alignment_extendPath() {
+        // Feed a path source a few points at a time, as an aligner
+        // would, and check that the paths extended as they arrive
+        // match those constructed from the whole source
+        auto reference = std::make_shared<SparseTimeValueModel>(100, 10, true);
+        auto aligned = std::make_shared<SparseTimeValueModel>(100, 10, true);
+        auto source = std::make_shared<SparseTimeValueModel>(100, 10, true);
+        source->setCompletion(0);
+        auto referenceId = ModelById::add(reference);
+        auto alignedId = ModelById::add(aligned);
+        auto sourceId = ModelById::add(source);
+
+        AlignmentModelProbe m(referenceId, alignedId, sourceId);
+
+        for (int i = 0; i < 100; ++i) {
+            sv_frame_t frame = i * 10;
+            source->add(Event(frame, float(i) * 0.15f, ""));
+            if (i % 7 == 3) {
+                // A further point at the frame just read, which the
+                // next extension must pick up without repeating the
+                // one before it
+                source->add(Event(frame, float(i) * 0.15f + 0.05f, ""));
+            }
+            if (i % 10 == 9) {
+                EventVector ee;
+                for (int j = 1; j <= 3; ++j) {
+                    ee.push_back(Event(frame + j * 2,
+                                       float(i) * 0.15f + float(j) * 0.03f,
+                                       ""));
+                }
+                source->addEvents(ee);
+                compareWithConstructed(m, referenceId, alignedId, sourceId);
+            }
+        }
+
+        QCOMPARE(m.getForwardPoints().size(),
+                 size_t(source->getEventCount()));
+
+        // A point arriving out of order is missed while extending,
+        // but the point count no longer matches once the source is
+        // complete, so the paths are constructed again then
+        source->add(Event(55, 0.6f, ""));
+        QCOMPARE(m.getForwardPoints().size() + 1,
+                 size_t(source->getEventCount()));
+        source->setCompletion(100);
+        compareWithConstructed(m, referenceId, alignedId, sourceId);
+
+        // Edits to a complete path may be anywhere in it
+        source->remove(Event(200, 20 * 0.15f, ""));
+        source->add(Event(57, 0.65f, ""));
+        compareWithConstructed(m, referenceId, alignedId, sourceId);
+
+        ModelById::release(sourceId);
+        ModelById::release(alignedId);
+        ModelById::release(referenceId);
+    }
 };
 
 #endif
@@ -2,6 +2,8 @@ TEST_HEADERS += \
 	Compares.h \
 	MockWaveModel.h \
 	TestFFTModel.h \
+	TestModelDataTableModel.h \
+	TestRowTextIndex.h \
         TestSparseModels.h \
         TestWaveformOversampler.h \
         TestZoomConstraints.h
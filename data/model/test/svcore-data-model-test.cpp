@@ -15,6 +15,8 @@
 #include "TestZoomConstraints.h"
 #include "TestWaveformOversampler.h"
 #include "TestSparseModels.h"
+#include "TestRowTextIndex.h"
+#include "TestModelDataTableModel.h"
 
 #include "system/Init.h"
 
@@ -58,6 +60,18 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        TestRowTextIndex t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestModelDataTableModel t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     if (bad > 0) {
         SVCERR << "\n********* " << bad << " test suite(s) failed!\n" << endl;
         return 1;
@@ -14,6 +14,7 @@ SVCORE_HEADERS = \
            base/Extents.h \
            base/HelperExecPath.h \
            base/HitCount.h \
+           base/LeftRight.h \
            base/LogRange.h \
            base/MagnitudeRange.h \
            base/NoteData.h \
@@ -33,13 +34,16 @@ SVCORE_HEADERS = \
            base/RecordDirectory.h \
            base/ResourceFinder.h \
            base/RingBuffer.h \
+           base/RTree.h \
            base/ScaleTickIntervals.h \
            base/Scavenger.h \
            base/Selection.h \
            base/Serialiser.h \
+           base/SlidingFrameWindow.h \
            base/StorageAdviser.h \
            base/StringBits.h \
            base/Strings.h \
+           base/SymbolTable.h \
            base/TempDirectory.h \
            base/TempWriteFile.h \
            base/TextMatcher.h \
@@ -85,23 +89,28 @@ SVCORE_HEADERS = \
            data/model/DenseTimeValueModel.h \
            data/model/DeferredNotifier.h \
            data/model/EditableDenseThreeDimensionalModel.h \
+           data/model/EventBoxIndex.h \
            data/model/EventCommands.h \
            data/model/FFTModel.h \
+           data/model/FFTModelRegistry.h \
            data/model/ImageModel.h \
            data/model/Labeller.h \
            data/model/Model.h \
            data/model/ModelDataTableModel.h \
            data/model/NoteModel.h \
+           data/model/NotificationScheduler.h \
            data/model/Path.h \
            data/model/PowerOfSqrtTwoZoomConstraint.h \
            data/model/PowerOfTwoZoomConstraint.h \
            data/model/RangeSummarisableTimeValueModel.h \
            data/model/RegionModel.h \
            data/model/RelativelyFineZoomConstraint.h \
+           data/model/RowTextIndex.h \
            data/model/SparseOneDimensionalModel.h \
            data/model/SparseTimeValueModel.h \
            data/model/TabularModel.h \
            data/model/TextModel.h \
+           data/model/ValueSummaryIndex.h \
            data/model/BoxModel.h \
            data/model/WaveformOversampler.h \
            data/model/WaveFileModel.h \
@@ -141,7 +150,9 @@ SVCORE_HEADERS = \
            rdf/RDFTransformFactory.h \
 	   system/Init.h \
            system/System.h \
+	   transform/BatchAnalysisRunner.h \
 	   transform/CSVFeatureWriter.h \
+           transform/FeatureExtractionFanOutModelTransformer.h \
            transform/FeatureExtractionModelTransformer.h \
            transform/FeatureWriter.h \
            transform/FileFeatureWriter.h \
@@ -149,6 +160,8 @@ SVCORE_HEADERS = \
            transform/Transform.h \
            transform/TransformDescription.h \
            transform/TransformFactory.h \
+           transform/TransformerScheduler.h \
+           transform/TransformResultCache.h \
            transform/ModelTransformer.h \
            transform/ModelTransformerFactory.h
 	   
@@ -181,6 +194,7 @@ SVCORE_SOURCES = \
            base/StorageAdviser.cpp \
            base/StringBits.cpp \
            base/Strings.cpp \
+           base/SymbolTable.cpp \
            base/TempDirectory.cpp \
            base/TempWriteFile.cpp \
            base/TextMatcher.cpp \
@@ -218,13 +232,18 @@ SVCORE_SOURCES = \
            data/model/Dense3DModelPeakCache.cpp \
            data/model/DenseTimeValueModel.cpp \
            data/model/EditableDenseThreeDimensionalModel.cpp \
+           data/model/EventBoxIndex.cpp \
            data/model/FFTModel.cpp \
+           data/model/FFTModelRegistry.cpp \
            data/model/Model.cpp \
            data/model/ModelDataTableModel.cpp \
+           data/model/NotificationScheduler.cpp \
            data/model/PowerOfSqrtTwoZoomConstraint.cpp \
            data/model/PowerOfTwoZoomConstraint.cpp \
            data/model/RangeSummarisableTimeValueModel.cpp \
            data/model/RelativelyFineZoomConstraint.cpp \
+           data/model/RowTextIndex.cpp \
+           data/model/ValueSummaryIndex.cpp \
            data/model/WaveformOversampler.cpp \
            data/model/WaveFileModel.cpp \
            data/model/ReadOnlyWaveFileModel.cpp \
@@ -254,12 +273,16 @@ SVCORE_SOURCES = \
 	   system/Init.cpp \
            system/System.cpp \
            system/os-other.cpp \
+	   transform/BatchAnalysisRunner.cpp \
 	   transform/CSVFeatureWriter.cpp \
+           transform/FeatureExtractionFanOutModelTransformer.cpp \
            transform/FeatureExtractionModelTransformer.cpp \
            transform/FileFeatureWriter.cpp \
            transform/RealTimeEffectModelTransformer.cpp \
            transform/Transform.cpp \
            transform/TransformFactory.cpp \
+           transform/TransformerScheduler.cpp \
+           transform/TransformResultCache.cpp \
            transform/ModelTransformer.cpp \
            transform/ModelTransformerFactory.cpp
 
@@ -32,3 +32,17 @@ include(files.pri)
 HEADERS = $$SVCORE_HEADERS
 SOURCES = $$SVCORE_SOURCES
 
+# Configuring with "qmake CONFIG+=svcore_batch" builds the svcore-batch
+# command-line tool (see transform/BatchAnalysisRunner.h) from the
+# library sources, instead of the library. The Vamp host SDK, Dataquay
+# and Piper are built by the containing project rather than here, so
+# pass the libraries to link with in BATCH_LIBS, for example
+# qmake CONFIG+=svcore_batch "BATCH_LIBS=-L../vamp-plugin-sdk -lvamp-hostsdk"
+
+svcore_batch {
+    TEMPLATE = app
+    TARGET = svcore-batch
+    CONFIG -= staticlib
+    SOURCES += transform/batch/svcore-batch.cpp
+    LIBS += $$BATCH_LIBS
+}
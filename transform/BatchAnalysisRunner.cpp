@@ -0,0 +1,602 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "BatchAnalysisRunner.h"
+#include "FeatureWriter.h"
+
+#include "data/fileio/FileSource.h"
+#include "data/fileio/AudioFileSizeEstimator.h"
+#include "data/model/ReadOnlyWaveFileModel.h"
+#include "data/model/DenseThreeDimensionalModel.h"
+#include "data/model/SparseOneDimensionalModel.h"
+#include "data/model/SparseTimeValueModel.h"
+#include "data/model/NoteModel.h"
+#include "data/model/RegionModel.h"
+#include "base/StorageAdviser.h"
+#include "base/Thread.h"
+#include "base/Debug.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <memory>
+
+//#define DEBUG_BATCH_ANALYSIS_RUNNER 1
+
+// Features are passed to the writer in lists of at most this many
+static const int writeChunkSize = 1024;
+
+class BatchAnalysisRunner::Worker : public Thread
+{
+public:
+    Worker(BatchAnalysisRunner *runner) : m_runner(runner) { }
+
+protected:
+    void run() override {
+        while (true) {
+            int index = 0;
+            {
+                QMutexLocker locker(&m_runner->m_mutex);
+                if (m_runner->m_nextPath >= m_runner->m_paths.size()) {
+                    return;
+                }
+                index = m_runner->m_nextPath++;
+            }
+            m_runner->processFile(index);
+        }
+    }
+
+private:
+    BatchAnalysisRunner *m_runner;
+};
+
+BatchAnalysisRunner::BatchAnalysisRunner(FeatureWriter *writer) :
+    m_writer(writer),
+    m_workerCount(0),
+    m_sampleRate(0),
+    m_nextPath(0),
+    m_inProgress(0)
+{
+}
+
+BatchAnalysisRunner::~BatchAnalysisRunner()
+{
+}
+
+void
+BatchAnalysisRunner::setWorkerCount(int count)
+{
+    m_workerCount = (count < 0 ? 0 : count);
+}
+
+void
+BatchAnalysisRunner::setSampleRate(sv_samplerate_t rate)
+{
+    m_sampleRate = (rate < 0 ? 0 : rate);
+}
+
+double
+BatchAnalysisRunner::FileReport::getRealTimeFactor() const
+{
+    if (totalMsec <= 0 || sampleRate <= 0) {
+        return 0.0;
+    }
+    return (double(frameCount) / sampleRate) / (double(totalMsec) / 1000.0);
+}
+
+std::vector<BatchAnalysisRunner::FileReport>
+BatchAnalysisRunner::run(const QStringList &paths,
+                         const Transforms &transforms)
+{
+    m_paths = paths;
+    m_transforms = transforms;
+    m_reports = std::vector<FileReport>(paths.size());
+    m_nextPath = 0;
+    m_inProgress = 0;
+
+    int count = m_workerCount;
+    if (count == 0) {
+        count = QThread::idealThreadCount();
+    }
+    if (count > paths.size()) {
+        count = paths.size();
+    }
+    if (count < 1) {
+        count = 1;
+    }
+
+    SVDEBUG << "BatchAnalysisRunner::run: " << paths.size() << " file(s), "
+            << transforms.size() << " transform(s), " << count
+            << " worker(s)" << endl;
+
+    // ModelTransformerFactory learns that a transformer has finished
+    // (and so deletes it and calls us back with any additional
+    // models) through a queued signal, which needs the main thread's
+    // event loop. If we are on the main thread, nobody else is
+    // running that, so we process its events while we wait
+    QCoreApplication *app = QCoreApplication::instance();
+    bool onMainThread = (app && QThread::currentThread() == app->thread());
+    auto idle = [&]() {
+                    if (onMainThread) {
+                        QCoreApplication::processEvents();
+                    }
+                    QThread::msleep(50);
+                };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < count; ++i) {
+        workers.emplace_back(new Worker(this));
+        workers.back()->start();
+    }
+    for (auto &w: workers) {
+        while (!w->wait(50)) {
+            if (onMainThread) {
+                QCoreApplication::processEvents();
+            }
+        }
+    }
+
+    while (ModelTransformerFactory::getInstance()->haveRunningTransformers()) {
+        idle();
+    }
+
+    std::vector<FileReport> reports;
+    reports.swap(m_reports);
+    m_paths.clear();
+    m_transforms.clear();
+    return reports;
+}
+
+void
+BatchAnalysisRunner::processFile(int index)
+{
+    FileReport &report = m_reports[index];
+    report.path = m_paths[index];
+    report.ok = false;
+    report.sampleRate = 0;
+    report.channelCount = 0;
+    report.frameCount = 0;
+    report.featureCount = 0;
+    report.waitMsec = 0;
+    report.decodeMsec = 0;
+    report.analysisMsec = 0;
+    report.writeMsec = 0;
+    report.totalMsec = 0;
+
+    FileSource source(report.path);
+    if (!source.isAvailable()) {
+        report.message = QString("File \"%1\" not found").arg(report.path);
+        return;
+    }
+    source.waitForData();
+    if (!source.isOK()) {
+        report.message = source.getErrorString();
+        return;
+    }
+
+    // The estimate is in samples across all channels, and we hold
+    // decoded audio as floats
+    size_t kilobytes = size_t(AudioFileSizeEstimator::estimate
+                              (source, m_sampleRate)) * sizeof(float) / 1024;
+
+    report.waitMsec = admit(kilobytes);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::shared_ptr<ReadOnlyWaveFileModel> model;
+    {
+        // The reader factory asks StorageAdviser whether to decode
+        // into memory, and must not count this file's own
+        // reservation against it. We hold the mutex meanwhile so
+        // that no other file is admitted into the gap
+        QMutexLocker locker(&m_mutex);
+        StorageAdviser::notifyDoneAllocation
+            (StorageAdviser::MemoryAllocation, kilobytes);
+        model = std::make_shared<ReadOnlyWaveFileModel>(source, m_sampleRate);
+        StorageAdviser::notifyPlannedAllocation
+            (StorageAdviser::MemoryAllocation, kilobytes);
+    }
+
+    if (!model->isOK()) {
+        report.message = QString("Failed to open \"%1\" as audio")
+            .arg(report.path);
+        discharge(kilobytes);
+        return;
+    }
+
+    // The model's update timer and the notification that its range
+    // cache is filled need an event loop, which this thread lacks
+    QCoreApplication *app = QCoreApplication::instance();
+    if (app) {
+        model->moveToThread(app->thread());
+    }
+
+    ModelId inputId = ModelById::add(model);
+    report.sampleRate = model->getSampleRate();
+    report.channelCount = model->getChannelCount();
+
+    QString message;
+    std::vector<ModelId> outputs =
+        ModelTransformerFactory::getInstance()->transformSharingInput
+        (m_transforms, ModelTransformer::Input(inputId), message, this);
+
+    report.message = message;
+
+    if (!outputs.empty()) {
+
+        // The transforms follow the decoder, so we just wait for
+        // them all to be complete, noting when decoding finishes. If
+        // they all stop without completing, they failed or were
+        // abandoned
+
+        bool decoded = false;
+        bool complete = false;
+        while (true) {
+            bool running = ModelTransformerFactory::getInstance()->
+                haveRunningTransformersFor(inputId);
+            if (!decoded && model->isFullyAvailable()) {
+                decoded = true;
+                report.decodeMsec = timer.elapsed();
+                // A reader decoding into memory has now registered
+                // its allocation itself, so our estimate can go
+                releaseReservation(kilobytes);
+                kilobytes = 0;
+            }
+            complete = true;
+            for (auto id: outputs) {
+                auto output = ModelById::get(id);
+                if (output && !output->isReady()) {
+                    complete = false;
+                    break;
+                }
+            }
+            if ((decoded && complete) || !running) {
+                break;
+            }
+            QThread::msleep(50);
+        }
+
+        report.analysisMsec = timer.elapsed();
+        report.frameCount = model->getEndFrame() - model->getStartFrame();
+
+        if (complete) {
+            QElapsedTimer writeTimer;
+            writeTimer.start();
+            report.featureCount = writeFeatures(index, outputs);
+            report.writeMsec = writeTimer.elapsed();
+            report.ok = (report.featureCount >= 0);
+        } else if (report.message == "") {
+            report.message = QString("Transforms failed or were abandoned");
+        }
+
+        for (auto id: outputs) {
+            if (ModelById::get(id)) {
+                ModelById::release(id);
+            }
+        }
+    }
+
+    // The model has to finish filling its range cache, which it does
+    // on the main thread, before it can be deleted here
+    while (model->isOK() && !model->isReady()) {
+        QThread::msleep(10);
+    }
+
+    ModelById::release(inputId);
+    model.reset();
+
+    discharge(kilobytes);
+
+    report.totalMsec = timer.elapsed();
+
+    SVDEBUG << "BatchAnalysisRunner: Finished \"" << report.path
+            << "\" in " << report.totalMsec << "ms (ok = " << report.ok
+            << ")" << endl;
+}
+
+int64_t
+BatchAnalysisRunner::admit(size_t kilobytes)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker locker(&m_mutex);
+
+    // A file always starts if nothing else is in progress, however
+    // large it is
+
+    while (m_inProgress > 0) {
+        bool fits = true;
+        try {
+            StorageAdviser::Recommendation recommendation =
+                StorageAdviser::recommend(StorageAdviser::SpeedCritical,
+                                          kilobytes, kilobytes);
+            fits = !(recommendation & StorageAdviser::UseDisc);
+        } catch (const std::exception &) {
+            fits = false;
+        }
+        if (fits) {
+            break;
+        }
+#ifdef DEBUG_BATCH_ANALYSIS_RUNNER
+        SVDEBUG << "BatchAnalysisRunner::admit: " << kilobytes
+                << "K will not fit in memory alongside " << m_inProgress
+                << " file(s) in progress, waiting" << endl;
+#endif
+        m_condition.wait(&m_mutex);
+    }
+
+    StorageAdviser::notifyPlannedAllocation
+        (StorageAdviser::MemoryAllocation, kilobytes);
+    ++m_inProgress;
+
+    return timer.elapsed();
+}
+
+void
+BatchAnalysisRunner::releaseReservation(size_t kilobytes)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StorageAdviser::notifyDoneAllocation
+        (StorageAdviser::MemoryAllocation, kilobytes);
+}
+
+void
+BatchAnalysisRunner::discharge(size_t kilobytes)
+{
+    QMutexLocker locker(&m_mutex);
+
+    StorageAdviser::notifyDoneAllocation
+        (StorageAdviser::MemoryAllocation, kilobytes);
+    --m_inProgress;
+
+    m_condition.wakeAll();
+}
+
+int64_t
+BatchAnalysisRunner::writeFeatures(int index,
+                                   const std::vector<ModelId> &outputs)
+{
+    // Writers are not thread-safe, and those writing several files to
+    // one stream expect each file's features together
+    QMutexLocker locker(&m_writerMutex);
+
+    FileReport &report = m_reports[index];
+    int64_t count = 0;
+
+    try {
+        m_writer->setNofM(index + 1, m_paths.size());
+
+        for (int i = 0; in_range_for(outputs, i); ++i) {
+
+            if (outputs[i].isNone() || !in_range_for(m_transforms, i)) {
+                continue;
+            }
+
+            const Transform &transform = m_transforms[i];
+
+            Vamp::Plugin::OutputDescriptor descriptor =
+                getDescriptor(transform, outputs[i]);
+            Vamp::Plugin::FeatureList features = getFeatures(outputs[i]);
+
+            for (int j = 0; in_range_for(features, j); j += writeChunkSize) {
+                int n = int(features.size()) - j;
+                if (n > writeChunkSize) n = writeChunkSize;
+                Vamp::Plugin::FeatureList chunk(features.begin() + j,
+                                                features.begin() + j + n);
+                m_writer->write(report.path, transform, descriptor, chunk);
+            }
+
+            count += features.size();
+        }
+
+        m_writer->flush();
+
+    } catch (const std::exception &e) {
+        SVCERR << "BatchAnalysisRunner: Failed to write features for \""
+               << report.path << "\": " << e.what() << endl;
+        report.message = e.what();
+        return -1;
+    }
+
+    return count;
+}
+
+template <typename M>
+static bool
+appendEvents(ModelId id, Vamp::Plugin::FeatureList &features)
+{
+    auto model = ModelById::getAs<M>(id);
+    if (!model) return false;
+
+    sv_samplerate_t rate = model->getSampleRate();
+
+    EventVector events = model->getAllEvents();
+    features.reserve(features.size() + events.size());
+
+    for (const auto &e: events) {
+        Vamp::Plugin::Feature f;
+        f.hasTimestamp = true;
+        f.timestamp =
+            RealTime::frame2RealTime(e.getFrame(), rate).toVampRealTime();
+        if (e.hasDuration()) {
+            f.hasDuration = true;
+            f.duration =
+                RealTime::frame2RealTime(e.getDuration(), rate).toVampRealTime();
+        }
+        if (e.hasValue()) {
+            f.values.push_back(e.getValue());
+        }
+        if (e.hasLevel()) {
+            f.values.push_back(e.getLevel());
+        }
+        f.label = e.getLabel().toStdString();
+        features.push_back(f);
+    }
+
+    return true;
+}
+
+Vamp::Plugin::FeatureList
+BatchAnalysisRunner::getFeatures(ModelId id)
+{
+    Vamp::Plugin::FeatureList features;
+
+    if (auto dense = ModelById::getAs<DenseThreeDimensionalModel>(id)) {
+        sv_samplerate_t rate = dense->getSampleRate();
+        int width = dense->getWidth();
+        features.reserve(width);
+        for (int x = 0; x < width; ++x) {
+            Vamp::Plugin::Feature f;
+            f.hasTimestamp = true;
+            f.timestamp = RealTime::frame2RealTime
+                (dense->getStartFrame() + sv_frame_t(x) * dense->getResolution(),
+                 rate).toVampRealTime();
+            auto column = dense->getColumn(x);
+            f.values.insert(f.values.end(), column.begin(), column.end());
+            features.push_back(f);
+        }
+        return features;
+    }
+
+    (void)
+        (appendEvents<SparseOneDimensionalModel>(id, features) ||
+         appendEvents<SparseTimeValueModel>(id, features) ||
+         appendEvents<NoteModel>(id, features) ||
+         appendEvents<RegionModel>(id, features));
+
+    return features;
+}
+
+Vamp::Plugin::OutputDescriptor
+BatchAnalysisRunner::getDescriptor(const Transform &transform, ModelId id)
+{
+    // Writers identify the output by transform; the descriptor only
+    // describes the features' shape, as far as the model tells us
+
+    Vamp::Plugin::OutputDescriptor d;
+    d.identifier = transform.getOutput().toStdString();
+    d.name = d.identifier;
+    d.sampleType = Vamp::Plugin::OutputDescriptor::VariableSampleRate;
+    d.sampleRate = 0;
+    d.hasDuration = (ModelById::isa<NoteModel>(id) ||
+                     ModelById::isa<RegionModel>(id));
+
+    if (auto dense = ModelById::getAs<DenseThreeDimensionalModel>(id)) {
+        d.hasFixedBinCount = true;
+        d.binCount = dense->getHeight();
+        for (int i = 0; i < dense->getHeight(); ++i) {
+            d.binNames.push_back(dense->getBinName(i).toStdString());
+        }
+    } else if (ModelById::isa<SparseOneDimensionalModel>(id)) {
+        d.hasFixedBinCount = true;
+        d.binCount = 0;
+    } else {
+        d.hasFixedBinCount = false;
+    }
+
+    return d;
+}
+
+void
+BatchAnalysisRunner::moreModelsAvailable(std::vector<ModelId> models)
+{
+    // We don't write additional models, so just let them go
+    for (auto id: models) {
+        if (ModelById::get(id)) {
+            ModelById::release(id);
+        }
+    }
+}
+
+void
+BatchAnalysisRunner::noMoreModelsAvailable()
+{
+}
+
+QString
+BatchAnalysisRunner::formatReports(const std::vector<FileReport> &reports)
+{
+    QStringList lines;
+
+    auto seconds = [](int64_t msec) {
+                       return QString("%1").arg(double(msec) / 1000.0,
+                                                8, 'f', 2);
+                   };
+
+    lines.push_back(QString("%1 %2 %3 %4 %5 %6 %7 %8  %9")
+                    .arg("audio(s)", 8)
+                    .arg("wait(s)", 8)
+                    .arg("decode(s)", 9)
+                    .arg("analyse(s)", 10)
+                    .arg("write(s)", 8)
+                    .arg("total(s)", 8)
+                    .arg("x-real", 7)
+                    .arg("features", 9)
+                    .arg("file"));
+
+    int succeeded = 0;
+    double audioSec = 0.0;
+    int64_t totalMsec = 0;
+    int64_t features = 0;
+
+    for (const auto &r: reports) {
+
+        double duration = 0.0;
+        if (r.sampleRate > 0) {
+            duration = double(r.frameCount) / r.sampleRate;
+        }
+
+        QString line = QString("%1 %2 %3 %4 %5 %6 %7 %8  %9")
+            .arg(duration, 8, 'f', 2)
+            .arg(seconds(r.waitMsec))
+            .arg(seconds(r.decodeMsec), 9)
+            .arg(seconds(r.analysisMsec), 10)
+            .arg(seconds(r.writeMsec))
+            .arg(seconds(r.totalMsec))
+            .arg(r.getRealTimeFactor(), 7, 'f', 1)
+            .arg(r.featureCount, 9)
+            .arg(r.path);
+        if (!r.ok) {
+            line += QString(" (failed: %1)").arg(r.message);
+        } else if (r.message != "") {
+            line += QString(" (%1)").arg(r.message);
+        }
+        lines.push_back(line);
+
+        if (r.ok) {
+            ++succeeded;
+            audioSec += duration;
+            totalMsec += r.totalMsec;
+            features += r.featureCount;
+        }
+    }
+
+    lines.push_back(QString("%1 of %2 file(s) analysed: %3s of audio, "
+                            "%4 features, %5s of per-file processing "
+                            "time (%6x real time per file)")
+                    .arg(succeeded)
+                    .arg(reports.size())
+                    .arg(audioSec, 0, 'f', 2)
+                    .arg(features)
+                    .arg(double(totalMsec) / 1000.0, 0, 'f', 2)
+                    .arg(totalMsec > 0 ?
+                         audioSec / (double(totalMsec) / 1000.0) : 0.0,
+                         0, 'f', 1));
+
+    return lines.join("\n");
+}
@@ -0,0 +1,166 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_BATCH_ANALYSIS_RUNNER_H
+#define SV_BATCH_ANALYSIS_RUNNER_H
+
+#include "Transform.h"
+#include "ModelTransformerFactory.h"
+
+#include "data/model/Model.h"
+
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vamp-hostsdk/Plugin.h>
+
+#include <vector>
+#include <cstdint>
+
+class FeatureWriter;
+
+/**
+ * Apply a set of feature extraction transforms to each of a list of
+ * audio files without a GUI, writing the results through a
+ * FeatureWriter.
+ *
+ * Several files are in progress at once, each on a worker thread of
+ * its own. A file is decoded into a ReadOnlyWaveFileModel, the
+ * transforms are applied to it together through
+ * ModelTransformerFactory::transformSharingInput (so they follow the
+ * decoder rather than waiting for it, and are subject to the
+ * TransformerScheduler's limit on how many run at once), and once
+ * they are complete their output models are written to the writer
+ * and released.
+ *
+ * Before starting a file, a worker estimates how much memory the
+ * decoded audio will need, and if StorageAdviser advises that it
+ * will not fit in memory alongside the files already in progress,
+ * waits for one of those to finish first. The estimate is registered
+ * with StorageAdviser until the file is decoded (when a decoder that
+ * kept its audio in memory registers that itself), so that decoders
+ * asking it where to keep their audio take the other files into
+ * account. A file's own estimate is withdrawn while its decoder asks.
+ *
+ * The features written are those held in the output models, so a
+ * feature's timestamp is the frame the model records, and its values
+ * are the event's value and level, or the column of a dense model.
+ * Additional output models (for plugins with unknown bin counts) are
+ * not written.
+ *
+ * run() should be called from the application's main thread, which
+ * it uses to process the events through which the transformer factory
+ * learns that transformers have finished.
+ */
+class BatchAnalysisRunner : public ModelTransformerFactory::AdditionalModelHandler
+{
+public:
+    /**
+     * Construct a runner writing to the given writer, which should
+     * already have its parameters set. The writer is not owned by
+     * the runner.
+     */
+    BatchAnalysisRunner(FeatureWriter *writer);
+    virtual ~BatchAnalysisRunner();
+
+    /**
+     * Set the number of files that may be in progress at once. If
+     * zero (the default), the number of processor cores is used.
+     */
+    void setWorkerCount(int count);
+
+    /**
+     * Set the sample rate to decode each file at. If zero (the
+     * default), each file is decoded at its own rate.
+     */
+    void setSampleRate(sv_samplerate_t rate);
+
+    struct FileReport {
+        QString path;
+        bool ok;
+        QString message;
+        sv_samplerate_t sampleRate;
+        int channelCount;
+        sv_frame_t frameCount;
+        int64_t featureCount;
+        /// Time spent waiting for memory to start the file
+        int64_t waitMsec;
+        /// Time from starting the file until decoding was complete
+        int64_t decodeMsec;
+        /// Time from starting the file until the transforms were complete
+        int64_t analysisMsec;
+        /// Time spent writing the features
+        int64_t writeMsec;
+        /// Total time from starting the file until it was written
+        int64_t totalMsec;
+
+        /**
+         * Return the duration of the audio divided by the total time
+         * taken, i.e. the multiple of real-time speed achieved.
+         */
+        double getRealTimeFactor() const;
+    };
+
+    /**
+     * Apply the given transforms to each of the given files in turn,
+     * returning a report for each file in the order given. Call
+     * finish() on the writer afterwards.
+     */
+    std::vector<FileReport> run(const QStringList &paths,
+                                const Transforms &transforms);
+
+    /**
+     * Format the given reports as a table, with one line per file
+     * and a summary line.
+     */
+    static QString formatReports(const std::vector<FileReport> &reports);
+
+    // AdditionalModelHandler methods
+    void moreModelsAvailable(std::vector<ModelId> models) override;
+    void noMoreModelsAvailable() override;
+
+private:
+    class Worker;
+    friend class Worker;
+
+    FeatureWriter *m_writer;
+    int m_workerCount;
+    sv_samplerate_t m_sampleRate;
+
+    // Set for the duration of a run
+    QStringList m_paths;
+    Transforms m_transforms;
+    std::vector<FileReport> m_reports;
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    int m_nextPath;
+    int m_inProgress;
+
+    QMutex m_writerMutex;
+
+    void processFile(int index);
+    int64_t admit(size_t kilobytes);
+    void releaseReservation(size_t kilobytes);
+    void discharge(size_t kilobytes);
+    int64_t writeFeatures(int index, const std::vector<ModelId> &outputs);
+
+    static Vamp::Plugin::FeatureList getFeatures(ModelId model);
+    static Vamp::Plugin::OutputDescriptor getDescriptor(const Transform &,
+                                                        ModelId model);
+};
+
+#endif
@@ -0,0 +1,795 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FeatureExtractionFanOutModelTransformer.h"
+#include "FeatureExtractionModelTransformer.h"
+#include "TransformerScheduler.h"
+#include "TransformResultCache.h"
+
+#include "data/model/DenseTimeValueModel.h"
+#include "data/model/FFTModel.h"
+#include "data/model/FFTModelRegistry.h"
+#include "base/Debug.h"
+#include "system/System.h"
+
+#include <QThread>
+#include <QStringList>
+
+#include <memory>
+
+//#define DEBUG_FAN_OUT_TRANSFORMER 1
+
+/**
+ * A worker runs the plugins of the members assigned to it, taking
+ * each batch in turn as the driver (the transformer's own run
+ * thread) posts it.
+ */
+class FeatureExtractionFanOutModelTransformer::Worker : public Thread
+{
+public:
+    Worker(FeatureExtractionFanOutModelTransformer *transformer, int index) :
+        m_transformer(transformer), m_index(index) { }
+
+protected:
+    void run() override {
+
+        auto t = m_transformer;
+        int seen = 0;
+
+        while (true) {
+
+            const Batch *batch = nullptr;
+            {
+                QMutexLocker locker(&t->m_batchMutex);
+                while (t->m_generation == seen) {
+                    t->m_batchPosted.wait(&t->m_batchMutex);
+                }
+                seen = t->m_generation;
+                batch = &t->m_batches[seen % 2];
+            }
+
+            for (auto &member: t->m_members) {
+                if (member.worker == m_index) {
+                    t->processMember(member, *batch);
+                }
+            }
+
+            bool quit = (batch->type == Batch::Quit);
+            {
+                QMutexLocker locker(&t->m_batchMutex);
+                if (--t->m_busyWorkers == 0) {
+                    t->m_batchDone.wakeAll();
+                }
+            }
+            if (quit) {
+                return;
+            }
+        }
+    }
+
+private:
+    FeatureExtractionFanOutModelTransformer *m_transformer;
+    int m_index;
+};
+
+FeatureExtractionFanOutModelTransformer::FeatureExtractionFanOutModelTransformer
+(Input in, const Transforms &transforms, int workerCount) :
+    ModelTransformer(in, transforms),
+    m_workerCount(0),
+    m_sampleRate(0),
+    m_generation(0),
+    m_busyWorkers(0),
+    m_haveOutputs(false)
+{
+    // Transforms differing only in plugin output share a plugin
+
+    for (const auto &transformNos: groupSimilarTransforms(m_transforms)) {
+        Member member;
+        member.transformer = nullptr;
+        member.transformNos = transformNos;
+        member.worker = 0;
+        member.pass = -1;
+        member.ok = false;
+        member.frequencyDomain = false;
+        member.channelCount = 0;
+        m_members.push_back(member);
+    }
+
+    if (workerCount <= 0) {
+        workerCount = QThread::idealThreadCount();
+    }
+    if (workerCount > int(m_members.size())) {
+        workerCount = int(m_members.size());
+    }
+    if (workerCount < 1) {
+        workerCount = 1;
+    }
+    m_workerCount = workerCount;
+
+    for (int i = 0; in_range_for(m_members, i); ++i) {
+        Transforms tt;
+        for (int n: m_members[i].transformNos) {
+            tt.push_back(m_transforms[n]);
+        }
+        m_members[i].transformer = new FeatureExtractionModelTransformer(in, tt);
+        m_members[i].worker = i % m_workerCount;
+    }
+
+    SVDEBUG << "FeatureExtractionFanOutModelTransformer: " << transforms.size()
+            << " transform(s) using " << m_members.size()
+            << " plugin(s) on " << m_workerCount << " worker(s)" << endl;
+}
+
+FeatureExtractionFanOutModelTransformer::~FeatureExtractionFanOutModelTransformer()
+{
+    // The run thread deletes the workers before it exits, and the
+    // workers have destroyed their plugins by then. Wait for it here
+    // rather than in the parent class dtor, as the members are about
+    // to go
+    m_abandoned = true;
+    wait();
+
+    for (auto &member: m_members) {
+        delete member.transformer;
+    }
+}
+
+std::vector<std::vector<int>>
+FeatureExtractionFanOutModelTransformer::groupSimilarTransforms
+(const Transforms &transforms)
+{
+    std::vector<std::vector<int>> groups;
+    for (int i = 0; in_range_for(transforms, i); ++i) {
+        bool found = false;
+        for (auto &group: groups) {
+            if (FeatureExtractionModelTransformer::areTransformsSimilar
+                (transforms[group[0]], transforms[i])) {
+                group.push_back(i);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            groups.push_back({ i });
+        }
+    }
+    return groups;
+}
+
+std::vector<int>
+FeatureExtractionFanOutModelTransformer::groupIntoPasses
+(const std::vector<PassProperties> &plugins)
+{
+    std::vector<int> passes(plugins.size(), -1);
+    std::vector<int> firsts; // plugin index of first in each pass
+
+    for (int i = 0; in_range_for(plugins, i); ++i) {
+        const PassProperties &plugin = plugins[i];
+        const Transform &transform = plugin.transform;
+        for (int p = 0; in_range_for(firsts, p); ++p) {
+            const PassProperties &pass = plugins[firsts[p]];
+            if (pass.frequencyDomain == plugin.frequencyDomain &&
+                pass.channelCount == plugin.channelCount &&
+                pass.transform.getBlockSize() == transform.getBlockSize() &&
+                pass.transform.getStepSize() == transform.getStepSize() &&
+                pass.transform.getStartTime() == transform.getStartTime() &&
+                pass.transform.getDuration() == transform.getDuration() &&
+                (!plugin.frequencyDomain ||
+                 pass.transform.getWindowType() == transform.getWindowType())) {
+                passes[i] = p;
+                break;
+            }
+        }
+        if (passes[i] < 0) {
+            passes[i] = int(firsts.size());
+            firsts.push_back(i);
+        }
+    }
+
+    return passes;
+}
+
+FeatureExtractionFanOutModelTransformer::Models
+FeatureExtractionFanOutModelTransformer::orderOutputs
+(int transformCount,
+ const std::vector<std::vector<int>> &transformNos,
+ const std::vector<Models> &outputs)
+{
+    Models ordered(transformCount);
+    for (int i = 0; in_range_for(transformNos, i); ++i) {
+        if (!in_range_for(outputs, i)) break;
+        for (int j = 0; in_range_for(transformNos[i], j); ++j) {
+            int n = transformNos[i][j];
+            if (in_range_for(outputs[i], j) && in_range_for(ordered, n)) {
+                ordered[n] = outputs[i][j];
+            }
+        }
+    }
+    return ordered;
+}
+
+void
+FeatureExtractionFanOutModelTransformer::awaitOutputModels()
+{
+    m_outputMutex.lock();
+    while (!m_haveOutputs && !m_abandoned) {
+        m_outputsCondition.wait(&m_outputMutex, 500);
+    }
+    m_outputMutex.unlock();
+}
+
+FeatureExtractionFanOutModelTransformer::Models
+FeatureExtractionFanOutModelTransformer::getAdditionalOutputModels()
+{
+    Models mm;
+    for (auto &member: m_members) {
+        if (!member.ok) continue;
+        for (auto m: member.transformer->getAdditionalOutputModels()) {
+            mm.push_back(m);
+        }
+    }
+    return mm;
+}
+
+bool
+FeatureExtractionFanOutModelTransformer::willHaveAdditionalOutputModels()
+{
+    for (auto &member: m_members) {
+        if (member.ok &&
+            member.transformer->willHaveAdditionalOutputModels()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+FeatureExtractionFanOutModelTransformer::processMember(Member &member,
+                                                       const Batch &batch)
+{
+    auto t = member.transformer;
+    int outputCount = int(t->m_transforms.size());
+
+    try {
+        switch (batch.type) {
+
+        case Batch::Initialise:
+            member.ok = t->initialise();
+            if (member.ok) {
+                member.frequencyDomain = (t->m_plugin->getInputDomain() ==
+                                          Vamp::Plugin::FrequencyDomain);
+                auto input = ModelById::getAs<DenseTimeValueModel>
+                    (getInputModel());
+                member.channelCount = input ? input->getChannelCount() : 1;
+                if ((int)t->m_plugin->getMaxChannelCount() <
+                    member.channelCount) {
+                    member.channelCount = 1;
+                }
+            } else {
+                t->deinitialise();
+            }
+            break;
+
+        case Batch::Process:
+            if (!member.ok || member.pass != batch.pass || t->isAbandoned()) {
+                break;
+            }
+            for (int b = 0; in_range_for(batch.frames, b); ++b) {
+                t->processBlock(batch.buffers.data() + b * member.channelCount,
+                                batch.frames[b], m_sampleRate);
+                if (t->isAbandoned()) {
+                    break;
+                }
+            }
+            for (int j = 0; j < outputCount; ++j) {
+                t->setCompletion(j, batch.completion);
+            }
+            break;
+
+        case Batch::Finish:
+            if (!member.ok || member.pass != batch.pass) {
+                break;
+            }
+            if (!t->isAbandoned()) {
+                t->processRemaining(batch.finalFrame);
+            }
+            for (int j = 0; j < outputCount; ++j) {
+                t->setCompletion(j, 100);
+            }
+            break;
+
+        case Batch::Quit:
+            if (member.ok) {
+                for (int j = 0; j < outputCount; ++j) {
+                    t->setCompletion(j, 100);
+                }
+                t->deinitialise();
+            }
+            break;
+        }
+
+    } catch (const std::exception &e) {
+        SVCERR << "FeatureExtractionFanOutModelTransformer::processMember: Exception caught: " << e.what() << endl;
+        t->abandon();
+        t->m_message = e.what();
+        if (batch.type == Batch::Initialise) {
+            member.ok = false;
+            t->deinitialise();
+        }
+    }
+}
+
+void
+FeatureExtractionFanOutModelTransformer::postBatch(int generation)
+{
+    QMutexLocker locker(&m_batchMutex);
+    while (m_busyWorkers > 0) {
+        m_batchDone.wait(&m_batchMutex);
+    }
+    m_busyWorkers = int(m_workers.size());
+    m_generation = generation;
+    m_batchPosted.wakeAll();
+}
+
+void
+FeatureExtractionFanOutModelTransformer::awaitWorkers()
+{
+    QMutexLocker locker(&m_batchMutex);
+    while (m_busyWorkers > 0) {
+        m_batchDone.wait(&m_batchMutex);
+    }
+}
+
+bool
+FeatureExtractionFanOutModelTransformer::checkModels(const Pass &pass)
+{
+    if (!m_inputHandle.isLive()) {
+#ifdef DEBUG_FAN_OUT_TRANSFORMER
+        SVDEBUG << "FeatureExtractionFanOutModelTransformer: Input model "
+                << getInputModel() << " no longer exists" << endl;
+#endif
+        abandon();
+        return false;
+    }
+
+    // A plugin whose output models have gone is abandoned, but the
+    // others carry on
+
+    bool any = false;
+    for (int m: pass.members) {
+        auto t = m_members[m].transformer;
+        if (t->isAbandoned()) continue;
+        for (const auto &h: m_members[m].outputHandles) {
+            if (!h.isLive()) {
+#ifdef DEBUG_FAN_OUT_TRANSFORMER
+                SVDEBUG << "FeatureExtractionFanOutModelTransformer: Output model #" << h.getUntypedId() << " no longer exists" << endl;
+#endif
+                t->abandon();
+                break;
+            }
+        }
+        if (!t->isAbandoned()) {
+            any = true;
+        }
+    }
+    return any;
+}
+
+void
+FeatureExtractionFanOutModelTransformer::runPass(int p)
+{
+    const Pass &pass = m_passes[p];
+    const Transform &transform = pass.transform;
+
+    int stepSize = transform.getStepSize();
+    int blockSize = transform.getBlockSize();
+    int channelCount = pass.channelCount;
+    bool frequencyDomain = pass.frequencyDomain;
+
+    sv_frame_t startFrame, endFrame;
+    bool inputComplete;
+    {
+        auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
+        if (!input) {
+            abandon();
+            return;
+        }
+        startFrame = input->getStartFrame();
+        inputComplete = input->isFullyAvailable();
+        endFrame = input->getEndFrame();
+    }
+
+    sv_frame_t contextStart =
+        RealTime::realTime2Frame(transform.getStartTime(), m_sampleRate);
+    sv_frame_t requestedDuration =
+        RealTime::realTime2Frame(transform.getDuration(), m_sampleRate);
+
+    if (contextStart == 0 || contextStart < startFrame) {
+        contextStart = startFrame;
+    }
+
+    // Provisional until the input is complete, as in
+    // FeatureExtractionModelTransformer::run
+    sv_frame_t contextDuration = 0;
+    auto updateContextDuration = [&]() {
+                                     contextDuration = requestedDuration;
+                                     if (contextDuration == 0 ||
+                                         contextStart + contextDuration > endFrame) {
+                                         contextDuration = endFrame - contextStart;
+                                     }
+                                 };
+    updateContextDuration();
+
+#ifdef DEBUG_FAN_OUT_TRANSFORMER
+    SVDEBUG << "FeatureExtractionFanOutModelTransformer: Pass " << p
+            << " with " << pass.members.size() << " plugin(s), block "
+            << blockSize << ", step " << stepSize << ", frequency domain "
+            << frequencyDomain << endl;
+#endif
+
+    auto abandonPass = [&](QString error) {
+                           for (int m: pass.members) {
+                               m_members[m].transformer->abandon();
+                               m_members[m].transformer->m_message = error;
+                           }
+                       };
+
+    std::vector<ModelId> fftModelIds;
+    std::vector<std::shared_ptr<FFTModel>> fftModels;
+    std::vector<float> reals, imaginaries;
+
+    bool done = false;
+
+    if (frequencyDomain) {
+        reals.resize(blockSize/2 + 1);
+        imaginaries.resize(blockSize/2 + 1);
+        for (int ch = 0; ch < channelCount; ++ch) {
+            QString err;
+            ModelId fftModelId = FFTModelRegistry::getInstance()->acquire
+                (getInputModel(),
+                 channelCount == 1 ? m_input.getChannel() : ch,
+                 transform.getWindowType(),
+                 blockSize,
+                 stepSize,
+                 blockSize,
+                 &err);
+            auto model = ModelById::getAs<FFTModel>(fftModelId);
+            if (!model) {
+                SVDEBUG << "FeatureExtractionFanOutModelTransformer: Failed to create FFT model for input model " << getInputModel() << ": " << err << endl;
+                abandonPass("Failed to create the FFT model for this feature extraction model transformer: error is: " + err);
+                done = true;
+                break;
+            }
+            fftModelIds.push_back(fftModelId);
+            fftModels.push_back(model);
+        }
+    }
+
+    auto reader = m_members[pass.members[0]].transformer;
+    std::vector<float *> into(channelCount, nullptr);
+
+    // A frequency-domain batch holds a separate buffer for each block
+    // and channel. A time-domain batch holds one contiguous run of
+    // frames for each channel, block b starting b * stepSize frames
+    // into it, so that the overlap between blocks is read only once.
+    // At the start of a batch, the overlap with the last block of the
+    // previous one is copied from there rather than read again
+
+    const int batchBlocks = 32;
+    int blockStride = (frequencyDomain ? blockSize + 2 : stepSize);
+    int span = (frequencyDomain ?
+                batchBlocks * blockStride :
+                (batchBlocks - 1) * stepSize + blockSize);
+
+    const Batch *previous = nullptr;
+    sv_frame_t previousStart = 0;
+    int previousHeld = 0;
+    int held = 0; // frames at the start of each channel's run
+
+    sv_frame_t blockFrame = contextStart;
+
+    while (!done && !m_abandoned) {
+
+        // Fill the batch that is not in use by the workers while they
+        // process the one last posted
+
+        int generation = m_generation + 1;
+        Batch &batch = m_batches[generation % 2];
+        batch.type = Batch::Process;
+        batch.pass = p;
+        batch.frames.clear();
+        batch.data.resize(size_t(channelCount) * span);
+        batch.buffers.resize(size_t(batchBlocks) * channelCount);
+        held = 0;
+
+        while (int(batch.frames.size()) < batchBlocks) {
+
+            if (!inputComplete) {
+                sv_frame_t need = blockFrame +
+                    (frequencyDomain ? blockSize/2 : blockSize);
+                auto input = awaitInputAvailable(need) ?
+                    ModelById::getAs<DenseTimeValueModel>(getInputModel()) :
+                    nullptr;
+                if (!input) {
+                    abandon();
+                    done = true;
+                    break;
+                }
+                inputComplete = input->isFullyAvailable();
+                endFrame = input->getEndFrame();
+                updateContextDuration();
+            }
+
+            if (frequencyDomain) {
+                if (blockFrame - int(blockSize)/2 >
+                    contextStart + contextDuration) {
+                    done = true;
+                    break;
+                }
+            } else {
+                if (blockFrame >= contextStart + contextDuration) {
+                    done = true;
+                    break;
+                }
+            }
+
+            int b = int(batch.frames.size());
+            for (int ch = 0; ch < channelCount; ++ch) {
+                batch.buffers[b * channelCount + ch] =
+                    batch.data.data() + ch * span + b * blockStride;
+            }
+
+            if (frequencyDomain) {
+                int column = int((blockFrame - startFrame) / stepSize);
+                for (int ch = 0; ch < channelCount; ++ch) {
+                    float *buffer = batch.buffers[b * channelCount + ch];
+                    bool have = fftModels[ch]->getValuesAt
+                        (column, reals.data(), imaginaries.data());
+                    for (int i = 0; i <= blockSize/2; ++i) {
+                        buffer[i*2] = have ? reals[i] : 0.f;
+                        buffer[i*2+1] = have ? imaginaries[i] : 0.f;
+                    }
+                    QString error = fftModels[ch]->getError();
+                    if (error != "") {
+                        SVCERR << "FeatureExtractionFanOutModelTransformer: Abandoning pass, error is " << error << endl;
+                        abandonPass(error);
+                        done = true;
+                        break;
+                    }
+                }
+                if (done) break;
+            } else {
+                int offset = b * stepSize;
+                if (b == 0 && previous &&
+                    blockFrame >= previousStart &&
+                    blockFrame < previousStart + previousHeld) {
+                    int from = int(blockFrame - previousStart);
+                    held = previousHeld - from;
+                    for (int ch = 0; ch < channelCount; ++ch) {
+                        const float *source =
+                            previous->data.data() + ch * span + from;
+                        std::copy(source, source + held,
+                                  batch.data.data() + ch * span);
+                    }
+                }
+                if (held < offset) {
+                    held = offset;
+                }
+                if (held < offset + blockSize) {
+                    for (int ch = 0; ch < channelCount; ++ch) {
+                        into[ch] = batch.data.data() + ch * span + held;
+                    }
+                    reader->getFrames(channelCount,
+                                      blockFrame - offset + held,
+                                      offset + blockSize - held,
+                                      into.data());
+                    held = offset + blockSize;
+                }
+            }
+
+            batch.frames.push_back(blockFrame);
+            blockFrame += stepSize;
+        }
+
+        if (!batch.frames.empty()) {
+            batch.completion = int
+                ((((batch.frames.back() - contextStart) / stepSize) * 99) /
+                 (contextDuration / stepSize + 1));
+            postBatch(generation);
+            previous = &batch;
+            previousStart = batch.frames[0];
+            previousHeld = held;
+        }
+
+        if (!checkModels(pass)) {
+            done = true;
+        }
+    }
+
+    int generation = m_generation + 1;
+    Batch &batch = m_batches[generation % 2];
+    batch.type = Batch::Finish;
+    batch.pass = p;
+    batch.frames.clear();
+    batch.finalFrame = blockFrame;
+    postBatch(generation);
+
+    fftModels.clear();
+    for (auto id: fftModelIds) {
+        FFTModelRegistry::getInstance()->release(id);
+    }
+}
+
+void
+FeatureExtractionFanOutModelTransformer::run()
+{
+    if (m_members.empty()) {
+        abandon();
+        return;
+    }
+
+    ModelId inputId = getInputModel();
+
+    // As in FeatureExtractionModelTransformer, we don't wait for the
+    // input to be ready, but follow it within each pass as it arrives
+    {
+        auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
+        if (!input || !input->isOK()) {
+            abandon();
+            return;
+        }
+        m_sampleRate = input->getSampleRate();
+    }
+
+    for (int i = 0; i < m_workerCount; ++i) {
+        m_workers.push_back(new Worker(this, i));
+        m_workers[i]->start();
+    }
+
+    int generation = m_generation + 1;
+    m_batches[generation % 2].type = Batch::Initialise;
+    postBatch(generation);
+    awaitWorkers();
+
+    // Gather the outputs, in order of transform
+
+    m_inputHandle = ModelById::getHandle<DenseTimeValueModel>(getInputModel());
+
+    QStringList messages;
+    bool any = false;
+    std::vector<std::vector<int>> transformNos;
+    std::vector<Models> outputs;
+
+    for (int i = 0; in_range_for(m_members, i); ++i) {
+
+        Member &member = m_members[i];
+        auto t = member.transformer;
+
+        transformNos.push_back(member.transformNos);
+        outputs.push_back({});
+
+        if (t->getMessage() != "") {
+            messages.push_back(t->getMessage());
+        }
+        if (!member.ok) {
+            continue;
+        }
+        any = true;
+
+        outputs[i] = t->m_outputs;
+        for (auto mid: t->m_outputs) {
+            member.outputHandles.push_back(ModelById::getHandle<Model>(mid));
+        }
+    }
+
+    m_outputs = orderOutputs(int(m_transforms.size()), transformNos, outputs);
+    m_message = messages.join("; ");
+
+    if (!any) {
+        m_outputs.clear();
+        abandon();
+    }
+
+    m_outputMutex.lock();
+    m_haveOutputs = true;
+    m_outputsCondition.wakeAll();
+    m_outputMutex.unlock();
+
+    // We take a single scheduler slot for all the passes, although
+    // we run plugins on several threads of our own. If we are
+    // abandoned while waiting for it, the loops below do nothing
+    TransformerScheduler::Slot slot(this);
+
+    // Restore from the result cache the outputs of any plugin whose
+    // results are all there, and group the rest into passes
+
+    auto cache = TransformResultCache::getInstance();
+    int restored = 0;
+
+    std::vector<int> toRun;
+    std::vector<PassProperties> properties;
+
+    for (int i = 0; in_range_for(m_members, i); ++i) {
+
+        if (m_abandoned) break;
+
+        Member &member = m_members[i];
+        auto t = member.transformer;
+        if (!member.ok) {
+            continue;
+        }
+
+        member.cacheKeys = t->getResultCacheKeys();
+        if (cache->restore(member.cacheKeys, t->m_outputs)) {
+            for (int j = 0; in_range_for(member.transformNos, j); ++j) {
+                t->setCompletion(j, 100);
+            }
+            member.cacheKeys.clear();
+            ++restored;
+            continue;
+        }
+
+        toRun.push_back(i);
+        properties.push_back({ t->m_transforms[0],
+                               member.frequencyDomain,
+                               member.channelCount });
+    }
+
+    std::vector<int> passNos = groupIntoPasses(properties);
+
+    for (int k = 0; in_range_for(toRun, k); ++k) {
+        Member &member = m_members[toRun[k]];
+        member.pass = passNos[k];
+        if (!in_range_for(m_passes, member.pass)) {
+            Pass pass;
+            pass.transform = properties[k].transform;
+            pass.frequencyDomain = properties[k].frequencyDomain;
+            pass.channelCount = properties[k].channelCount;
+            m_passes.push_back(pass);
+        }
+        m_passes[member.pass].members.push_back(toRun[k]);
+    }
+
+    if (!m_abandoned) {
+        SVDEBUG << "FeatureExtractionFanOutModelTransformer::run: Restored "
+                << restored << " plugin(s) from result cache, running "
+                << m_passes.size() << " pass(es)" << endl;
+    }
+
+    for (int p = 0; in_range_for(m_passes, p); ++p) {
+        if (m_abandoned) break;
+        runPass(p);
+    }
+
+    if (!m_abandoned) {
+        for (const auto &member: m_members) {
+            if (member.transformer->isAbandoned()) continue;
+            for (int j = 0; in_range_for(member.cacheKeys, j); ++j) {
+                cache->store(member.cacheKeys[j],
+                             member.transformer->m_outputs[j]);
+            }
+        }
+    }
+
+    generation = m_generation + 1;
+    m_batches[generation % 2].type = Batch::Quit;
+    postBatch(generation);
+    awaitWorkers();
+
+    for (auto w: m_workers) {
+        w->wait();
+        delete w;
+    }
+    m_workers.clear();
+}
@@ -0,0 +1,177 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_FEATURE_EXTRACTION_FAN_OUT_MODEL_TRANSFORMER_H
+#define SV_FEATURE_EXTRACTION_FAN_OUT_MODEL_TRANSFORMER_H
+
+#include "ModelTransformer.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vector>
+
+class FeatureExtractionModelTransformer;
+class DenseTimeValueModel;
+
+/**
+ * Run any number of feature extraction transforms, using any number
+ * of different plugins, over a single input model in one go.
+ *
+ * Transforms that could share a FeatureExtractionModelTransformer
+ * (differing only in plugin output) share a plugin instance. The
+ * plugins are then grouped into passes by input domain, block size,
+ * step size, window and extent. Each pass reads its input blocks once
+ * and, for frequency-domain plugins, calculates each FFT column
+ * once, and hands every block to all of the plugins in the pass.
+ *
+ * The plugins are run on a pool of worker threads, each plugin being
+ * constructed, used and destroyed on a single worker. Input is read
+ * in batches of blocks, and the next batch is read while the workers
+ * process the current one.
+ *
+ * If TransformResultCache is enabled, a plugin whose results are all
+ * in the cache is restored from there and not run, and the results
+ * of those that are run are stored in it.
+ *
+ * If some transforms cannot be initialised, the others go ahead, and
+ * getOutputModels() returns a none id for each transform that
+ * failed. If none can be initialised, no models are returned.
+ */
+class FeatureExtractionFanOutModelTransformer : public ModelTransformer
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Construct a transformer for the given transforms. The worker
+     * count is the number of threads to run plugins on; if zero, it
+     * is chosen from the number of processors available.
+     */
+    FeatureExtractionFanOutModelTransformer(Input input,
+                                            const Transforms &transforms,
+                                            int workerCount = 0);
+
+    virtual ~FeatureExtractionFanOutModelTransformer();
+
+    Models getAdditionalOutputModels() override;
+    bool willHaveAdditionalOutputModels() override;
+
+    /**
+     * Group the given transforms into those that can share a plugin
+     * instance, i.e. that differ only in plugin output. Return the
+     * indices of the transforms in each group, groups being in order
+     * of their first transform.
+     */
+    static std::vector<std::vector<int>>
+    groupSimilarTransforms(const Transforms &transforms);
+
+    /**
+     * The properties of an initialised plugin that decide which
+     * others it can share a pass with.
+     */
+    struct PassProperties {
+        Transform transform;
+        bool frequencyDomain;
+        int channelCount;
+    };
+
+    /**
+     * Group plugins with the given properties into passes. Plugins
+     * share a pass if they have the same input domain, channel count,
+     * block size, step size, start time and duration, and (for
+     * frequency-domain plugins) window type. Return the pass index of
+     * each plugin, passes being numbered in order of their first
+     * plugin.
+     */
+    static std::vector<int>
+    groupIntoPasses(const std::vector<PassProperties> &plugins);
+
+    /**
+     * Arrange the output models of a set of plugins in the order of
+     * the transforms they were made from. Plugin i was made from the
+     * transforms whose indices are in transformNos[i], and produced
+     * the models in outputs[i] in the same order, or none if it
+     * failed. Return transformCount models, with a none id for each
+     * transform whose plugin did not produce one.
+     */
+    static Models
+    orderOutputs(int transformCount,
+                 const std::vector<std::vector<int>> &transformNos,
+                 const std::vector<Models> &outputs);
+
+protected:
+    void run() override;
+    void awaitOutputModels() override;
+
+private:
+    class Worker;
+    friend class Worker;
+
+    struct Member {
+        FeatureExtractionModelTransformer *transformer;
+        std::vector<int> transformNos; // indices into m_transforms
+        int worker;
+        int pass;
+        bool ok;
+        bool frequencyDomain;
+        int channelCount;
+        std::vector<ByIdHandle<Model>> outputHandles;
+        std::vector<QString> cacheKeys; // to store results under
+    };
+
+    struct Pass {
+        Transform transform; // of the first member, as initialised
+        bool frequencyDomain;
+        int channelCount;
+        std::vector<int> members;
+    };
+
+    struct Batch {
+        enum Type { Initialise, Process, Finish, Quit };
+        Type type;
+        int pass;
+        std::vector<sv_frame_t> frames;
+        std::vector<float> data;
+        std::vector<float *> buffers; // block * channelCount + channel
+        int completion;
+        sv_frame_t finalFrame;
+    };
+
+    std::vector<Member> m_members;
+    std::vector<Pass> m_passes;
+    int m_workerCount;
+    std::vector<Worker *> m_workers;
+    ByIdHandle<DenseTimeValueModel> m_inputHandle;
+    sv_samplerate_t m_sampleRate;
+
+    QMutex m_batchMutex;
+    QWaitCondition m_batchPosted;
+    QWaitCondition m_batchDone;
+    Batch m_batches[2];
+    int m_generation;
+    int m_busyWorkers;
+
+    bool m_haveOutputs;
+    QMutex m_outputMutex;
+    QWaitCondition m_outputsCondition;
+
+    void processMember(Member &member, const Batch &batch);
+    void runPass(int pass);
+    void postBatch(int generation);
+    void awaitWorkers();
+    bool checkModels(const Pass &pass);
+};
+
+#endif
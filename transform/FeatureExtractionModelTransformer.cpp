@@ -23,6 +23,7 @@
 #include "data/model/Model.h"
 #include "base/Window.h"
 #include "base/Exceptions.h"
+#include "base/SlidingFrameWindow.h"
 #include "data/model/SparseOneDimensionalModel.h"
 #include "data/model/SparseTimeValueModel.h"
 #include "data/model/BasicCompressedDenseThreeDimensionalModel.h"
@@ -30,21 +31,33 @@
 #include "data/model/NoteModel.h"
 #include "data/model/RegionModel.h"
 #include "data/model/FFTModel.h"
+#include "data/model/FFTModelRegistry.h"
 #include "data/model/WaveFileModel.h"
 #include "rdf/PluginRDFDescription.h"
 
 #include "TransformFactory.h"
+#include "TransformerScheduler.h"
+#include "TransformResultCache.h"
 
 #include <iostream>
+#include <memory>
+#include <atomic>
+#include <limits>
+#include <algorithm>
 
 #include <QSettings>
+#include <QStringList>
 
 //#define DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN 1
 
 FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
                                                                      const Transform &transform) :
     ModelTransformer(in, transform),
+    m_keepFrom(0),
+    m_keepTo(std::numeric_limits<sv_frame_t>::max()),
     m_plugin(nullptr),
+    m_inputRate(0),
+    m_deferWrites(false),
     m_haveOutputs(false)
 {
     SVDEBUG << "FeatureExtractionModelTransformer::FeatureExtractionModelTransformer: plugin " << m_transforms.begin()->getPluginIdentifier() << ", outputName " << m_transforms.begin()->getOutput() << endl;
@@ -53,7 +66,11 @@ FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
 FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
                                                                      const Transforms &transforms) :
     ModelTransformer(in, transforms),
+    m_keepFrom(0),
+    m_keepTo(std::numeric_limits<sv_frame_t>::max()),
     m_plugin(nullptr),
+    m_inputRate(0),
+    m_deferWrites(false),
     m_haveOutputs(false)
 {
     if (m_transforms.empty()) {
@@ -63,14 +80,36 @@ FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
     }
 }
 
-static bool
-areTransformsSimilar(const Transform &t1, const Transform &t2)
+bool
+FeatureExtractionModelTransformer::areTransformsSimilar(const Transform &t1,
+                                                        const Transform &t2)
 {
     Transform t2o(t2);
     t2o.setOutput(t1.getOutput());
     return t1 == t2o;
 }
 
+bool
+FeatureExtractionModelTransformer::isStatelessPlugin(QString pluginId)
+{
+    static const QStringList known {
+        "vamp:qm-vamp-plugins:qm-chromagram",
+        "vamp:qm-vamp-plugins:qm-constantq",
+        "vamp:qm-vamp-plugins:qm-mfcc",
+        "vamp:vamp-example-plugins:powerspectrum",
+        "vamp:vamp-example-plugins:spectralcentroid",
+        "vamp:vamp-example-plugins:zerocrossing"
+    };
+
+    QSettings settings;
+    settings.beginGroup("Transformer");
+    QStringList ids =
+        settings.value("segment-parallel-plugins", known).toStringList();
+    settings.endGroup();
+
+    return ids.contains(pluginId);
+}
+
 bool
 FeatureExtractionModelTransformer::initialise()
 {
@@ -121,6 +160,8 @@ FeatureExtractionModelTransformer::initialise()
         return false;
     }
 
+    m_inputRate = input->getSampleRate();
+
     TransformFactory::getInstance()->makeContextConsistentWithPlugin
         (primaryTransform, m_plugin);
     
@@ -252,6 +293,8 @@ FeatureExtractionModelTransformer::initialise()
         setCompletion(j, 0);
     }
 
+    cacheOutputTypes();
+
     m_outputMutex.lock();
     m_haveOutputs = true;
     m_outputsCondition.wakeAll();
@@ -545,6 +588,39 @@ FeatureExtractionModelTransformer::createOutputModels(int n)
     }
 }
 
+void
+FeatureExtractionModelTransformer::cacheOutputTypes()
+{
+    m_outputTypes.clear();
+    m_outputResolutions.clear();
+
+    for (int n = 0; in_range_for(m_outputs, n); ++n) {
+
+        OutputType type = UnknownOutput;
+        int resolution = 1;
+
+        if (isOutputType<SparseOneDimensionalModel>(n)) {
+            type = SparseOneDimensionalOutput;
+        } else if (isOutputType<SparseTimeValueModel>(n)) {
+            type = SparseTimeValueOutput;
+        } else if (isOutputType<NoteModel>(n)) {
+            type = NoteOutput;
+        } else if (isOutputType<RegionModel>(n)) {
+            type = RegionOutput;
+        } else {
+            auto model = ModelById::getAs
+                <BasicCompressedDenseThreeDimensionalModel>(m_outputs[n]);
+            if (model) {
+                type = DenseThreeDimensionalOutput;
+                resolution = model->getResolution();
+            }
+        }
+
+        m_outputTypes.push_back(type);
+        m_outputResolutions.push_back(resolution);
+    }
+}
+
 void
 FeatureExtractionModelTransformer::awaitOutputModels()
 {
@@ -652,42 +728,49 @@ FeatureExtractionModelTransformer::run()
         return;
     }
 
-    Transform primaryTransform = m_transforms[0];
-
-    ModelId inputId = getInputModel();
-
-    bool ready = false;
-    while (!ready && !m_abandoned) {
-        { // scope so as to release input shared_ptr before sleeping
-            auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
-            if (!input || !input->isOK()) {
-                abandon();
-                return;
-            }
-            ready = input->isReady();
+    // The output models exist now, so whoever is waiting for them
+    // can go ahead; but we wait our turn before reading any input
+    TransformerScheduler::Slot slot(this);
+    if (!slot.isAcquired()) {
+        for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+            setCompletion(j, 100);
         }
-        if (!ready) {
-            SVDEBUG << "FeatureExtractionModelTransformer::run: Waiting for input model "
-                    << inputId << " to be ready..." << endl;
-            usleep(500000);
+        deinitialise();
+        return;
+    }
+
+    // If the results of all of our transforms are in the result
+    // cache, restore them instead of running the plugin. Keying may
+    // mean reading the whole input file, so is also done in turn
+    std::vector<QString> cacheKeys = getResultCacheKeys();
+    if (TransformResultCache::getInstance()->restore(cacheKeys, m_outputs)) {
+        SVDEBUG << "FeatureExtractionModelTransformer::run: Restored "
+                << cacheKeys.size() << " output(s) from result cache" << endl;
+        for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+            setCompletion(j, 100);
         }
+        deinitialise();
+        return;
     }
-    if (m_abandoned) return;
 
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-    SVDEBUG << "FeatureExtractionModelTransformer::run: Input model "
-            << inputId << " is ready, going ahead" << endl;
-#endif
+    Transform primaryTransform = m_transforms[0];
+
+    ModelId inputId = getInputModel();
+
+    // We don't wait for the input model to be ready: if it is still
+    // being decoded, we follow behind the decoder, waiting within
+    // the process loop for each block's input to become available
 
     sv_samplerate_t sampleRate;
     int channelCount;
     sv_frame_t startFrame;
     sv_frame_t endFrame;
+    bool inputComplete;
     
     { // scope so as not to have this borrowed pointer retained around
       // the edges of the process loop
         auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
-        if (!input) {
+        if (!input || !input->isOK()) {
             abandon();
             return;
         }
@@ -700,9 +783,31 @@ FeatureExtractionModelTransformer::run()
         }
 
         startFrame = input->getStartFrame();
+        inputComplete = input->isFullyAvailable();
         endFrame = input->getEndFrame();
     }
 
+#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
+    SVDEBUG << "FeatureExtractionModelTransformer::run: Input model "
+            << inputId << " is OK, going ahead (input complete = "
+            << inputComplete << ")" << endl;
+#endif
+
+    if (inputComplete &&
+        runSegmented(channelCount, sampleRate, startFrame, endFrame)) {
+        for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+            setCompletion(j, 100);
+        }
+        if (!m_abandoned) {
+            for (int j = 0; in_range_for(cacheKeys, j); ++j) {
+                TransformResultCache::getInstance()->store(cacheKeys[j],
+                                                           m_outputs[j]);
+            }
+        }
+        deinitialise();
+        return;
+    }
+
     float **buffers = new float*[channelCount];
     for (int ch = 0; ch < channelCount; ++ch) {
         buffers[ch] = new float[primaryTransform.getBlockSize() + 2];
@@ -714,34 +819,46 @@ FeatureExtractionModelTransformer::run()
     bool frequencyDomain = (m_plugin->getInputDomain() ==
                             Vamp::Plugin::FrequencyDomain);
 
-    std::vector<FFTModel *> fftModels;
+    // FFT models come from the registry, so that they can be shared
+    // with any other transformer (or view) using the same input and
+    // FFT parameters
+    std::vector<ModelId> fftModelIds;
+    std::vector<std::shared_ptr<FFTModel>> fftModels;
+
+    auto releaseFFTModels = [&]() {
+                                fftModels.clear();
+                                for (auto id: fftModelIds) {
+                                    FFTModelRegistry::getInstance()->release(id);
+                                }
+                                fftModelIds.clear();
+                            };
 
     if (frequencyDomain) {
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
         SVDEBUG << "FeatureExtractionModelTransformer::run: Input is frequency-domain" << endl;
 #endif
         for (int ch = 0; ch < channelCount; ++ch) {
-            FFTModel *model = new FFTModel
+            QString err;
+            ModelId fftModelId = FFTModelRegistry::getInstance()->acquire
                 (inputId,
                  channelCount == 1 ? m_input.getChannel() : ch,
                  primaryTransform.getWindowType(),
                  blockSize,
                  stepSize,
-                 blockSize);
-            if (!model->isOK() || model->getError() != "") {
-                QString err = model->getError();
-                delete model;
+                 blockSize,
+                 &err);
+            auto model = ModelById::getAs<FFTModel>(fftModelId);
+            if (!model) {
                 for (int j = 0; in_range_for(m_outputNos, j); ++j) {
                     setCompletion(j, 100);
                 }
                 SVDEBUG << "FeatureExtractionModelTransformer::run: Failed to create FFT model for input model " << inputId << ": " << err << endl;
                 m_message = "Failed to create the FFT model for this feature extraction model transformer: error is: " + err;
-                for (int cch = 0; cch < ch; ++cch) {
-                    delete fftModels[cch];
-                }
+                releaseFFTModels();
                 abandon();
                 return;
             }
+            fftModelIds.push_back(fftModelId);
             fftModels.push_back(model);
         }
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
@@ -755,19 +872,24 @@ FeatureExtractionModelTransformer::run()
     sv_frame_t contextStart =
         RealTime::realTime2Frame(contextStartRT, sampleRate);
 
-    sv_frame_t contextDuration =
+    sv_frame_t requestedDuration =
         RealTime::realTime2Frame(contextDurationRT, sampleRate);
 
     if (contextStart == 0 || contextStart < startFrame) {
         contextStart = startFrame;
     }
 
-    if (contextDuration == 0) {
-        contextDuration = endFrame - contextStart;
-    }
-    if (contextStart + contextDuration > endFrame) {
-        contextDuration = endFrame - contextStart;
-    }
+    // While the input is still arriving, its end frame (and so our
+    // duration and completion estimate) is provisional
+    sv_frame_t contextDuration = 0;
+    auto updateContextDuration = [&]() {
+                                     contextDuration = requestedDuration;
+                                     if (contextDuration == 0 ||
+                                         contextStart + contextDuration > endFrame) {
+                                         contextDuration = endFrame - contextStart;
+                                     }
+                                 };
+    updateContextDuration();
 
     sv_frame_t blockFrame = contextStart;
 
@@ -784,11 +906,51 @@ FeatureExtractionModelTransformer::run()
         imaginaries = new float[blockSize/2 + 1];
     }
 
+    // Consecutive time-domain blocks overlap by blockSize - stepSize
+    // frames, so read through a sliding window that only fetches the
+    // frames each block adds
+    std::unique_ptr<SlidingFrameWindow> window;
+    if (!frequencyDomain) {
+        window.reset(new SlidingFrameWindow
+                     (channelCount, blockSize,
+                      [this, channelCount](sv_frame_t start,
+                                           sv_frame_t count,
+                                           float **into) {
+                          getFrames(channelCount, start, count, into);
+                      }));
+    }
+
+    // Handles, rather than ids, so that the check on each block for
+    // models having been released does not go through the registry
+    auto inputHandle = ModelById::getHandle<DenseTimeValueModel>(inputId);
+    std::vector<ByIdHandle<Model>> outputHandles;
+    for (auto mid: m_outputs) {
+        outputHandles.push_back(ModelById::getHandle<Model>(mid));
+    }
+
     QString error = "";
 
     try {
         while (!m_abandoned) {
 
+            if (!inputComplete) {
+                // A frequency-domain block is centred on blockFrame
+                sv_frame_t need = blockFrame +
+                    (frequencyDomain ? blockSize/2 : blockSize);
+                if (!awaitInputAvailable(need)) {
+                    abandon();
+                    break;
+                }
+                auto input = inputHandle.get();
+                if (!input) {
+                    abandon();
+                    break;
+                }
+                inputComplete = input->isFullyAvailable();
+                endFrame = input->getEndFrame();
+                updateContextDuration();
+            }
+
             if (frequencyDomain) {
                 if (blockFrame - int(blockSize)/2 >
                     contextStart + contextDuration) {
@@ -812,7 +974,7 @@ FeatureExtractionModelTransformer::run()
                  (contextDuration / stepSize + 1));
 
             bool haveAllModels = true;
-            if (!ModelById::get(inputId)) {
+            if (!inputHandle.isLive()) {
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
                 SVDEBUG << "FeatureExtractionModelTransformer::run: Input model " << inputId << " no longer exists" << endl;
 #endif
@@ -822,15 +984,15 @@ FeatureExtractionModelTransformer::run()
                 SVDEBUG << "Input model " << inputId << " still exists" << endl;
 #endif
             }
-            for (auto mid: m_outputs) {
-                if (!ModelById::get(mid)) {
+            for (const auto &h: outputHandles) {
+                if (!h.isLive()) {
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-                    SVDEBUG << "FeatureExtractionModelTransformer::run: Output model " << mid << " no longer exists" << endl;
+                    SVDEBUG << "FeatureExtractionModelTransformer::run: Output model #" << h.getUntypedId() << " no longer exists" << endl;
 #endif
                     haveAllModels = false;
                 } else {
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-                    SVDEBUG << "Output model " << mid << " still exists" << endl;
+                    SVDEBUG << "Output model #" << h.getUntypedId() << " still exists" << endl;
 #endif
                 }
             }
@@ -868,26 +1030,15 @@ FeatureExtractionModelTransformer::run()
                         break;
                     }
                 }
-            } else {
-                getFrames(channelCount, blockFrame, blockSize, buffers);
             }
 
             if (m_abandoned) break;
 
-            auto features = m_plugin->process
-                (buffers,
-                 RealTime::frame2RealTime(blockFrame, sampleRate)
-                 .toVampRealTime());
+            processBlock(frequencyDomain ? buffers : window->getBlock(blockFrame),
+                         blockFrame, sampleRate);
             
             if (m_abandoned) break;
 
-            for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
-                    auto feature = features[m_outputNos[j]][fi];
-                    addFeature(j, blockFrame, feature);
-                }
-            }
-
             if (blockFrame == contextStart || completion > prevCompletion) {
                 for (int j = 0; in_range_for(m_outputNos, j); ++j) {
                     setCompletion(j, completion);
@@ -900,17 +1051,7 @@ FeatureExtractionModelTransformer::run()
         }
 
         if (!m_abandoned) {
-            auto features = m_plugin->getRemainingFeatures();
-
-            for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
-                    auto feature = features[m_outputNos[j]][fi];
-                    addFeature(j, blockFrame, feature);
-                    if (m_abandoned) {
-                        break;
-                    }
-                }
-            }
+            processRemaining(blockFrame);
         }
     } catch (const std::exception &e) {
         SVCERR << "FeatureExtractionModelTransformer::run: Exception caught: "
@@ -923,10 +1064,15 @@ FeatureExtractionModelTransformer::run()
         setCompletion(j, 100);
     }
 
-    if (frequencyDomain) {
-        for (int ch = 0; ch < channelCount; ++ch) {
-            delete fftModels[ch];
+    if (!m_abandoned) {
+        for (int j = 0; in_range_for(cacheKeys, j); ++j) {
+            TransformResultCache::getInstance()->store(cacheKeys[j],
+                                                       m_outputs[j]);
         }
+    }
+
+    if (frequencyDomain) {
+        releaseFFTModels();
         delete[] reals;
         delete[] imaginaries;
     }
@@ -939,6 +1085,465 @@ FeatureExtractionModelTransformer::run()
     deinitialise();
 }
 
+std::vector<QString>
+FeatureExtractionModelTransformer::getResultCacheKeys()
+{
+    // Results split into additional models as they are calculated
+    // are not cached
+    auto cache = TransformResultCache::getInstance();
+    if (!cache->isEnabled() || willHaveAdditionalOutputModels()) {
+        return {};
+    }
+
+    QString pluginVersion = QString("%1").arg(m_plugin->getPluginVersion());
+
+    std::vector<QString> keys;
+    for (const auto &transform: m_transforms) {
+        QString key = cache->getKey(transform, m_input, pluginVersion);
+        if (key == "") {
+            return {};
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// A segment is only worth a thread of its own if it is at least this
+// many blocks long
+static const int64_t minimumSegmentBlocks = 512;
+
+// Each segment starts processing this many blocks before its first
+// block, and drops the features from them, so that a plugin with any
+// short-lived internal state (a smoothing filter, say) has settled
+static const int64_t segmentWarmUpBlocks = 8;
+
+int64_t
+FeatureExtractionModelTransformer::getBlockCount(sv_frame_t duration,
+                                                 int stepSize,
+                                                 int blockSize,
+                                                 bool frequencyDomain)
+{
+    if (duration <= 0 || stepSize <= 0) {
+        return 0;
+    }
+    if (frequencyDomain) {
+        return (duration + blockSize/2) / stepSize + 1;
+    } else {
+        return (duration + stepSize - 1) / stepSize;
+    }
+}
+
+std::vector<FeatureExtractionModelTransformer::Segment>
+FeatureExtractionModelTransformer::planSegments(sv_frame_t contextStart,
+                                                int64_t blockCount,
+                                                int stepSize,
+                                                int maxSegments)
+{
+    int64_t segmentCount = maxSegments;
+    if (segmentCount > blockCount / minimumSegmentBlocks) {
+        segmentCount = blockCount / minimumSegmentBlocks;
+    }
+    if (segmentCount < 2) {
+        return {};
+    }
+
+    // The last segment keeps everything from its first block on,
+    // including the features the plugin returns at the end. The
+    // others end where the next begins, so that the remaining
+    // features they return at that frame are dropped
+    
+    std::vector<Segment> segments;
+    for (int64_t i = 0; i < segmentCount; ++i) {
+        int64_t first = (blockCount * i) / segmentCount;
+        int64_t next = (blockCount * (i + 1)) / segmentCount;
+        int64_t warmUp = std::max(int64_t(0), first - segmentWarmUpBlocks);
+        Segment segment;
+        segment.processFrom = contextStart + warmUp * stepSize;
+        segment.processTo = contextStart + next * stepSize;
+        segment.keepFrom = (i == 0 ? 0 : contextStart + first * stepSize);
+        segment.keepTo = (i + 1 == segmentCount ?
+                          std::numeric_limits<sv_frame_t>::max() :
+                          contextStart + next * stepSize);
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+struct FeatureExtractionModelTransformer::SegmentRun
+{
+    std::vector<Segment> segments;
+    int channelCount;
+    sv_samplerate_t sampleRate;
+    sv_frame_t startFrame;
+    int64_t totalBlocks;
+    std::atomic<int64_t> blocksDone;
+    int reportedCompletion;
+};
+
+/**
+ * A segment worker processes one segment of the input, other than the
+ * first, using a FeatureExtractionModelTransformer of its own (which
+ * is never started as a thread) with its own plugin instance. The
+ * plugin is constructed, used and destroyed on the worker's thread.
+ */
+class FeatureExtractionModelTransformer::SegmentWorker : public Thread
+{
+public:
+    SegmentWorker(FeatureExtractionModelTransformer *primary,
+                  SegmentRun *run,
+                  int index) :
+        m_primary(primary),
+        m_run(run),
+        m_index(index),
+        m_segment(primary->m_input, primary->m_transforms),
+        m_ok(false) { }
+
+    bool isOK() const { return m_ok; }
+    QString getMessage() const { return m_segment.getMessage(); }
+    FeatureExtractionModelTransformer *getSegment() { return &m_segment; }
+
+protected:
+    void run() override {
+        try {
+            if (m_segment.initialiseSegment(m_primary,
+                                            m_run->channelCount)) {
+                m_segment.processSegment(*m_run, m_index, m_primary);
+                m_ok = !m_primary->isAbandoned();
+            }
+        } catch (const std::exception &e) {
+            SVCERR << "FeatureExtractionModelTransformer::SegmentWorker: "
+                   << "Exception caught: " << e.what() << endl;
+            m_segment.m_message = e.what();
+        }
+        m_segment.deinitialise();
+    }
+
+private:
+    FeatureExtractionModelTransformer *m_primary;
+    SegmentRun *m_run;
+    int m_index;
+    FeatureExtractionModelTransformer m_segment;
+    bool m_ok;
+};
+
+bool
+FeatureExtractionModelTransformer::runSegmented(int channelCount,
+                                                sv_samplerate_t sampleRate,
+                                                sv_frame_t startFrame,
+                                                sv_frame_t endFrame)
+{
+    const Transform &primaryTransform = m_transforms[0];
+
+    // Only features stamped with the frame of the block they came
+    // from can be attributed to a segment. Additional models are
+    // created as bins are found, which segments cannot share
+    
+    if (!isStatelessPlugin(primaryTransform.getPluginIdentifier()) ||
+        willHaveAdditionalOutputModels()) {
+        return false;
+    }
+    for (const auto &d: m_descriptors) {
+        if (d.sampleType != Vamp::Plugin::OutputDescriptor::OneSamplePerStep) {
+            return false;
+        }
+    }
+
+    int stepSize = primaryTransform.getStepSize();
+    int blockSize = primaryTransform.getBlockSize();
+    bool frequencyDomain = (m_plugin->getInputDomain() ==
+                            Vamp::Plugin::FrequencyDomain);
+
+    sv_frame_t contextStart = RealTime::realTime2Frame
+        (primaryTransform.getStartTime(), sampleRate);
+    if (contextStart == 0 || contextStart < startFrame) {
+        contextStart = startFrame;
+    }
+    sv_frame_t contextDuration = RealTime::realTime2Frame
+        (primaryTransform.getDuration(), sampleRate);
+    if (contextDuration == 0 || contextStart + contextDuration > endFrame) {
+        contextDuration = endFrame - contextStart;
+    }
+
+    // The same blocks as the sequential loop in run() would process
+    int64_t totalBlocks = getBlockCount(contextDuration, stepSize, blockSize,
+                                        frequencyDomain);
+    
+    int64_t segmentCount = planSegments(contextStart, totalBlocks, stepSize,
+                                        QThread::idealThreadCount()).size();
+    if (segmentCount < 2) {
+        return false;
+    }
+
+    // We already hold one scheduler slot, and each further segment
+    // needs one of its own, so that the scheduler's limit on the
+    // number of threads processing at once still holds. We take only
+    // those that are free and that no other transformer is waiting
+    // for, and run in fewer segments (or none) if there are not
+    // enough of them
+
+    auto scheduler = TransformerScheduler::getInstance();
+    segmentCount = 1 + scheduler->claimExtraSlots(this, int(segmentCount - 1));
+    if (segmentCount < 2) {
+        return false;
+    }
+
+    SVDEBUG << "FeatureExtractionModelTransformer::runSegmented: Running "
+            << totalBlocks << " blocks in " << segmentCount
+            << " segments" << endl;
+
+    SegmentRun run;
+    run.channelCount = channelCount;
+    run.sampleRate = sampleRate;
+    run.startFrame = startFrame;
+    run.totalBlocks = totalBlocks;
+    run.blocksDone = 0;
+    run.reportedCompletion = 0;
+    run.segments = planSegments(contextStart, totalBlocks, stepSize,
+                                int(segmentCount));
+
+    std::vector<std::unique_ptr<SegmentWorker>> workers;
+    for (int i = 1; i < int(segmentCount); ++i) {
+        workers.emplace_back(new SegmentWorker(this, &run, i));
+        workers.back()->start();
+    }
+
+    // We process the first segment ourselves, writing its features
+    // as we go
+    try {
+        processSegment(run, 0, this);
+    } catch (const std::exception &e) {
+        SVCERR << "FeatureExtractionModelTransformer::runSegmented: "
+               << "Exception caught: " << e.what() << endl;
+        m_message = e.what();
+        abandon();
+    }
+
+    // Then write each of the other segments' features in order as it
+    // finishes, so that the output models are only ever appended to
+    // and only ever written from this thread
+    for (auto &w: workers) {
+        while (!w->wait(100)) {
+            updateSegmentCompletion(run);
+        }
+        if (!w->isOK()) {
+            if (m_message == "") {
+                m_message = w->getMessage();
+            }
+            abandon();
+        } else if (!m_abandoned) {
+            w->getSegment()->writeDeferredFeatures();
+        }
+        updateSegmentCompletion(run);
+    }
+
+    scheduler->releaseExtraSlots(this);
+    return true;
+}
+
+bool
+FeatureExtractionModelTransformer::initialiseSegment
+(const FeatureExtractionModelTransformer *primary, int channelCount)
+{
+    const Transform &transform = m_transforms[0];
+    QString pluginId = transform.getPluginIdentifier();
+
+    auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
+    if (!input) {
+        m_message = tr("Input model for feature extraction plugin \"%1\" is of wrong type (internal error?)").arg(pluginId);
+        return false;
+    }
+
+    // The primary has already made the step and block sizes
+    // consistent with the plugin, so we just use them
+    
+    m_plugin = FeatureExtractionPluginFactory::instance()->instantiatePlugin
+        (pluginId, input->getSampleRate());
+    if (!m_plugin) {
+        m_message = tr("Failed to instantiate plugin \"%1\"").arg(pluginId);
+        return false;
+    }
+    
+    TransformFactory::getInstance()->setPluginParameters(transform, m_plugin);
+
+    if (!m_plugin->initialise(channelCount,
+                              transform.getStepSize(),
+                              transform.getBlockSize())) {
+        m_message = tr("Failed to initialise feature extraction plugin \"%1\"").arg(pluginId);
+        return false;
+    }
+
+    m_outputs = primary->m_outputs;
+    m_descriptors = primary->m_descriptors;
+    m_outputNos = primary->m_outputNos;
+    m_fixedRateFeatureNos = primary->m_fixedRateFeatureNos;
+    m_needAdditionalModels = primary->m_needAdditionalModels;
+    m_outputTypes = primary->m_outputTypes;
+    m_outputResolutions = primary->m_outputResolutions;
+    m_inputRate = primary->m_inputRate;
+    m_deferWrites = true;
+    
+    return true;
+}
+
+void
+FeatureExtractionModelTransformer::processSegment(SegmentRun &run,
+                                                  int index,
+                                                  ModelTransformer *owner)
+{
+    const Segment &segment = run.segments[index];
+    const Transform &transform = m_transforms[0];
+
+    int channelCount = run.channelCount;
+    int stepSize = transform.getStepSize();
+    int blockSize = transform.getBlockSize();
+    bool frequencyDomain = (m_plugin->getInputDomain() ==
+                            Vamp::Plugin::FrequencyDomain);
+    
+    m_keepFrom = segment.keepFrom;
+    m_keepTo = segment.keepTo;
+
+    std::vector<ByIdHandle<Model>> outputHandles;
+    for (auto mid: m_outputs) {
+        outputHandles.push_back(ModelById::getHandle<Model>(mid));
+    }
+
+    // Each segment has FFT models of its own, rather than sharing them
+    // through FFTModelRegistry, as a shared model calculates only one
+    // column at a time
+    std::vector<std::unique_ptr<FFTModel>> fftModels;
+    std::vector<float> reals, imaginaries;
+    std::vector<std::vector<float>> data;
+    std::vector<float *> buffers;
+    std::unique_ptr<SlidingFrameWindow> window;
+
+    if (frequencyDomain) {
+        data.reserve(channelCount);
+        for (int ch = 0; ch < channelCount; ++ch) {
+            fftModels.emplace_back
+                (new FFTModel(getInputModel(),
+                              channelCount == 1 ? m_input.getChannel() : ch,
+                              transform.getWindowType(),
+                              blockSize,
+                              stepSize,
+                              blockSize));
+            data.push_back(std::vector<float>(blockSize + 2, 0.f));
+            buffers.push_back(data[ch].data());
+        }
+        reals.resize(blockSize/2 + 1);
+        imaginaries.resize(blockSize/2 + 1);
+    } else {
+        window.reset(new SlidingFrameWindow
+                     (channelCount, blockSize,
+                      [this, channelCount](sv_frame_t start,
+                                           sv_frame_t count,
+                                           float **into) {
+                          getFrames(channelCount, start, count, into);
+                      }));
+    }
+
+    sv_frame_t blockFrame = segment.processFrom;
+
+    for (; blockFrame < segment.processTo; blockFrame += stepSize) {
+
+        if (owner->isAbandoned()) {
+            return;
+        }
+        for (const auto &h: outputHandles) {
+            if (!h.isLive()) {
+                owner->abandon();
+                return;
+            }
+        }
+
+        if (frequencyDomain) {
+            int column = int((blockFrame - run.startFrame) / stepSize);
+            for (int ch = 0; ch < channelCount; ++ch) {
+                if (!fftModels[ch]->getValuesAt(column,
+                                                reals.data(),
+                                                imaginaries.data())) {
+                    std::fill(reals.begin(), reals.end(), 0.f);
+                    std::fill(imaginaries.begin(), imaginaries.end(), 0.f);
+                }
+                for (int i = 0; i <= blockSize/2; ++i) {
+                    buffers[ch][i*2] = reals[i];
+                    buffers[ch][i*2+1] = imaginaries[i];
+                }
+                QString error = fftModels[ch]->getError();
+                if (error != "") {
+                    SVCERR << "FeatureExtractionModelTransformer::processSegment: Abandoning, error is " << error << endl;
+                    m_message = error;
+                    owner->abandon();
+                    return;
+                }
+            }
+        }
+
+        processBlock(frequencyDomain ?
+                     buffers.data() : window->getBlock(blockFrame),
+                     blockFrame, run.sampleRate);
+
+        if (blockFrame >= segment.keepFrom) {
+            ++run.blocksDone;
+        }
+        if (owner == this) {
+            updateSegmentCompletion(run);
+        }
+    }
+
+    processRemaining(blockFrame);
+}
+
+void
+FeatureExtractionModelTransformer::updateSegmentCompletion(SegmentRun &run)
+{
+    int completion = int((run.blocksDone * 99) / (run.totalBlocks + 1));
+    if (completion > run.reportedCompletion) {
+        for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+            setCompletion(j, completion);
+        }
+        run.reportedCompletion = completion;
+    }
+}
+
+void
+FeatureExtractionModelTransformer::processBlock(const float *const *buffers,
+                                                sv_frame_t blockFrame,
+                                                sv_samplerate_t sampleRate)
+{
+    auto features = m_plugin->process
+        (buffers,
+         RealTime::frame2RealTime(blockFrame, sampleRate).toVampRealTime());
+
+    if (m_abandoned) return;
+
+    for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+        for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
+            auto feature = features[m_outputNos[j]][fi];
+            addFeature(j, blockFrame, feature);
+        }
+    }
+
+    flushPendingFeatures();
+}
+
+void
+FeatureExtractionModelTransformer::processRemaining(sv_frame_t blockFrame)
+{
+    auto features = m_plugin->getRemainingFeatures();
+
+    for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+        for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
+            auto feature = features[m_outputNos[j]][fi];
+            addFeature(j, blockFrame, feature);
+            if (m_abandoned) {
+                break;
+            }
+        }
+    }
+
+    flushPendingFeatures();
+}
+
 void
 FeatureExtractionModelTransformer::getFrames(int channelCount,
                                              sv_frame_t startFrame,
@@ -1005,10 +1610,7 @@ FeatureExtractionModelTransformer::addFeature(int n,
                                               sv_frame_t blockFrame,
                                               const Vamp::Plugin::Feature &feature)
 {
-    auto input = ModelById::get(getInputModel());
-    if (!input) return;
-
-    sv_samplerate_t inputRate = input->getSampleRate();
+    sv_samplerate_t inputRate = m_inputRate;
 
 //    cerr << "FeatureExtractionModelTransformer::addFeature: blockFrame = "
 //              << blockFrame << ", hasTimestamp = " << feature.hasTimestamp
@@ -1067,23 +1669,24 @@ FeatureExtractionModelTransformer::addFeature(int n,
         return;
     }
 
+    if (frame < m_keepFrom || frame >= m_keepTo) {
+        return;
+    }
+
     // Rather than repeat the complicated tests from the constructor
     // to determine what sort of model we must be adding the features
-    // to, we instead test what sort of model the constructor decided
-    // to create.
+    // to, we instead use the sort of model the constructor decided
+    // to create, as found by cacheOutputTypes.
 
     ModelId outputId = m_outputs[n];
+    OutputType type = m_outputTypes[n];
 
-    if (isOutputType<SparseOneDimensionalModel>(n)) {
+    if (type == SparseOneDimensionalOutput) {
 
-        auto model = ModelById::getAs<SparseOneDimensionalModel>(outputId);
-        if (!model) return;
-        model->add(Event(frame, feature.label.c_str()));
+        getPendingEvents(outputId, type).push_back
+            (Event(frame, feature.label.c_str()));
         
-    } else if (isOutputType<SparseTimeValueModel>(n)) {
-
-        auto model = ModelById::getAs<SparseTimeValueModel>(outputId);
-        if (!model) return;
+    } else if (type == SparseTimeValueOutput) {
 
         for (int i = 0; in_range_for(feature.values, i); ++i) {
 
@@ -1094,18 +1697,20 @@ FeatureExtractionModelTransformer::addFeature(int n,
                 label = QString("[%1] %2").arg(i+1).arg(label);
             }
 
-            auto targetModel = model;
+            ModelId targetId = outputId;
 
             if (m_needAdditionalModels[n] && i > 0) {
-                targetModel = ModelById::getAs<SparseTimeValueModel>
-                    (getAdditionalModel(n, i));
-                if (!targetModel) targetModel = model;
+                ModelId additionalId = getAdditionalModel(n, i);
+                if (!additionalId.isNone()) {
+                    targetId = additionalId;
+                }
             }
 
-            targetModel->add(Event(frame, value, label));
+            getPendingEvents(targetId, type).push_back
+                (Event(frame, value, label));
         }
 
-    } else if (isOutputType<NoteModel>(n) || isOutputType<RegionModel>(n)) {
+    } else if (type == NoteOutput || type == RegionOutput) {
     
         int index = 0;
 
@@ -1123,8 +1728,7 @@ FeatureExtractionModelTransformer::addFeature(int n,
             }
         }
 
-        auto noteModel = ModelById::getAs<NoteModel>(outputId);
-        if (noteModel) {
+        if (type == NoteOutput) {
 
             float velocity = 100;
             if ((int)feature.values.size() > index) {
@@ -1133,14 +1737,14 @@ FeatureExtractionModelTransformer::addFeature(int n,
             if (velocity < 0) velocity = 127;
             if (velocity > 127) velocity = 127;
             
-            noteModel->add(Event(frame, value, // value is pitch
-                                 duration,
-                                 velocity / 127.f,
-                                 feature.label.c_str()));
+            getPendingEvents(outputId, type).push_back
+                (Event(frame, value, // value is pitch
+                       duration,
+                       velocity / 127.f,
+                       feature.label.c_str()));
         }
 
-        auto regionModel = ModelById::getAs<RegionModel>(outputId);
-        if (regionModel) {
+        if (type == RegionOutput) {
             
             if (feature.hasDuration && !feature.values.empty()) {
                 
@@ -1153,34 +1757,27 @@ FeatureExtractionModelTransformer::addFeature(int n,
                         label = QString("[%1] %2").arg(i+1).arg(label);
                     }
                     
-                    regionModel->add(Event(frame,
-                                           value,
-                                           duration,
-                                           label));
+                    getPendingEvents(outputId, type).push_back
+                        (Event(frame, value, duration, label));
                 }
             } else {
                 
-                regionModel->add(Event(frame,
-                                       value,
-                                       duration,
-                                       feature.label.c_str()));
+                getPendingEvents(outputId, type).push_back
+                    (Event(frame, value, duration, feature.label.c_str()));
             }
         }
 
-    } else if (isOutputType<BasicCompressedDenseThreeDimensionalModel>(n)) {
+    } else if (type == DenseThreeDimensionalOutput) {
 
-        auto model = ModelById::getAs
-            <BasicCompressedDenseThreeDimensionalModel>(outputId);
-        if (!model) return;
-        
         DenseThreeDimensionalModel::Column values;
         values.insert(values.begin(),
                       feature.values.begin(), feature.values.end());
         
         if (!feature.hasTimestamp && m_fixedRateFeatureNos[n] >= 0) {
-            model->setColumn(m_fixedRateFeatureNos[n], values);
+            queueColumn(outputId, m_fixedRateFeatureNos[n], values);
         } else {
-            model->setColumn(int(frame / model->getResolution()), values);
+            queueColumn(outputId, int(frame / m_outputResolutions[n]),
+                        values);
         }
     } else {
         
@@ -1189,6 +1786,103 @@ FeatureExtractionModelTransformer::addFeature(int n,
     }
 }
 
+EventVector &
+FeatureExtractionModelTransformer::getPendingEvents(ModelId model,
+                                                    OutputType type)
+{
+    auto itr = m_pendingEvents.find(model);
+    if (itr == m_pendingEvents.end()) {
+        PendingEvents pending;
+        pending.type = type;
+        pending.model = ModelById::getHandle<Model>(model);
+        itr = m_pendingEvents.insert({ model, pending }).first;
+    }
+    return itr->second.events;
+}
+
+void
+FeatureExtractionModelTransformer::queueColumn(ModelId model,
+                                               int index,
+                                               const floatvec_t &values)
+{
+    // Columns can only be written together if they are consecutive
+    
+    auto itr = m_pendingColumns.find(model);
+    if (itr != m_pendingColumns.end()) {
+        PendingColumns &pending = itr->second;
+        if (index == pending.start + int(pending.columns.size())) {
+            pending.columns.push_back(values);
+            return;
+        }
+        if (m_deferWrites) {
+            m_deferredColumns.push_back({ model, pending });
+        } else {
+            flushPendingColumns(model, pending);
+        }
+        m_pendingColumns.erase(itr);
+    }
+
+    m_pendingColumns[model] = { index, { values } };
+}
+
+void
+FeatureExtractionModelTransformer::flushPendingColumns(ModelId modelId,
+                                                       PendingColumns &pending)
+{
+    auto model = ModelById::getAs
+        <BasicCompressedDenseThreeDimensionalModel>(modelId);
+    if (model) {
+        model->setColumns(pending.start, pending.columns);
+    }
+}
+
+void
+FeatureExtractionModelTransformer::flushPendingFeatures()
+{
+    if (m_deferWrites) {
+        return;
+    }
+
+    for (auto &p: m_pendingEvents) {
+        PendingEvents &pending = p.second;
+        if (pending.events.empty()) continue;
+        switch (pending.type) {
+        case SparseOneDimensionalOutput:
+            addPendingEvents<SparseOneDimensionalModel>(pending);
+            break;
+        case SparseTimeValueOutput:
+            addPendingEvents<SparseTimeValueModel>(pending);
+            break;
+        case NoteOutput:
+            addPendingEvents<NoteModel>(pending);
+            break;
+        case RegionOutput:
+            addPendingEvents<RegionModel>(pending);
+            break;
+        default:
+            break;
+        }
+        pending.events.clear();
+    }
+
+    for (auto &p: m_pendingColumns) {
+        flushPendingColumns(p.first, p.second);
+    }
+    m_pendingColumns.clear();
+}
+
+void
+FeatureExtractionModelTransformer::writeDeferredFeatures()
+{
+    for (auto &p: m_deferredColumns) {
+        flushPendingColumns(p.first, p.second);
+    }
+    m_deferredColumns.clear();
+
+    m_deferWrites = false;
+    flushPendingFeatures();
+}
+
 void
 FeatureExtractionModelTransformer::setCompletion(int n, int completion)
 {
@@ -48,16 +48,118 @@ public:
 
     virtual ~FeatureExtractionModelTransformer();
 
+    /**
+     * Return true if the two transforms could be run together by a
+     * single FeatureExtractionModelTransformer, i.e. if they differ
+     * in nothing but their plugin output.
+     */
+    static bool areTransformsSimilar(const Transform &t1,
+                                     const Transform &t2);
+
+    /**
+     * Return true if the plugin with the given id is known to keep no
+     * state from one processing block to the next, so that separate
+     * instances of it may be run over separate segments of a long
+     * input at once and their results joined. Plugins have no way to
+     * declare this themselves, so this consults a list of plugin ids,
+     * which may be replaced using the "segment-parallel-plugins" key
+     * in the "Transformer" settings group.
+     */
+    static bool isStatelessPlugin(QString pluginId);
+
+    /**
+     * A part of the input processed by one plugin instance when the
+     * input is split into segments (see planSegments).
+     */
+    struct Segment {
+        sv_frame_t processFrom; // first block frame processed
+        sv_frame_t processTo;   // block frame following the last processed
+        sv_frame_t keepFrom;    // features are kept from this frame
+        sv_frame_t keepTo;      // up to but not including this one
+    };
+
+    /**
+     * Return the number of blocks the sequential processing loop
+     * passes to the plugin for an input of the given duration. A
+     * frequency-domain block is centred on its frame, so the last
+     * block may start up to half a block past the end.
+     */
+    static int64_t getBlockCount(sv_frame_t duration,
+                                 int stepSize,
+                                 int blockSize,
+                                 bool frequencyDomain);
+
+    /**
+     * Split the given number of blocks, the first of which is at
+     * contextStart, into at most maxSegments segments that are each
+     * long enough to be worth a thread. Each segment after the first
+     * starts processing a few blocks early, so that the plugin has
+     * settled, and features are kept only from its own blocks. Return
+     * an empty vector if there would be fewer than two segments.
+     */
+    static std::vector<Segment> planSegments(sv_frame_t contextStart,
+                                             int64_t blockCount,
+                                             int stepSize,
+                                             int maxSegments);
+
     // ModelTransformer method, retrieve the additional models
     Models getAdditionalOutputModels() override;
     bool willHaveAdditionalOutputModels() override;
 
 protected:
+    friend class FeatureExtractionFanOutModelTransformer;
+    
     bool initialise();
     void deinitialise();
 
     void run() override;
 
+    /**
+     * Pass one block of input to the plugin, and add the features it
+     * returns to the output models.
+     */
+    void processBlock(const float *const *buffers, sv_frame_t blockFrame,
+                      sv_samplerate_t sampleRate);
+
+    /**
+     * Add the plugin's remaining features to the output models, at
+     * the end of processing. The block frame is that following the
+     * last block processed.
+     */
+    void processRemaining(sv_frame_t blockFrame);
+
+    class SegmentWorker;
+    friend class SegmentWorker;
+
+    struct SegmentRun;
+
+    /**
+     * If the plugin is stateless and the input long enough, split the
+     * input into segments and run a separate plugin instance over
+     * each at once, writing the results to our output models. Each
+     * segment after the first takes a spare scheduler slot. Return
+     * false, having done nothing, if the input cannot be segmented
+     * or there are no spare slots.
+     */
+    bool runSegmented(int channelCount, sv_samplerate_t sampleRate,
+                      sv_frame_t startFrame, sv_frame_t endFrame);
+
+    /**
+     * Set up this transformer to process a segment on behalf of the
+     * given one, with a plugin instance of its own but writing to
+     * the other transformer's output models.
+     */
+    bool initialiseSegment(const FeatureExtractionModelTransformer *primary,
+                           int channelCount);
+
+    void processSegment(SegmentRun &run, int index, ModelTransformer *owner);
+    void updateSegmentCompletion(SegmentRun &run);
+
+    // Features at frames outside this range are dropped, as they
+    // belong to a neighbouring segment
+    sv_frame_t m_keepFrom;
+    sv_frame_t m_keepTo;
+
     std::shared_ptr<Vamp::Plugin> m_plugin;
 
     // descriptors per transform
@@ -85,8 +187,63 @@ protected:
                     sv_frame_t blockFrame,
                     const Vamp::Plugin::Feature &feature);
 
+    // The kind of model created for each output, with the input
+    // sample rate and the output model resolutions, found once when
+    // the output models are created rather than for every feature
+    enum OutputType {
+        UnknownOutput,
+        SparseOneDimensionalOutput,
+        SparseTimeValueOutput,
+        NoteOutput,
+        RegionOutput,
+        DenseThreeDimensionalOutput
+    };
+    std::vector<OutputType> m_outputTypes;
+    std::vector<int> m_outputResolutions;
+    sv_samplerate_t m_inputRate;
+
+    void cacheOutputTypes();
+
+    // addFeature queues up events and columns per model (output or
+    // additional), and flushPendingFeatures writes them to the models
+    // in one batch per model after each process call. The queues are
+    // kept, with a handle to their model, from one call to the next
+    struct PendingEvents {
+        OutputType type;
+        ByIdHandle<Model> model;
+        EventVector events;
+    };
+    std::map<ModelId, PendingEvents> m_pendingEvents;
+
+    EventVector &getPendingEvents(ModelId model, OutputType type);
+    struct PendingColumns {
+        int start;
+        std::vector<floatvec_t> columns;
+    };
+    std::map<ModelId, PendingColumns> m_pendingColumns;
+
+    void queueColumn(ModelId model, int index, const floatvec_t &values);
+    void flushPendingColumns(ModelId model, PendingColumns &pending);
+    void flushPendingFeatures();
+
+    // A segment other than the first holds on to all of its features
+    // until the segments before it have been written, and then
+    // writeDeferredFeatures writes them, from the primary's thread
+    bool m_deferWrites;
+    std::vector<std::pair<ModelId, PendingColumns>> m_deferredColumns;
+    void writeDeferredFeatures();
+
+    template <typename T> void addPendingEvents(const PendingEvents &pending) {
+        auto model = std::dynamic_pointer_cast<T>(pending.model.get());
+        if (model) {
+            model->addEvents(pending.events);
+        }
+    }
+
     void setCompletion(int, int);
 
+    std::vector<QString> getResultCacheKeys();
+
     void getFrames(int channelCount, sv_frame_t startFrame, sv_frame_t size,
                    float **buffer);
 
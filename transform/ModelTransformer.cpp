@@ -14,10 +14,15 @@
 */
 
 #include "ModelTransformer.h"
+#include "TransformerScheduler.h"
+
+#include "data/model/DenseTimeValueModel.h"
 
 ModelTransformer::ModelTransformer(Input input, const Transform &transform) :
     m_input(input),
-    m_abandoned(false)
+    m_abandoned(false),
+    m_priority(0),
+    m_inputChanges(0)
 {
     m_transforms.push_back(transform);
 }
@@ -25,13 +30,98 @@ ModelTransformer::ModelTransformer(Input input, const Transform &transform) :
 ModelTransformer::ModelTransformer(Input input, const Transforms &transforms) :
     m_transforms(transforms),
     m_input(input),
-    m_abandoned(false)
+    m_abandoned(false),
+    m_priority(0),
+    m_inputChanges(0)
 {
 }
 
 ModelTransformer::~ModelTransformer()
 {
-    m_abandoned = true;
+    abandon();
     wait();
 }
 
+void
+ModelTransformer::abandon()
+{
+    m_abandoned = true;
+    inputChanged();
+}
+
+
+void
+ModelTransformer::setPriority(int priority)
+{
+    m_priority = priority;
+    TransformerScheduler::getInstance()->reschedule();
+}
+
+void
+ModelTransformer::inputChanged()
+{
+    ++m_inputChanges;
+    QMutexLocker locker(&m_inputMutex);
+    m_inputCondition.wakeAll();
+}
+
+bool
+ModelTransformer::awaitInputAvailable(sv_frame_t frame)
+{
+    // If we are holding a scheduler slot, let it go while we wait, in
+    // case the input is being written by a transformer that is
+    // itself waiting for a slot
+    bool suspended = false;
+
+    // Rather than poll the input, we sleep until it signals that it
+    // has more data. We can't hold m_inputMutex while looking at the
+    // input, as it may hold its own lock while signalling, so we note
+    // the change count beforehand and only sleep if it hasn't moved.
+    // The timeout is for an input that goes away without telling us
+    std::vector<QMetaObject::Connection> connections;
+    auto wake = [this]() { inputChanged(); };
+    bool available = false;
+    
+    while (!m_abandoned) {
+        int changes = m_inputChanges;
+        { // scope so as to release input shared_ptr before sleeping
+            auto input = ModelById::getAs<DenseTimeValueModel>
+                (m_input.getModel());
+            if (!input || !input->isOK()) {
+                break;
+            }
+            if (connections.empty()) {
+                Model *m = input.get();
+                connections.push_back(connect(m, &Model::modelChangedWithin,
+                                              this, wake, Qt::DirectConnection));
+                connections.push_back(connect(m, &Model::modelChanged,
+                                              this, wake, Qt::DirectConnection));
+                connections.push_back(connect(m, &Model::ready,
+                                              this, wake, Qt::DirectConnection));
+                connections.push_back(connect(m, &QObject::destroyed,
+                                              this, wake, Qt::DirectConnection));
+            }
+            if (input->isFullyAvailable() ||
+                input->getAvailableEndFrame() >= frame) {
+                available = true;
+                break;
+            }
+        }
+        if (!suspended) {
+            suspended = TransformerScheduler::getInstance()->suspend(this);
+        }
+        QMutexLocker locker(&m_inputMutex);
+        if (m_inputChanges == changes && !m_abandoned) {
+            m_inputCondition.wait(&m_inputMutex, 1000);
+        }
+    }
+
+    for (const auto &c: connections) {
+        disconnect(c);
+    }
+    
+    if (available && suspended) {
+        return TransformerScheduler::getInstance()->acquire(this);
+    }
+    return available;
+}
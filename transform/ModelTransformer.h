@@ -22,6 +22,11 @@
 
 #include "Transform.h"
 
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+
 /**
  * A ModelTransformer turns one data model into another.
  *
@@ -63,13 +68,26 @@ public:
      * model/document context is being replaced.  Caller should still
      * wait() to be sure that processing has ended.
      */
-    void abandon() { m_abandoned = true; }
+    void abandon();
 
     /**
      * Return true if the processing thread is being or has been
      * abandoned, i.e. if abandon() has been called.
      */
     bool isAbandoned() const { return m_abandoned; }
+
+    /**
+     * Set the scheduling priority of this transformer. When more
+     * transformers are waiting to run than TransformerScheduler has
+     * slots for, those with higher priority go first. The default is
+     * 0; a negative priority is lower than the default.
+     */
+    void setPriority(int priority);
+
+    /**
+     * Return the scheduling priority of this transformer.
+     */
+    int getPriority() const { return m_priority; }
     
     /**
      * Return the input model for the transform.
@@ -122,12 +140,34 @@ protected:
     ModelTransformer(Input input, const Transforms &transforms);
 
     virtual void awaitOutputModels() = 0;
+
+    /**
+     * Wait until the input model, which must be a
+     * DenseTimeValueModel, has data available up to (but not
+     * including) the given frame, or has all of its data available.
+     * This allows a transformer to process the input as it arrives,
+     * for example while an audio file is still being decoded, rather
+     * than waiting for the whole model to be ready before starting.
+     * Return true if the data are available, or false if the
+     * transformer has been abandoned or the input model has gone
+     * away while waiting. If the transformer holds a slot from
+     * TransformerScheduler, it gives it up while waiting.
+     */
+    bool awaitInputAvailable(sv_frame_t frame);
+
+    // Wake any wait in awaitInputAvailable to look at the input again
+    void inputChanged();
     
     Transforms m_transforms;
     Input m_input;
     Models m_outputs;
     bool m_abandoned;
+    std::atomic<int> m_priority;
     QString m_message;
+
+    QMutex m_inputMutex;
+    QWaitCondition m_inputCondition;
+    std::atomic<int> m_inputChanges;
 };
 
 #endif
@@ -16,7 +16,9 @@
 #include "ModelTransformerFactory.h"
 
 #include "FeatureExtractionModelTransformer.h"
+#include "FeatureExtractionFanOutModelTransformer.h"
 #include "RealTimeEffectModelTransformer.h"
+#include "TransformerScheduler.h"
 
 #include "TransformFactory.h"
 
@@ -272,6 +274,97 @@ ModelTransformerFactory::transformMultiple(const Transforms &transforms,
     return models;
 }
 
+vector<ModelId>
+ModelTransformerFactory::transformSharingInput(const Transforms &transforms,
+                                               const ModelTransformer::Input &input,
+                                               QString &message,
+                                               AdditionalModelHandler *handler)
+{
+    SVDEBUG << "ModelTransformerFactory::transformSharingInput: Constructing transformer for " << transforms.size() << " transform(s) with input model " << input.getModel() << endl;
+
+    if (!ModelById::get(input.getModel())) return {};
+    
+    vector<ModelId> models(transforms.size());
+    QStringList messages;
+    
+    // Real-time effects produce audio rather than features and have
+    // nothing to share, so they go through the ordinary route (before
+    // we take the mutex, as transform() takes it too)
+
+    Transforms extraction;
+    vector<int> extractionIndices;
+    
+    for (int i = 0; in_range_for(transforms, i); ++i) {
+        QString id = transforms[i].getPluginIdentifier();
+        if (RealTimePluginFactory::instanceFor(id)) {
+            QString m;
+            models[i] = transform(transforms[i], input, m);
+            if (m != "") messages.push_back(m);
+        } else {
+            extraction.push_back(transforms[i]);
+            extractionIndices.push_back(i);
+        }
+    }
+
+    if (!extraction.empty()) {
+
+        QMutexLocker locker(&m_mutex);
+
+        auto inputModel = ModelById::get(input.getModel());
+        if (!inputModel) return {};
+    
+        ModelTransformer *t =
+            new FeatureExtractionFanOutModelTransformer(input, extraction);
+        t->setObjectName(extraction[0].getIdentifier());
+
+        if (handler) {
+            m_handlers[t] = handler;
+        }
+
+        m_runningTransformers.insert(t);
+
+        connect(t, SIGNAL(finished()), this, SLOT(transformerFinished()));
+
+        t->start();
+        vector<ModelId> extracted = t->getOutputModels();
+
+        if (extracted.empty()) {
+            t->wait();
+        }
+
+        QString imn = inputModel->objectName();
+        
+        for (int i = 0; in_range_for(extracted, i); ++i) {
+            models[extractionIndices[i]] = extracted[i];
+            auto model = ModelById::get(extracted[i]);
+            if (!model) continue;
+            QString trn =
+                TransformFactory::getInstance()->getTransformFriendlyName
+                (extraction[i].getIdentifier());
+            if (imn != "") {
+                if (trn != "") {
+                    model->setObjectName(tr("%1: %2").arg(imn).arg(trn));
+                } else {
+                    model->setObjectName(imn);
+                }
+            } else if (trn != "") {
+                model->setObjectName(trn);
+            }
+        }
+
+        if (t->getMessage() != "") {
+            messages.push_back(t->getMessage());
+        }
+    }
+
+    message = messages.join("; ");
+
+    for (auto m: models) {
+        if (!m.isNone()) return models;
+    }
+    return {};
+}
+
 void
 ModelTransformerFactory::transformerFinished()
 {
@@ -339,3 +432,49 @@ ModelTransformerFactory::haveRunningTransformers() const
     
     return (!m_runningTransformers.empty());
 }
+
+bool
+ModelTransformerFactory::haveRunningTransformersFor(ModelId inputModel) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (ModelTransformer *t: m_runningTransformers) {
+        if (t->getInputModel() == inputModel) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+ModelTransformerFactory::setTransformPriority(ModelId outputModel,
+                                              int priority)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Every transformer in the running set has already delivered its
+    // output models, so getOutputModels does not block here
+    for (ModelTransformer *t: m_runningTransformers) {
+        for (auto m: t->getOutputModels()) {
+            if (m == outputModel) {
+                t->setPriority(priority);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void
+ModelTransformerFactory::abandonTransformsFor(ModelId inputModel)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (ModelTransformer *t: m_runningTransformers) {
+        if (t->getInputModel() == inputModel) {
+            t->abandon();
+        }
+    }
+    
+    TransformerScheduler::getInstance()->reschedule();
+}
@@ -148,7 +148,56 @@ public:
                                            QString &message,
                                            AdditionalModelHandler *handler = 0);
 
+    /**
+     * Return the output models resulting from applying any number of
+     * transforms, which may use different plugins, to the given input
+     * model. The feature extraction transforms are run together by a
+     * single FeatureExtractionFanOutModelTransformer, which reads
+     * each block of input once per distinct block, step and window
+     * configuration, calculates each FFT once, and runs the plugins
+     * on a pool of worker threads. Any real-time effect transforms
+     * are run separately as by transform().
+     *
+     * Models are returned in the same order as the transforms were
+     * given. If some transforms could not be run, a none id is
+     * returned in their place and message describes the problem; if
+     * none could be run, an empty vector is returned.
+     *
+     * If an additionalModelHandler is provided, it is called as for
+     * transformMultiple with the additional models of all the
+     * feature extraction transforms together.
+     */
+    std::vector<ModelId> transformSharingInput(const Transforms &transforms,
+                                               const ModelTransformer::Input &input,
+                                               QString &message,
+                                               AdditionalModelHandler *handler = 0);
+
     bool haveRunningTransformers() const;
+
+    /**
+     * Return true if any transformer whose input is the given model
+     * has not yet finished. A transformer counts as running until
+     * the factory has handled its finished() signal, which it does
+     * on the main thread.
+     */
+    bool haveRunningTransformersFor(ModelId inputModel) const;
+
+    /**
+     * Set the scheduling priority of the transformer producing the
+     * given output model, for example to have the transforms for the
+     * layers currently on view run before those that are not. See
+     * TransformerScheduler. Return false if no transformer is running
+     * or waiting to run for that model.
+     */
+    bool setTransformPriority(ModelId outputModel, int priority);
+
+    /**
+     * Abandon every transformer, running or waiting to run, whose
+     * input is the given model. Transformers that have not started
+     * processing give up their places in the TransformerScheduler
+     * queue.
+     */
+    void abandonTransformsFor(ModelId inputModel);
     
 signals:
     void transformFailed(QString transformName, QString message);
@@ -26,6 +26,7 @@
 #include "data/model/WaveFileModel.h"
 
 #include "TransformFactory.h"
+#include "TransformerScheduler.h"
 
 #include <iostream>
 
@@ -118,38 +119,24 @@ RealTimeEffectModelTransformer::run()
         return;
     }
 
-    bool ready = false;
-    while (!ready && !m_abandoned) {
-        { // scope so as to release input shared_ptr before sleeping
-            auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
-            if (!input) {
-                abandon();
-                return;
-            }
-            ready = input->isReady();
-        }
-        if (!ready) {
-            SVDEBUG << "RealTimeEffectModelTransformer::run: Waiting for input model to be ready..." << endl;
-            usleep(500000);
-        }
-    }
-    if (m_abandoned) return;
-
-    auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
-    if (!input) {
-        abandon();
+    TransformerScheduler::Slot slot(this);
+    if (!slot.isAcquired()) {
         return;
     }
 
+    // We don't wait for the input model to be ready, but follow it
+    // as it arrives, waiting for each block within the process loop
+
     sv_samplerate_t sampleRate;
     int channelCount;
     sv_frame_t startFrame;
     sv_frame_t endFrame;
+    bool inputComplete;
 
     { // scope so as not to have this borrowed pointer retained around
       // the edges of the process loop
         auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
-        if (!input) {
+        if (!input || !input->isOK()) {
             abandon();
             return;
         }
@@ -157,6 +144,7 @@ RealTimeEffectModelTransformer::run()
         sampleRate = input->getSampleRate();
         channelCount = input->getChannelCount();
         startFrame = input->getStartFrame();
+        inputComplete = input->isFullyAvailable();
         endFrame = input->getEndFrame();
     }
 
@@ -185,19 +173,23 @@ RealTimeEffectModelTransformer::run()
     sv_frame_t contextStart =
         RealTime::realTime2Frame(contextStartRT, sampleRate);
 
-    sv_frame_t contextDuration =
+    sv_frame_t requestedDuration =
         RealTime::realTime2Frame(contextDurationRT, sampleRate);
 
     if (contextStart == 0 || contextStart < startFrame) {
         contextStart = startFrame;
     }
 
-    if (contextDuration == 0) {
-        contextDuration = endFrame - contextStart;
-    }
-    if (contextStart + contextDuration > endFrame) {
-        contextDuration = endFrame - contextStart;
-    }
+    // Provisional until the input is complete
+    sv_frame_t contextDuration = 0;
+    auto updateContextDuration = [&]() {
+                                     contextDuration = requestedDuration;
+                                     if (contextDuration == 0 ||
+                                         contextStart + contextDuration > endFrame) {
+                                         contextDuration = endFrame - contextStart;
+                                     }
+                                 };
+    updateContextDuration();
 
     if (wwfm) {
         wwfm->setStartFrame(contextStart);
@@ -209,8 +201,26 @@ RealTimeEffectModelTransformer::run()
 
     sv_frame_t latency = m_plugin->getLatency();
 
-    while (blockFrame < contextStart + contextDuration + latency &&
-           !m_abandoned) {
+    while (!m_abandoned) {
+
+        if (!inputComplete) {
+            if (!awaitInputAvailable(blockFrame + blockSize)) {
+                abandon();
+                return;
+            }
+            auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
+            if (!input) {
+                abandon();
+                return;
+            }
+            inputComplete = input->isFullyAvailable();
+            endFrame = input->getEndFrame();
+            updateContextDuration();
+        }
+
+        if (blockFrame >= contextStart + contextDuration + latency) {
+            break;
+        }
 
         int completion = int
             ((((blockFrame - contextStart) / blockSize) * 99) /
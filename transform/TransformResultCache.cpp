@@ -0,0 +1,597 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "TransformResultCache.h"
+
+#include "data/model/ReadOnlyWaveFileModel.h"
+#include "data/model/SparseOneDimensionalModel.h"
+#include "data/model/SparseTimeValueModel.h"
+#include "data/model/NoteModel.h"
+#include "data/model/RegionModel.h"
+#include "data/model/BasicCompressedDenseThreeDimensionalModel.h"
+
+#include "base/TempDirectory.h"
+#include "base/Preferences.h"
+#include "base/Exceptions.h"
+#include "base/Debug.h"
+
+#include <QMutexLocker>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+
+#include <algorithm>
+#include <functional>
+
+//#define DEBUG_TRANSFORM_RESULT_CACHE 1
+
+static const quint32 cacheMagic = 0x53565443; // "SVTC"
+static const quint32 cacheVersion = 1;
+static const QString cacheSuffix = ".svtc";
+
+enum CachedModelType : quint8 {
+    CachedEvents = 1,
+    CachedDenseColumns = 2
+};
+
+enum CachedEventFlag : quint8 {
+    EventHasValue = 1,
+    EventHasDuration = 2,
+    EventHasLevel = 4,
+    EventHasReferenceFrame = 8,
+    EventHasLabel = 16,
+    EventHasURI = 32
+};
+
+TransformResultCache *
+TransformResultCache::m_instance = new TransformResultCache;
+
+TransformResultCache *
+TransformResultCache::getInstance()
+{
+    return m_instance;
+}
+
+TransformResultCache::TransformResultCache() :
+    m_currentSize(-1),
+    m_enabled(false),
+    m_maximumSize(int64_t(512) * 1024 * 1024),
+    m_hits(0),
+    m_misses(0),
+    m_stores(0),
+    m_evictions(0)
+{
+}
+
+void
+TransformResultCache::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void
+TransformResultCache::setMaximumSize(int64_t bytes)
+{
+    m_maximumSize = bytes;
+    if (m_enabled) {
+        QMutexLocker locker(&m_mutex);
+        evict();
+    }
+}
+
+QString
+TransformResultCache::getDirectory() const
+{
+    try {
+        QDir dir = TempDirectory::getInstance()->getContainingPath();
+        QString name("transform-cache");
+        QFileInfo fi(dir.filePath(name));
+        if ((fi.exists() && !fi.isDir()) ||
+            (!fi.exists() && !dir.mkdir(name))) {
+            SVCERR << "WARNING: TransformResultCache: Failed to create cache directory "
+                   << fi.filePath() << endl;
+            return "";
+        }
+        return fi.filePath();
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: TransformResultCache: " << f.what() << endl;
+        return "";
+    }
+}
+
+QString
+TransformResultCache::getContentHash(QString filename)
+{
+    QFileInfo fi(filename);
+    if (!fi.exists() || !fi.isFile()) {
+        return "";
+    }
+
+    QString id = QString("%1|%2|%3")
+        .arg(fi.absoluteFilePath())
+        .arg(fi.size())
+        .arg(fi.lastModified().toMSecsSinceEpoch());
+
+    {
+        // If another thread is already hashing this file, wait for
+        // it rather than reading the whole file again
+        QMutexLocker locker(&m_mutex);
+        while (m_hashesInProgress.find(id) != m_hashesInProgress.end()) {
+            m_hashCondition.wait(&m_mutex);
+        }
+        auto itr = m_contentHashes.find(id);
+        if (itr != m_contentHashes.end()) {
+            return itr->second;
+        }
+        m_hashesInProgress.insert(id);
+    }
+
+    // Hash without the lock held, as it may take a while. A failure
+    // is not remembered, so that the next caller tries again
+
+    QString result;
+    QFile file(filename);
+    if (file.open(QFile::ReadOnly)) {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        if (hash.addData(&file)) {
+            result = QString::fromLatin1(hash.result().toHex());
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (result != "") {
+        m_contentHashes[id] = result;
+    }
+    m_hashesInProgress.erase(id);
+    m_hashCondition.wakeAll();
+    return result;
+}
+
+QString
+TransformResultCache::getKey(const Transform &transform,
+                             const ModelTransformer::Input &input,
+                             QString pluginVersion)
+{
+    if (!m_enabled) return "";
+
+    QString filename;
+    QString inputProperties;
+
+    {
+        auto model = ModelById::getAs<ReadOnlyWaveFileModel>(input.getModel());
+        if (!model || !model->isOK()) {
+            return "";
+        }
+        filename = model->getLocalFilename();
+
+        // The sample rate, channel count, and normalisation (which
+        // is applied at load time according to the preference) can
+        // all differ between models read from the same file
+        bool normalised = Preferences::getInstance()->getNormaliseAudio();
+        inputProperties = QString("%1|%2|%3|%4|%5")
+            .arg(model->getSampleRate())
+            .arg(model->getChannelCount())
+            .arg(model->getStartFrame())
+            .arg(normalised)
+            .arg(input.getChannel());
+    }
+
+    if (filename == "") {
+        return "";
+    }
+
+    QString contentHash = getContentHash(filename);
+    if (contentHash == "") {
+        return "";
+    }
+
+    Transform t(transform);
+    t.setPluginVersion(pluginVersion);
+
+    QByteArray description;
+    description.append(QString("%1|%2|%3|%4")
+                       .arg(cacheVersion)
+                       .arg(contentHash)
+                       .arg(inputProperties)
+                       .arg(t.toXmlString())
+                       .toUtf8());
+
+    return QString::fromLatin1
+        (QCryptographicHash::hash(description,
+                                  QCryptographicHash::Sha1).toHex());
+}
+
+template <typename M>
+static bool
+writeEvents(QDataStream &out, ModelId id)
+{
+    auto model = ModelById::getAs<M>(id);
+    if (!model) return false;
+
+    EventVector events = model->getAllEvents();
+
+    out << quint8(CachedEvents) << quint64(events.size());
+
+    for (const auto &e: events) {
+        quint8 flags = 0;
+        if (e.hasValue()) flags |= EventHasValue;
+        if (e.hasDuration()) flags |= EventHasDuration;
+        if (e.hasLevel()) flags |= EventHasLevel;
+        if (e.hasReferenceFrame()) flags |= EventHasReferenceFrame;
+        if (e.hasLabel()) flags |= EventHasLabel;
+        if (e.hasUri()) flags |= EventHasURI;
+        out << flags << qint64(e.getFrame());
+        if (flags & EventHasValue) out << e.getValue();
+        if (flags & EventHasDuration) out << qint64(e.getDuration());
+        if (flags & EventHasLevel) out << e.getLevel();
+        if (flags & EventHasReferenceFrame) out << qint64(e.getReferenceFrame());
+        if (flags & EventHasLabel) out << e.getLabel();
+        if (flags & EventHasURI) out << e.getURI();
+    }
+
+    return true;
+}
+
+// The read functions parse an entry completely before touching the
+// model, returning a function that fills the model, or an empty
+// function if the entry is unreadable or the model of the wrong type
+
+typedef std::function<void()> Restorer;
+
+template <typename M>
+static Restorer
+readEvents(QDataStream &in, ModelId id)
+{
+    auto model = ModelById::getAs<M>(id);
+    if (!model) return {};
+
+    quint64 count = 0;
+    in >> count;
+
+    EventVector events;
+    for (quint64 i = 0; i < count; ++i) {
+        quint8 flags = 0;
+        qint64 frame = 0;
+        in >> flags >> frame;
+        Event e(frame);
+        if (flags & EventHasValue) {
+            float value; in >> value; e = e.withValue(value);
+        }
+        if (flags & EventHasDuration) {
+            qint64 duration; in >> duration; e = e.withDuration(duration);
+        }
+        if (flags & EventHasLevel) {
+            float level; in >> level; e = e.withLevel(level);
+        }
+        if (flags & EventHasReferenceFrame) {
+            qint64 ref; in >> ref; e = e.withReferenceFrame(ref);
+        }
+        if (flags & EventHasLabel) {
+            QString label; in >> label; e = e.withLabel(label);
+        }
+        if (flags & EventHasURI) {
+            QString uri; in >> uri; e = e.withURI(uri);
+        }
+        if (in.status() != QDataStream::Ok) {
+            return {};
+        }
+        events.push_back(e);
+    }
+
+    return [id, events]() {
+               auto model = ModelById::getAs<M>(id);
+               if (!model) return;
+               model->addEvents(events);
+           };
+}
+
+static bool
+writeColumns(QDataStream &out, ModelId id)
+{
+    auto model = ModelById::getAs<BasicCompressedDenseThreeDimensionalModel>(id);
+    if (!model) return false;
+
+    int width = model->getWidth();
+    out << quint8(CachedDenseColumns) << qint32(width);
+
+    for (int x = 0; x < width; ++x) {
+        auto column = model->getColumn(x);
+        out << quint32(column.size());
+        for (float v: column) {
+            out << v;
+        }
+    }
+
+    return true;
+}
+
+static Restorer
+readColumns(QDataStream &in, ModelId id)
+{
+    auto model = ModelById::getAs<BasicCompressedDenseThreeDimensionalModel>(id);
+    if (!model) return {};
+
+    qint32 width = 0;
+    in >> width;
+
+    std::vector<DenseThreeDimensionalModel::Column> columns;
+    for (qint32 x = 0; x < width; ++x) {
+        quint32 height = 0;
+        in >> height;
+        if (in.status() != QDataStream::Ok) {
+            return {};
+        }
+        DenseThreeDimensionalModel::Column column(height);
+        for (quint32 y = 0; y < height; ++y) {
+            in >> column[y];
+        }
+        columns.push_back(column);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return {};
+    }
+
+    return [id, columns]() {
+               auto model = ModelById::getAs
+                   <BasicCompressedDenseThreeDimensionalModel>(id);
+               if (!model) return;
+               for (int x = 0; in_range_for(columns, x); ++x) {
+                   model->setColumn(x, columns[x]);
+               }
+           };
+}
+
+bool
+TransformResultCache::restore(const std::vector<QString> &keys,
+                              const ModelTransformer::Models &models)
+{
+    if (!m_enabled || keys.empty() || keys.size() != models.size()) {
+        return false;
+    }
+
+    QString dir = getDirectory();
+    if (dir == "") return false;
+
+    std::vector<Restorer> restorers;
+
+    for (int i = 0; in_range_for(keys, i); ++i) {
+
+        if (keys[i] == "") {
+            return false;
+        }
+        
+        QFile file(QDir(dir).filePath(keys[i] + cacheSuffix));
+        if (!file.open(QFile::ReadOnly)) {
+            ++m_misses;
+            return false;
+        }
+
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_0);
+        in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+        quint32 magic = 0, version = 0;
+        quint8 type = 0;
+        in >> magic >> version >> type;
+
+        Restorer restorer;
+        if (magic == cacheMagic && version == cacheVersion) {
+            if (type == CachedEvents) {
+                if (!(restorer = readEvents<SparseOneDimensionalModel>(in, models[i])) &&
+                    !(restorer = readEvents<SparseTimeValueModel>(in, models[i])) &&
+                    !(restorer = readEvents<NoteModel>(in, models[i]))) {
+                    restorer = readEvents<RegionModel>(in, models[i]);
+                }
+            } else if (type == CachedDenseColumns) {
+                restorer = readColumns(in, models[i]);
+            }
+        }
+
+        if (!restorer) {
+            SVDEBUG << "TransformResultCache::restore: Entry " << keys[i]
+                    << " is unreadable or does not match model type" << endl;
+            ++m_misses;
+            return false;
+        }
+
+        restorers.push_back(restorer);
+    }
+
+    for (const auto &r: restorers) {
+        r();
+    }
+
+    // Eviction goes by modification time, so mark the entries as
+    // recently used. (Older Qt can't set the time, in which case
+    // entries are evicted in the order they were written)
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    QDateTime now = QDateTime::currentDateTime();
+    for (const auto &key: keys) {
+        QFile file(QDir(dir).filePath(key + cacheSuffix));
+        if (file.open(QFile::ReadWrite)) {
+            file.setFileTime(now, QFileDevice::FileModificationTime);
+        }
+    }
+#endif
+
+    m_hits += int64_t(keys.size());
+
+#ifdef DEBUG_TRANSFORM_RESULT_CACHE
+    SVDEBUG << "TransformResultCache::restore: Restored " << keys.size()
+            << " model(s)" << endl;
+#endif
+
+    return true;
+}
+
+bool
+TransformResultCache::store(QString key, ModelId model)
+{
+    if (!m_enabled || key == "") return false;
+
+    QString dir = getDirectory();
+    if (dir == "") return false;
+
+    QString path = QDir(dir).filePath(key + cacheSuffix);
+    QString tmpPath = path + ".tmp";
+
+    {
+        QFile file(tmpPath);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            SVCERR << "WARNING: TransformResultCache::store: Failed to open "
+                   << tmpPath << " for writing" << endl;
+            return false;
+        }
+
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_5_0);
+        out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+        out << cacheMagic << cacheVersion;
+
+        bool ok = (writeEvents<SparseOneDimensionalModel>(out, model) ||
+                   writeEvents<SparseTimeValueModel>(out, model) ||
+                   writeEvents<NoteModel>(out, model) ||
+                   writeEvents<RegionModel>(out, model) ||
+                   writeColumns(out, model));
+
+        if (!ok || out.status() != QDataStream::Ok) {
+            file.close();
+            QFile::remove(tmpPath);
+            return false;
+        }
+    }
+
+    // Write then rename, so that a reader in another process never
+    // sees a partial entry
+
+    QMutexLocker locker(&m_mutex);
+
+    updateCurrentSize();
+
+    QFileInfo previous(path);
+    if (previous.exists()) {
+        m_currentSize -= previous.size();
+    }
+    QFile::remove(path);
+    if (!QFile::rename(tmpPath, path)) {
+        QFile::remove(tmpPath);
+        return false;
+    }
+    m_currentSize += QFileInfo(path).size();
+
+    ++m_stores;
+
+#ifdef DEBUG_TRANSFORM_RESULT_CACHE
+    SVDEBUG << "TransformResultCache::store: key " << key << ", model "
+            << model << ", " << QFileInfo(path).size() << " bytes" << endl;
+#endif
+
+    evict();
+    return true;
+}
+
+void
+TransformResultCache::updateCurrentSize() const
+{
+    // Call with m_mutex held
+
+    if (m_currentSize >= 0) {
+        return;
+    }
+
+    QString dir = getDirectory();
+    if (dir == "") return;
+
+    QFileInfoList entries = QDir(dir).entryInfoList
+        (QStringList() << ("*" + cacheSuffix), QDir::Files);
+    int64_t total = 0;
+    for (const auto &fi: entries) {
+        total += fi.size();
+    }
+    m_currentSize = total;
+}
+
+void
+TransformResultCache::evict()
+{
+    // Call with m_mutex held
+
+    // We keep a running total of the size of the cache, and only
+    // list the directory once it exceeds the maximum. The total does
+    // not see entries written by other processes sharing the cache,
+    // so we take the opportunity to correct it from the listing here
+
+    updateCurrentSize();
+    if (m_currentSize <= m_maximumSize) {
+        return;
+    }
+
+    QString dir = getDirectory();
+    if (dir == "") return;
+
+    QFileInfoList entries = QDir(dir).entryInfoList
+        (QStringList() << ("*" + cacheSuffix), QDir::Files, QDir::Time);
+
+    int64_t total = 0;
+    for (const auto &fi: entries) {
+        total += fi.size();
+    }
+
+    // Sorted newest first, so remove from the end
+    while (total > m_maximumSize && !entries.empty()) {
+        QFileInfo fi = entries.takeLast();
+        if (QFile::remove(fi.filePath())) {
+            total -= fi.size();
+            ++m_evictions;
+        }
+    }
+
+    m_currentSize = total;
+}
+
+void
+TransformResultCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QString dir = getDirectory();
+    if (dir == "") return;
+
+    QFileInfoList entries = QDir(dir).entryInfoList
+        (QStringList() << ("*" + cacheSuffix), QDir::Files);
+    for (const auto &fi: entries) {
+        QFile::remove(fi.filePath());
+    }
+
+    m_currentSize = -1;
+}
+
+int64_t
+TransformResultCache::getCurrentSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    updateCurrentSize();
+    return std::max(m_currentSize, int64_t(0));
+}
+
+TransformResultCache::Counts
+TransformResultCache::getCounts() const
+{
+    return { m_hits, m_misses, m_stores, m_evictions };
+}
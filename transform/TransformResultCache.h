@@ -0,0 +1,138 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_TRANSFORM_RESULT_CACHE_H
+#define SV_TRANSFORM_RESULT_CACHE_H
+
+#include "Transform.h"
+#include "ModelTransformer.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <vector>
+#include <cstdint>
+
+/**
+ * An on-disk cache of the output models of feature extraction
+ * transforms, so that running the same transform with the same
+ * parameters on the same audio again (for example when a session is
+ * reopened) can restore the results rather than recalculating them.
+ *
+ * An entry is keyed by a hash of the contents of the input audio
+ * file, the input model's sample rate and channel count, the input
+ * channel, the transform as serialised to XML, and the version of
+ * the plugin. Only inputs that are read directly from a local audio
+ * file can be cached, as there is otherwise no content to hash.
+ *
+ * Entries are kept in a compact binary form in a directory alongside
+ * the application's temporary directory. Sparse (event-based) models
+ * and BasicCompressedDenseThreeDimensionalModels are supported. When
+ * the cache exceeds its maximum size, the least recently used entries
+ * are removed.
+ *
+ * The cache is disabled by default. TransformResultCache is
+ * thread-safe.
+ */
+class TransformResultCache
+{
+public:
+    static TransformResultCache *getInstance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+
+    /**
+     * Set the maximum total size of the cache in bytes. The default
+     * is 512MB.
+     */
+    void setMaximumSize(int64_t bytes);
+    int64_t getMaximumSize() const { return m_maximumSize; }
+
+    /**
+     * Return the cache key for the results of the given transform on
+     * the given input, with the given plugin version, or an empty
+     * string if the input cannot be cached. The first call for a
+     * given input file reads the whole file to hash it; concurrent
+     * calls for the same file wait for that one rather than reading
+     * it again.
+     */
+    QString getKey(const Transform &transform,
+                   const ModelTransformer::Input &input,
+                   QString pluginVersion);
+
+    /**
+     * Fill the given (empty) models from the cache entries with the
+     * corresponding keys. Either all of the models are filled, or,
+     * if any entry is missing, unreadable, or of the wrong type for
+     * its model, none of them is and false is returned.
+     */
+    bool restore(const std::vector<QString> &keys,
+                 const ModelTransformer::Models &models);
+
+    /**
+     * Store the contents of the given model, which should be
+     * complete, in the cache under the given key. Return false if
+     * the model is of a type that cannot be cached, or if it could
+     * not be written.
+     */
+    bool store(QString key, ModelId model);
+
+    /**
+     * Remove every entry from the cache.
+     */
+    void clear();
+
+    /**
+     * Return the current total size of the entries in bytes.
+     */
+    int64_t getCurrentSize() const;
+
+    struct Counts {
+        int64_t hits;
+        int64_t misses;
+        int64_t stores;
+        int64_t evictions;
+    };
+
+    Counts getCounts() const;
+
+private:
+    TransformResultCache();
+
+    QString getDirectory() const;
+    QString getContentHash(QString filename);
+    void updateCurrentSize() const;
+    void evict();
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_hashCondition;
+    std::map<QString, QString> m_contentHashes; // path/size/time -> hash
+    std::set<QString> m_hashesInProgress;
+    mutable int64_t m_currentSize; // bytes, or -1 if not yet known
+    std::atomic<bool> m_enabled;
+    std::atomic<int64_t> m_maximumSize;
+    std::atomic<int64_t> m_hits;
+    std::atomic<int64_t> m_misses;
+    std::atomic<int64_t> m_stores;
+    std::atomic<int64_t> m_evictions;
+
+    static TransformResultCache *m_instance;
+};
+
+#endif
@@ -0,0 +1,328 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "TransformerScheduler.h"
+#include "ModelTransformer.h"
+
+#include "base/Debug.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+
+//#define DEBUG_TRANSFORMER_SCHEDULER 1
+
+TransformerScheduler *
+TransformerScheduler::m_instance = new TransformerScheduler;
+
+TransformerScheduler *
+TransformerScheduler::getInstance()
+{
+    return m_instance;
+}
+
+TransformerScheduler::TransformerScheduler() :
+    m_nextSequence(0),
+    m_workerCount(0),
+    m_metrics({ 0, 0, 0, 0, 0, 0, 0, 0 })
+{
+}
+
+void
+TransformerScheduler::setWorkerCount(int count)
+{
+    if (count < 0) count = 0;
+    m_workerCount = count;
+    reschedule();
+}
+
+int
+TransformerScheduler::getWorkerCount() const
+{
+    return getEffectiveWorkerCount();
+}
+
+int
+TransformerScheduler::getEffectiveWorkerCount() const
+{
+    int count = m_workerCount;
+    if (count == 0) {
+        count = QThread::idealThreadCount();
+    }
+    if (count < 1) {
+        count = 1;
+    }
+    return count;
+}
+
+ModelTransformer *
+TransformerScheduler::chooseNext() const
+{
+    // Call with m_mutex held
+
+    ModelTransformer *best = nullptr;
+    int bestPriority = 0;
+    int bestShare = 0;
+    int64_t bestSequence = 0;
+
+    for (const auto &j: m_jobs) {
+
+        // A suspended job is not waiting for a slot, so it must not
+        // stand in the way of those that are (one of which may be
+        // the producer of the input it is waiting for)
+        if (j.second.running || j.second.suspended ||
+            j.first->isAbandoned()) {
+            continue;
+        }
+
+        int priority = j.first->getPriority();
+        int share = 0;
+        auto ritr = m_runningPerInput.find(j.second.input);
+        if (ritr != m_runningPerInput.end()) {
+            share = ritr->second;
+        }
+        int64_t sequence = j.second.sequence;
+
+        if (!best ||
+            priority > bestPriority ||
+            (priority == bestPriority &&
+             (share < bestShare ||
+              (share == bestShare && sequence < bestSequence)))) {
+            best = j.first;
+            bestPriority = priority;
+            bestShare = share;
+            bestSequence = sequence;
+        }
+    }
+
+    return best;
+}
+
+bool
+TransformerScheduler::acquire(ModelTransformer *t)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto itr = m_jobs.find(t);
+    if (itr == m_jobs.end()) {
+        Job job;
+        job.input = t->getInputModel();
+        job.sequence = m_nextSequence++;
+        job.running = false;
+        job.suspended = false;
+        job.extra = 0;
+        itr = m_jobs.insert({ t, job }).first;
+    } else if (itr->second.running) {
+        return true;
+    }
+
+    // A suspended job resuming keeps its original sequence number,
+    // and so its place ahead of those that queued after it
+    Job &job = itr->second;
+    job.suspended = false;
+    job.timer.start();
+
+    ++m_metrics.queued;
+    if (m_metrics.queued > m_metrics.peakQueued) {
+        m_metrics.peakQueued = m_metrics.queued;
+    }
+
+#ifdef DEBUG_TRANSFORMER_SCHEDULER
+    SVDEBUG << "TransformerScheduler::acquire: transformer " << t
+            << " for input " << job.input << " queued behind "
+            << m_metrics.running << " running" << endl;
+#endif
+
+    while (true) {
+        if (t->isAbandoned()) {
+            --m_metrics.queued;
+            ++m_metrics.cancelled;
+            m_jobs.erase(itr);
+            m_condition.wakeAll();
+            return false;
+        }
+        if (m_metrics.running < getEffectiveWorkerCount() &&
+            chooseNext() == t) {
+            break;
+        }
+        // Timed, so as to notice abandonment, which is not signalled
+        m_condition.wait(&m_mutex, 100);
+    }
+
+    int64_t waited = job.timer.restart();
+    m_metrics.totalWaitMsec += waited;
+    if (waited > m_metrics.maxWaitMsec) {
+        m_metrics.maxWaitMsec = waited;
+    }
+
+    --m_metrics.queued;
+    ++m_metrics.running;
+    ++m_runningPerInput[job.input];
+    job.running = true;
+
+#ifdef DEBUG_TRANSFORMER_SCHEDULER
+    SVDEBUG << "TransformerScheduler::acquire: transformer " << t
+            << " running after waiting " << waited << "ms" << endl;
+#endif
+
+    // Another slot may still be free for the next in the queue
+    m_condition.wakeAll();
+    return true;
+}
+
+void
+TransformerScheduler::stopRunning(Job &job)
+{
+    // Call with m_mutex held
+
+    dropExtraSlots(job);
+    m_metrics.totalRunMsec += job.timer.restart();
+    --m_metrics.running;
+    if (--m_runningPerInput[job.input] <= 0) {
+        m_runningPerInput.erase(job.input);
+    }
+    job.running = false;
+}
+
+void
+TransformerScheduler::dropExtraSlots(Job &job)
+{
+    // Call with m_mutex held
+
+    if (job.extra == 0) {
+        return;
+    }
+    m_metrics.running -= job.extra;
+    if ((m_runningPerInput[job.input] -= job.extra) <= 0) {
+        m_runningPerInput.erase(job.input);
+    }
+    job.extra = 0;
+}
+
+int
+TransformerScheduler::claimExtraSlots(ModelTransformer *t, int wanted)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto itr = m_jobs.find(t);
+    if (itr == m_jobs.end() || !itr->second.running || wanted <= 0) {
+        return 0;
+    }
+
+    int waiting = 0;
+    for (const auto &j: m_jobs) {
+        if (!j.second.running && !j.second.suspended &&
+            !j.first->isAbandoned()) {
+            ++waiting;
+        }
+    }
+
+    int spare = getEffectiveWorkerCount() - m_metrics.running - waiting;
+    int n = std::max(0, std::min(wanted, spare));
+    if (n > 0) {
+        Job &job = itr->second;
+        job.extra += n;
+        m_metrics.running += n;
+        m_runningPerInput[job.input] += n;
+    }
+
+#ifdef DEBUG_TRANSFORMER_SCHEDULER
+    SVDEBUG << "TransformerScheduler::claimExtraSlots: transformer " << t
+            << " wanted " << wanted << ", took " << n << endl;
+#endif
+
+    return n;
+}
+
+void
+TransformerScheduler::releaseExtraSlots(ModelTransformer *t)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto itr = m_jobs.find(t);
+    if (itr == m_jobs.end()) {
+        return;
+    }
+
+    dropExtraSlots(itr->second);
+    m_condition.wakeAll();
+}
+
+void
+TransformerScheduler::release(ModelTransformer *t)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto itr = m_jobs.find(t);
+    if (itr == m_jobs.end()) {
+        return;
+    }
+
+    if (itr->second.running) {
+        stopRunning(itr->second);
+        ++m_metrics.completed;
+    }
+
+    m_jobs.erase(itr);
+    m_condition.wakeAll();
+}
+
+bool
+TransformerScheduler::suspend(ModelTransformer *t)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto itr = m_jobs.find(t);
+    if (itr == m_jobs.end() || !itr->second.running) {
+        return false;
+    }
+
+#ifdef DEBUG_TRANSFORMER_SCHEDULER
+    SVDEBUG << "TransformerScheduler::suspend: transformer " << t << endl;
+#endif
+
+    stopRunning(itr->second);
+    itr->second.suspended = true;
+    m_condition.wakeAll();
+    return true;
+}
+
+void
+TransformerScheduler::reschedule()
+{
+    QMutexLocker locker(&m_mutex);
+    m_condition.wakeAll();
+}
+
+TransformerScheduler::Metrics
+TransformerScheduler::getMetrics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_metrics;
+}
+
+void
+TransformerScheduler::resetMetrics()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // The current queue and running counts are state, not history
+    m_metrics.peakQueued = m_metrics.queued;
+    m_metrics.completed = 0;
+    m_metrics.cancelled = 0;
+    m_metrics.totalWaitMsec = 0;
+    m_metrics.maxWaitMsec = 0;
+    m_metrics.totalRunMsec = 0;
+}
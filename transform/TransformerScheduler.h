@@ -0,0 +1,187 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_TRANSFORMER_SCHEDULER_H
+#define SV_TRANSFORMER_SCHEDULER_H
+
+#include "data/model/Model.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <map>
+#include <cstdint>
+
+class ModelTransformer;
+
+/**
+ * Limits how many ModelTransformers may process at once.
+ *
+ * Each transformer still has its own thread, because a plugin must be
+ * constructed, run and destroyed on a single thread, and because the
+ * transformer's output models are created on that thread before the
+ * caller of ModelTransformerFactory gets them back. But before it
+ * starts reading its input, a transformer obtains a slot from this
+ * scheduler, blocking until one is free, and it gives the slot up
+ * again when it finishes, or while it waits for more input to arrive.
+ * So applying a transform to many files, or loading a session with
+ * many derived layers, runs only as many transforms at a time as
+ * there are slots (by default, one per processor core) rather than
+ * all of them at once.
+ *
+ * When a slot becomes free, it goes to the waiting transformer with
+ * the highest priority (see ModelTransformer::setPriority). Among
+ * those of equal priority, it goes to one whose input model has the
+ * fewest transformers already running, so that one input cannot
+ * starve the others, and then to the one that has waited longest.
+ *
+ * A waiting transformer that is abandoned gives up its place in the
+ * queue. A suspended transformer keeps its place, but is passed over
+ * until it asks for a slot again.
+ */
+class TransformerScheduler
+{
+public:
+    static TransformerScheduler *getInstance();
+
+    /**
+     * Set the number of transformers that may process at once. If
+     * zero (the default), the number of processor cores is used.
+     */
+    void setWorkerCount(int count);
+
+    /**
+     * Return the number of transformers that may process at once.
+     */
+    int getWorkerCount() const;
+
+    /**
+     * Wait for a slot for the given transformer, and return true once
+     * it has one, or false if the transformer was abandoned while
+     * waiting. Return true at once if it already has a slot. Called
+     * from the transformer's own thread.
+     */
+    bool acquire(ModelTransformer *);
+
+    /**
+     * Give up the transformer's slot or its place in the queue, as
+     * it has finished.
+     */
+    void release(ModelTransformer *);
+
+    /**
+     * Give up the transformer's slot for now, for example while it
+     * waits for input from another transformer. The slot is not
+     * offered back to it until it calls acquire() to resume, when it
+     * is queued ahead of those that arrived after it. Return true if
+     * the transformer had a slot.
+     */
+    bool suspend(ModelTransformer *);
+
+    /**
+     * Take up to the given number of further slots for a transformer
+     * that already has one, for it to run additional threads of its
+     * own on. Only slots that are free and not wanted by any waiting
+     * transformer are taken; this does not wait. Return the number
+     * taken, which may be zero. The slots are given up with
+     * releaseExtraSlots(), or with the transformer's own slot.
+     */
+    int claimExtraSlots(ModelTransformer *, int wanted);
+
+    /**
+     * Give up any further slots taken with claimExtraSlots().
+     */
+    void releaseExtraSlots(ModelTransformer *);
+
+    /**
+     * Re-evaluate the queue, after a priority has changed or a
+     * waiting transformer has been abandoned.
+     */
+    void reschedule();
+
+    struct Metrics {
+        /// Transformers currently waiting for a slot
+        int queued;
+        /// Transformers currently holding a slot
+        int running;
+        /// The largest number of transformers that have waited at once
+        int peakQueued;
+        /// Transformers that have finished after running
+        int64_t completed;
+        /// Transformers abandoned while waiting
+        int64_t cancelled;
+        /// Total and longest time spent waiting for a slot
+        int64_t totalWaitMsec;
+        int64_t maxWaitMsec;
+        /// Total time spent holding a slot
+        int64_t totalRunMsec;
+    };
+
+    Metrics getMetrics() const;
+    void resetMetrics();
+
+    /**
+     * Holds a slot for the lifetime of the object, for use at the
+     * top of a transformer's run function.
+     */
+    class Slot {
+    public:
+        Slot(ModelTransformer *t) :
+            m_transformer(t),
+            m_acquired(getInstance()->acquire(t)) { }
+        ~Slot() {
+            getInstance()->release(m_transformer);
+        }
+        bool isAcquired() const { return m_acquired; }
+
+    private:
+        ModelTransformer *m_transformer;
+        bool m_acquired;
+        Slot(const Slot &) =delete;
+        Slot &operator=(const Slot &) =delete;
+    };
+
+private:
+    TransformerScheduler();
+
+    struct Job {
+        ModelId input;
+        int64_t sequence;
+        bool running;
+        bool suspended; // gave up its slot, and is not asking for one
+        int extra; // further slots held, see claimExtraSlots
+        QElapsedTimer timer; // since queued, or since started running
+    };
+
+    typedef std::map<ModelTransformer *, Job> JobMap;
+
+    int getEffectiveWorkerCount() const;
+    ModelTransformer *chooseNext() const;
+    void stopRunning(Job &job);
+    void dropExtraSlots(Job &job);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    JobMap m_jobs;
+    std::map<ModelId, int> m_runningPerInput;
+    int64_t m_nextSequence;
+    std::atomic<int> m_workerCount;
+    Metrics m_metrics;
+
+    static TransformerScheduler *m_instance;
+};
+
+#endif
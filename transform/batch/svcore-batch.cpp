@@ -0,0 +1,177 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    This file copyright 2026 QMUL.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+/*
+ * A small command-line front end for BatchAnalysisRunner: apply one
+ * or more transforms to a list of audio files, writing CSV through
+ * CSVFeatureWriter and reporting timings on stderr.
+ */
+
+#include "transform/BatchAnalysisRunner.h"
+#include "transform/CSVFeatureWriter.h"
+#include "transform/TransformFactory.h"
+#include "transform/TransformResultCache.h"
+
+#include "system/Init.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include <iostream>
+#include <map>
+#include <string>
+
+using std::cerr;
+using std::endl;
+
+static void
+usage(QString name)
+{
+    cerr << "Usage: " << name.toStdString() << " [options] <audiofile> ...\n"
+         << "\n"
+         << "  -t <file>            Apply the transform described in the given XML file\n"
+         << "  -T <id>              Apply the transform with the given id, with defaults\n"
+         << "  -j <n>               Process at most n files at once (default: one per core)\n"
+         << "  -r <rate>            Decode audio at the given sample rate\n"
+         << "  -w <name>[=<value>]  Set a CSV writer parameter, e.g. -w basedir=out\n"
+         << "  -c                   Use the on-disk transform result cache\n"
+         << "  -h                   Show this help\n"
+         << "\n"
+         << "At least one transform must be given. Features are written as CSV, and\n"
+         << "a timing and throughput report for each file is printed on stderr.\n"
+         << endl;
+}
+
+int main(int argc, char **argv)
+{
+    svSystemSpecificInitialisation();
+
+    QCoreApplication app(argc, argv);
+    app.setOrganizationName("sonic-visualiser");
+    app.setApplicationName("svcore-batch");
+
+    QStringList args = app.arguments();
+    QString name = args.empty() ? "svcore-batch" : args[0];
+
+    Transforms transforms;
+    QStringList paths;
+    std::map<std::string, std::string> writerParameters;
+    int workers = 0;
+    sv_samplerate_t rate = 0;
+
+    for (int i = 1; i < args.size(); ++i) {
+
+        QString arg = args[i];
+        bool hasValue = (i + 1 < args.size());
+
+        if (arg == "-h" || arg == "--help") {
+            usage(name);
+            return 0;
+
+        } else if (arg == "-c") {
+            TransformResultCache::getInstance()->setEnabled(true);
+
+        } else if (arg == "-t" && hasValue) {
+            QFile file(args[++i]);
+            if (!file.open(QFile::ReadOnly | QFile::Text)) {
+                cerr << name.toStdString() << ": Failed to open transform file \""
+                     << file.fileName().toStdString() << "\"" << endl;
+                return 2;
+            }
+            transforms.push_back(Transform(QTextStream(&file).readAll()));
+
+        } else if (arg == "-T" && hasValue) {
+            QString id = args[++i];
+            if (!TransformFactory::getInstance()->haveTransform(id)) {
+                cerr << name.toStdString() << ": Unknown transform \""
+                     << id.toStdString() << "\"" << endl;
+                return 2;
+            }
+            transforms.push_back
+                (TransformFactory::getInstance()->getDefaultTransformFor(id));
+
+        } else if (arg == "-j" && hasValue) {
+            workers = args[++i].toInt();
+
+        } else if (arg == "-r" && hasValue) {
+            rate = args[++i].toDouble();
+
+        } else if (arg == "-w" && hasValue) {
+            QString p = args[++i];
+            int eq = p.indexOf('=');
+            if (eq < 0) {
+                writerParameters[p.toStdString()] = "";
+            } else {
+                writerParameters[p.left(eq).toStdString()] =
+                    p.mid(eq + 1).toStdString();
+            }
+
+        } else if (arg.startsWith("-")) {
+            usage(name);
+            return 2;
+
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (transforms.empty() || paths.empty()) {
+        usage(name);
+        return 2;
+    }
+
+    CSVFeatureWriter writer;
+    writer.setParameters(writerParameters);
+
+    BatchAnalysisRunner runner(&writer);
+    runner.setWorkerCount(workers);
+    runner.setSampleRate(rate);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<BatchAnalysisRunner::FileReport> reports =
+        runner.run(paths, transforms);
+
+    try {
+        writer.finish();
+    } catch (const std::exception &e) {
+        cerr << name.toStdString() << ": Failed to finish writing: "
+             << e.what() << endl;
+        return 1;
+    }
+
+    double elapsed = double(timer.elapsed()) / 1000.0;
+    double audio = 0.0;
+    bool allOK = true;
+    for (const auto &r: reports) {
+        if (r.ok && r.sampleRate > 0) {
+            audio += double(r.frameCount) / r.sampleRate;
+        }
+        if (!r.ok) {
+            allOK = false;
+        }
+    }
+
+    cerr << BatchAnalysisRunner::formatReports(reports).toStdString() << endl;
+    cerr << QString("Batch took %1s (%2x real time overall)")
+        .arg(elapsed, 0, 'f', 2)
+        .arg(elapsed > 0.0 ? audio / elapsed : 0.0, 0, 'f', 1)
+        .toStdString() << endl;
+
+    return allOK ? 0 : 1;
+}
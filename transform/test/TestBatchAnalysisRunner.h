@@ -0,0 +1,130 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_BATCH_ANALYSIS_RUNNER_H
+#define TEST_BATCH_ANALYSIS_RUNNER_H
+
+#include "../BatchAnalysisRunner.h"
+#include "../FeatureWriter.h"
+#include "../TransformFactory.h"
+
+#include "data/fileio/WavFileWriter.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <cmath>
+
+using namespace std;
+
+// A writer that only counts what it is given
+class CountingFeatureWriter : public FeatureWriter
+{
+public:
+    CountingFeatureWriter() : m_count(0) { }
+
+    string getDescription() const override { return "Counting writer"; }
+    void write(QString, const Transform &,
+               const Vamp::Plugin::OutputDescriptor &,
+               const Vamp::Plugin::FeatureList &features,
+               std::string) override {
+        m_count += int(features.size());
+    }
+    void finish() override { }
+    QString getWriterTag() const override { return "counting"; }
+
+    int getCount() const { return m_count; }
+
+private:
+    int m_count;
+};
+
+class TestBatchAnalysisRunner : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_dir;
+
+    // Write a second of a 440Hz sine wave, returning the file's path
+    QString writeWav(QString name) {
+        QString path = m_dir.filePath(name);
+        WavFileWriter writer(path, 44100, 1, WavFileWriter::WriteToTarget);
+        vector<float> samples(44100);
+        for (int i = 0; in_range_for(samples, i); ++i) {
+            samples[i] = float(0.5 * sin(2.0 * M_PI * 440.0 * i / 44100.0));
+        }
+        float *channels[] = { samples.data() };
+        writer.writeSamples(channels, sv_frame_t(samples.size()));
+        writer.close();
+        return path;
+    }
+
+private slots:
+    void missingFile() {
+        CountingFeatureWriter writer;
+        BatchAnalysisRunner runner(&writer);
+        Transforms transforms { Transform() };
+        auto reports = runner.run({ m_dir.filePath("nonexistent.wav") },
+                                  transforms);
+        QCOMPARE(int(reports.size()), 1);
+        QVERIFY(!reports[0].ok);
+        QCOMPARE(writer.getCount(), 0);
+    }
+
+    void noUsableTransform() {
+        // The file is decoded even though no transform runs, and its
+        // model has to be released cleanly afterwards
+        QString path = writeWav("tone.wav");
+        CountingFeatureWriter writer;
+        BatchAnalysisRunner runner(&writer);
+        Transform t;
+        t.setPluginIdentifier("vamp:no-such-library:no-such-plugin");
+        t.setOutput("no-such-output");
+        auto reports = runner.run({ path }, { t });
+        QCOMPARE(int(reports.size()), 1);
+        QVERIFY(!reports[0].ok);
+        QCOMPARE(reports[0].sampleRate, 44100.0);
+        QCOMPARE(reports[0].channelCount, 1);
+        QCOMPARE(writer.getCount(), 0);
+    }
+
+    void amplitude() {
+        TransformId id =
+            "vamp:vamp-example-plugins:amplitudefollower:amplitude";
+        if (!TransformFactory::getInstance()->haveTransform(id)) {
+            QSKIP("Vamp example plugins not available");
+        }
+        QStringList paths;
+        paths << writeWav("a.wav") << writeWav("b.wav") << writeWav("c.wav");
+        CountingFeatureWriter writer;
+        BatchAnalysisRunner runner(&writer);
+        runner.setWorkerCount(2);
+        auto reports = runner.run
+            (paths,
+             { TransformFactory::getInstance()->getDefaultTransformFor(id) });
+        QCOMPARE(int(reports.size()), 3);
+        int64_t total = 0;
+        for (const auto &r: reports) {
+            QVERIFY(r.ok);
+            QCOMPARE(r.frameCount, sv_frame_t(44100));
+            QVERIFY(r.featureCount > 0);
+            QVERIFY(r.decodeMsec <= r.analysisMsec);
+            total += r.featureCount;
+        }
+        QCOMPARE(int64_t(writer.getCount()), total);
+    }
+};
+
+#endif
@@ -0,0 +1,220 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_FEATURE_EXTRACTION_FAN_OUT_H
+#define TEST_FEATURE_EXTRACTION_FAN_OUT_H
+
+#include "../FeatureExtractionFanOutModelTransformer.h"
+#include "../FeatureExtractionModelTransformer.h"
+#include "../TransformFactory.h"
+
+#include "data/model/ReadOnlyWaveFileModel.h"
+#include "data/model/SparseTimeValueModel.h"
+#include "data/fileio/WavFileWriter.h"
+#include "data/fileio/FileSource.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <cmath>
+
+using namespace std;
+
+class TestFeatureExtractionFanOut : public QObject
+{
+    Q_OBJECT
+
+    typedef FeatureExtractionFanOutModelTransformer FanOut;
+
+    QTemporaryDir m_dir;
+
+    Transform makeTransform(QString plugin, QString output,
+                            int blockSize, int stepSize) {
+        Transform t;
+        t.setPluginIdentifier(plugin);
+        t.setOutput(output);
+        t.setBlockSize(blockSize);
+        t.setStepSize(stepSize);
+        return t;
+    }
+
+    FanOut::PassProperties makePlugin(int blockSize, int stepSize,
+                                      bool frequencyDomain,
+                                      int channelCount = 1) {
+        FanOut::PassProperties p;
+        p.transform = makeTransform("vamp:lib:plugin", "output",
+                                    blockSize, stepSize);
+        p.frequencyDomain = frequencyDomain;
+        p.channelCount = channelCount;
+        return p;
+    }
+
+    ModelId makeId(int n) {
+        ModelId id;
+        id.untyped = n;
+        return id;
+    }
+
+    // Write two seconds of a rising sweep, returning the file's path
+    QString writeSweep() {
+        QString path = m_dir.filePath("sweep.wav");
+        WavFileWriter writer(path, 44100, 1, WavFileWriter::WriteToTarget);
+        vector<float> samples(88200);
+        double phase = 0.0;
+        for (int i = 0; in_range_for(samples, i); ++i) {
+            phase += 2.0 * M_PI * (100.0 + i / 20.0) / 44100.0;
+            samples[i] = float(0.5 * sin(phase));
+        }
+        float *channels[] = { samples.data() };
+        writer.writeSamples(channels, sv_frame_t(samples.size()));
+        writer.close();
+        return path;
+    }
+
+    void compareEvents(ModelId id0, ModelId id1) {
+        auto m0 = ModelById::getAs<SparseTimeValueModel>(id0);
+        auto m1 = ModelById::getAs<SparseTimeValueModel>(id1);
+        QVERIFY(m0);
+        QVERIFY(m1);
+        EventVector a = m0->getAllEvents();
+        EventVector b = m1->getAllEvents();
+        QVERIFY(!a.empty());
+        QCOMPARE(b.size(), a.size());
+        for (int i = 0; in_range_for(a, i); ++i) {
+            QCOMPARE(b[i], a[i]);
+        }
+    }
+
+private slots:
+    void similarTransforms() {
+        Transforms tt {
+            makeTransform("vamp:lib:a", "one", 1024, 512),
+            makeTransform("vamp:lib:b", "one", 1024, 512),
+            makeTransform("vamp:lib:a", "two", 1024, 512),
+            makeTransform("vamp:lib:a", "three", 2048, 512),
+            makeTransform("vamp:lib:b", "two", 1024, 512)
+        };
+        auto groups = FanOut::groupSimilarTransforms(tt);
+        QCOMPARE(int(groups.size()), 3);
+        QCOMPARE(groups[0], vector<int>({ 0, 2 }));
+        QCOMPARE(groups[1], vector<int>({ 1, 4 }));
+        QCOMPARE(groups[2], vector<int>({ 3 }));
+    }
+
+    void passGrouping() {
+        vector<FanOut::PassProperties> plugins {
+            makePlugin(1024, 512, true),        // 0: pass 0
+            makePlugin(1024, 512, false),       // 1: pass 1
+            makePlugin(1024, 512, true),        // 2: pass 0
+            makePlugin(1024, 256, true),        // 3: pass 2
+            makePlugin(1024, 512, false, 2),    // 4: pass 3
+            makePlugin(1024, 512, true),        // 5: window differs
+            makePlugin(1024, 512, false),       // 6: window ignored
+            makePlugin(1024, 512, false),       // 7: start differs
+            makePlugin(2048, 512, false),       // 8: pass 6
+            makePlugin(1024, 512, true)         // 9: duration differs
+        };
+        plugins[5].transform.setWindowType(BlackmanWindow);
+        plugins[6].transform.setWindowType(BlackmanWindow);
+        plugins[7].transform.setStartTime(RealTime(1, 0));
+        plugins[9].transform.setDuration(RealTime(2, 0));
+
+        auto passes = FanOut::groupIntoPasses(plugins);
+        QCOMPARE(passes,
+                 vector<int>({ 0, 1, 0, 2, 3, 4, 1, 5, 6, 7 }));
+
+        QVERIFY(FanOut::groupIntoPasses({}).empty());
+    }
+
+    void outputOrdering() {
+        // Transforms 0 and 2 share a plugin, 1 and 3 belong to one
+        // that failed, and 4 to one that returned no model for it
+        vector<vector<int>> transformNos { { 0, 2 }, { 1, 3 }, { 4 } };
+        vector<ModelTransformer::Models> outputs {
+            { makeId(10), makeId(11) }, { }, { }
+        };
+        auto ordered = FanOut::orderOutputs(5, transformNos, outputs);
+        QCOMPARE(int(ordered.size()), 5);
+        QCOMPARE(ordered[0], makeId(10));
+        QVERIFY(ordered[1].isNone());
+        QCOMPARE(ordered[2], makeId(11));
+        QVERIFY(ordered[3].isNone());
+        QVERIFY(ordered[4].isNone());
+
+        // Plugins that are listed out of transform order
+        transformNos = { { 3 }, { 1, 0 }, { 2 } };
+        outputs = { { makeId(20) }, { makeId(21), makeId(22) },
+                    { makeId(23) } };
+        ordered = FanOut::orderOutputs(4, transformNos, outputs);
+        QCOMPARE(ordered[0], makeId(22));
+        QCOMPARE(ordered[1], makeId(21));
+        QCOMPARE(ordered[2], makeId(23));
+        QCOMPARE(ordered[3], makeId(20));
+    }
+
+    void timeDomainBlocks() {
+        QString zc = "vamp:vamp-example-plugins:zerocrossing";
+        QString af = "vamp:vamp-example-plugins:amplitudefollower";
+        auto factory = TransformFactory::getInstance();
+        if (!factory->haveTransform(zc + ":counts") ||
+            !factory->haveTransform(af + ":amplitude")) {
+            QSKIP("Vamp example plugins not available");
+        }
+
+        auto audio = make_shared<ReadOnlyWaveFileModel>
+            (FileSource(writeSweep()));
+        QVERIFY(audio->isOK());
+        auto audioId = ModelById::add(audio);
+        QTRY_VERIFY(audio->isReady());
+        ModelTransformer::Input input(audioId);
+
+        // Overlapping, adjacent and separated blocks, all running
+        // across several batches
+        vector<pair<int, int>> sizes { { 1024, 256 }, { 1024, 1024 },
+                                       { 512, 700 } };
+
+        for (auto sz: sizes) {
+
+            Transforms tt {
+                makeTransform(zc, "counts", sz.first, sz.second),
+                makeTransform(af, "amplitude", sz.first, sz.second)
+            };
+
+            FanOut fanOut(input, tt, 2);
+            fanOut.start();
+            fanOut.wait();
+            auto outputs = fanOut.getOutputModels();
+            QCOMPARE(int(outputs.size()), 2);
+
+            for (int i = 0; in_range_for(tt, i); ++i) {
+                FeatureExtractionModelTransformer single(input, tt[i]);
+                single.start();
+                single.wait();
+                auto expected = single.getOutputModels();
+                QCOMPARE(int(expected.size()), 1);
+                compareEvents(expected[0], outputs[i]);
+                ModelById::release(expected[0]);
+            }
+
+            for (auto id: outputs) {
+                ModelById::release(id);
+            }
+        }
+
+        ModelById::release(audioId);
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_FEATURE_EXTRACTION_SEGMENTS_H
+#define TEST_FEATURE_EXTRACTION_SEGMENTS_H
+
+#include "../FeatureExtractionModelTransformer.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <limits>
+
+using namespace std;
+
+class TestFeatureExtractionSegments : public QObject
+{
+    Q_OBJECT
+
+    typedef FeatureExtractionModelTransformer FEMT;
+
+    // The block frames visited by the sequential loop in
+    // FeatureExtractionModelTransformer::run, with the same tests
+    // for the end of the input
+    vector<sv_frame_t> sequentialBlocks(sv_frame_t contextStart,
+                                        sv_frame_t duration,
+                                        int stepSize,
+                                        int blockSize,
+                                        bool frequencyDomain) {
+        vector<sv_frame_t> frames;
+        for (sv_frame_t f = contextStart; ; f += stepSize) {
+            if (frequencyDomain) {
+                if (f - blockSize/2 > contextStart + duration) break;
+            } else {
+                if (f >= contextStart + duration) break;
+            }
+            frames.push_back(f);
+        }
+        return frames;
+    }
+
+    void checkPlan(sv_frame_t contextStart, sv_frame_t duration,
+                   int stepSize, int blockSize, bool frequencyDomain,
+                   int maxSegments) {
+
+        auto frames = sequentialBlocks(contextStart, duration,
+                                       stepSize, blockSize, frequencyDomain);
+        int64_t blockCount = FEMT::getBlockCount(duration, stepSize,
+                                                 blockSize, frequencyDomain);
+        QCOMPARE(blockCount, int64_t(frames.size()));
+
+        auto segments = FEMT::planSegments(contextStart, blockCount,
+                                           stepSize, maxSegments);
+        QCOMPARE(int64_t(segments.size()),
+                 min(int64_t(maxSegments), blockCount / 512));
+
+        // Every sequential block is processed, and its features kept,
+        // by exactly one segment
+        for (auto f: frames) {
+            int keptBy = 0;
+            for (const auto &s: segments) {
+                if (f >= s.keepFrom && f < s.keepTo) {
+                    QVERIFY(f >= s.processFrom);
+                    QVERIFY(f < s.processTo);
+                    QCOMPARE((f - s.processFrom) % stepSize, sv_frame_t(0));
+                    ++keptBy;
+                }
+            }
+            QCOMPARE(keptBy, 1);
+        }
+
+        for (int i = 0; in_range_for(segments, i); ++i) {
+            const auto &s = segments[i];
+
+            // No segment processes a block the sequential loop would not
+            QVERIFY(s.processFrom >= contextStart);
+            QVERIFY(s.processTo <= frames.back() + stepSize);
+            QVERIFY(s.processFrom < s.processTo);
+
+            if (i == 0) {
+                QCOMPARE(s.processFrom, contextStart);
+                QCOMPARE(s.keepFrom, sv_frame_t(0));
+            } else {
+                // Warm-up blocks belong to, and end at, the previous
+                // segment
+                QCOMPARE(s.keepFrom, segments[i-1].keepTo);
+                QCOMPARE(s.processFrom,
+                         max(contextStart, s.keepFrom - 8 * stepSize));
+                QVERIFY(s.keepFrom - s.processFrom <= 8 * stepSize);
+            }
+
+            // The remaining features each segment returns at the end
+            // are stamped with its processTo frame. Only the last
+            // segment's are kept, at the same frame as those the
+            // sequential loop would return
+            if (i + 1 < int(segments.size())) {
+                QCOMPARE(s.keepTo, s.processTo);
+                QVERIFY((s.keepTo - s.keepFrom) / stepSize >= 512);
+            } else {
+                QCOMPARE(s.keepTo, numeric_limits<sv_frame_t>::max());
+                QCOMPARE(s.processTo, frames.back() + stepSize);
+                QVERIFY((s.processTo - s.keepFrom) / stepSize >= 512);
+            }
+        }
+    }
+
+private slots:
+    void blockCounts() {
+        QCOMPARE(FEMT::getBlockCount(0, 512, 1024, false), int64_t(0));
+        QCOMPARE(FEMT::getBlockCount(1000, 0, 1024, false), int64_t(0));
+        QCOMPARE(FEMT::getBlockCount(1024, 512, 1024, false), int64_t(2));
+        QCOMPARE(FEMT::getBlockCount(1025, 512, 1024, false), int64_t(3));
+        QCOMPARE(FEMT::getBlockCount(1024, 512, 1024, true), int64_t(4));
+        QCOMPARE(FEMT::getBlockCount(1023, 512, 1024, true), int64_t(3));
+    }
+
+    void timeDomainPlan() {
+        checkPlan(0, 44100 * 60, 512, 1024, false, 4);
+        checkPlan(0, 44100 * 60 + 1, 512, 1024, false, 4);
+        checkPlan(0, 44100 * 600, 1024, 1024, false, 7);
+        checkPlan(0, 44100 * 600, 700, 512, false, 16);
+        checkPlan(1000, 44100 * 60, 256, 2048, false, 3);
+        checkPlan(0, 1024 * 512, 512, 1024, false, 8);
+    }
+
+    void frequencyDomainPlan() {
+        checkPlan(0, 44100 * 60, 512, 1024, true, 4);
+        checkPlan(0, 44100 * 60 + 1, 512, 1024, true, 4);
+        checkPlan(0, 44100 * 600, 1024, 1024, true, 7);
+        checkPlan(0, 44100 * 600, 256, 4096, true, 16);
+        checkPlan(1000, 44100 * 60, 256, 2048, true, 3);
+    }
+
+    void tooShort() {
+        QVERIFY(FEMT::planSegments(0, 1023, 512, 8).empty());
+        QCOMPARE(int(FEMT::planSegments(0, 1024, 512, 8).size()), 2);
+        QVERIFY(FEMT::planSegments(0, 100000, 512, 1).empty());
+        QVERIFY(FEMT::planSegments(0, 0, 512, 8).empty());
+    }
+};
+
+#endif
@@ -0,0 +1,311 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_TRANSFORM_RESULT_CACHE_H
+#define TEST_TRANSFORM_RESULT_CACHE_H
+
+#include "../TransformResultCache.h"
+
+#include "data/model/SparseOneDimensionalModel.h"
+#include "data/model/SparseTimeValueModel.h"
+#include "data/model/NoteModel.h"
+#include "data/model/RegionModel.h"
+#include "data/model/BasicCompressedDenseThreeDimensionalModel.h"
+#include "data/model/ReadOnlyWaveFileModel.h"
+#include "data/fileio/WavFileWriter.h"
+#include "data/fileio/FileSource.h"
+#include "data/fileio/test/AudioTestData.h"
+
+#include "base/TempDirectory.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QDir>
+#include <QFile>
+
+using namespace std;
+
+class TestTransformResultCache : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_dir;
+    int64_t m_maximumSize;
+
+    TransformResultCache *cache() {
+        return TransformResultCache::getInstance();
+    }
+
+    QString entryPath(QString key) {
+        return QDir(TempDirectory::getInstance()->getContainingPath())
+            .filePath("transform-cache/" + key + ".svtc");
+    }
+
+    // One event for each combination of the optional properties
+    EventVector allFlagEvents() {
+        EventVector ee;
+        for (int flags = 0; flags < 64; ++flags) {
+            Event e(sv_frame_t(flags) * 100);
+            if (flags & 1) e = e.withValue(float(flags) * 0.5f);
+            if (flags & 2) e = e.withDuration(flags + 10);
+            if (flags & 4) e = e.withLevel(float(flags) / 64.f);
+            if (flags & 8) e = e.withReferenceFrame(flags * 7);
+            if (flags & 16) e = e.withLabel(QString("label %1 \"&\"").arg(flags));
+            if (flags & 32) e = e.withURI(QString("file:///%1").arg(flags));
+            ee.push_back(e);
+        }
+        return ee;
+    }
+
+    template <typename M>
+    void roundTripEvents(QString key) {
+        auto source = make_shared<M>(100, 10, false);
+        source->addEvents(allFlagEvents());
+        auto sourceId = ModelById::add(source);
+        QVERIFY(cache()->store(key, sourceId));
+
+        auto target = make_shared<M>(100, 10, false);
+        auto targetId = ModelById::add(target);
+        QVERIFY(cache()->restore({ key }, { targetId }));
+
+        EventVector a = source->getAllEvents();
+        EventVector b = target->getAllEvents();
+        QCOMPARE(b.size(), a.size());
+        for (int i = 0; in_range_for(a, i); ++i) {
+            QCOMPARE(b[i], a[i]);
+        }
+
+        ModelById::release(targetId);
+        ModelById::release(sourceId);
+    }
+
+    void storeEvents(QString key) {
+        auto source = make_shared<SparseTimeValueModel>(100, 10, false);
+        source->addEvents(allFlagEvents());
+        auto sourceId = ModelById::add(source);
+        QVERIFY(cache()->store(key, sourceId));
+        ModelById::release(sourceId);
+    }
+
+    // Restore the given entries into fresh models, setting
+    // firstCount to the number of events that ended up in the first
+    bool restoreEvents(vector<QString> keys, int &firstCount) {
+        vector<shared_ptr<SparseTimeValueModel>> models;
+        ModelTransformer::Models ids;
+        for (int i = 0; in_range_for(keys, i); ++i) {
+            models.push_back(make_shared<SparseTimeValueModel>(100, 10, false));
+            ids.push_back(ModelById::add(models[i]));
+        }
+        bool result = cache()->restore(keys, ids);
+        firstCount = models[0]->getEventCount();
+        for (auto id: ids) {
+            ModelById::release(id);
+        }
+        return result;
+    }
+
+    bool restoreEvents(QString key) {
+        int count = 0;
+        return restoreEvents({ key }, count);
+    }
+
+private slots:
+    void initTestCase() {
+        m_maximumSize = cache()->getMaximumSize();
+        cache()->setEnabled(true);
+        cache()->clear();
+    }
+
+    void cleanupTestCase() {
+        cache()->clear();
+        cache()->setMaximumSize(m_maximumSize);
+        cache()->setEnabled(false);
+    }
+
+    void events() {
+        roundTripEvents<SparseOneDimensionalModel>("events-1d");
+        roundTripEvents<SparseTimeValueModel>("events-tv");
+        roundTripEvents<NoteModel>("events-note");
+        roundTripEvents<RegionModel>("events-region");
+    }
+
+    void denseColumns() {
+        auto source = make_shared<BasicCompressedDenseThreeDimensionalModel>
+            (100, 10, 4, false);
+        for (int x = 0; x < 20; ++x) {
+            DenseThreeDimensionalModel::Column column;
+            for (int y = 0; y < 4; ++y) {
+                column.push_back(float(x * 4 + y) / 7.f);
+            }
+            source->setColumn(x, column);
+        }
+        auto sourceId = ModelById::add(source);
+        QVERIFY(cache()->store("dense", sourceId));
+
+        auto target = make_shared<BasicCompressedDenseThreeDimensionalModel>
+            (100, 10, 4, false);
+        auto targetId = ModelById::add(target);
+        QVERIFY(cache()->restore({ "dense" }, { targetId }));
+
+        QCOMPARE(target->getWidth(), source->getWidth());
+        for (int x = 0; x < source->getWidth(); ++x) {
+            auto a = source->getColumn(x);
+            auto b = target->getColumn(x);
+            QCOMPARE(b.size(), a.size());
+            for (int y = 0; in_range_for(a, y); ++y) {
+                QCOMPARE(b[y], a[y]);
+            }
+        }
+
+        // An entry of events does not restore into a dense model
+        storeEvents("not-dense");
+        auto other = make_shared<BasicCompressedDenseThreeDimensionalModel>
+            (100, 10, 4, false);
+        auto otherId = ModelById::add(other);
+        QVERIFY(!cache()->restore({ "not-dense" }, { otherId }));
+        QCOMPARE(other->getWidth(), 0);
+
+        ModelById::release(otherId);
+        ModelById::release(targetId);
+        ModelById::release(sourceId);
+    }
+
+    void missingEntry() {
+        storeEvents("present");
+        QVERIFY(restoreEvents("present"));
+        QVERIFY(!restoreEvents("absent"));
+
+        // Nothing is restored unless everything is
+        int count = 0;
+        QVERIFY(!restoreEvents({ "present", "absent" }, count));
+        QCOMPARE(count, 0);
+    }
+
+    void corruptEntry() {
+        storeEvents("intact");
+        storeEvents("truncated");
+        storeEvents("garbled");
+
+        QFile truncated(entryPath("truncated"));
+        QVERIFY(truncated.open(QFile::ReadWrite));
+        QVERIFY(truncated.resize(truncated.size() / 2));
+        truncated.close();
+
+        QFile garbled(entryPath("garbled"));
+        QVERIFY(garbled.open(QFile::WriteOnly | QFile::Truncate));
+        garbled.write("not a cache entry at all");
+        garbled.close();
+
+        int count = 0;
+        QVERIFY(!restoreEvents({ "intact", "truncated" }, count));
+        QCOMPARE(count, 0);
+        QVERIFY(!restoreEvents({ "intact", "garbled" }, count));
+        QCOMPARE(count, 0);
+        QVERIFY(restoreEvents({ "intact" }, count));
+        QCOMPARE(count, 64);
+    }
+
+    void keys() {
+        QString path = m_dir.filePath("keys.wav");
+        {
+            AudioTestData data(44100, 2);
+            WavFileWriter writer(path, 44100, 2, WavFileWriter::WriteToTarget);
+            float *interleaved = data.getInterleavedData();
+            writer.putInterleavedFrames
+                (floatvec_t(interleaved,
+                            interleaved + data.getFrameCount() * 2));
+            QVERIFY(writer.close());
+        }
+
+        auto audio = make_shared<ReadOnlyWaveFileModel>(FileSource(path));
+        QVERIFY(audio->isOK());
+        auto audioId = ModelById::add(audio);
+
+        Transform t;
+        t.setPluginIdentifier("vamp:test-library:test-plugin");
+        t.setOutput("output");
+        t.setStepSize(512);
+        t.setBlockSize(1024);
+
+        ModelTransformer::Input input(audioId, 0);
+        QString key = cache()->getKey(t, input, "1");
+        QVERIFY(key != "");
+        QCOMPARE(cache()->getKey(t, input, "1"), key);
+
+        QVERIFY(cache()->getKey(t, ModelTransformer::Input(audioId, 1), "1")
+                != key);
+        QVERIFY(cache()->getKey(t, ModelTransformer::Input(audioId, -1), "1")
+                != key);
+        QVERIFY(cache()->getKey(t, input, "2") != key);
+
+        Transform t1(t);
+        t1.setParameter("threshold", 0.5f);
+        QVERIFY(cache()->getKey(t1, input, "1") != key);
+
+        Transform t2(t);
+        t2.setOutput("other-output");
+        QVERIFY(cache()->getKey(t2, input, "1") != key);
+
+        Transform t3(t);
+        t3.setStepSize(256);
+        QVERIFY(cache()->getKey(t3, input, "1") != key);
+
+        // Only audio read from a file has contents to hash
+        auto events = make_shared<SparseTimeValueModel>(44100, 512, false);
+        auto eventsId = ModelById::add(events);
+        QCOMPARE(cache()->getKey(t, ModelTransformer::Input(eventsId), "1"),
+                 QString());
+
+        QTRY_VERIFY(audio->isReady());
+        ModelById::release(eventsId);
+        ModelById::release(audioId);
+    }
+
+    void evictLeastRecentlyUsed() {
+#if (QT_VERSION < QT_VERSION_CHECK(5, 10, 0))
+        QSKIP("Entries can't be marked as used with this version of Qt");
+#endif
+        cache()->clear();
+        cache()->setMaximumSize(m_maximumSize);
+
+        // Modification times may only be accurate to the second
+        storeEvents("lru-a");
+        QThread::msleep(1100);
+        storeEvents("lru-b");
+        QThread::msleep(1100);
+        storeEvents("lru-c");
+        int64_t entrySize = cache()->getCurrentSize() / 3;
+        QVERIFY(entrySize > 0);
+
+        // Using the oldest entry makes the second one the least
+        // recently used
+        QThread::msleep(1100);
+        QVERIFY(restoreEvents("lru-a"));
+
+        int64_t evictions = cache()->getCounts().evictions;
+        cache()->setMaximumSize(entrySize * 2 + entrySize / 2);
+        QCOMPARE(cache()->getCounts().evictions, evictions + 1);
+        QVERIFY(cache()->getCurrentSize() <= entrySize * 2 + entrySize / 2);
+
+        QVERIFY(!restoreEvents("lru-b"));
+        QVERIFY(restoreEvents("lru-a"));
+        QVERIFY(restoreEvents("lru-c"));
+
+        cache()->setMaximumSize(m_maximumSize);
+    }
+};
+
+#endif
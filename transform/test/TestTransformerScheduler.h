@@ -0,0 +1,171 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_TRANSFORMER_SCHEDULER_H
+#define TEST_TRANSFORMER_SCHEDULER_H
+
+#include "../TransformerScheduler.h"
+#include "../ModelTransformer.h"
+
+#include "base/Debug.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+// A transformer that is never started: the tests call the scheduler
+// on its behalf from their own threads
+class MockTransformer : public ModelTransformer
+{
+public:
+    MockTransformer() : ModelTransformer(Input(ModelId()), Transform()) { }
+    void awaitOutputModels() override { }
+protected:
+    void run() override { }
+};
+
+class TestTransformerScheduler : public QObject
+{
+    Q_OBJECT
+
+    // Abandon t if it is still waiting for a slot after the given
+    // time, so that a test of a case that used to deadlock fails
+    // instead of hanging
+    class Watchdog {
+    public:
+        Watchdog(MockTransformer *t, int msec) :
+            m_done(false),
+            m_thread([=]() {
+                         for (int waited = 0; waited < msec; waited += 10) {
+                             if (m_done) return;
+                             this_thread::sleep_for(chrono::milliseconds(10));
+                         }
+                         t->abandon();
+                     }) { }
+        ~Watchdog() {
+            m_done = true;
+            m_thread.join();
+        }
+    private:
+        atomic<bool> m_done;
+        thread m_thread;
+    };
+
+private slots:
+    void init() {
+        TransformerScheduler::getInstance()->setWorkerCount(1);
+    }
+
+    void cleanup() {
+        TransformerScheduler::getInstance()->setWorkerCount(0);
+    }
+
+    void acquireRelease() {
+        auto s = TransformerScheduler::getInstance();
+        MockTransformer a, b;
+        QVERIFY(s->acquire(&a));
+        QVERIFY(s->acquire(&a)); // already has its slot
+        {
+            Watchdog w(&b, 300);
+            QVERIFY(!s->acquire(&b)); // no free slot: abandoned waiting
+        }
+        s->release(&b);
+        s->release(&a);
+        QCOMPARE(s->getMetrics().running, 0);
+    }
+
+    void extraSlots() {
+        auto s = TransformerScheduler::getInstance();
+        s->setWorkerCount(3);
+        MockTransformer a, b;
+        QCOMPARE(s->claimExtraSlots(&a, 2), 0); // has no slot itself
+        QVERIFY(s->acquire(&a));
+        QCOMPARE(s->claimExtraSlots(&a, 5), 2);
+        QCOMPARE(s->getMetrics().running, 3);
+        {
+            Watchdog w(&b, 300);
+            QVERIFY(!s->acquire(&b)); // all slots taken
+        }
+        s->releaseExtraSlots(&a);
+        QCOMPARE(s->getMetrics().running, 1);
+        QCOMPARE(s->claimExtraSlots(&a, 1), 1);
+
+        // Extra slots go with the transformer's own
+        s->release(&a);
+        QCOMPARE(s->getMetrics().running, 0);
+    }
+
+    void suspendedConsumer() {
+        // A consumer with the only slot and a higher priority than
+        // its producer suspends itself while it waits for input. The
+        // producer must then get the slot, even though the consumer
+        // is still ahead of it in the queue
+        auto s = TransformerScheduler::getInstance();
+        MockTransformer consumer, producer;
+        consumer.setPriority(10);
+        QVERIFY(s->acquire(&consumer));
+        QVERIFY(s->suspend(&consumer));
+        {
+            Watchdog w(&producer, 2000);
+            QVERIFY(s->acquire(&producer));
+        }
+        QCOMPARE(s->getMetrics().running, 1);
+
+        // Once the producer is done, the consumer resumes
+        s->release(&producer);
+        QVERIFY(s->acquire(&consumer));
+        QCOMPARE(s->getMetrics().running, 1);
+        s->release(&consumer);
+        QCOMPARE(s->getMetrics().running, 0);
+    }
+
+    void resumedConsumerKeepsPlace() {
+        // A suspended consumer that asks for its slot back is queued
+        // ahead of a transformer that arrived while it was suspended
+        auto s = TransformerScheduler::getInstance();
+        MockTransformer consumer, producer, other;
+        QVERIFY(s->acquire(&consumer));
+        QVERIFY(s->suspend(&consumer));
+        QVERIFY(s->acquire(&producer));
+
+        atomic<bool> otherAcquired(false);
+        thread t([&]() {
+                     otherAcquired = s->acquire(&other);
+                 });
+        this_thread::sleep_for(chrono::milliseconds(100));
+
+        thread r([&]() {
+                     this_thread::sleep_for(chrono::milliseconds(100));
+                     s->release(&producer);
+                 });
+        {
+            Watchdog w(&consumer, 2000);
+            QVERIFY(s->acquire(&consumer));
+        }
+        r.join();
+        QVERIFY(!otherAcquired);
+
+        s->release(&consumer);
+        t.join();
+        QVERIFY(otherAcquired);
+        s->release(&other);
+    }
+};
+
+#endif
@@ -0,0 +1,9 @@
+TEST_HEADERS = \
+	     TestBatchAnalysisRunner.h \
+	     TestFeatureExtractionFanOut.h \
+	     TestFeatureExtractionSegments.h \
+	     TestTransformResultCache.h \
+	     TestTransformerScheduler.h
+	     
+TEST_SOURCES += \
+	     svcore-transform-test.cpp